@@ -0,0 +1,318 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Checks run_classifier_continuous_batch against run_classifier_stream_continuous
+// on one stream at a time and times it:
+//  - every stream gets the same classifications, in the same order,
+//  - a stream in the middle of the batch that is canceled while its slice is
+//    added, or while its window is classified, stops the batch: the call
+//    returns EI_IMPULSE_CANCELED, the streams before it keep their result and
+//    every stream it left out has EI_IMPULSE_CANCELED in errors.
+// Cancellation goes through ei_run_impulse_check_canceled, which this file
+// overrides (the posix porting one is weak). Exits non-zero if a check fails.
+//
+//   continuous_batch_benchmark [repeat]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "model-parameters/model_metadata.h"
+
+namespace {
+
+const size_t kStreamCount = 4;
+const size_t kCanceledStream = 2;
+const size_t kSlicesPerStream = 6 * EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+
+// Checks of ei_run_impulse_check_canceled that pass before it cancels, -1 to
+// never cancel
+long cancel_countdown = -1;
+size_t cancel_checks = 0;
+
+typedef std::vector<float> Classifications;
+
+// Tones that change pitch every quarter second plus noise, a different part
+// of it for every stream
+std::vector<float> TestAudio() {
+  std::vector<int16_t> audio(kSlicesPerStream * EI_CLASSIFIER_SLICE_SIZE +
+                             kStreamCount * 1111);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < audio.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    audio[i] = static_cast<int16_t>(
+        3000 * sin(i * 0.05 * (1 + (i / 4000) % 3)) +
+        static_cast<int>((seed >> 16) % 400) - 200);
+  }
+  std::vector<float> samples(audio.size());
+  numpy::int16_to_float(audio.data(), samples.data(), audio.size());
+  return samples;
+}
+
+float* StreamSlice(std::vector<float>* audio, size_t stream, size_t slice) {
+  return &(*audio)[stream * 1111 + slice * EI_CLASSIFIER_SLICE_SIZE];
+}
+
+void AppendClassification(const ei_impulse_result_t& result,
+                          Classifications* values) {
+  for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+    values->push_back(result.classification[ix].value);
+  }
+}
+
+struct Batch {
+  ei_classifier_stream_t streams[kStreamCount];
+  ei_classifier_stream_t* stream_pointers[kStreamCount];
+  signal_t signals[kStreamCount];
+  signal_t* signal_pointers[kStreamCount];
+  ei_impulse_result_t results[kStreamCount];
+  EI_IMPULSE_ERROR errors[kStreamCount];
+
+  bool Init() {
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      if (run_classifier_stream_init(&streams[ix]) != EI_IMPULSE_OK) {
+        return false;
+      }
+      stream_pointers[ix] = &streams[ix];
+      signal_pointers[ix] = &signals[ix];
+    }
+    return true;
+  }
+
+  void Deinit() {
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      run_classifier_stream_deinit(&streams[ix]);
+    }
+  }
+
+  EI_IMPULSE_ERROR Run(std::vector<float>* audio, size_t slice) {
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      numpy::signal_from_buffer(StreamSlice(audio, ix, slice),
+                                EI_CLASSIFIER_SLICE_SIZE, &signals[ix]);
+    }
+    return run_classifier_continuous_batch(stream_pointers, signal_pointers,
+                                           results, errors, kStreamCount, false);
+  }
+};
+
+// run_classifier_stream_continuous, one stream after the other
+bool ReferenceResults(std::vector<float>* audio,
+                      std::vector<Classifications>* values) {
+  values->assign(kStreamCount, Classifications());
+  for (size_t stream_ix = 0; stream_ix < kStreamCount; stream_ix++) {
+    ei_classifier_stream_t stream;
+    if (run_classifier_stream_init(&stream) != EI_IMPULSE_OK) {
+      return false;
+    }
+    for (size_t slice_ix = 0; slice_ix < kSlicesPerStream; slice_ix++) {
+      signal_t signal;
+      numpy::signal_from_buffer(StreamSlice(audio, stream_ix, slice_ix),
+                                EI_CLASSIFIER_SLICE_SIZE, &signal);
+      ei_impulse_result_t result = {0};
+      if (run_classifier_stream_continuous(&stream, &signal, &result, false) !=
+          EI_IMPULSE_OK) {
+        run_classifier_stream_deinit(&stream);
+        return false;
+      }
+      if (stream.feature_buffer_full) {
+        AppendClassification(result, &(*values)[stream_ix]);
+      }
+    }
+    run_classifier_stream_deinit(&stream);
+  }
+  return true;
+}
+
+bool CheckBatch(std::vector<float>* audio,
+                const std::vector<Classifications>& reference, int repeat) {
+  Batch batch;
+  if (!batch.Init()) {
+    printf("batch: stream init failed\n");
+    return false;
+  }
+
+  bool ok = true;
+  std::vector<Classifications> values(kStreamCount);
+  for (size_t slice_ix = 0; slice_ix < kSlicesPerStream; slice_ix++) {
+    if (batch.Run(audio, slice_ix) != EI_IMPULSE_OK) {
+      ok = false;
+      break;
+    }
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      if (batch.streams[ix].feature_buffer_full) {
+        AppendClassification(batch.results[ix], &values[ix]);
+      }
+    }
+  }
+  batch.Deinit();
+
+  for (size_t ix = 0; ix < kStreamCount; ix++) {
+    ok &= values[ix] == reference[ix];
+  }
+  printf("batch of %u streams against one stream at a time  %s\n",
+         static_cast<unsigned>(kStreamCount), ok ? "MATCH" : "MISMATCH");
+
+  if (!batch.Init()) {
+    return false;
+  }
+  const uint64_t start_us = ei_read_timer_us();
+  for (int rep = 0; rep < repeat; rep++) {
+    for (size_t slice_ix = 0; slice_ix < kSlicesPerStream; slice_ix++) {
+      batch.Run(audio, slice_ix);
+    }
+  }
+  const uint64_t elapsed_us = ei_read_timer_us() - start_us;
+  batch.Deinit();
+  printf("  %.1f us per stream slice\n",
+         elapsed_us / static_cast<double>(repeat * kSlicesPerStream * kStreamCount));
+  return ok;
+}
+
+// Fills the windows of all streams, then runs one more batch that is canceled
+// on check number cancel_at (counted from the start of that batch, -1 for
+// never)
+bool RunCanceled(std::vector<float>* audio, long cancel_at,
+                 EI_IMPULSE_ERROR* res, EI_IMPULSE_ERROR* errors,
+                 size_t* checks) {
+  Batch batch;
+  if (!batch.Init()) {
+    return false;
+  }
+  for (size_t slice_ix = 0; slice_ix < EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+       slice_ix++) {
+    if (batch.Run(audio, slice_ix) != EI_IMPULSE_OK) {
+      batch.Deinit();
+      return false;
+    }
+  }
+
+  cancel_checks = 0;
+  cancel_countdown = cancel_at;
+  *res = batch.Run(audio, EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
+  *checks = cancel_checks;
+  cancel_countdown = -1;
+
+  for (size_t ix = 0; ix < kStreamCount; ix++) {
+    errors[ix] = batch.errors[ix];
+  }
+  batch.Deinit();
+  return true;
+}
+
+bool CheckCancel(std::vector<float>* audio) {
+  EI_IMPULSE_ERROR res;
+  EI_IMPULSE_ERROR errors[kStreamCount];
+
+  // How often a batch with full windows checks for cancellation: slice_checks
+  // per stream while the slices are added, window_checks per stream while the
+  // windows are classified
+  size_t total_checks;
+  if (!RunCanceled(audio, -1, &res, errors, &total_checks)) {
+    printf("batch cancel: setup failed  MISMATCH\n");
+    return false;
+  }
+  cancel_checks = 0;
+  {
+    Batch batch;
+    if (!batch.Init()) {
+      return false;
+    }
+    batch.Run(audio, 0);
+    batch.Deinit();
+  }
+  const size_t slice_checks = cancel_checks / kStreamCount;
+  const size_t window_checks = (total_checks - cancel_checks) / kStreamCount;
+  if (slice_checks == 0 || window_checks == 0) {
+    printf("batch cancel: %u checks per slice, %u per window, nothing to "
+           "cancel  MISMATCH\n",
+           static_cast<unsigned>(slice_checks),
+           static_cast<unsigned>(window_checks));
+    return false;
+  }
+
+  struct Phase {
+    const char* name;
+    size_t cancel_at;
+  };
+  const Phase phases[] = {
+    { "adding its slice", kCanceledStream * slice_checks },
+    { "classifying its window",
+      kStreamCount * slice_checks + kCanceledStream * window_checks },
+  };
+
+  bool ok = true;
+  for (const Phase& phase : phases) {
+    size_t checks;
+    const bool ran = RunCanceled(audio, static_cast<long>(phase.cancel_at), &res,
+                                 errors, &checks);
+    const bool slice_phase = phase.cancel_at < kStreamCount * slice_checks;
+
+    // In the slice phase no window got classified, so every stream is
+    // canceled. In the window phase the streams before the canceled one have
+    // their result.
+    bool match = ran && res == EI_IMPULSE_CANCELED;
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      const EI_IMPULSE_ERROR expected =
+          (slice_phase || ix >= kCanceledStream) ? EI_IMPULSE_CANCELED
+                                                 : EI_IMPULSE_OK;
+      match &= errors[ix] == expected;
+    }
+    printf("batch canceled in stream %u of %u while %s: returns %d, errors",
+           static_cast<unsigned>(kCanceledStream),
+           static_cast<unsigned>(kStreamCount), phase.name, res);
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      printf(" %d", errors[ix]);
+    }
+    printf("  %s\n", match ? "MATCH" : "MISMATCH");
+    ok &= match;
+  }
+  return ok;
+}
+
+}  // namespace
+
+EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
+  cancel_checks++;
+  if (cancel_countdown < 0) {
+    return EI_IMPULSE_OK;
+  }
+  return cancel_countdown-- == 0 ? EI_IMPULSE_CANCELED : EI_IMPULSE_OK;
+}
+
+int main(int argc, char** argv) {
+  const int repeat = argc > 1 ? atoi(argv[1]) : 10;
+
+  std::vector<float> audio = TestAudio();
+  std::vector<Classifications> reference;
+  if (!ReferenceResults(&audio, &reference)) {
+    printf("reference run failed\n");
+    return 1;
+  }
+
+  bool ok = CheckBatch(&audio, reference, repeat);
+  ok &= CheckCancel(&audio);
+  run_classifier_deinit();
+  return ok ? 0 : 1;
+}
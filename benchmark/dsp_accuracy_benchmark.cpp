@@ -0,0 +1,607 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Checks the DSP approximations against exact references and times them:
+//  - fast_math::log and fast_math::exp (array versions, so the vector unit
+//    picked by EIDSP_USE_FAST_MATH is what runs) against libm in double, with
+//    the error bounds documented in fast_math.hpp, and exp below its clamp,
+//  - fast_math::softmax against reference_ops::Softmax over random rows,
+//    the argmax has to be the same for every row,
+//  - the MFE / MFCC front end (sparse batched filterbank, precomputed DCT
+//    basis) against the dense path it replaced, on a fixed window of tones, a
+//    chirp, noise and silence,
+//  - cmvnw with running sums against the padded window loop it replaced, on
+//    the MFCC of that window,
+//  - cmvnw_quantized on rows spread over a ring against cmvnw and
+//    quantize_int8,
+//  - the fixed point MFCC against the float one, before and after cmvnw.
+// Exits non-zero if a check fails.
+//
+//   dsp_accuracy_benchmark [iterations]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "edge-impulse-sdk/dsp/fast_math.hpp"
+#include "edge-impulse-sdk/dsp/speechpy/speechpy.hpp"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/softmax.h"
+
+namespace {
+
+// The bounds documented in fast_math.hpp
+const double kLogMaxAbsError = 2.3e-5;
+const double kExpMaxUlp = 1.4;
+
+// Filterbank outputs only differ by the float rounding of the summation order
+const double kMfeMaxRelError = 1e-6;
+// Precomputed DCT basis against the FFT based numpy::dct2 it replaced. Both
+// round a num_filters term sum in float, so the error is relative to the
+// magnitude of the row, sqrt(2 / num_filters) * sum(|log mel|).
+const double kDctMaxRelError = 1e-6;
+// Running sums in double against window sums in float, relative to the
+// largest normalized feature
+const double kCmvnwMaxRelError = 1e-5;
+// Fixed point MFCC against the float one (documented with mfcc_q15)
+const double kMfccQ15MaxAbsError = 0.0035;
+const double kMfccQ15CmvnwMaxAbsError = 0.0025;
+
+// The MFCC block of the model (model_metadata.h), without pre-emphasis so the
+// dense reference below doesn't need it
+const uint32_t kSamplingFrequency = 16000;
+const float kFrameLength = 0.02f;
+const float kFrameStride = 0.02f;
+const uint8_t kNumCepstral = 13;
+const uint16_t kNumFilters = 32;
+const uint16_t kFftLength = 256;
+const uint32_t kLowFrequency = 300;
+const uint32_t kHighFrequency = kSamplingFrequency / 2;
+const uint16_t kCmvnwWinSize = 101;
+const float kPreCof = 0.98f;
+
+uint32_t rand_state = 1;
+float RandomFloat() {
+  rand_state = rand_state * 1103515245 + 12345;
+  return ((rand_state >> 8) & 0xffff) / 65535.0f;
+}
+
+double MicrosecondsSince(std::chrono::steady_clock::time_point start,
+                         int iterations) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+const char* VectorUnit() {
+#if defined(EIDSP_FAST_MATH_CMSIS)
+  return "CMSIS-DSP";
+#elif defined(EIDSP_FAST_MATH_AVX2)
+  return "AVX2";
+#elif defined(EIDSP_FAST_MATH_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+// One second of int16 audio scaled to [-1, 1) like numpy::int16_to_float: two
+// tones, a 100 Hz - 7 kHz chirp, noise and silence, a quarter second each
+std::vector<float> TestWindow() {
+  const float kPi = 3.14159265358979f;
+  const size_t quarter = kSamplingFrequency / 4;
+  std::vector<float> window(kSamplingFrequency);
+  uint32_t noise_state = 7;
+  for (size_t i = 0; i < window.size(); i++) {
+    const float t = (float)i / kSamplingFrequency;
+    float v = 0;
+    if (i < quarter) {
+      v = 6000.0f * sinf(2 * kPi * 440.0f * t) + 3000.0f * sinf(2 * kPi * 2500.0f * t);
+    } else if (i < 2 * quarter) {
+      const float ct = t - 0.25f;
+      v = 8000.0f * sinf(2 * kPi * (100.0f * ct + 0.5f * 27600.0f * ct * ct));
+    } else if (i < 3 * quarter) {
+      noise_state = noise_state * 1103515245 + 12345;
+      v = (float)((noise_state >> 8) & 0xffff) - 32768.0f;
+    }
+    window[i] = roundf(v) / 32768.0f;
+  }
+  return window;
+}
+
+int FrameCount(size_t samples) {
+  return ei::speechpy::processing::calculate_no_of_stack_frames(
+      samples, kSamplingFrequency, kFrameLength, kFrameStride, false);
+}
+
+// The dense MFE the sparse filterbank replaced: power spectrum per frame
+// through a full num_filters x (fft_length / 2 + 1) filterbank matrix
+bool ReferenceMfe(const std::vector<float>& window, std::vector<float>* features,
+                  std::vector<float>* energies) {
+  const size_t frame_length = (size_t)roundf(kSamplingFrequency * kFrameLength);
+  const size_t frame_stride = (size_t)roundf(kSamplingFrequency * kFrameStride);
+  const size_t bins = kFftLength / 2 + 1;
+  const int frames = FrameCount(window.size());
+
+#if EIDSP_QUANTIZE_FILTERBANK
+  ei::quantized_matrix_t filterbank(kNumFilters, bins, &ei::numpy::dequantize_zero_one);
+#else
+  ei::matrix_t filterbank(kNumFilters, bins);
+#endif
+  if (ei::speechpy::feature::filterbanks(&filterbank, kNumFilters, bins, kSamplingFrequency,
+                                         kLowFrequency, kHighFrequency, true) != ei::EIDSP_OK) {
+    return false;
+  }
+
+  std::vector<float> power(bins);
+  features->assign(frames * kNumFilters, 0.0f);
+  energies->assign(frames, 0.0f);
+  ei::matrix_t out_matrix(frames, kNumFilters, features->data());
+  for (int ix = 0; ix < frames; ix++) {
+    if (ei::numpy::rfft(&window[ix * frame_stride], frame_length, power.data(), bins,
+                        kFftLength) != ei::EIDSP_OK) {
+      return false;
+    }
+    for (size_t k = 0; k < bins; k++) {
+      power[k] = (1.0f / kFftLength) * (power[k] * power[k]);
+    }
+
+    const float energy = ei::numpy::sum(power.data(), bins);
+    (*energies)[ix] = energy == 0 ? FLT_EPSILON : energy;
+    if (ei::numpy::dot_by_row(ix, power.data(), bins, &filterbank, &out_matrix) != ei::EIDSP_OK) {
+      return false;
+    }
+  }
+  ei::speechpy::functions::zero_handling(&out_matrix);
+  return true;
+}
+
+bool CheckMfe(const std::vector<float>& window) {
+  std::vector<float> reference, reference_energies;
+  if (!ReferenceMfe(window, &reference, &reference_energies)) {
+    printf("mfe: reference failed  MISMATCH\n");
+    return false;
+  }
+
+  std::vector<float> samples(window), out(reference.size()), energies(reference_energies.size());
+  ei::signal_t signal;
+  ei::numpy::signal_from_buffer(samples.data(), samples.size(), &signal);
+  ei::matrix_t out_matrix(energies.size(), kNumFilters, out.data());
+  ei::matrix_t energy_matrix(energies.size(), 1, energies.data());
+  ei::speechpy::mfcc_plan_t plan;
+  int ret = ei::speechpy::feature::create_mfcc_plan(&plan, kSamplingFrequency, kFrameLength,
+      kFrameStride, 0, kNumFilters, kFftLength, kLowFrequency, kHighFrequency);
+  if (ret == ei::EIDSP_OK) {
+    ret = ei::speechpy::feature::mfe(&out_matrix, &energy_matrix, &signal, &plan);
+    ei::speechpy::feature::free_mfcc_plan(&plan);
+  }
+
+  double max_error = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    max_error = fmax(max_error, fabs((double)out[i] - reference[i]) / reference[i]);
+  }
+  for (size_t i = 0; i < energies.size(); i++) {
+    max_error = fmax(max_error, fabs((double)energies[i] - reference_energies[i]) /
+                                    reference_energies[i]);
+  }
+  const bool match = ret == ei::EIDSP_OK && max_error <= kMfeMaxRelError;
+
+  printf("mfe, %u frames against the dense filterbank\n", (unsigned)energies.size());
+  printf("  max rel error %.3g (bound %.3g)  %s\n", max_error, kMfeMaxRelError,
+         match ? "MATCH" : "MISMATCH");
+  return match;
+}
+
+// MFCC of the window, `pre_cof` 0 for no pre-emphasis
+bool Mfcc(const std::vector<float>& window, float pre_cof, std::vector<float>* out) {
+  std::vector<float> samples(window);
+  ei::signal_t signal;
+  ei::numpy::signal_from_buffer(samples.data(), samples.size(), &signal);
+  out->assign(FrameCount(window.size()) * kNumCepstral, 0.0f);
+  ei::matrix_t out_matrix(FrameCount(window.size()), kNumCepstral, out->data());
+  ei::speechpy::processing::preemphasis_params_t preemphasis = { 1, pre_cof, NULL };
+
+  ei::speechpy::mfcc_plan_t plan;
+  int ret = ei::speechpy::feature::create_mfcc_plan(&plan, kSamplingFrequency, kFrameLength,
+      kFrameStride, kNumCepstral, kNumFilters, kFftLength, kLowFrequency, kHighFrequency);
+  if (ret != ei::EIDSP_OK) {
+    return false;
+  }
+  ret = ei::speechpy::feature::mfcc(&out_matrix, &signal, &plan, true, &preemphasis);
+  ei::speechpy::feature::free_mfcc_plan(&plan);
+  return ret == ei::EIDSP_OK;
+}
+
+bool CheckMfcc(const std::vector<float>& window) {
+  std::vector<float> mfe, energies, out;
+  if (!ReferenceMfe(window, &mfe, &energies) || !Mfcc(window, 0.0f, &out)) {
+    printf("mfcc: extraction failed  MISMATCH\n");
+    return false;
+  }
+
+  // the old MFCC: log, FFT based DCT-II over every row, the first coefficient
+  // replaced by the log frame energy (dc elimination)
+  ei::matrix_t mfe_matrix(energies.size(), kNumFilters, mfe.data());
+  ei::matrix_t energy_matrix(energies.size(), 1, energies.data());
+  ei::numpy::log(&mfe_matrix);
+  ei::numpy::log(&energy_matrix);
+  std::vector<double> row_scale(energies.size(), 0.0);
+  for (size_t row = 0; row < energies.size(); row++) {
+    for (size_t j = 0; j < kNumFilters; j++) {
+      row_scale[row] += fabs(mfe[row * kNumFilters + j]);
+    }
+    row_scale[row] *= sqrt(2.0 / kNumFilters);
+  }
+  if (ei::numpy::dct2(&mfe_matrix, ei::DCT_NORMALIZATION_ORTHO) != ei::EIDSP_OK) {
+    printf("mfcc: dct2 failed  MISMATCH\n");
+    return false;
+  }
+
+  double max_error = 0, max_rel_error = 0;
+  for (size_t row = 0; row < energies.size(); row++) {
+    for (size_t i = 0; i < kNumCepstral; i++) {
+      const float reference = i == 0 ? energies[row] : mfe[row * kNumFilters + i];
+      const double error = fabs((double)out[row * kNumCepstral + i] - reference);
+      max_error = fmax(max_error, error);
+      if (i > 0) {
+        max_rel_error = fmax(max_rel_error, error / row_scale[row]);
+      }
+      else if (error != 0) {
+        // the energy takes the same path in both
+        max_rel_error = INFINITY;
+      }
+    }
+  }
+  const bool match = max_rel_error <= kDctMaxRelError;
+
+  printf("mfcc, %u frames against numpy::dct2\n", (unsigned)energies.size());
+  printf("  max abs error %.3g, rel to the row %.3g (bound %.3g)  %s\n", max_error,
+         max_rel_error, kDctMaxRelError, match ? "MATCH" : "MISMATCH");
+  return match;
+}
+
+// cmvnw before the running sums: every row re-sums its window of a
+// symmetrically padded copy of the features, in float
+bool ReferenceCmvnw(ei::matrix_t* features, uint16_t win_size, bool variance_normalization) {
+  const uint16_t pad_size = (win_size - 1) / 2;
+  ei::matrix_t padded(features->rows + (pad_size * 2), features->cols);
+  ei::matrix_t mean(features->cols, 1);
+  ei::matrix_t std(features->cols, 1);
+  if (ei::numpy::pad_1d_symmetric(features, &padded, pad_size, pad_size) != ei::EIDSP_OK) {
+    return false;
+  }
+
+  for (size_t ix = 0; ix < features->rows; ix++) {
+    ei::matrix_t window(win_size, padded.cols, padded.buffer + (ix * padded.cols));
+    if (ei::numpy::mean_axis0(&window, &mean) != ei::EIDSP_OK ||
+        ei::numpy::std_axis0(&window, &std) != ei::EIDSP_OK) {
+      return false;
+    }
+    float* row = &features->buffer[ix * features->cols];
+    for (size_t col = 0; col < features->cols; col++) {
+      row[col] = variance_normalization ?
+          (row[col] - mean.buffer[col]) / (std.buffer[col] + FLT_EPSILON) :
+          row[col] - mean.buffer[col];
+    }
+  }
+  return true;
+}
+
+bool CheckCmvnw(const std::vector<float>& window) {
+  std::vector<float> mfcc;
+  if (!Mfcc(window, kPreCof, &mfcc)) {
+    printf("cmvnw: mfcc failed  MISMATCH\n");
+    return false;
+  }
+
+  bool match = true;
+  printf("cmvnw, %u x %u MFCC against the padded window loop\n",
+         (unsigned)(mfcc.size() / kNumCepstral), (unsigned)kNumCepstral);
+  for (bool variance_normalization : { true, false }) {
+    std::vector<float> out(mfcc), reference(mfcc);
+    ei::matrix_t out_matrix(mfcc.size() / kNumCepstral, kNumCepstral, out.data());
+    ei::matrix_t reference_matrix(mfcc.size() / kNumCepstral, kNumCepstral, reference.data());
+    const bool ok = ei::speechpy::processing::cmvnw(&out_matrix, kCmvnwWinSize,
+                                                    variance_normalization) == ei::EIDSP_OK &&
+                    ReferenceCmvnw(&reference_matrix, kCmvnwWinSize, variance_normalization);
+
+    double max_diff = 0, max_value = 0;
+    for (size_t i = 0; i < out.size(); i++) {
+      max_diff = fmax(max_diff, fabs((double)out[i] - reference[i]));
+      max_value = fmax(max_value, fabs(reference[i]));
+    }
+    const double rel_error = max_diff / max_value;
+    const bool window_match = ok && rel_error <= kCmvnwMaxRelError;
+    printf("  %s max rel error %.3g (bound %.3g)  %s\n",
+           variance_normalization ? "mean and variance," : "mean only,", rel_error,
+           kCmvnwMaxRelError, window_match ? "MATCH" : "MISMATCH");
+    match &= window_match;
+  }
+  return match;
+}
+
+bool CheckCmvnwQuantized(const std::vector<float>& window) {
+  std::vector<float> mfcc;
+  if (!Mfcc(window, kPreCof, &mfcc)) {
+    printf("cmvnw_quantized: mfcc failed  MISMATCH\n");
+    return false;
+  }
+  const size_t rows = mfcc.size() / kNumCepstral;
+
+  // The window as it sits in the feature ring: rotated by a third, and the
+  // first row not filled in yet (NULL, read as zeros)
+  std::vector<float> ring(mfcc.size());
+  std::vector<const float*> row_pointers(rows);
+  const size_t rotation = rows / 3;
+  for (size_t row = 0; row < rows; row++) {
+    const size_t ring_row = (row + rotation) % rows;
+    std::copy(&mfcc[row * kNumCepstral], &mfcc[(row + 1) * kNumCepstral],
+              &ring[ring_row * kNumCepstral]);
+    row_pointers[row] = &ring[ring_row * kNumCepstral];
+  }
+  row_pointers[0] = NULL;
+  std::fill(mfcc.begin(), mfcc.begin() + kNumCepstral, 0.0f);
+
+  struct Quantization {
+    bool variance_normalization;
+    bool scale;
+    float quantization_scale;
+    int32_t zero_point;
+  };
+  const Quantization quantizations[] = {
+    { true, false, 0.05f, 0 },
+    { false, true, 1.0f / 256, -128 },
+  };
+
+  bool match = true;
+  printf("cmvnw_quantized, %u x %u MFCC against cmvnw and quantize_int8"
+         " (EIDSP_CMVNW_RUNNING_SUMS=%d)\n",
+         (unsigned)rows, (unsigned)kNumCepstral, EIDSP_CMVNW_RUNNING_SUMS);
+  for (const Quantization& q : quantizations) {
+    std::vector<float> reference(mfcc);
+    std::vector<int8_t> out(mfcc.size());
+    ei::matrix_t reference_matrix(rows, kNumCepstral, reference.data());
+    ei::matrix_i8_t out_matrix(rows, kNumCepstral, out.data());
+    const bool ok = ei::speechpy::processing::cmvnw_quantized(
+                        row_pointers.data(), rows, kNumCepstral, &out_matrix,
+                        q.quantization_scale, q.zero_point, kCmvnwWinSize,
+                        q.variance_normalization, q.scale) == ei::EIDSP_OK &&
+                    ei::speechpy::processing::cmvnw(&reference_matrix, kCmvnwWinSize,
+                                                    q.variance_normalization,
+                                                    q.scale) == ei::EIDSP_OK;
+
+    // Values right on a rounding boundary may land one step apart
+    int max_diff = 0;
+    for (size_t i = 0; i < out.size(); i++) {
+      const int expected = ei::numpy::quantize_int8(reference[i], 1.0f / q.quantization_scale,
+                                                    q.zero_point);
+      max_diff = std::max(max_diff, abs(out[i] - expected));
+    }
+    const bool quantization_match = ok && max_diff <= 1;
+    printf("  %s%s max diff %d step(s) (bound 1)  %s\n",
+           q.variance_normalization ? "mean and variance" : "mean only",
+           q.scale ? ", scaled," : ",", max_diff, quantization_match ? "MATCH" : "MISMATCH");
+    match &= quantization_match;
+  }
+  return match;
+}
+
+bool CheckMfccQ15(const std::vector<float>& window) {
+  std::vector<float> reference, samples(window);
+  std::vector<float> out(FrameCount(window.size()) * kNumCepstral);
+  ei::signal_t signal;
+  ei::numpy::signal_from_buffer(samples.data(), samples.size(), &signal);
+  ei::matrix_t out_matrix(FrameCount(window.size()), kNumCepstral, out.data());
+
+  ei::speechpy::mfcc_q15_plan_t plan;
+  int ret = ei::speechpy::feature::create_mfcc_q15_plan(&plan, kSamplingFrequency, kFrameLength,
+      kFrameStride, kNumCepstral, kNumFilters, kFftLength, kLowFrequency, kHighFrequency);
+  if (ret == ei::EIDSP_OK) {
+    ei::speechpy::processing::preemphasis_q15 pre(&signal, 1, kPreCof);
+    ret = ei::speechpy::feature::mfcc_q15(&out_matrix, &pre, &plan);
+    ei::speechpy::feature::free_mfcc_q15_plan(&plan);
+  }
+  if (ret != ei::EIDSP_OK || !Mfcc(window, kPreCof, &reference)) {
+    printf("mfcc_q15: extraction failed  MISMATCH\n");
+    return false;
+  }
+
+  double max_error = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    max_error = fmax(max_error, fabs((double)out[i] - reference[i]));
+  }
+
+  ei::matrix_t reference_matrix(out_matrix.rows, kNumCepstral, reference.data());
+  ei::speechpy::processing::cmvnw(&out_matrix, kCmvnwWinSize, true);
+  ei::speechpy::processing::cmvnw(&reference_matrix, kCmvnwWinSize, true);
+  double max_cmvnw_error = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    max_cmvnw_error = fmax(max_cmvnw_error, fabs((double)out[i] - reference[i]));
+  }
+  const bool match = max_error <= kMfccQ15MaxAbsError &&
+                     max_cmvnw_error <= kMfccQ15CmvnwMaxAbsError;
+
+  printf("mfcc_q15, %u frames against the float mfcc\n", (unsigned)out_matrix.rows);
+  printf("  max abs error %.3g (bound %.3g), after cmvnw %.3g (bound %.3g)  %s\n", max_error,
+         kMfccQ15MaxAbsError, max_cmvnw_error, kMfccQ15CmvnwMaxAbsError,
+         match ? "MATCH" : "MISMATCH");
+  return match;
+}
+
+bool CheckLog(int iterations) {
+  std::vector<float> in, out;
+  for (double v = 1e-30; v < 1e30; v *= 1.0001) {
+    in.push_back((float)v);
+  }
+  out.resize(in.size());
+  ei::fast_math::log(in.data(), out.data(), in.size());
+
+  double max_error = 0;
+  for (size_t i = 0; i < in.size(); i++) {
+    max_error = fmax(max_error, fabs((double)out[i] - log((double)in[i])));
+  }
+  const bool match = max_error <= kLogMaxAbsError;
+
+  // One MFCC window worth of logs (49 frames x 32 filters)
+  std::vector<float> window(49 * 32), window_out(window.size());
+  for (size_t i = 0; i < window.size(); i++) {
+    window[i] = 1e-3f + i * 0.37f;
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    ei::fast_math::log(window.data(), window_out.data(), window.size());
+  }
+  const double fast_us = MicrosecondsSince(start, iterations);
+  start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    for (size_t i = 0; i < window.size(); i++) {
+      window_out[i] = logf(window[i]);
+    }
+  }
+  const double libm_us = MicrosecondsSince(start, iterations);
+
+  printf("log, %u values in [1e-30, 1e30]\n", (unsigned)in.size());
+  printf("  max abs error %.3g (bound %.3g)  %s\n", max_error, kLogMaxAbsError,
+         match ? "MATCH" : "MISMATCH");
+  printf("  %u values: fast_math %.2f us, logf %.2f us\n",
+         (unsigned)window.size(), fast_us, libm_us);
+  return match;
+}
+
+bool CheckExp() {
+  std::vector<float> in, out;
+  for (double v = -88.0; v < 88.0; v += 0.00037) {
+    in.push_back((float)v);
+  }
+  out.resize(in.size());
+  ei::fast_math::exp(in.data(), out.data(), in.size());
+
+  double max_ulp = 0;
+  for (size_t i = 0; i < in.size(); i++) {
+    const double reference = exp((double)in[i]);
+    // subnormal results have a fixed spacing, the polynomial doesn't aim for them
+    if (reference < 1.1754944e-38) {
+      continue;
+    }
+    const double ulp = ldexp(1.0, ilogb(reference) - 23);
+    max_ulp = fmax(max_ulp, fabs((double)out[i] - reference) / ulp);
+  }
+  const bool match = max_ulp <= kExpMaxUlp;
+
+  printf("exp, %u values in [-88, 88]\n", (unsigned)in.size());
+  printf("  max error %.2f ulp (bound %.2f)  %s\n", max_ulp, kExpMaxUlp,
+         match ? "MATCH" : "MISMATCH");
+
+  // Below log(FLT_MIN) the input is clamped, the result must stay at
+  // exp(clamp), just above FLT_MIN, instead of flushing to 0 (n = -127 gives
+  // an exponent field of 0)
+  std::vector<float> low_in, low_out;
+  const float clamp = -87.33654f;
+  for (double v = -100.0; v <= clamp; v += 0.0013) {
+    low_in.push_back((float)v);
+  }
+  low_in.push_back(-88.3762626647949f);
+  low_in.push_back(clamp);
+  low_out.resize(low_in.size());
+  ei::fast_math::exp(low_in.data(), low_out.data(), low_in.size());
+
+  const double flt_min = 1.1754943508222875e-38;
+  const double reference = exp((double)clamp);
+  const double ulp = ldexp(1.0, -126 - 23);
+  double low_max_ulp = 0;
+  size_t flushed = 0;
+  for (size_t i = 0; i < low_out.size(); i++) {
+    if (low_out[i] < flt_min) {
+      flushed++;
+    }
+    low_max_ulp = fmax(low_max_ulp, fabs((double)low_out[i] - reference) / ulp);
+  }
+  const bool low_match = flushed == 0 && low_max_ulp <= kExpMaxUlp;
+  printf("exp, %u values in [-100, log(FLT_MIN)]\n", (unsigned)low_in.size());
+  printf("  %u flushed to 0, max error %.2f ulp from exp(clamp) (bound %.2f)  %s\n",
+         (unsigned)flushed, low_max_ulp, kExpMaxUlp,
+         low_match ? "MATCH" : "MISMATCH");
+  return match && low_match;
+}
+
+bool CheckSoftmax() {
+  static const int depths[] = { 2, 3, 7, 10, 35, 100 };
+  const int rows_per_depth = 2000;
+  int rows = 0, argmax_changes = 0;
+  double max_diff = 0;
+
+  for (int depth : depths) {
+    std::vector<float> in(depth), reference(depth), out(depth);
+    tflite::SoftmaxParams params;
+    params.beta = 1.0;
+    tflite::RuntimeShape shape({ 1, depth });
+
+    for (int row = 0; row < rows_per_depth; row++) {
+      // every fourth row is spread wide enough to saturate
+      const float spread = row % 4 == 0 ? 50.0f : 8.0f;
+      for (int i = 0; i < depth; i++) {
+        in[i] = (RandomFloat() - 0.5f) * spread;
+      }
+      tflite::reference_ops::Softmax(params, shape, in.data(), shape, reference.data());
+      ei::fast_math::softmax(in.data(), out.data(), depth, 1.0f);
+
+      int reference_top = 0, top = 0;
+      for (int i = 0; i < depth; i++) {
+        max_diff = fmax(max_diff, fabs((double)out[i] - reference[i]));
+        if (reference[i] > reference[reference_top]) reference_top = i;
+        if (out[i] > out[top]) top = i;
+      }
+      argmax_changes += reference_top != top;
+      rows++;
+    }
+  }
+  const bool match = argmax_changes == 0;
+
+  printf("softmax, %d rows against reference_ops::Softmax\n", rows);
+  printf("  max abs diff %.3g, argmax changed in %d row(s)  %s\n", max_diff,
+         argmax_changes, match ? "MATCH" : "MISMATCH");
+  return match;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+  printf("fast_math vector unit: %s (EIDSP_USE_FAST_MATH=%d)\n", VectorUnit(),
+         EIDSP_USE_FAST_MATH);
+  bool ok = CheckLog(iterations);
+  ok &= CheckExp();
+  ok &= CheckSoftmax();
+
+  const std::vector<float> window = TestWindow();
+  ok &= CheckMfe(window);
+  ok &= CheckMfcc(window);
+  ok &= CheckCmvnw(window);
+  ok &= CheckCmvnwQuantized(window);
+  ok &= CheckMfccQ15(window);
+  return ok ? 0 : 1;
+}
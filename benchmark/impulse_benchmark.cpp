@@ -0,0 +1,437 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Streams 16 kHz mono 16-bit PCM WAV files through the full impulse and
+// reports how fast it keeps up with the audio:
+//  - single: run_classifier() on consecutive windows of
+//    EI_CLASSIFIER_RAW_SAMPLE_COUNT samples,
+//  - continuous: run_classifier_continuous() on slices of
+//    EI_CLASSIFIER_SLICE_SIZE samples, the way the sketch runs.
+// Per mode it prints the real-time factor (processing time over audio time),
+// the mean DSP and classification time per window, the p50 / p99 / p99.9
+// latency of the calls that produced a result, the DSP heap peak
+// (EIDSP_TRACK_ALLOCATIONS) and the peak RSS of the process. Built with
+// EI_CLASSIFIER_PROFILING=1 it adds the time per DSP stage and model node,
+// with EI_CLASSIFIER_VAD=1 the windows without speech and the ones that
+// skipped the network.
+// Partial windows or slices at the end of a file are skipped.
+//
+//   impulse_benchmark [-m single|continuous|both] [-r repeat] [-v] file.wav...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/classifier/ei_latency_histogram.h"
+#include "edge-impulse-sdk/dsp/memory.hpp"
+#include "edge-impulse-sdk/dsp/numpy.hpp"
+#include "model-parameters/model_metadata.h"
+
+namespace {
+
+struct Recording {
+  std::string path;
+  std::vector<int16_t> samples;
+};
+
+struct ModeStats {
+  uint64_t audio_samples;
+  uint64_t processing_us;
+  uint64_t calls;
+  uint64_t windows;
+  uint64_t dsp_us;
+  uint64_t classification_us;
+  uint64_t anomaly_us;
+  size_t dsp_heap_peak_bytes;
+  size_t dsp_heap_leaked_bytes;
+  uint64_t no_speech_windows;
+  uint64_t skipped_windows;
+  ei_latency_histogram_t latency;
+};
+
+enum Mode { kSingle = 1, kContinuous = 2 };
+
+const int16_t* signal_samples = nullptr;
+
+int GetSignalData(size_t offset, size_t length, float* out_ptr) {
+  return ei::numpy::int16_to_float(signal_samples + offset, out_ptr, length);
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint16_t ReadLe16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+// Reads a RIFF/WAVE file with one channel of 16-bit PCM at the model's
+// frequency, anything else is an error: resampling would skew the timings.
+bool LoadWav(const char* path, Recording* recording) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    bytes.insert(bytes.end(), buf, buf + n);
+  }
+  fclose(f);
+
+  if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) != 0 ||
+      memcmp(&bytes[8], "WAVE", 4) != 0) {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    return false;
+  }
+
+  bool have_format = false;
+  size_t pos = 12;
+  while (pos + 8 <= bytes.size()) {
+    const uint8_t* chunk = &bytes[pos];
+    const size_t chunk_size = ReadLe32(chunk + 4);
+    const size_t body = pos + 8;
+    const size_t available = bytes.size() - body;
+
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunk_size < 16 || available < 16) {
+        break;
+      }
+      const uint16_t format = ReadLe16(&bytes[body]);
+      const uint16_t channels = ReadLe16(&bytes[body + 2]);
+      const uint32_t rate = ReadLe32(&bytes[body + 4]);
+      const uint16_t bits = ReadLe16(&bytes[body + 14]);
+      if (format != 1 || channels != 1 || bits != 16 ||
+          rate != EI_CLASSIFIER_FREQUENCY) {
+        fprintf(stderr,
+                "%s: need mono 16-bit PCM at %d Hz, got format %u, "
+                "%u channel(s), %u bits, %u Hz\n",
+                path, EI_CLASSIFIER_FREQUENCY, format, channels, bits, rate);
+        return false;
+      }
+      have_format = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!have_format) {
+        break;
+      }
+      // Recorders that stream to disk leave the size of the data chunk 0
+      // or too large, take what is there
+      const size_t data_size =
+          (chunk_size == 0 || chunk_size > available) ? available : chunk_size;
+      recording->path = path;
+      recording->samples.resize(data_size / 2);
+      for (size_t ix = 0; ix < recording->samples.size(); ix++) {
+        recording->samples[ix] = (int16_t)ReadLe16(&bytes[body + ix * 2]);
+      }
+      return true;
+    }
+    pos = body + chunk_size + (chunk_size & 1);
+  }
+
+  fprintf(stderr, "%s: no fmt or data chunk\n", path);
+  return false;
+}
+
+void PrintResult(const Recording& recording, size_t sample, const ei_impulse_result_t& result) {
+  size_t top = 0;
+  for (size_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+    if (result.classification[ix].value > result.classification[top].value) {
+      top = ix;
+    }
+  }
+  printf("  %s @ %.3f s: %s %.5f%s\n", recording.path.c_str(),
+         (double)sample / EI_CLASSIFIER_FREQUENCY,
+         result.classification[top].label, result.classification[top].value,
+#if EI_CLASSIFIER_VAD == 1
+         result.no_speech ? " (no speech)" : "");
+#else
+         "");
+#endif
+}
+
+void AddTiming(ModeStats* stats, const ei_impulse_result_t& result, uint64_t call_us) {
+  stats->windows++;
+  stats->dsp_us += result.timing.dsp_us;
+  stats->classification_us += result.timing.classification_us;
+  stats->anomaly_us += result.timing.anomaly_us;
+#if EI_CLASSIFIER_VAD == 1
+  if (result.no_speech) {
+    stats->no_speech_windows++;
+    if (result.timing.classification_us == 0) {
+      stats->skipped_windows++;
+    }
+  }
+#endif
+  ei_latency_histogram_record(&stats->latency, call_us);
+}
+
+bool RunSingle(const Recording& recording, ModeStats* stats, bool verbose) {
+  signal_t signal;
+  signal.total_length = EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+  signal.get_data = &GetSignalData;
+
+  const size_t count = recording.samples.size();
+  for (size_t pos = 0; pos + EI_CLASSIFIER_RAW_SAMPLE_COUNT <= count;
+       pos += EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+    signal_samples = &recording.samples[pos];
+    ei_impulse_result_t result = { 0 };
+
+    const uint64_t start_us = ei_read_timer_us();
+    EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+    const uint64_t call_us = ei_read_timer_us() - start_us;
+    if (res != EI_IMPULSE_OK) {
+      fprintf(stderr, "run_classifier failed (%d)\n", res);
+      return false;
+    }
+
+    stats->audio_samples += EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+    stats->processing_us += call_us;
+    stats->calls++;
+    AddTiming(stats, result, call_us);
+    if (verbose) {
+      PrintResult(recording, pos, result);
+    }
+  }
+  return true;
+}
+
+bool RunContinuous(const Recording& recording, ModeStats* stats, bool verbose) {
+  signal_t signal;
+  signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
+  signal.get_data = &GetSignalData;
+
+  // Every recording starts with an empty window, like a fresh boot
+  run_classifier_deinit();
+  run_classifier_init();
+
+  const size_t count = recording.samples.size();
+  for (size_t pos = 0; pos + EI_CLASSIFIER_SLICE_SIZE <= count;
+       pos += EI_CLASSIFIER_SLICE_SIZE) {
+    signal_samples = &recording.samples[pos];
+    ei_impulse_result_t result = { 0 };
+
+    const uint64_t start_us = ei_read_timer_us();
+    EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, false);
+    const uint64_t call_us = ei_read_timer_us() - start_us;
+    if (res != EI_IMPULSE_OK) {
+      fprintf(stderr, "run_classifier_continuous failed (%d)\n", res);
+      return false;
+    }
+
+    stats->audio_samples += EI_CLASSIFIER_SLICE_SIZE;
+    stats->processing_us += call_us;
+    stats->calls++;
+    // Until the window is full a slice only runs the DSP, and gives no result
+    if (classifier_stream.feature_buffer_full) {
+      AddTiming(stats, result, call_us);
+      if (verbose) {
+        PrintResult(recording, pos + EI_CLASSIFIER_SLICE_SIZE, result);
+      }
+    }
+  }
+  return true;
+}
+
+#if EI_CLASSIFIER_PROFILING == 1
+void PrintProfile() {
+  static const char* stage_names[EI_DSP_STAGE_COUNT] = {
+      "preemphasis", "framing", "fft", "filterbank", "log", "dct", "cmvn"};
+
+  ei_impulse_profile_t profile;
+  run_classifier_get_profile(&profile);
+
+  printf("  %-28s %10s %12s %10s %10s\n", "", "calls", "total (us)",
+         "mean (us)", "max (us)");
+  for (int ix = 0; ix < EI_DSP_STAGE_COUNT; ix++) {
+    const ei_profile_counter_t& c = profile.dsp_stages[ix];
+    if (c.calls == 0) {
+      continue;
+    }
+    printf("  dsp %-24s %10u %12llu %10.1f %10u\n", stage_names[ix], c.calls,
+           (unsigned long long)c.total_us, (double)c.total_us / c.calls, c.max_us);
+  }
+  for (size_t ix = 0; ix < profile.nodes_size; ix++) {
+    const ei_profile_counter_t& c = profile.nodes[ix].time;
+    printf("  node %-3u %-19s %10u %12llu %10.1f %10u\n", (unsigned)ix,
+           profile.nodes[ix].name ? profile.nodes[ix].name : "?", c.calls,
+           (unsigned long long)c.total_us,
+           c.calls ? (double)c.total_us / c.calls : 0.0, c.max_us);
+  }
+  if (profile.arena_size > 0) {
+    printf("  TFLite arena: %u of %u bytes used at peak\n",
+           (unsigned)profile.arena_peak_bytes, (unsigned)profile.arena_size);
+  }
+}
+#endif
+
+void PrintStats(const char* name, const ModeStats& stats) {
+  const double audio_s = (double)stats.audio_samples / EI_CLASSIFIER_FREQUENCY;
+  const double processing_s = stats.processing_us / 1e6;
+  const double windows = stats.windows ? (double)stats.windows : 1.0;
+
+  ei_latency_summary_t latency;
+  ei_latency_histogram_summary(&stats.latency, &latency);
+
+  printf("%s:\n", name);
+  printf("  audio %.2f s in %llu calls, %llu classified window(s)\n", audio_s,
+         (unsigned long long)stats.calls, (unsigned long long)stats.windows);
+  if (processing_s > 0) {
+    printf("  processing %.3f s, real-time factor %.5f (%.1fx real time)\n",
+           processing_s, processing_s / audio_s, audio_s / processing_s);
+  }
+  printf("  per window: dsp %.1f us, classification %.1f us, anomaly %.1f us\n",
+         stats.dsp_us / windows, stats.classification_us / windows,
+         stats.anomaly_us / windows);
+  printf("  latency (us): min %u, mean %u, p50 %u, p99 %u, p99.9 %u, max %u\n",
+         latency.min_us, latency.mean_us, latency.p50_us, latency.p99_us,
+         latency.p999_us, latency.max_us);
+#if EI_CLASSIFIER_VAD == 1
+  printf("  voice activity gate: %llu window(s) without speech, %llu skipped the network\n",
+         (unsigned long long)stats.no_speech_windows,
+         (unsigned long long)stats.skipped_windows);
+#endif
+  printf("  DSP heap peak %u bytes", (unsigned)stats.dsp_heap_peak_bytes);
+  if (stats.dsp_heap_leaked_bytes > 0) {
+    printf(", %u bytes not freed", (unsigned)stats.dsp_heap_leaked_bytes);
+  }
+  printf("\n");
+#if EI_CLASSIFIER_PROFILING == 1
+  PrintProfile();
+#endif
+}
+
+bool RunMode(Mode mode, const std::vector<Recording>& recordings, int repeat,
+             bool verbose) {
+  ModeStats stats;
+  memset(&stats, 0, sizeof(stats));
+  ei_latency_histogram_reset(&stats.latency);
+
+  run_classifier_init();
+#if EI_CLASSIFIER_PROFILING == 1
+  run_classifier_reset_profile();
+#endif
+  const size_t heap_before = ei_memory_in_use;
+  ei_memory_peak_use = heap_before;
+
+  for (int r = 0; r < repeat; r++) {
+    for (const Recording& recording : recordings) {
+      const bool ok = mode == kSingle
+                          ? RunSingle(recording, &stats, verbose && r == 0)
+                          : RunContinuous(recording, &stats, verbose && r == 0);
+      if (!ok) {
+        return false;
+      }
+    }
+  }
+
+  // The profile and the session live until deinit, read them first
+  stats.dsp_heap_peak_bytes = ei_memory_peak_use - heap_before;
+  PrintStats(mode == kSingle ? "run_classifier" : "run_classifier_continuous",
+             stats);
+  run_classifier_deinit();
+  if (ei_memory_in_use > heap_before) {
+    printf("  DSP heap: %u bytes still allocated after run_classifier_deinit\n",
+           (unsigned)(ei_memory_in_use - heap_before));
+  }
+  return true;
+}
+
+void Usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [-m single|continuous|both] [-r repeat] [-v] file.wav...\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int modes = kSingle | kContinuous;
+  int repeat = 1;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "m:r:vh")) != -1) {
+    switch (opt) {
+      case 'm':
+        if (strcmp(optarg, "single") == 0) {
+          modes = kSingle;
+        } else if (strcmp(optarg, "continuous") == 0) {
+          modes = kContinuous;
+        } else if (strcmp(optarg, "both") == 0) {
+          modes = kSingle | kContinuous;
+        } else {
+          Usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'r':
+        repeat = atoi(optarg);
+        if (repeat < 1) {
+          Usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Recording> recordings(argc - optind);
+  for (int ix = optind; ix < argc; ix++) {
+    if (!LoadWav(argv[ix], &recordings[ix - optind])) {
+      return 1;
+    }
+  }
+
+  printf("window %d samples, %d slices of %d samples, %d Hz, arena %d bytes\n",
+         EI_CLASSIFIER_RAW_SAMPLE_COUNT, EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW,
+         EI_CLASSIFIER_SLICE_SIZE, EI_CLASSIFIER_FREQUENCY,
+         EI_CLASSIFIER_TFLITE_ARENA_SIZE);
+
+  if ((modes & kSingle) && !RunMode(kSingle, recordings, repeat, verbose)) {
+    return 1;
+  }
+  if ((modes & kContinuous) &&
+      !RunMode(kContinuous, recordings, repeat, verbose)) {
+    return 1;
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    printf("peak RSS %ld KiB\n", usage.ru_maxrss);
+  }
+  return 0;
+}
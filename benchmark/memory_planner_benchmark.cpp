@@ -0,0 +1,270 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Startup cost of planning the tensor arena, for models from the size of the
+// ones we ship today up to a few thousand tensors:
+//  - GreedyMemoryPlanner, what AllocateTensors() does on a cold start,
+//  - a MemoryPlanCache hit, what it does once the plan is cached (hash the
+//    buffer sizes and lifetimes, find the plan, copy the offsets).
+// The models are chains of ops, every output is read by the next op and one
+// in ten is kept alive for a skip connection. The planner's result is checked
+// for overlapping buffers and against the offsets that come out of the cache.
+//
+// It also checks that a corrupted cached plan (offsets outside the arena, a
+// plan larger than the arena) is planned again instead of being committed:
+// the TFLM complex mock model is allocated through MicroInterpreter with the
+// corrupted plan loaded, every arena tensor has to be inside the arena and the
+// cache has to hold the freshly planned plan afterwards.
+//
+//   memory_planner_benchmark [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/memory_plan_cache.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_error_reporter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/test_helpers.h"
+
+namespace {
+
+constexpr int kMaxBuffers = 3000;
+
+struct Buffer {
+  int32_t size;
+  int32_t first_used;
+  int32_t last_used;
+  int32_t offline_offset;
+};
+
+Buffer buffers[kMaxBuffers];
+int32_t offsets[kMaxBuffers];
+unsigned char planner_scratch[kMaxBuffers * 64];
+uint32_t cache_storage[kMaxBuffers + 64];
+
+uint32_t rand_state = 1;
+int RandomInt(int max) {
+  rand_state = rand_state * 1103515245 + 12345;
+  return static_cast<int>((rand_state >> 8) % max);
+}
+
+void MakeModel(int buffers_size) {
+  for (int i = 0; i < buffers_size; i++) {
+    buffers[i].size = 16 * (1 + RandomInt(512));
+    buffers[i].first_used = i;
+    buffers[i].last_used =
+        i + 1 + (RandomInt(10) == 0 ? 1 + RandomInt(20) : 0);
+    buffers[i].offline_offset = -1;
+  }
+}
+
+double MicrosecondsSince(std::chrono::steady_clock::time_point start,
+                         int iterations) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+// Plans the model, returns the arena size or 0 on failure.
+size_t Plan(tflite::ErrorReporter* error_reporter, int buffers_size,
+            bool check) {
+  tflite::GreedyMemoryPlanner planner(planner_scratch,
+                                      sizeof(planner_scratch));
+  for (int i = 0; i < buffers_size; i++) {
+    if (planner.AddBuffer(error_reporter, buffers[i].size,
+                          buffers[i].first_used,
+                          buffers[i].last_used) != kTfLiteOk) {
+      return 0;
+    }
+  }
+  const size_t arena_bytes = planner.GetMaximumMemorySize();
+  for (int i = 0; i < buffers_size; i++) {
+    int offset;
+    if (planner.GetOffsetForBuffer(error_reporter, i, &offset) != kTfLiteOk) {
+      return 0;
+    }
+    offsets[i] = offset;
+  }
+  if (check && planner.DoAnyBuffersOverlap(error_reporter)) {
+    return 0;
+  }
+  return arena_bytes;
+}
+
+// Same steps as MicroAllocator::CommitStaticMemoryPlan on a cache hit.
+const int32_t* LookupPlan(const tflite::MemoryPlanCache& cache,
+                          int buffers_size, size_t* arena_bytes) {
+  const uint32_t buffers_hash = tflite::MemoryPlanCache::Hash(
+      buffers, buffers_size * sizeof(Buffer));
+  return cache.Lookup(/*model_hash=*/buffers_size, buffers_hash,
+                      buffers_size, arena_bytes);
+}
+
+int RunModel(tflite::ErrorReporter* error_reporter, int buffers_size,
+             int iterations) {
+  MakeModel(buffers_size);
+  tflite::MemoryPlanCache cache(reinterpret_cast<uint8_t*>(cache_storage),
+                                sizeof(cache_storage));
+
+  const size_t arena_bytes = Plan(error_reporter, buffers_size, true);
+  if (arena_bytes == 0) {
+    printf("%5d buffers: planning failed\n", buffers_size);
+    return 1;
+  }
+  int32_t* cached = cache.Insert(
+      /*model_hash=*/buffers_size,
+      tflite::MemoryPlanCache::Hash(buffers, buffers_size * sizeof(Buffer)),
+      buffers_size, arena_bytes);
+  memcpy(cached, offsets, buffers_size * sizeof(int32_t));
+
+  // Fewer runs for the large models, planning them takes milliseconds
+  const int plan_iterations = iterations * 30 / buffers_size + 1;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < plan_iterations; i++) {
+    Plan(error_reporter, buffers_size, false);
+  }
+  const double plan_us = MicrosecondsSince(start, plan_iterations);
+
+  size_t cached_arena_bytes = 0;
+  bool match = true;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    const int32_t* plan =
+        LookupPlan(cache, buffers_size, &cached_arena_bytes);
+    if (plan == nullptr) {
+      match = false;
+      break;
+    }
+    memcpy(offsets, plan, buffers_size * sizeof(int32_t));
+  }
+  const double cached_us = MicrosecondsSince(start, iterations);
+
+  Plan(error_reporter, buffers_size, false);
+  size_t unused;
+  const int32_t* plan = LookupPlan(cache, buffers_size, &unused);
+  match = match && plan != nullptr && cached_arena_bytes == arena_bytes &&
+          memcmp(plan, offsets, buffers_size * sizeof(int32_t)) == 0;
+
+  printf("%5d buffers  %8zu bytes  planned %10.1f us  cached %8.1f us  %s\n",
+         buffers_size, arena_bytes, plan_us, cached_us,
+         match ? "OK" : "MISMATCH");
+  return match ? 0 : 1;
+}
+
+constexpr uint32_t kMockModelHash = 0x12345678;
+constexpr size_t kMockArenaSize = 4096;
+uint8_t mock_arena[kMockArenaSize] __attribute__((aligned(16)));
+
+// Allocates the complex mock model with `cache`, false if that fails or a
+// tensor of the arena lies outside of it.
+bool AllocateMockModel(tflite::ErrorReporter* error_reporter,
+                       tflite::MemoryPlanCache* cache) {
+  tflite::testing::MockOpResolver resolver;
+  tflite::MicroInterpreter interpreter(tflite::testing::GetComplexMockModel(),
+                                       resolver, mock_arena,
+                                       sizeof(mock_arena), error_reporter);
+  interpreter.SetMemoryPlanCache(cache, kMockModelHash);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    return false;
+  }
+  for (size_t i = 0; i < interpreter.tensors_size(); i++) {
+    const TfLiteTensor* tensor = interpreter.tensor(i);
+    if (tensor->allocation_type != kTfLiteArenaRw) {
+      continue;
+    }
+    const uint8_t* data = tensor->data.uint8;
+    if (data < mock_arena || tensor->bytes > sizeof(mock_arena) ||
+        data + tensor->bytes > mock_arena + sizeof(mock_arena)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int CheckCorruptedPlans(tflite::ErrorReporter* error_reporter) {
+  static uint32_t good_storage[256];
+  static uint32_t blob[256];
+  static uint32_t storage[256];
+  tflite::MemoryPlanCache good(reinterpret_cast<uint8_t*>(good_storage),
+                               sizeof(good_storage));
+  if (!AllocateMockModel(error_reporter, &good) || good.size() == 0) {
+    printf("mock model: planning failed\n");
+    return 1;
+  }
+
+  // Fields of the serialized plan (memory_plan_cache.h): magic, model hash,
+  // buffers hash, buffer count, arena bytes, offsets
+  const int buffer_count = static_cast<int>(good_storage[3]);
+  const uint32_t arena_bytes = good_storage[4];
+  struct Corruption {
+    const char* name;
+    int word;
+    uint32_t value;
+  };
+  const Corruption corruptions[] = {
+      {"offset past the arena", 5, static_cast<uint32_t>(kMockArenaSize)},
+      {"offset past the plan", 5 + buffer_count - 1, arena_bytes},
+      {"negative offset", 5, static_cast<uint32_t>(-16)},
+      {"plan larger than the arena", 4,
+       static_cast<uint32_t>(kMockArenaSize * 4)},
+  };
+
+  int failed = 0;
+  for (const Corruption& corruption : corruptions) {
+    memcpy(blob, good_storage, good.size());
+    blob[corruption.word] = corruption.value;
+    tflite::MemoryPlanCache cache(reinterpret_cast<uint8_t*>(storage),
+                                  sizeof(storage));
+    bool ok = cache.Load(reinterpret_cast<uint8_t*>(blob), good.size()) ==
+              kTfLiteOk;
+    ok = ok && AllocateMockModel(error_reporter, &cache);
+    // The planner ran and replaced the corrupted plan
+    ok = ok && cache.size() == good.size() &&
+         memcmp(cache.data(), good.data(), good.size()) == 0;
+    printf("mock model, %d buffers, %s: %s\n", buffer_count, corruption.name,
+           ok ? "planned again OK" : "MISMATCH");
+    failed |= ok ? 0 : 1;
+  }
+  return failed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+  tflite::MicroErrorReporter micro_error_reporter;
+
+  printf("scratch per buffer: %zu bytes\n",
+         tflite::GreedyMemoryPlanner::per_buffer_size());
+  int failed = 0;
+  const int sizes[] = {30, 100, 300, 1000, 3000};
+  for (int buffers_size : sizes) {
+    failed |= RunModel(&micro_error_reporter, buffers_size, iterations);
+  }
+  failed |= CheckCorruptedPlans(&micro_error_reporter);
+  return failed;
+}
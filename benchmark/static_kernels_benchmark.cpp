@@ -0,0 +1,266 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Runs the two conv blocks of the compiled model (conv, bias add + relu,
+// max pool) three ways and checks that they give the same output:
+//  - the registered kernels, Register_CONV_2D / ADD / MAX_POOL_2D,
+//  - the generic fused loop of MicroGraphOptimizer,
+//  - the static_shape::ConvBlock instantiated for the block's shape.
+// The weights are random, the shapes and quantization are the model's.
+//
+//   static_kernels_benchmark [iterations]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/static_shape_kernels.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_graph_optimizer.h"
+
+namespace {
+
+template <int SZ, class T> struct TfArray {
+  int sz; T elem[SZ];
+};
+
+uint8_t arena[16 * 1024] __attribute__((aligned(16)));
+size_t arena_used = 0;
+
+TfLiteStatus AllocatePersistentBuffer(TfLiteContext* /*context*/, size_t bytes,
+                                      void** ptr) {
+  if (arena_used + bytes > sizeof(arena)) {
+    return kTfLiteError;
+  }
+  *ptr = arena + arena_used;
+  arena_used += (bytes + 15) & ~static_cast<size_t>(15);
+  return kTfLiteOk;
+}
+
+void ReportError(TfLiteContext* /*context*/, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+uint32_t rand_state = 1;
+int8_t RandomInt8() {
+  rand_state = rand_state * 1103515245 + 12345;
+  return static_cast<int8_t>((rand_state >> 16) & 0xff);
+}
+
+double MicrosecondsSince(std::chrono::steady_clock::time_point start,
+                         int iterations) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+// One block: [1, 1, T, C] -> conv -> add -> max pool -> [1, 1, T / 2, K]
+template <int T, int C, int K, class StaticBlock>
+int RunBlock(const char* name, int iterations) {
+  enum { kInput, kFilter, kBias, kConvOut, kVector, kAddOut, kPoolOut };
+  constexpr int P = (T + 1) / 2;
+
+  static int8_t filter[K * 3 * C], vector[K];
+  static int32_t bias[K];
+  static int8_t input[T * C], conv_out[T * K], add_out[T * K];
+  static int8_t reference[P * K], output[P * K];
+  for (int i = 0; i < K * 3 * C; i++) filter[i] = RandomInt8();
+  for (int i = 0; i < K; i++) vector[i] = RandomInt8();
+  for (int i = 0; i < K; i++) bias[i] = RandomInt8() * 16;
+
+  static TfArray<4, int> input_dims = { 4, { 1, 1, T, C } };
+  static TfArray<4, int> filter_dims = { 4, { K, 1, 3, C } };
+  static TfArray<1, int> vector_dims = { 1, { K } };
+  static TfArray<4, int> conv_dims = { 4, { 1, 1, T, K } };
+  static TfArray<4, int> pool_dims = { 4, { 1, 1, P, K } };
+  static TfArray<K, float> filter_scales, bias_scales;
+  static TfArray<K, int> zero_points;
+  filter_scales.sz = bias_scales.sz = zero_points.sz = K;
+  for (int i = 0; i < K; i++) {
+    filter_scales.elem[i] = 0.004f + 0.0002f * i;
+    bias_scales.elem[i] = 0.047152f * filter_scales.elem[i];
+    zero_points.elem[i] = 0;
+  }
+  static TfLiteAffineQuantization filter_quant = {
+      (TfLiteFloatArray*)&filter_scales, (TfLiteIntArray*)&zero_points, 0 };
+  static TfLiteAffineQuantization bias_quant = {
+      (TfLiteFloatArray*)&bias_scales, (TfLiteIntArray*)&zero_points, 0 };
+
+  static TfLiteTensor tensors[7];
+  static TfArray<1, float> scales[7];
+  static TfArray<1, int> offsets[7];
+  static TfLiteAffineQuantization quant[7];
+  memset(tensors, 0, sizeof(tensors));
+  struct { void* data; TfLiteIntArray* dims; TfLiteType type; size_t bytes;
+           float scale; int zero_point; TfLiteAllocationType allocation; }
+  info[7] = {
+    { input, (TfLiteIntArray*)&input_dims, kTfLiteInt8, T * C, 0.047152f, -4, kTfLiteArenaRw },
+    { filter, (TfLiteIntArray*)&filter_dims, kTfLiteInt8, K * 3 * C, 0, 0, kTfLiteMmapRo },
+    { bias, (TfLiteIntArray*)&vector_dims, kTfLiteInt32, K * 4, 0, 0, kTfLiteMmapRo },
+    { conv_out, (TfLiteIntArray*)&conv_dims, kTfLiteInt8, T * K, 0.0612f, 9, kTfLiteArenaRw },
+    { vector, (TfLiteIntArray*)&vector_dims, kTfLiteInt8, K, 0.0045f, 0, kTfLiteMmapRo },
+    { add_out, (TfLiteIntArray*)&conv_dims, kTfLiteInt8, T * K, 0.0301f, -128, kTfLiteArenaRw },
+    { output, (TfLiteIntArray*)&pool_dims, kTfLiteInt8, P * K, 0.0301f, -128, kTfLiteArenaRw },
+  };
+  for (int i = 0; i < 7; i++) {
+    tensors[i].data.data = info[i].data;
+    tensors[i].dims = info[i].dims;
+    tensors[i].type = info[i].type;
+    tensors[i].bytes = info[i].bytes;
+    tensors[i].params.scale = info[i].scale;
+    tensors[i].params.zero_point = info[i].zero_point;
+    tensors[i].allocation_type = info[i].allocation;
+    scales[i] = { 1, { info[i].scale } };
+    offsets[i] = { 1, { info[i].zero_point } };
+    quant[i] = { (TfLiteFloatArray*)&scales[i], (TfLiteIntArray*)&offsets[i], 0 };
+    tensors[i].quantization = { kTfLiteAffineQuantization, &quant[i] };
+  }
+  tensors[kFilter].quantization = { kTfLiteAffineQuantization, &filter_quant };
+  tensors[kBias].quantization = { kTfLiteAffineQuantization, &bias_quant };
+
+  static TfLiteContext context;
+  context.tensors = tensors;
+  context.tensors_size = 7;
+  context.AllocatePersistentBuffer = &AllocatePersistentBuffer;
+  context.ReportError = &ReportError;
+
+  static TfArray<3, int> conv_inputs = { 3, { kInput, kFilter, kBias } };
+  static TfArray<1, int> conv_outputs = { 1, { kConvOut } };
+  static TfArray<2, int> add_inputs = { 2, { kConvOut, kVector } };
+  static TfArray<1, int> add_outputs = { 1, { kAddOut } };
+  static TfArray<1, int> pool_inputs = { 1, { kAddOut } };
+  static TfArray<1, int> pool_outputs = { 1, { kPoolOut } };
+  static TfLiteConvParams conv_params = { kTfLitePaddingSame, 1, 1, kTfLiteActNone, 1, 1 };
+  static TfLiteAddParams add_params = { kTfLiteActRelu };
+  static TfLitePoolParams pool_params = { kTfLitePaddingSame, 2, 1, 2, 1, kTfLiteActNone, { { 0, 0, 0, 0 } } };
+
+  static TfLiteNode nodes[3];
+  const TfLiteRegistration* registrations[3] = {
+    tflite::ops::micro::Register_CONV_2D(),
+    tflite::ops::micro::Register_ADD(),
+    tflite::ops::micro::Register_MAX_POOL_2D(),
+  };
+  TfLiteIntArray* node_io[3][2] = {
+    { (TfLiteIntArray*)&conv_inputs, (TfLiteIntArray*)&conv_outputs },
+    { (TfLiteIntArray*)&add_inputs, (TfLiteIntArray*)&add_outputs },
+    { (TfLiteIntArray*)&pool_inputs, (TfLiteIntArray*)&pool_outputs },
+  };
+  void* builtin_data[3] = { &conv_params, &add_params, &pool_params };
+  for (int i = 0; i < 3; i++) {
+    memset(&nodes[i], 0, sizeof(TfLiteNode));
+    nodes[i].inputs = node_io[i][0];
+    nodes[i].outputs = node_io[i][1];
+    nodes[i].builtin_data = builtin_data[i];
+    if (registrations[i]->init) {
+      nodes[i].user_data = registrations[i]->init(&context, nullptr, 0);
+    }
+    if (registrations[i]->prepare &&
+        registrations[i]->prepare(&context, &nodes[i]) != kTfLiteOk) {
+      printf("%s: prepare failed for node %d\n", name, i);
+      return 1;
+    }
+  }
+
+  // small values around the zero point, like MFE features
+  for (int i = 0; i < T * C; i++) input[i] = -4 + (RandomInt8() % 40);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    registrations[0]->invoke(&context, &nodes[0]);
+  }
+  const double conv_us = MicrosecondsSince(start, iterations);
+
+  start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    for (int i = 0; i < 3; i++) {
+      registrations[i]->invoke(&context, &nodes[i]);
+    }
+  }
+  const double registered_us = MicrosecondsSince(start, iterations);
+  memcpy(reference, output, sizeof(reference));
+
+  // The optimizer plans its own tensors, so copy the input over afterwards
+  static const int graph_outputs[] = { kPoolOut };
+  static uint8_t tensor_arena[2048] __attribute__((aligned(16)));
+  tflite::MicroGraphOptimizer optimizer;
+  size_t planned_bytes;
+  if (optimizer.Init(&context, nodes, registrations, 3, graph_outputs, 1) != kTfLiteOk ||
+      optimizer.PlanMemory(tensor_arena, sizeof(tensor_arena), &planned_bytes) != kTfLiteOk ||
+      optimizer.Prepare() != kTfLiteOk || optimizer.fused_blocks() != 1) {
+    printf("%s: could not fuse the block\n", name);
+    return 1;
+  }
+  memcpy(tensors[kInput].data.data, input, sizeof(input));
+
+  start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    optimizer.Invoke();
+  }
+  const double fused_us = MicrosecondsSince(start, iterations);
+  const bool fused_match =
+      memcmp(tensors[kPoolOut].data.data, reference, sizeof(reference)) == 0;
+
+  memset(tensors[kPoolOut].data.data, 0, sizeof(reference));
+  if (optimizer.SetBlockKernel(0, StaticBlock::Shape(), &StaticBlock::Eval) != kTfLiteOk) {
+    printf("%s: static kernel does not match the block shape\n", name);
+    return 1;
+  }
+  start = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++) {
+    optimizer.Invoke();
+  }
+  const double static_us = MicrosecondsSince(start, iterations);
+  const bool static_match =
+      memcmp(tensors[kPoolOut].data.data, reference, sizeof(reference)) == 0;
+
+  printf("%s (%dx%d -> %d channels)\n", name, T, C, K);
+  printf("  Register_CONV_2D only           %8.2f us\n", conv_us);
+  printf("  conv + add + max pool kernels   %8.2f us\n", registered_us);
+  printf("  fused, generic loop             %8.2f us  %s\n", fused_us,
+         fused_match ? "MATCH" : "MISMATCH");
+  printf("  fused, static_shape::ConvBlock  %8.2f us  %s\n", static_us,
+         static_match ? "MATCH" : "MISMATCH");
+  return fused_match && static_match ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+  typedef tflite::static_shape::ConvBlock<49, 13, 8, 3, 1, 1, kTfLitePaddingSame, true, 2, 2, kTfLitePaddingSame> ConvBlock0;
+  typedef tflite::static_shape::ConvBlock<25, 8, 16, 3, 1, 1, kTfLitePaddingSame, true, 2, 2, kTfLitePaddingSame> ConvBlock1;
+
+  int failed = RunBlock<49, 13, 8, ConvBlock0>("block 0", iterations);
+  failed |= RunBlock<25, 8, 16, ConvBlock1>("block 1", iterations);
+  return failed;
+}
@@ -0,0 +1,257 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Runs classifier_thread_pool with slices submitted from several threads at
+// once and checks it against run_classifier_stream_continuous on one thread:
+//  - every stream gets the same classifications, in the same order,
+//  - the per stream statistics count every submitted slice,
+//  - stop() joins the workers with nothing left queued, a second stop() and
+//    the destructor are no-ops, and the DSP heap is back where it started.
+// Prints the time per slice. Exits non-zero if a check fails.
+//
+//   thread_pool_benchmark [workers] [submitter threads]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/ei_classifier_thread_pool.h"
+#include "edge-impulse-sdk/dsp/memory.hpp"
+#include "model-parameters/model_metadata.h"
+
+namespace {
+
+const size_t kStreamCount = 8;
+const size_t kSlicesPerStream = 6 * EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+
+typedef std::vector<float> Classifications;
+
+struct PoolResults {
+  std::mutex mutex;
+  std::vector<Classifications> values;
+  size_t errors = 0;
+};
+
+// Tones that change pitch every quarter second plus noise, a different part
+// of it for every stream
+std::vector<int16_t> TestAudio() {
+  std::vector<int16_t> audio(kSlicesPerStream * EI_CLASSIFIER_SLICE_SIZE +
+                             kStreamCount * 1111);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < audio.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    audio[i] = static_cast<int16_t>(
+        3000 * sin(i * 0.05 * (1 + (i / 4000) % 3)) +
+        static_cast<int>((seed >> 16) % 400) - 200);
+  }
+  return audio;
+}
+
+const int16_t* StreamSlice(const std::vector<int16_t>& audio, size_t stream,
+                           size_t slice) {
+  return &audio[stream * 1111 + slice * EI_CLASSIFIER_SLICE_SIZE];
+}
+
+void AppendClassification(const ei_impulse_result_t& result,
+                          Classifications* values) {
+  for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+    values->push_back(result.classification[ix].value);
+  }
+}
+
+// run_classifier_stream_continuous on this thread, one stream after the other
+bool ReferenceResults(const std::vector<int16_t>& audio,
+                      std::vector<Classifications>* values) {
+  values->assign(kStreamCount, Classifications());
+  std::vector<float> slice(EI_CLASSIFIER_SLICE_SIZE);
+  for (size_t stream_ix = 0; stream_ix < kStreamCount; stream_ix++) {
+    ei_classifier_stream_t stream;
+    if (run_classifier_stream_init(&stream) != EI_IMPULSE_OK) {
+      return false;
+    }
+    for (size_t slice_ix = 0; slice_ix < kSlicesPerStream; slice_ix++) {
+      numpy::int16_to_float(StreamSlice(audio, stream_ix, slice_ix),
+                            slice.data(), slice.size());
+      signal_t signal;
+      numpy::signal_from_buffer(slice.data(), slice.size(), &signal);
+      ei_impulse_result_t result = {0};
+      if (run_classifier_stream_continuous(&stream, &signal, &result, false) !=
+          EI_IMPULSE_OK) {
+        run_classifier_stream_deinit(&stream);
+        return false;
+      }
+      if (stream.feature_buffer_full) {
+        AppendClassification(result, &(*values)[stream_ix]);
+      }
+    }
+    run_classifier_stream_deinit(&stream);
+  }
+  return true;
+}
+
+void OnResult(size_t stream_id, EI_IMPULSE_ERROR error,
+              ei_impulse_result_t* result, void* user_data) {
+  PoolResults* results = static_cast<PoolResults*>(user_data);
+  std::lock_guard<std::mutex> lock(results->mutex);
+  if (error != EI_IMPULSE_OK || stream_id >= results->values.size()) {
+    results->errors++;
+    return;
+  }
+  AppendClassification(*result, &results->values[stream_id]);
+}
+
+// Every submitter owns the streams submitter, submitter + submitter_count, ...
+// so the slices of one stream are submitted in order, but the streams of
+// different submitters interleave
+void Submit(ei::classifier_thread_pool* pool, const std::vector<int16_t>& audio,
+            const std::vector<int>& stream_ids, size_t submitter,
+            size_t submitter_count, size_t* failed) {
+  for (size_t slice_ix = 0; slice_ix < kSlicesPerStream; slice_ix++) {
+    for (size_t stream_ix = submitter; stream_ix < kStreamCount;
+         stream_ix += submitter_count) {
+      if (pool->submit(stream_ids[stream_ix],
+                       StreamSlice(audio, stream_ix, slice_ix),
+                       EI_CLASSIFIER_SLICE_SIZE) != EI_IMPULSE_OK) {
+        (*failed)++;
+      }
+    }
+  }
+}
+
+bool CheckPool(const std::vector<int16_t>& audio,
+               const std::vector<Classifications>& reference,
+               size_t worker_count, size_t submitter_count) {
+  const size_t heap_before = ei_memory_in_use;
+  PoolResults results;
+  results.values.assign(kStreamCount, Classifications());
+  bool ok = true;
+
+  {
+    ei::classifier_thread_pool pool(worker_count, OnResult, &results);
+    if (pool.start() != EI_IMPULSE_OK) {
+      printf("thread pool: start failed\n");
+      return false;
+    }
+
+    std::vector<int> stream_ids;
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      stream_ids.push_back(pool.add_stream());
+      if (stream_ids.back() < 0) {
+        printf("thread pool: add_stream failed\n");
+        return false;
+      }
+    }
+
+    const auto start = ei_read_timer_us();
+    std::vector<std::thread> submitters;
+    std::vector<size_t> failed(submitter_count, 0);
+    for (size_t ix = 0; ix < submitter_count; ix++) {
+      submitters.push_back(std::thread(Submit, &pool, std::cref(audio),
+                                       std::cref(stream_ids), ix,
+                                       submitter_count, &failed[ix]));
+    }
+    for (size_t ix = 0; ix < submitter_count; ix++) {
+      submitters[ix].join();
+      if (failed[ix] > 0) {
+        printf("thread pool: %u submits failed\n",
+               static_cast<unsigned>(failed[ix]));
+        ok = false;
+      }
+    }
+    pool.wait_idle();
+    const auto elapsed_us = ei_read_timer_us() - start;
+
+    for (size_t ix = 0; ix < kStreamCount; ix++) {
+      ei::classifier_stream_stats_t stats;
+      pool.get_stream_stats(stream_ids[ix], &stats);
+      const bool match = results.values[ix] == reference[ix] &&
+                         stats.slices == kSlicesPerStream &&
+                         stats.queue_depth == 0 &&
+                         stats.last_error == EI_IMPULSE_OK;
+      if (!match) {
+        printf("  stream %u: %u of %u classifications, %u of %u slices "
+               "MISMATCH\n",
+               static_cast<unsigned>(ix),
+               static_cast<unsigned>(results.values[ix].size() /
+                                     EI_CLASSIFIER_LABEL_COUNT),
+               static_cast<unsigned>(reference[ix].size() /
+                                     EI_CLASSIFIER_LABEL_COUNT),
+               static_cast<unsigned>(stats.slices),
+               static_cast<unsigned>(kSlicesPerStream));
+        ok = false;
+      }
+    }
+    if (results.errors > 0) {
+      printf("  %u results with an error\n",
+             static_cast<unsigned>(results.errors));
+      ok = false;
+    }
+
+    pool.stop();
+    if (pool.get_queue_depth() != 0) {
+      printf("  %u streams still queued after stop\n",
+             static_cast<unsigned>(pool.get_queue_depth()));
+      ok = false;
+    }
+    pool.stop();
+
+    printf("thread pool, %u workers, %u submitters: %.1f us per slice %s\n",
+           static_cast<unsigned>(worker_count),
+           static_cast<unsigned>(submitter_count),
+           elapsed_us / static_cast<double>(kStreamCount * kSlicesPerStream),
+           ok ? "MATCH" : "MISMATCH");
+  }
+
+  // The streams and the model instances of the workers are freed with the
+  // pool, so whatever they had on the DSP heap is back
+  const size_t heap_after = ei_memory_in_use;
+  if (heap_after != heap_before) {
+    printf("  DSP heap %u bytes before the pool, %u after MISMATCH\n",
+           static_cast<unsigned>(heap_before),
+           static_cast<unsigned>(heap_after));
+    ok = false;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t workers = argc > 1 ? atoi(argv[1]) : 4;
+  const size_t submitters = argc > 2 ? atoi(argv[2]) : 3;
+
+  const std::vector<int16_t> audio = TestAudio();
+  std::vector<Classifications> reference;
+  if (!ReferenceResults(audio, &reference)) {
+    printf("reference run failed\n");
+    return 1;
+  }
+
+  bool ok = CheckPool(audio, reference, workers, submitters);
+  ok &= CheckPool(audio, reference, 1, submitters);
+  run_classifier_deinit();
+  return ok ? 0 : 1;
+}
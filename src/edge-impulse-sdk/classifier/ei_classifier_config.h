@@ -50,4 +50,84 @@
 #endif // CPU_ARC
 #endif // EI_CLASSIFIER_TFLITE_ENABLE_ARC
 
+// SSE4.1 / AVX2 int8 kernels (conv, fully connected, add, max pool) for x86 hosts,
+// picked at compile time, build with -msse4.1, -mavx2 or -march=native to enable
+#ifndef EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD
+#if EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN == 0 && EI_CLASSIFIER_TFLITE_ENABLE_ARC == 0 && (defined(__SSE4_1__) || defined(__AVX2__))
+#define EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD        1
+#else
+#define EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD        0
+#endif
+#endif // EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD
+
+// Continuous classification on compiled models only computes the time steps of
+// the convolutional layers that changed since the last window (see
+// trained_model_invoke_streaming). Needs a front end that leaves old frames
+// as they were, a window-wide normalization changes every frame.
+#ifndef EI_CLASSIFIER_TFLITE_STREAMING
+#define EI_CLASSIFIER_TFLITE_STREAMING              0
+#endif // EI_CLASSIFIER_TFLITE_STREAMING
+
+// Compiled models elide their reshapes and run conv + bias add + max pool as one
+// loop (see tflite::MicroGraphOptimizer), which also shrinks the arena. The
+// fused loop replaces the CMSIS-NN and ARC MLI conv kernels, so it's off there.
+#ifndef EI_CLASSIFIER_TFLITE_GRAPH_FUSION
+#if EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN == 0 && EI_CLASSIFIER_TFLITE_ENABLE_ARC == 0
+#define EI_CLASSIFIER_TFLITE_GRAPH_FUSION           1
+#else
+#define EI_CLASSIFIER_TFLITE_GRAPH_FUSION           0
+#endif
+#endif // EI_CLASSIFIER_TFLITE_GRAPH_FUSION
+
+// The fused blocks of compiled models run kernels instantiated for their exact
+// shapes (tflite::static_shape::ConvBlock) rather than the generic fused loop
+#ifndef EI_CLASSIFIER_TFLITE_STATIC_KERNELS
+#define EI_CLASSIFIER_TFLITE_STATIC_KERNELS         EI_CLASSIFIER_TFLITE_GRAPH_FUSION
+#endif // EI_CLASSIFIER_TFLITE_STATIC_KERNELS
+
+// Bytes kept for the memory plans of the TFLite interpreter (not used by compiled
+// models), so the arena is only planned for the first inference. A plan takes 20
+// bytes plus 4 per tensor, 0 plans on every inference.
+#ifndef EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE
+#define EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE        1024
+#endif // EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE
+
+// Time every node of the model and the DSP stages, and track the arena high
+// water mark. Read the numbers with run_classifier_get_profile(). The DSP and
+// TFLite sources check this too, define it for the whole build.
+#ifndef EI_CLASSIFIER_PROFILING
+#define EI_CLASSIFIER_PROFILING                     0
+#endif // EI_CLASSIFIER_PROFILING
+
+// Nodes that get their own counter when profiling, later nodes are not counted
+#ifndef EI_CLASSIFIER_PROFILING_MAX_NODES
+#define EI_CLASSIFIER_PROFILING_MAX_NODES           64
+#endif // EI_CLASSIFIER_PROFILING_MAX_NODES
+
+// Keep a histogram of the end-to-end latency of every slice per continuous
+// stream (p50 / p99 / p99.9, see run_classifier_stream_get_latency). Takes
+// about 1.5K per stream.
+#ifndef EI_CLASSIFIER_LATENCY_HISTOGRAM
+#define EI_CLASSIFIER_LATENCY_HISTOGRAM             0
+#endif // EI_CLASSIFIER_LATENCY_HISTOGRAM
+
+// Energy based voice activity gate for continuous classification. Every stream
+// tracks the noise floor of its frame energies; once no slice of the window got
+// EI_CLASSIFIER_VAD_THRESHOLD_DB above it and that silence went through the
+// network once, the network is skipped and its last result is reused (see
+// ei_impulse_result_t::no_speech). Needs an MFCC or MFE front end.
+#ifndef EI_CLASSIFIER_VAD
+#define EI_CLASSIFIER_VAD                           0
+#endif // EI_CLASSIFIER_VAD
+
+// How far above the noise floor the loudest frame of a slice has to be to count as speech
+#ifndef EI_CLASSIFIER_VAD_THRESHOLD_DB
+#define EI_CLASSIFIER_VAD_THRESHOLD_DB              10.0f
+#endif // EI_CLASSIFIER_VAD_THRESHOLD_DB
+
+// The noise floor drops to the quietest frame at once, but only rises this fast
+#ifndef EI_CLASSIFIER_VAD_FLOOR_RISE_DB_PER_S
+#define EI_CLASSIFIER_VAD_FLOOR_RISE_DB_PER_S       3.0f
+#endif // EI_CLASSIFIER_VAD_FLOOR_RISE_DB_PER_S
+
 #endif // _EI_CLASSIFIER_CONFIG_H_
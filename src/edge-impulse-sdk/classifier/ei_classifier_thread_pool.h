@@ -0,0 +1,457 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EI_CLASSIFIER_THREAD_POOL_H_
+#define _EI_CLASSIFIER_THREAD_POOL_H_
+
+#include "ei_run_classifier.h"
+
+#if EIDSP_MULTI_THREADED != 1
+#error "ei_classifier_thread_pool.h needs EIDSP_MULTI_THREADED=1"
+#endif
+#if EIDSP_SIGNAL_C_FN_POINTER == 1
+#error "ei_classifier_thread_pool.h needs EIDSP_SIGNAL_C_FN_POINTER=0"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ei {
+
+/**
+ * Per stream statistics of a classifier_thread_pool
+ */
+typedef struct {
+    size_t queue_depth;             // slices waiting to be classified
+    size_t max_queue_depth;
+    uint64_t slices;                // slices classified
+    uint64_t last_latency_us;       // from submit() until the result of the last slice
+    uint64_t max_latency_us;
+    uint64_t total_latency_us;      // divide by slices for the mean latency
+    EI_IMPULSE_ERROR last_error;
+} classifier_stream_stats_t;
+
+/**
+ * Called from a worker thread for every slice that produced a classification
+ * (the stream holds a full window), or that failed. `result` is only valid
+ * during the call.
+ */
+typedef void (*classifier_result_fn)(size_t stream_id, EI_IMPULSE_ERROR error,
+                                     ei_impulse_result_t *result, void *user_data);
+
+/**
+ * Runs run_classifier_stream_continuous for many streams on a pool of worker
+ * threads. Every worker has its own model instance (arena and scratch buffers,
+ * see run_classifier_thread_init), the model weights are shared.
+ *
+ * A stream with queued slices sits in the queue of one worker, and goes to the
+ * back of that queue after each slice, so a stream that has fallen behind can't
+ * starve the others. Idle workers steal streams from the back of the queues of
+ * busy workers. Slices of one stream are always classified in order, by one
+ * worker at a time.
+ */
+class classifier_thread_pool {
+public:
+    /**
+     * @param worker_count Number of worker threads
+     * @param result_fn Result callback (can be NULL)
+     * @param user_data Passed to the result callback
+     */
+    classifier_thread_pool(size_t worker_count, classifier_result_fn result_fn, void *user_data)
+        : _worker_count(worker_count > 0 ? worker_count : 1), _result_fn(result_fn), _user_data(user_data),
+          _workers(NULL), _ready_count(0), _outstanding(0), _running(false), _stopping(false)
+    {
+    }
+
+    ~classifier_thread_pool() {
+        stop();
+
+        for (size_t ix = 0; ix < _streams.size(); ix++) {
+            if (_streams[ix]) {
+                run_classifier_stream_deinit(&_streams[ix]->state);
+                delete _streams[ix];
+            }
+        }
+    }
+
+    /**
+     * Start the worker threads
+     * @returns EI_IMPULSE_OK, or the error of a worker that failed to set up its model instance
+     */
+    EI_IMPULSE_ERROR start() {
+        if (_running) {
+            return EI_IMPULSE_OK;
+        }
+
+        _workers = new worker_t[_worker_count];
+        _stopping = false;
+        _started_count = 0;
+        _start_error = EI_IMPULSE_OK;
+
+        for (size_t ix = 0; ix < _worker_count; ix++) {
+            _workers[ix].thread = std::thread(&classifier_thread_pool::worker_main, this, ix);
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            _idle_cv.wait(lock, [this] { return _started_count == _worker_count; });
+        }
+
+        _running = true;
+
+        if (_start_error != EI_IMPULSE_OK) {
+            EI_IMPULSE_ERROR res = _start_error;
+            stop();
+            return res;
+        }
+        return EI_IMPULSE_OK;
+    }
+
+    /**
+     * Finish all queued slices and stop the worker threads
+     */
+    void stop() {
+        if (!_running) {
+            return;
+        }
+
+        wait_idle();
+
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _stopping = true;
+        }
+        _work_cv.notify_all();
+
+        for (size_t ix = 0; ix < _worker_count; ix++) {
+            _workers[ix].thread.join();
+        }
+
+        delete[] _workers;
+        _workers = NULL;
+        _running = false;
+    }
+
+    /**
+     * Add a stream
+     * @returns Stream id, or -1 if the stream could not be allocated
+     */
+    int add_stream() {
+        pool_stream_t *stream = new pool_stream_t();
+        if (run_classifier_stream_init(&stream->state) != EI_IMPULSE_OK) {
+            delete stream;
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(_streams_mutex);
+
+        size_t id = 0;
+        while (id < _streams.size() && _streams[id]) {
+            id++;
+        }
+        if (id == _streams.size()) {
+            _streams.push_back(NULL);
+        }
+
+        stream->id = id;
+        stream->home_worker = id % _worker_count;
+        _streams[id] = stream;
+        return (int)id;
+    }
+
+    /**
+     * Remove a stream, waits until its queued slices are classified
+     */
+    EI_IMPULSE_ERROR remove_stream(size_t stream_id) {
+        pool_stream_t *stream = get_stream(stream_id);
+        if (!stream) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            stream->idle_cv.wait(lock, [stream] { return !stream->scheduled; });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_streams_mutex);
+            _streams[stream_id] = NULL;
+        }
+
+        run_classifier_stream_deinit(&stream->state);
+        delete stream;
+        return EI_IMPULSE_OK;
+    }
+
+    /**
+     * Queue a slice of audio for a stream, the samples are copied
+     * @param stream_id Stream id from add_stream
+     * @param samples Samples (normally EI_CLASSIFIER_SLICE_SIZE)
+     * @param length Number of samples
+     */
+    EI_IMPULSE_ERROR submit(size_t stream_id, const int16_t *samples, size_t length) {
+        std::vector<float> slice(length);
+        numpy::int16_to_float(samples, slice.data(), length);
+        return submit_slice(stream_id, slice);
+    }
+
+    EI_IMPULSE_ERROR submit(size_t stream_id, const float *samples, size_t length) {
+        std::vector<float> slice(samples, samples + length);
+        return submit_slice(stream_id, slice);
+    }
+
+    /**
+     * Wait until all queued slices are classified
+     */
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _idle_cv.wait(lock, [this] { return _outstanding.load() == 0 || !_running; });
+    }
+
+    /**
+     * Get the statistics of a stream
+     */
+    EI_IMPULSE_ERROR get_stream_stats(size_t stream_id, classifier_stream_stats_t *stats) {
+        pool_stream_t *stream = get_stream(stream_id);
+        if (!stream) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        *stats = stream->stats;
+        stats->queue_depth = stream->pending.size();
+        return EI_IMPULSE_OK;
+    }
+
+    /**
+     * Number of streams that have slices queued, over all workers
+     */
+    size_t get_queue_depth() {
+        return _ready_count.load();
+    }
+
+private:
+    typedef struct {
+        std::vector<float> samples;
+        uint64_t submit_us;
+    } pending_slice_t;
+
+    typedef struct pool_stream {
+        ei_classifier_stream_t state = { 0 };
+        std::mutex mutex;
+        std::condition_variable idle_cv;
+        std::deque<pending_slice_t> pending;
+        bool scheduled = false;          // in a worker queue, or being classified
+        size_t id = 0;
+        size_t home_worker = 0;
+        classifier_stream_stats_t stats = { 0, 0, 0, 0, 0, 0, EI_IMPULSE_OK };
+    } pool_stream_t;
+
+    typedef struct {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<pool_stream_t*> queue;
+    } worker_t;
+
+    pool_stream_t *get_stream(size_t stream_id) {
+        std::lock_guard<std::mutex> lock(_streams_mutex);
+        return stream_id < _streams.size() ? _streams[stream_id] : NULL;
+    }
+
+    EI_IMPULSE_ERROR submit_slice(size_t stream_id, std::vector<float> &samples) {
+        if (!_running) {
+            return EI_IMPULSE_CANCELED;
+        }
+
+        pool_stream_t *stream = get_stream(stream_id);
+        if (!stream) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+
+        pending_slice_t slice;
+        slice.samples.swap(samples);
+        slice.submit_us = ei_read_timer_us();
+
+        // count the slice before a worker can see it
+        _outstanding++;
+
+        bool schedule = false;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->pending.push_back(std::move(slice));
+            if (stream->pending.size() > stream->stats.max_queue_depth) {
+                stream->stats.max_queue_depth = stream->pending.size();
+            }
+            if (!stream->scheduled) {
+                stream->scheduled = true;
+                schedule = true;
+            }
+        }
+
+        if (schedule) {
+            enqueue(stream->home_worker, stream);
+        }
+        return EI_IMPULSE_OK;
+    }
+
+    void enqueue(size_t worker_ix, pool_stream_t *stream) {
+        {
+            std::lock_guard<std::mutex> lock(_workers[worker_ix].mutex);
+            _workers[worker_ix].queue.push_back(stream);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _ready_count++;
+        }
+        _work_cv.notify_one();
+    }
+
+    /**
+     * Take the next stream from the front of our own queue, or steal one from
+     * the back of another worker's queue
+     */
+    pool_stream_t *dequeue(size_t worker_ix) {
+        for (size_t n = 0; n < _worker_count; n++) {
+            worker_t &w = _workers[(worker_ix + n) % _worker_count];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (w.queue.empty()) {
+                continue;
+            }
+
+            pool_stream_t *stream;
+            if (n == 0) {
+                stream = w.queue.front();
+                w.queue.pop_front();
+            }
+            else {
+                stream = w.queue.back();
+                w.queue.pop_back();
+            }
+            _ready_count--;
+            return stream;
+        }
+        return NULL;
+    }
+
+    void run_slice(size_t worker_ix, pool_stream_t *stream) {
+        pending_slice_t slice;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            slice = std::move(stream->pending.front());
+            stream->pending.pop_front();
+        }
+
+        signal_t signal;
+        numpy::signal_from_buffer(slice.samples.data(), slice.samples.size(), &signal);
+
+        ei_impulse_result_t result = { 0 };
+        EI_IMPULSE_ERROR res = run_classifier_stream_continuous(&stream->state, &signal, &result, false);
+        uint64_t latency_us = ei_read_timer_us() - slice.submit_us;
+
+        if (_result_fn && (res != EI_IMPULSE_OK || stream->state.feature_buffer_full)) {
+            _result_fn(stream->id, res, &result, _user_data);
+        }
+
+        bool requeue;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->stats.slices++;
+            stream->stats.last_latency_us = latency_us;
+            stream->stats.total_latency_us += latency_us;
+            if (latency_us > stream->stats.max_latency_us) {
+                stream->stats.max_latency_us = latency_us;
+            }
+            stream->stats.last_error = res;
+
+            requeue = !stream->pending.empty();
+            if (!requeue) {
+                stream->scheduled = false;
+                stream->idle_cv.notify_all();
+            }
+        }
+
+        // to the back of our queue, so the other streams get a turn first
+        if (requeue) {
+            enqueue(worker_ix, stream);
+        }
+
+        if (--_outstanding == 0) {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _idle_cv.notify_all();
+        }
+    }
+
+    void worker_main(size_t worker_ix) {
+        EI_IMPULSE_ERROR init_res = run_classifier_thread_init();
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            if (init_res != EI_IMPULSE_OK) {
+                _start_error = init_res;
+            }
+            _started_count++;
+        }
+        _idle_cv.notify_all();
+
+        while (true) {
+            pool_stream_t *stream = dequeue(worker_ix);
+            if (stream) {
+                run_slice(worker_ix, stream);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            if (_stopping) {
+                break;
+            }
+            _work_cv.wait(lock, [this] { return _ready_count > 0 || _stopping; });
+        }
+
+        run_classifier_thread_deinit();
+    }
+
+    size_t _worker_count;
+    classifier_result_fn _result_fn;
+    void *_user_data;
+
+    worker_t *_workers;
+    std::vector<pool_stream_t*> _streams;
+    std::mutex _streams_mutex;
+
+    std::mutex _sleep_mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _idle_cv;
+    std::atomic<size_t> _ready_count;   // streams in worker queues, raised under _sleep_mutex
+    std::atomic<size_t> _outstanding;   // slices submitted but not classified yet
+    size_t _started_count;
+    EI_IMPULSE_ERROR _start_error;
+    std::atomic<bool> _running;
+    bool _stopping;
+};
+
+} // namespace ei
+
+#endif // _EI_CLASSIFIER_THREAD_POOL_H_
@@ -24,24 +24,38 @@
 #define _EDGE_IMPULSE_RUN_CLASSIFIER_TYPES_H_
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "model-parameters/model_metadata.h"
+#include "ei_classifier_config.h"
+#include "ei_latency_histogram.h"
+#include "edge-impulse-sdk/dsp/profiling.hpp"
 
 typedef struct {
     const char *label;
     float value;
 } ei_impulse_result_classification_t;
 
+/* Time spent per step, in milliseconds (rounded down) and microseconds */
 typedef struct {
     int sampling;
     int dsp;
     int classification;
     int anomaly;
+    int64_t dsp_us;
+    int64_t classification_us;
+    int64_t anomaly_us;
 } ei_impulse_result_timing_t;
 
 typedef struct {
     ei_impulse_result_classification_t classification[EI_CLASSIFIER_LABEL_COUNT];
     float anomaly;
     ei_impulse_result_timing_t timing;
+#if EI_CLASSIFIER_VAD == 1
+    /* No slice of the window had speech. If the network was skipped, the classification
+       is the last result run through the moving average filter, with zero classification time */
+    bool no_speech;
+#endif
 } ei_impulse_result_t;
 
 typedef struct {
@@ -50,4 +64,81 @@ typedef struct {
     float maf_buffer[EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1];    
 }ei_impulse_maf;
 
+/* Longest pre-emphasis shift that is carried over from one slice to the next */
+#define EI_DSP_SLICE_PREEMPHASIS_MAX_SHIFT  4
+
+/* State the per-slice DSP functions keep between the slices of one stream */
+typedef struct {
+    bool mfcc_first_run;
+    bool mfcc_q15_first_run;
+    bool spectrogram_first_run;
+    bool mfe_first_run;
+    /* Last samples of the previous slice, the pre-emphasis history of the next one */
+    bool preemphasis_history_valid;
+    float preemphasis_history[EI_DSP_SLICE_PREEMPHASIS_MAX_SHIFT];
+    /* Quietest and loudest ln(frame energy) of the last slice, for the voice activity gate.
+       Not set by the spectrogram, it normalizes its frames away. */
+    bool frame_energy_valid;
+    float frame_log_energy_min;
+    float frame_log_energy_max;
+} ei_dsp_slice_state_t;
+
+#if EI_CLASSIFIER_VAD == 1
+/* Voice activity gate of one stream, see EI_CLASSIFIER_VAD */
+typedef struct {
+    bool noise_floor_valid;
+    float noise_floor;                  /* ln(frame energy) */
+    uint32_t quiet_slices;              /* slices in a row without speech */
+    /* A window of only quiet slices went through the network since the last speech */
+    bool silence_classified;
+    float silence_result[EI_CLASSIFIER_LABEL_COUNT];
+    float silence_anomaly;
+} ei_classifier_vad_t;
+#endif
+
+/* Continuous classification state of one audio stream, see run_classifier_stream_init() */
+typedef struct {
+    float *features;                    /* EI_CLASSIFIER_NN_INPUT_FRAME_SIZE items */
+    size_t slice_offset;
+    bool feature_buffer_full;
+    /* Once the feature buffer is full it is used as a ring of whole slices */
+    size_t feature_window_size;
+    size_t feature_ring_size;
+    size_t feature_ring_slice_size;
+    /* Features produced by the last slice */
+    size_t slice_size;
+    bool is_mfcc;
+    bool is_mfe;
+    bool is_spectrogram;
+    ei_dsp_slice_state_t dsp_state;
+    /* Row pointers into the window for the quantized normalization, allocated once
+       the feature buffer is full (NULL if the window doesn't go that way) */
+    const float **window_rows;
+    size_t window_row_count;
+    ei_impulse_maf maf[EI_CLASSIFIER_LABEL_COUNT];
+#if EI_CLASSIFIER_VAD == 1
+    ei_classifier_vad_t vad;
+#endif
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    /* Time from handing in a slice to the (smoothed) result, see run_classifier_stream_get_latency() */
+    ei_latency_histogram_t latency;
+#endif
+} ei_classifier_stream_t;
+
+/* Model node in ei_impulse_profile_t, times in microseconds */
+typedef struct {
+    const char *name;
+    ei_profile_counter_t time;
+} ei_impulse_profile_node_t;
+
+/* Counters collected with EI_CLASSIFIER_PROFILING, see run_classifier_get_profile() */
+typedef struct {
+    ei_profile_counter_t dsp_stages[EI_DSP_STAGE_COUNT];    /* indexed by ei_dsp_stage_t */
+    ei_impulse_profile_node_t nodes[EI_CLASSIFIER_PROFILING_MAX_NODES];
+    size_t nodes_size;
+    size_t arena_size;
+    size_t arena_peak_bytes;            /* high water mark of the TFLite arena */
+    size_t dsp_heap_peak_bytes;         /* needs EIDSP_TRACK_ALLOCATIONS */
+} ei_impulse_profile_t;
+
 #endif // _EDGE_IMPULSE_RUN_CLASSIFIER_TYPES_H_
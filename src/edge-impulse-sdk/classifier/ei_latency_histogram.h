@@ -0,0 +1,143 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EI_LATENCY_HISTOGRAM_H_
+#define _EI_LATENCY_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Latency histogram with log-linear buckets (as in HdrHistogram): values below
+ * 32 us have their own bucket, above that every power of two is split in 16
+ * buckets, so a percentile is off by at most 1/16th (6.25%). Values up to
+ * 2^26 us (67 s) are counted, anything slower ends up in the last bucket.
+ * Min, max and mean are exact.
+ */
+#define EI_LATENCY_HISTOGRAM_SUB_BUCKETS        16
+#define EI_LATENCY_HISTOGRAM_SHIFT_MAX          21
+#define EI_LATENCY_HISTOGRAM_BUCKETS            (EI_LATENCY_HISTOGRAM_SUB_BUCKETS * (EI_LATENCY_HISTOGRAM_SHIFT_MAX + 2))
+
+typedef struct {
+    uint32_t counts[EI_LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} ei_latency_histogram_t;
+
+/* Latency percentiles of a histogram, in microseconds */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+} ei_latency_summary_t;
+
+static inline void ei_latency_histogram_reset(ei_latency_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(ei_latency_histogram_t));
+}
+
+static inline size_t ei_latency_histogram_bucket(uint32_t value_us)
+{
+    if (value_us < 2 * EI_LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return value_us;
+    }
+    int msb = 31;
+    while (!(value_us & (1UL << msb))) {
+        msb--;
+    }
+    // shift so the value keeps its top 5 bits, [16, 32) after the shift
+    int shift = msb - 4;
+    if (shift > EI_LATENCY_HISTOGRAM_SHIFT_MAX) {
+        return EI_LATENCY_HISTOGRAM_BUCKETS - 1;
+    }
+    return (EI_LATENCY_HISTOGRAM_SUB_BUCKETS * shift) + (value_us >> shift);
+}
+
+/* Largest value that lands in a bucket */
+static inline uint32_t ei_latency_histogram_bucket_max(size_t bucket)
+{
+    if (bucket < 2 * EI_LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return static_cast<uint32_t>(bucket);
+    }
+    const size_t shift = (bucket / EI_LATENCY_HISTOGRAM_SUB_BUCKETS) - 1;
+    const uint32_t top = static_cast<uint32_t>((bucket % EI_LATENCY_HISTOGRAM_SUB_BUCKETS) + EI_LATENCY_HISTOGRAM_SUB_BUCKETS);
+    return ((top + 1) << shift) - 1;
+}
+
+static inline void ei_latency_histogram_record(ei_latency_histogram_t *histogram, uint64_t value_us)
+{
+    const uint32_t value = value_us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(value_us);
+    histogram->counts[ei_latency_histogram_bucket(value)]++;
+    if (histogram->count == 0 || value < histogram->min_us) {
+        histogram->min_us = value;
+    }
+    if (value > histogram->max_us) {
+        histogram->max_us = value;
+    }
+    histogram->count++;
+    histogram->total_us += value;
+}
+
+/**
+ * Value below which `percentile` (0..100) percent of the samples fall, rounded
+ * up to the end of its bucket (but never above the max). 0 without samples.
+ */
+static inline uint32_t ei_latency_histogram_percentile(const ei_latency_histogram_t *histogram, float percentile)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>((percentile / 100.0f) * histogram->count + 0.999f);
+    if (target < 1) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t ix = 0; ix < EI_LATENCY_HISTOGRAM_BUCKETS; ix++) {
+        seen += histogram->counts[ix];
+        if (seen >= target) {
+            const uint32_t value = ei_latency_histogram_bucket_max(ix);
+            return value < histogram->max_us ? value : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+static inline void ei_latency_histogram_summary(const ei_latency_histogram_t *histogram, ei_latency_summary_t *summary)
+{
+    summary->count = histogram->count;
+    summary->min_us = histogram->min_us;
+    summary->max_us = histogram->max_us;
+    summary->mean_us = histogram->count > 0 ?
+        static_cast<uint32_t>(histogram->total_us / histogram->count) : 0;
+    summary->p50_us = ei_latency_histogram_percentile(histogram, 50.0f);
+    summary->p99_us = ei_latency_histogram_percentile(histogram, 99.0f);
+    summary->p999_us = ei_latency_histogram_percentile(histogram, 99.9f);
+}
+
+#endif // _EI_LATENCY_HISTOGRAM_H_
@@ -44,6 +44,8 @@
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
 #include "edge-impulse-sdk/tensorflow/lite/version.h"
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_node_profiler.h"
 
 #include "tflite-model/tflite-trained.h"
 #if defined(EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER) && EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER == 1
@@ -88,6 +90,8 @@ static ai_handle network = AI_HANDLE_NULL;
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tflite-model/trained_model_compiled.h"
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_node_profiler.h"
 
 
 
@@ -109,18 +113,47 @@ namespace {
 extern "C" EI_IMPULSE_ERROR run_inference(ei::matrix_t *fmatrix, ei_impulse_result_t *result, bool debug);
 extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(signal_t *signal, ei_impulse_result_t *result, bool debug);
 static EI_IMPULSE_ERROR can_run_classifier_image_quantized();
+static EI_IMPULSE_ERROR can_run_inference_window_quantized(ei_classifier_stream_t *stream);
+static EI_IMPULSE_ERROR run_inference_window_quantized(ei_classifier_stream_t *stream,
+                                                       ei_impulse_result_t *result, bool debug);
 static void calc_cepstral_mean_and_var_normalization_mfcc(ei_matrix *matrix, void *config_ptr);
 static void calc_cepstral_mean_and_var_normalization_mfe(ei_matrix *matrix, void *config_ptr);
 static void calc_cepstral_mean_and_var_normalization_spectrogram(ei_matrix *matrix, void *config_ptr);
 
 /* Private variables ------------------------------------------------------- */
-#if EI_CLASSIFIER_LABEL_COUNT > 0
-ei_impulse_maf classifier_maf[EI_CLASSIFIER_LABEL_COUNT] = {{0}};
-#else
-ei_impulse_maf classifier_maf[0];
+/* Stream used by run_classifier_continuous */
+static ei_classifier_stream_t classifier_stream = { 0 };
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+/* Whether the model stays initialized between inferences (see run_classifier_session_create) */
+static EIDSP_THREAD_LOCAL bool tflite_session_active = false;
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+/* Model instance of the calling thread, NULL for the default one (see run_classifier_thread_init) */
+static EIDSP_THREAD_LOCAL trained_model_ctx_t *tflite_model_ctx = NULL;
+/* Features the window moved since the last inference, -1 outside of continuous mode */
+static EIDSP_THREAD_LOCAL int tflite_stream_shift = -1;
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1) && (EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE > 0)
+/* Memory plans of the interpreter, so AllocateTensors() only plans the model once */
+static EIDSP_THREAD_LOCAL uint32_t tflite_plan_cache_storage[EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE / sizeof(uint32_t)];
+static EIDSP_THREAD_LOCAL tflite::MemoryPlanCache tflite_plan_cache((uint8_t*)tflite_plan_cache_storage, sizeof(tflite_plan_cache_storage));
+static EIDSP_THREAD_LOCAL uint32_t tflite_model_hash = 0;
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+/* Interpreter and arena of the active session */
+static EIDSP_THREAD_LOCAL tflite::MicroInterpreter *tflite_session_interpreter = NULL;
+static EIDSP_THREAD_LOCAL uint8_t *tflite_session_arena = NULL;
+static EI_IMPULSE_ERROR inference_tflite_create_interpreter(tflite::MicroInterpreter **micro_interpreter,
+    uint8_t **micro_tensor_arena);
+static void inference_tflite_free_interpreter(tflite::MicroInterpreter *interpreter, uint8_t *tensor_arena);
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_PROFILING == 1)
+/* Node timings and arena high water mark of the calling thread, see run_classifier_get_profile */
+static EIDSP_THREAD_LOCAL tflite::MicroNodeProfiler::Node tflite_profiler_nodes[EI_CLASSIFIER_PROFILING_MAX_NODES];
+static EIDSP_THREAD_LOCAL tflite::MicroNodeProfiler tflite_profiler(tflite_profiler_nodes,
+    EI_CLASSIFIER_PROFILING_MAX_NODES, &ei_read_timer_us);
+static EIDSP_THREAD_LOCAL size_t tflite_arena_peak_bytes = 0;
 #endif
-static size_t slice_offset = 0;
-static bool feature_buffer_full = false;
 
 /* Private functions ------------------------------------------------------- */
 
@@ -160,110 +193,870 @@ static void clear_moving_average_filter(ei_impulse_maf *maf)
     }
 }
 
+/**
+ * @brief      Reset a stream to start at a new window, keeps the feature buffer
+ *
+ * @param      stream  The stream
+ */
+static void reset_classifier_stream(ei_classifier_stream_t *stream)
+{
+    stream->slice_offset = 0;
+    stream->feature_buffer_full = false;
+    stream->feature_window_size = 0;
+    stream->feature_ring_size = 0;
+    stream->feature_ring_slice_size = 0;
+    stream->slice_size = 0;
+    stream->is_mfcc = false;
+    stream->is_mfe = false;
+    stream->is_spectrogram = false;
+    memset(&stream->dsp_state, 0, sizeof(stream->dsp_state));
+#if EI_CLASSIFIER_VAD == 1
+    memset(&stream->vad, 0, sizeof(stream->vad));
+#endif
+
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        stream->maf[ix].buf_idx = 0;
+        clear_moving_average_filter(&stream->maf[ix]);
+    }
+}
+
 /**
  * @brief      Init static vars
  */
 extern "C" void run_classifier_init(void)
 {
-    slice_offset = 0;
-    feature_buffer_full = false;
+    reset_classifier_stream(&classifier_stream);
+}
 
-    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        clear_moving_average_filter(&classifier_maf[ix]);
+/**
+ * @brief      Set up a stream for run_classifier_stream_continuous and
+ *             run_classifier_continuous_batch. Every stream keeps its own feature
+ *             window, slice offsets and moving average filter; the model and
+ *             the DSP plans are shared between all streams. Release the stream
+ *             with run_classifier_stream_deinit.
+ *
+ * @param      stream  The stream
+ *
+ * @return     EI_IMPULSE_OK if successful
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_stream_init(ei_classifier_stream_t *stream)
+{
+    stream->window_rows = NULL;
+    stream->window_row_count = 0;
+    stream->features = (float*)ei_dsp_calloc(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, sizeof(float));
+    if (!stream->features) {
+        return EI_IMPULSE_ALLOC_FAILED;
     }
+
+    reset_classifier_stream(stream);
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    ei_latency_histogram_reset(&stream->latency);
+#endif
+    return EI_IMPULSE_OK;
 }
 
 /**
- * @brief      Fill the complete matrix with sample slices. From there, run inference
- *             on the matrix.
+ * @brief      Release the feature buffer and the window rows of a stream
  *
- * @param      signal  Sample data
- * @param      result  Classification output
- * @param[in]  debug   Debug output enable boot
+ * @param      stream  The stream
+ */
+extern "C" void run_classifier_stream_deinit(ei_classifier_stream_t *stream)
+{
+    if (stream->features) {
+        ei_dsp_free(stream->features, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE * sizeof(float));
+        stream->features = NULL;
+    }
+    if (stream->window_rows) {
+        ei_dsp_free(stream->window_rows, stream->window_row_count * sizeof(float*));
+        stream->window_rows = NULL;
+        stream->window_row_count = 0;
+    }
+    reset_classifier_stream(stream);
+}
+
+/**
+ * @brief      Latency of the slices of a stream that produced a result, from
+ *             handing in the slice to getting the (smoothed) classification
+ *             back. All zero without EI_CLASSIFIER_LATENCY_HISTOGRAM=1.
  *
- * @return     The ei impulse error.
+ * @param      stream   The stream
+ * @param      summary  Filled with the count, min, max, mean and percentiles
  */
-extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
-                                                      bool debug = false)
+extern "C" void run_classifier_stream_get_latency(const ei_classifier_stream_t *stream, ei_latency_summary_t *summary)
+{
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    ei_latency_histogram_summary(&stream->latency, summary);
+#else
+    memset(summary, 0, sizeof(ei_latency_summary_t));
+#endif
+}
+
+/**
+ * @brief      Forget the latencies recorded for a stream so far
+ *
+ * @param      stream  The stream
+ */
+extern "C" void run_classifier_stream_reset_latency(ei_classifier_stream_t *stream)
+{
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    ei_latency_histogram_reset(&stream->latency);
+#endif
+}
+
+/**
+ * @brief      run_classifier_stream_get_latency for the stream of run_classifier_continuous
+ */
+extern "C" void run_classifier_get_latency(ei_latency_summary_t *summary)
+{
+    run_classifier_stream_get_latency(&classifier_stream, summary);
+}
+
+/**
+ * @brief      Create a long-lived inference session. The model is initialized
+ *             (arena allocation and kernel init/prepare) once, after which every
+ *             call to run_inference() only fills the input tensor and invokes
+ *             the model. Calling this while a session is active is a no-op.
+ *             For TFLite models that are not compiled the interpreter, its op
+ *             resolver and the arena stay resident, so swapping in a flatbuffer
+ *             model costs no allocation or prepare per window. Only TFLite
+ *             models keep a session, for other engines this does nothing.
+ *
+ * @return     EI_IMPULSE_OK if successful
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_session_create(void)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    if (tflite_session_active) {
+        return EI_IMPULSE_OK;
+    }
+
+    TfLiteStatus init_status = trained_model_init_ctx(tflite_model_ctx, ei_aligned_malloc);
+    if (init_status != kTfLiteOk) {
+        ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
+        trained_model_reset_ctx(tflite_model_ctx, ei_aligned_free);
+        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+    }
+
+    tflite_session_active = true;
+#elif (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+    if (tflite_session_active) {
+        return EI_IMPULSE_OK;
+    }
+
+    EI_IMPULSE_ERROR init_res = inference_tflite_create_interpreter(&tflite_session_interpreter,
+        &tflite_session_arena);
+    if (init_res != EI_IMPULSE_OK) {
+        return init_res;
+    }
+
+    tflite_session_active = true;
+#endif
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Destroy the inference session and give the arena back, e.g. to
+ *             have the RAM for DSP. Later inferences will set up and tear down
+ *             the model per call again, until a new session is created.
+ */
+extern "C" void run_classifier_session_destroy(void)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    if (!tflite_session_active) {
+        return;
+    }
+
+    trained_model_reset_ctx(tflite_model_ctx, ei_aligned_free);
+    tflite_session_active = false;
+#elif (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+    if (!tflite_session_active) {
+        return;
+    }
+
+    inference_tflite_free_interpreter(tflite_session_interpreter, tflite_session_arena);
+    tflite_session_interpreter = NULL;
+    tflite_session_arena = NULL;
+    tflite_session_active = false;
+#endif
+}
+
+/**
+ * @brief      Release everything that was kept alive between calls to
+ *             run_classifier_continuous (the inference session, its feature
+ *             buffer, the MFCC and MFE plans and the cached FFT plans)
+ */
+extern "C" void run_classifier_deinit(void)
+{
+    run_classifier_session_destroy();
+    run_classifier_stream_deinit(&classifier_stream);
+    free_mfcc_plan();
+    free_mfcc_q15_plan();
+    numpy::free_fft_plans();
+}
+
+/**
+ * @brief      The memory plans of the TFLite interpreter, serialized. Write
+ *             them to flash and pass them to run_classifier_load_plan_cache
+ *             at the next start, so AllocateTensors() doesn't have to plan
+ *             the model. Compiled (EON) models are planned when they are
+ *             generated, for those this is always empty.
+ *
+ * @param      data  Set to the serialized plans
+ * @param      size  Set to the size of the plans in bytes
+ */
+extern "C" void run_classifier_get_plan_cache(const uint8_t **data, size_t *size)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1) && (EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE > 0)
+    *data = tflite_plan_cache.data();
+    *size = tflite_plan_cache.size();
+#else
+    *data = NULL;
+    *size = 0;
+#endif
+}
+
+/**
+ * @brief      Use memory plans saved from run_classifier_get_plan_cache. Plans
+ *             that don't match the model are ignored.
+ *
+ * @param      data  The serialized plans
+ * @param      size  Size of the plans in bytes
+ *
+ * @return     EI_IMPULSE_OK if successful, EI_IMPULSE_TFLITE_ERROR if the
+ *             plans are malformed or larger than EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_load_plan_cache(const uint8_t *data, size_t size)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1) && (EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE > 0)
+    if (tflite_plan_cache.Load(data, size) != kTfLiteOk) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+#endif
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Counters collected since the last run_classifier_reset_profile
+ *             on the calling thread: time per DSP stage and per model node,
+ *             and the peak use of the TFLite arena. Everything is zero unless
+ *             EI_CLASSIFIER_PROFILING=1 is defined for the whole build.
+ *
+ * @param      profile  Filled with the counters
+ */
+extern "C" void run_classifier_get_profile(ei_impulse_profile_t *profile)
+{
+    memset(profile, 0, sizeof(ei_impulse_profile_t));
+#if EIDSP_PROFILING == 1
+    memcpy(profile->dsp_stages, ei_dsp_stage_counters, sizeof(profile->dsp_stages));
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_PROFILING == 1)
+    const tflite::MicroNodeProfiler::Node *nodes = tflite_profiler.nodes();
+    profile->nodes_size = tflite_profiler.nodes_used();
+    for (size_t ix = 0; ix < profile->nodes_size; ix++) {
+        profile->nodes[ix].name = nodes[ix].tag;
+        profile->nodes[ix].time.calls = nodes[ix].invocations;
+        profile->nodes[ix].time.max_us = nodes[ix].max_ticks;
+        profile->nodes[ix].time.total_us = nodes[ix].total_ticks;
+    }
+    profile->arena_peak_bytes = tflite_arena_peak_bytes;
+#if (EI_CLASSIFIER_COMPILED == 1)
+    size_t arena_used_bytes;
+    trained_model_arena_stats_ctx(tflite_model_ctx, &arena_used_bytes, &profile->arena_size);
+#else
+    profile->arena_size = EI_CLASSIFIER_TFLITE_ARENA_SIZE;
+#endif
+#endif
+#if EIDSP_TRACK_ALLOCATIONS
+    profile->dsp_heap_peak_bytes = ei_memory_peak_use;
+#endif
+}
+
+/**
+ * @brief      Zero the profiling counters of the calling thread
+ */
+extern "C" void run_classifier_reset_profile(void)
+{
+#if EIDSP_PROFILING == 1
+    memset(ei_dsp_stage_counters, 0, sizeof(ei_dsp_stage_counters));
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_PROFILING == 1)
+    tflite_profiler.Reset();
+    tflite_arena_peak_bytes = 0;
+#endif
+}
+
+/**
+ * @brief      Give the calling thread its own model instance (arena and scratch
+ *             buffers), so it can classify at the same time as other threads.
+ *             The model weights are shared. Needs EIDSP_MULTI_THREADED=1, which
+ *             also makes the inference session and the DSP plans per thread.
+ *             Release with run_classifier_thread_deinit before the thread exits.
+ *
+ * @return     EI_IMPULSE_OK if successful
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_thread_init(void)
+{
+#if (EIDSP_MULTI_THREADED == 1) && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    if (!tflite_model_ctx) {
+        tflite_model_ctx = trained_model_ctx_create();
+        if (!tflite_model_ctx) {
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+    }
+#endif
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Release the model instance, the inference session and the DSP
+ *             plans of the calling thread
+ */
+extern "C" void run_classifier_thread_deinit(void)
+{
+    run_classifier_session_destroy();
+#if (EIDSP_MULTI_THREADED == 1) && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    trained_model_ctx_free(tflite_model_ctx);
+    tflite_model_ctx = NULL;
+#endif
+    free_mfcc_plan();
+    free_mfcc_q15_plan();
+    numpy::free_fft_plans();
+}
+
+/**
+ * @brief      Turn the full (linear) feature buffer into a ring of whole slices,
+ *             so new slices overwrite the oldest one instead of shifting the buffer.
+ *             The window is moved once so it ends on a slice boundary. If a whole
+ *             number of slices does not fit in the buffer the buffer keeps being
+ *             shifted per slice instead.
+ *
+ * @param      stream      The stream
+ * @param[in]  slice_size  Number of features per slice
+ */
+static void feature_ring_setup(ei_classifier_stream_t *stream, size_t slice_size)
+{
+    size_t ring_size = ((stream->feature_window_size + slice_size - 1) / slice_size) * slice_size;
+
+    if (ring_size > EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
+        stream->feature_ring_size = 0;
+        stream->slice_offset -= slice_size;
+        return;
+    }
+
+    size_t gap = ring_size - stream->feature_window_size;
+    if (gap > 0) {
+        memmove(stream->features + gap, stream->features, stream->feature_window_size * sizeof(float));
+    }
+
+    stream->feature_ring_size = ring_size;
+    stream->feature_ring_slice_size = slice_size;
+    stream->slice_offset = 0;
+}
+
+/**
+ * @brief      Get the features that make up the current window, oldest first,
+ *             as (at most) two contiguous spans in the feature buffer. The
+ *             remainder of the NN input up to EI_CLASSIFIER_NN_INPUT_FRAME_SIZE
+ *             is zero.
+ *
+ * @param      stream       The stream
+ * @param      span_a       First span
+ * @param      span_a_size  Number of features in the first span
+ * @param      span_b       Second span
+ * @param      span_b_size  Number of features in the second span (can be 0)
+ */
+static void feature_window_spans(const ei_classifier_stream_t *stream, const float **span_a, size_t *span_a_size,
+                                 const float **span_b, size_t *span_b_size)
+{
+    const float *buffer = stream->features;
+
+    *span_b = buffer;
+    *span_b_size = 0;
+
+    if (!stream->feature_buffer_full) {
+        *span_a = buffer;
+        *span_a_size = stream->slice_offset;
+        return;
+    }
+
+    if (stream->feature_ring_size == 0) {
+        *span_a = buffer;
+        *span_a_size = stream->feature_window_size;
+        return;
+    }
+
+    /* slice_offset is where the next slice goes, so the newest slice ends there */
+    size_t window_end = stream->slice_offset == 0 ? stream->feature_ring_size : stream->slice_offset;
+
+    if (window_end >= stream->feature_window_size) {
+        *span_a = buffer + (window_end - stream->feature_window_size);
+        *span_a_size = stream->feature_window_size;
+    }
+    else {
+        *span_a_size = stream->feature_window_size - window_end;
+        *span_a = buffer + (stream->feature_ring_size - *span_a_size);
+        *span_b_size = window_end;
+    }
+}
+
+/**
+ * @brief      Copy the current feature window into a matrix, oldest feature first,
+ *             zero filling up to EI_CLASSIFIER_NN_INPUT_FRAME_SIZE
+ *
+ * @param      stream  The stream
+ * @param      out     Output buffer (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE items)
+ */
+static void feature_window_copy(const ei_classifier_stream_t *stream, float *out)
+{
+    const float *span_a, *span_b;
+    size_t span_a_size, span_b_size;
+    feature_window_spans(stream, &span_a, &span_a_size, &span_b, &span_b_size);
+
+    memcpy(out, span_a, span_a_size * sizeof(float));
+    memcpy(out + span_a_size, span_b, span_b_size * sizeof(float));
+    memset(out + span_a_size + span_b_size, 0,
+        (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - span_a_size - span_b_size) * sizeof(float));
+}
+
+/**
+ * @brief      Get a pointer to every row of the current feature window, oldest
+ *             first. Rows past the end of the window (the zero filled remainder
+ *             of the NN input) are NULL.
+ *
+ * @param      stream     The stream
+ * @param[in]  cols       Number of features per row
+ * @param      rows       Output, row_count pointers
+ * @param[in]  row_count  Number of rows
+ *
+ * @return     false if a row would straddle the two spans of the window
+ */
+static bool feature_window_rows(const ei_classifier_stream_t *stream, size_t cols, const float **rows, size_t row_count)
 {
-    static ei::matrix_t static_features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
-    if (!static_features_matrix.buffer) {
+    const float *span_a, *span_b;
+    size_t span_a_size, span_b_size;
+    feature_window_spans(stream, &span_a, &span_a_size, &span_b, &span_b_size);
+
+    if (span_a_size % cols != 0 || span_b_size % cols != 0) {
+        return false;
+    }
+
+    for (size_t row = 0; row < row_count; row++) {
+        size_t ix = row * cols;
+        if (ix < span_a_size) {
+            rows[row] = span_a + ix;
+        }
+        else if (ix < span_a_size + span_b_size) {
+            rows[row] = span_b + (ix - span_a_size);
+        }
+        else {
+            rows[row] = NULL;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Get the number of features per row of the window (cepstral
+ *             coefficients or filters), 0 if the front end isn't MFCC or MFE
+ *
+ * @param      stream  The stream
+ */
+static size_t feature_window_cols(const ei_classifier_stream_t *stream)
+{
+    if (ei_dsp_blocks_size != 1 || !(stream->is_mfcc || stream->is_mfe)) {
+        return 0;
+    }
+
+    return stream->is_mfcc ?
+        ((ei_dsp_config_mfcc_t*)ei_dsp_blocks[0].config)->num_cepstral :
+        ((ei_dsp_config_mfe_t*)ei_dsp_blocks[0].config)->num_filters;
+}
+
+/**
+ * @brief      Allocate the row pointers of run_inference_window_quantized once
+ *             the feature buffer is full, the number of rows is the same for
+ *             every window. Kept over reset_classifier_stream like the feature
+ *             buffer.
+ *
+ * @param      stream  The stream
+ *
+ * @return     EI_IMPULSE_OK if successful or the window isn't normalized that way
+ */
+static EI_IMPULSE_ERROR feature_window_rows_setup(ei_classifier_stream_t *stream)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE) || (EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED != 1) || \
+    (EI_CLASSIFIER_TFLITE_INPUT_DATATYPE != EI_CLASSIFIER_DATATYPE_INT8) || (EI_CLASSIFIER_HAS_ANOMALY == 1)
+    (void)stream;
+    return EI_IMPULSE_OK;
+#else
+    size_t cols = feature_window_cols(stream);
+    if (cols == 0 || EI_CLASSIFIER_NN_INPUT_FRAME_SIZE % cols != 0) {
+        return EI_IMPULSE_OK;
+    }
+
+    size_t row_count = EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / cols;
+    if (stream->window_rows && stream->window_row_count == row_count) {
+        return EI_IMPULSE_OK;
+    }
+
+    if (stream->window_rows) {
+        ei_dsp_free(stream->window_rows, stream->window_row_count * sizeof(float*));
+        stream->window_row_count = 0;
+    }
+    stream->window_rows = (const float**)ei_dsp_malloc(row_count * sizeof(float*));
+    if (!stream->window_rows) {
         return EI_IMPULSE_ALLOC_FAILED;
     }
+    stream->window_row_count = row_count;
+
+    return EI_IMPULSE_OK;
+#endif
+}
+
+/**
+ * @brief      Make room for the next slice of a stream without a ring
+ *
+ * @param      stream  The stream
+ */
+static void feature_window_shift(ei_classifier_stream_t *stream)
+{
+    if (stream->feature_ring_size == 0) {
+        size_t feature_size = stream->slice_size;
+        for (size_t i = 0; i < (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size); i++) {
+            stream->features[i] = stream->features[i + feature_size];
+        }
+    }
+}
+
+#if EI_CLASSIFIER_VAD == 1
+/**
+ * @brief      Update the voice activity gate of a stream with the frame energies
+ *             of the slice that was just added. A slice has speech if its loudest
+ *             frame is EI_CLASSIFIER_VAD_THRESHOLD_DB above the noise floor, the
+ *             floor follows the quietest frames.
+ *
+ * @param      stream  The stream
+ */
+static void run_classifier_stream_vad_update(ei_classifier_stream_t *stream)
+{
+    ei_classifier_vad_t *vad = &stream->vad;
+    const ei_dsp_slice_state_t *dsp_state = &stream->dsp_state;
+
+    /* Without frame energies (spectrogram) every slice counts as speech */
+    if (!dsp_state->frame_energy_valid) {
+        vad->quiet_slices = 0;
+        vad->silence_classified = false;
+        return;
+    }
+
+    /* Energies are ln(power), so 1 dB is ln(10) / 10 */
+    const float db = 0.230258509f;
+    const float floor_rise = EI_CLASSIFIER_VAD_FLOOR_RISE_DB_PER_S * db *
+        ((float)EI_CLASSIFIER_SLICE_SIZE / (float)EI_CLASSIFIER_FREQUENCY);
+
+    /* Drop to the quietest frame at once, rise by at most floor_rise per slice */
+    if (!vad->noise_floor_valid || dsp_state->frame_log_energy_min < vad->noise_floor + floor_rise) {
+        vad->noise_floor = dsp_state->frame_log_energy_min;
+        vad->noise_floor_valid = true;
+    }
+    else {
+        vad->noise_floor += floor_rise;
+    }
+
+    if (dsp_state->frame_log_energy_max > vad->noise_floor + EI_CLASSIFIER_VAD_THRESHOLD_DB * db) {
+        vad->quiet_slices = 0;
+        vad->silence_classified = false;
+    }
+    else if (vad->quiet_slices < UINT32_MAX) {
+        vad->quiet_slices++;
+    }
+}
 
-    EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
+/**
+ * @brief      Stand in for the network on a window without speech, once the
+ *             silence was classified: run the result of the last silent window
+ *             through the moving average filter again and make room for the
+ *             next slice.
+ *
+ * @param      stream  The stream
+ * @param      result  Classification output
+ */
+static void run_classifier_stream_window_silent(ei_classifier_stream_t *stream, ei_impulse_result_t *result)
+{
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        result->classification[ix].label = ei_classifier_inferencing_categories[ix];
+        result->classification[ix].value =
+            run_moving_average_filter(&stream->maf[ix], stream->vad.silence_result[ix]);
+    }
+    result->anomaly = stream->vad.silence_anomaly;
 
-    uint64_t dsp_start_ms = ei_read_timer_ms();
+    result->timing.classification = 0;
+    result->timing.classification_us = 0;
+    result->timing.anomaly = 0;
+    result->timing.anomaly_us = 0;
+    result->no_speech = true;
+
+    feature_window_shift(stream);
+}
+#endif // EI_CLASSIFIER_VAD == 1
+
+/**
+ * @brief      Run the DSP blocks over one slice of a stream and add the features
+ *             to its window. Sets stream->feature_buffer_full once the window
+ *             can be classified.
+ *
+ * @param      stream  The stream
+ * @param      signal  Sample data (one slice)
+ * @param      result  Classification output, only the DSP timing is set
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR run_classifier_stream_slice(ei_classifier_stream_t *stream, signal_t *signal,
+                                                    ei_impulse_result_t *result)
+{
+    uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
-    size_t feature_size;
-    bool is_mfcc = false;
-    bool is_mfe = false;
-    bool is_spectrogram = false;
+    size_t feature_size = 0;
+
+    /* The per slice extract functions keep their state in the stream */
+    set_dsp_slice_state(&stream->dsp_state);
+    stream->dsp_state.frame_energy_valid = false;
 
     for (size_t ix = 0; ix < ei_dsp_blocks_size; ix++) {
         ei_model_dsp_t block = ei_dsp_blocks[ix];
 
         if (out_features_index + block.n_output_features > EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
             ei_printf("ERR: Would write outside feature buffer\n");
+            set_dsp_slice_state(NULL);
             return EI_IMPULSE_DSP_ERROR;
         }
 
         ei::matrix_t fm(1, block.n_output_features,
-                        static_features_matrix.buffer + out_features_index + slice_offset);
+                        stream->features + out_features_index + stream->slice_offset);
 
         /* Switch to the slice version of the mfcc feature extract function */
         if (block.extract_fn == extract_mfcc_features) {
             block.extract_fn = &extract_mfcc_per_slice_features;
-            is_mfcc = true;
+            stream->is_mfcc = true;
+        }
+        else if (block.extract_fn == extract_mfcc_q15_features) {
+            block.extract_fn = &extract_mfcc_q15_per_slice_features;
+            stream->is_mfcc = true;
         }
         else if (block.extract_fn == extract_spectrogram_features) {
             block.extract_fn = &extract_spectrogram_per_slice_features;
-            is_spectrogram = true;
+            stream->is_spectrogram = true;
         }
         else if (block.extract_fn == extract_mfe_features) {
             block.extract_fn = &extract_mfe_per_slice_features;
-            is_mfe = true;
+            stream->is_mfe = true;
         }
         else {
             ei_printf("ERR: Unknown extract function, only MFCC, MFE and spectrogram supported\n");
+            set_dsp_slice_state(NULL);
             return EI_IMPULSE_DSP_ERROR;
         }
 
         int ret = block.extract_fn(signal, &fm, block.config, EI_CLASSIFIER_FREQUENCY);
         if (ret != EIDSP_OK) {
             ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
+            set_dsp_slice_state(NULL);
             return EI_IMPULSE_DSP_ERROR;
         }
 
-        if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
-            return EI_IMPULSE_CANCELED;
-        }
+        if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+            set_dsp_slice_state(NULL);
+            return EI_IMPULSE_CANCELED;
+        }
+
+        out_features_index += block.n_output_features;
+
+        feature_size = (fm.rows * fm.cols);
+    }
+
+    set_dsp_slice_state(NULL);
+    stream->slice_size = feature_size;
+
+    /* For as long as the feature buffer isn't completely full, keep moving the slice offset */
+    if (stream->feature_buffer_full == false) {
+        stream->slice_offset += feature_size;
+
+        if (stream->slice_offset > (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size)) {
+            stream->feature_buffer_full = true;
+            stream->feature_window_size = stream->slice_offset;
+            feature_ring_setup(stream, feature_size);
+            EI_IMPULSE_ERROR rows_res = feature_window_rows_setup(stream);
+            if (rows_res != EI_IMPULSE_OK) {
+                return rows_res;
+            }
+        }
+    }
+    /* Ring: the slice replaced the oldest one, move on to the next slot */
+    else if (stream->feature_ring_size > 0) {
+        if (feature_size != stream->feature_ring_slice_size) {
+            ei_printf("ERR: Slice size changed (%d, expected %d)\n",
+                (int)feature_size, (int)stream->feature_ring_slice_size);
+            return EI_IMPULSE_DSP_ERROR;
+        }
+
+        stream->slice_offset += feature_size;
+        if (stream->slice_offset >= stream->feature_ring_size) {
+            stream->slice_offset = 0;
+        }
+    }
+
+#if EI_CLASSIFIER_VAD == 1
+    run_classifier_stream_vad_update(stream);
+    result->no_speech = false;
+#endif
+
+    result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+    result->timing.dsp = static_cast<int>(result->timing.dsp_us / 1000);
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Print the current feature window of a stream
+ *
+ * @param      stream  The stream
+ * @param      result  Classification output (for the DSP timing)
+ */
+static void run_classifier_stream_print_features(ei_classifier_stream_t *stream, ei_impulse_result_t *result)
+{
+    const float *span_a, *span_b;
+    size_t span_a_size, span_b_size;
+    feature_window_spans(stream, &span_a, &span_a_size, &span_b, &span_b_size);
+
+    ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
+    for (size_t ix = 0; ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; ix++) {
+        if (ix < span_a_size) {
+            ei_printf_float(span_a[ix]);
+        }
+        else if (ix < span_a_size + span_b_size) {
+            ei_printf_float(span_b[ix - span_a_size]);
+        }
+        else {
+            ei_printf_float(0.0f);
+        }
+        ei_printf(" ");
+    }
+    ei_printf("\n");
+}
+
+/**
+ * @brief      Classify the (full) feature window of a stream, run the moving
+ *             average filter over the result and make room for the next slice.
+ *             The inference session must be active. With EI_CLASSIFIER_VAD the
+ *             network is skipped on windows without speech.
+ *
+ * @param      stream  The stream
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR run_classifier_stream_window(ei_classifier_stream_t *stream, ei_impulse_result_t *result,
+                                                     bool debug)
+{
+    EI_IMPULSE_ERROR ei_impulse_error;
+
+#if EI_CLASSIFIER_VAD == 1
+    if (stream->vad.silence_classified) {
+        run_classifier_stream_window_silent(stream, result);
+        return EI_IMPULSE_OK;
+    }
+#endif
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    /* A skipped window only costs reuse, the streaming executor verifies the shift */
+    tflite_stream_shift = (int)stream->slice_size;
+#endif
+
+    if (can_run_inference_window_quantized(stream) == EI_IMPULSE_OK) {
+        /* Normalize and quantize straight from the window into the input tensor */
+        ei_impulse_error = run_inference_window_quantized(stream, result, debug);
+    }
+    else {
+        uint64_t dsp_start_us = ei_read_timer_us();
+        ei::matrix_t classify_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+
+        /* Normalization works in place, so gather the window (oldest slice first) into its own matrix */
+        feature_window_copy(stream, classify_matrix.buffer);
+
+        if (stream->is_mfcc) {
+            calc_cepstral_mean_and_var_normalization_mfcc(&classify_matrix, ei_dsp_blocks[0].config);
+        }
+        else if (stream->is_spectrogram) {
+            calc_cepstral_mean_and_var_normalization_spectrogram(&classify_matrix, ei_dsp_blocks[0].config);
+        }
+        else if (stream->is_mfe) {
+            calc_cepstral_mean_and_var_normalization_mfe(&classify_matrix, ei_dsp_blocks[0].config);
+        }
+        result->timing.dsp_us += ei_read_timer_us() - dsp_start_us;
+        result->timing.dsp = static_cast<int>(result->timing.dsp_us / 1000);
+
+        ei_impulse_error = run_inference(&classify_matrix, result, debug);
+    }
 
-        out_features_index += block.n_output_features;
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    tflite_stream_shift = -1;
+#endif
 
-        feature_size = (fm.rows * fm.cols);
+#if EI_CLASSIFIER_VAD == 1
+    /* Keep what the network makes of silence, it stands in for the next silent windows */
+    result->no_speech = stream->vad.quiet_slices >= EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+    if (result->no_speech && ei_impulse_error == EI_IMPULSE_OK) {
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            stream->vad.silence_result[ix] = result->classification[ix].value;
+        }
+        stream->vad.silence_anomaly = result->anomaly;
+        stream->vad.silence_classified = true;
     }
+#endif
 
-    /* For as long as the feature buffer isn't completely full, keep moving the slice offset */
-    if (feature_buffer_full == false) {
-        slice_offset += feature_size;
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        result->classification[ix].value =
+            run_moving_average_filter(&stream->maf[ix], result->classification[ix].value);
+    }
 
-        if (slice_offset > (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size)) {
-            feature_buffer_full = true;
-            slice_offset -= feature_size;
-        }
+    /* Without a ring, shift the feature buffer for new data */
+    feature_window_shift(stream);
+
+    return ei_impulse_error;
+}
+
+/**
+ * @brief      Add a slice to a stream. Once the stream holds a full window,
+ *             run inference on the window.
+ *
+ * @param      stream  The stream (see run_classifier_stream_init)
+ * @param      signal  Sample data
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable boot
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_stream_continuous(ei_classifier_stream_t *stream, signal_t *signal,
+                                                             ei_impulse_result_t *result, bool debug = false)
+{
+    if (!stream->features) {
+        return EI_IMPULSE_ALLOC_FAILED;
     }
 
-    result->timing.dsp = ei_read_timer_ms() - dsp_start_ms;
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    const uint64_t start_us = ei_read_timer_us();
+#endif
+
+    EI_IMPULSE_ERROR ei_impulse_error = run_classifier_stream_slice(stream, signal, result);
+    if (ei_impulse_error != EI_IMPULSE_OK) {
+        return ei_impulse_error;
+    }
 
     if (debug) {
-        ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
-        for (size_t ix = 0; ix < static_features_matrix.cols; ix++) {
-            ei_printf_float(static_features_matrix.buffer[ix]);
-            ei_printf(" ");
-        }
-        ei_printf("\n");
+        run_classifier_stream_print_features(stream, result);
     }
 
 #if EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_NONE
@@ -272,132 +1065,286 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
     }
 #endif
 
-    if (feature_buffer_full == true) {
-        dsp_start_ms = ei_read_timer_ms();
-        ei::matrix_t classify_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    if (stream->feature_buffer_full == true) {
+        /* Keep the model resident between slices, so we only quantize and invoke */
+        ei_impulse_error = run_classifier_session_create();
+        if (ei_impulse_error != EI_IMPULSE_OK) {
+            return ei_impulse_error;
+        }
 
-        /* Create a copy of the matrix for normalization */
-        for (size_t m_ix = 0; m_ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; m_ix++) {
-            classify_matrix.buffer[m_ix] = static_features_matrix.buffer[m_ix];
+        ei_impulse_error = run_classifier_stream_window(stream, result, debug);
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+        if (ei_impulse_error == EI_IMPULSE_OK) {
+            ei_latency_histogram_record(&stream->latency, ei_read_timer_us() - start_us);
         }
+#endif
+    }
+    return ei_impulse_error;
+}
 
-        if (is_mfcc) {
-            calc_cepstral_mean_and_var_normalization_mfcc(&classify_matrix, ei_dsp_blocks[0].config);
+/**
+ * @brief      Add one slice to each of a number of streams, then classify the
+ *             windows of all streams that are full, back to back on the same
+ *             inference session. All streams share the model and the DSP plans,
+ *             so this runs the front end and the model for every stream without
+ *             re-initializing anything in between.
+ *
+ * @param      streams       The streams (see run_classifier_stream_init)
+ * @param      signals       One slice of sample data per stream
+ * @param      results       Classification output per stream, only valid for
+ *                           streams with a full window (feature_buffer_full)
+ *                           that did not fail
+ * @param      errors        Output, error per stream
+ * @param[in]  stream_count  Number of streams
+ * @param[in]  debug         Debug output enable
+ *
+ * @return     EI_IMPULSE_OK, or the first error. A failing stream does not stop
+ *             the other streams from being processed, but EI_IMPULSE_CANCELED
+ *             does: every stream that was not processed, or whose full window
+ *             was not classified, gets EI_IMPULSE_CANCELED in errors as well.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous_batch(ei_classifier_stream_t **streams, signal_t **signals,
+                                                            ei_impulse_result_t *results, EI_IMPULSE_ERROR *errors,
+                                                            size_t stream_count, bool debug = false)
+{
+    EI_IMPULSE_ERROR first_error = EI_IMPULSE_OK;
+    bool any_full = false;
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+    /* All slices are handed in at once, a stream waits for the ones before it */
+    const uint64_t start_us = ei_read_timer_us();
+#endif
+
+    for (size_t ix = 0; ix < stream_count; ix++) {
+        EI_IMPULSE_ERROR res = streams[ix]->features ?
+            run_classifier_stream_slice(streams[ix], signals[ix], &results[ix]) :
+            EI_IMPULSE_ALLOC_FAILED;
+
+        if (res == EI_IMPULSE_CANCELED) {
+            /* The slices of this and the remaining streams were not added, and
+               none of the full windows got classified */
+            for (size_t rest = 0; rest < stream_count; rest++) {
+                if (rest >= ix || (streams[rest]->feature_buffer_full && errors[rest] == EI_IMPULSE_OK)) {
+                    errors[rest] = EI_IMPULSE_CANCELED;
+                }
+            }
+            return res;
         }
-        else if (is_spectrogram) {
-            calc_cepstral_mean_and_var_normalization_spectrogram(&classify_matrix, ei_dsp_blocks[0].config);
+        if (res == EI_IMPULSE_OK && debug) {
+            run_classifier_stream_print_features(streams[ix], &results[ix]);
         }
-        else if (is_mfe) {
-            calc_cepstral_mean_and_var_normalization_mfe(&classify_matrix, ei_dsp_blocks[0].config);
+        if (res == EI_IMPULSE_OK && streams[ix]->feature_buffer_full) {
+            any_full = true;
         }
-        result->timing.dsp += ei_read_timer_ms() - dsp_start_ms;
+        if (res != EI_IMPULSE_OK && first_error == EI_IMPULSE_OK) {
+            first_error = res;
+        }
+        errors[ix] = res;
+    }
 
-        ei_impulse_error = run_inference(&classify_matrix, result, debug);
+    if (!any_full) {
+        return first_error;
+    }
 
-        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-            result->classification[ix].value =
-                run_moving_average_filter(&classifier_maf[ix], result->classification[ix].value);
+    EI_IMPULSE_ERROR session_res = run_classifier_session_create();
+    if (session_res != EI_IMPULSE_OK) {
+        /* None of the full windows got classified, their results are not valid */
+        for (size_t ix = 0; ix < stream_count; ix++) {
+            if (streams[ix]->feature_buffer_full && errors[ix] == EI_IMPULSE_OK) {
+                errors[ix] = session_res;
+            }
         }
+        return first_error != EI_IMPULSE_OK ? first_error : session_res;
+    }
 
-        /* Shift the feature buffer for new data */
-        for (size_t i = 0; i < (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size); i++) {
-            static_features_matrix.buffer[i] = static_features_matrix.buffer[i + feature_size];
+    for (size_t ix = 0; ix < stream_count; ix++) {
+        if (!streams[ix]->feature_buffer_full || errors[ix] != EI_IMPULSE_OK) {
+            continue;
+        }
+
+        EI_IMPULSE_ERROR res = run_classifier_stream_window(streams[ix], &results[ix], debug);
+        if (res == EI_IMPULSE_CANCELED) {
+            /* This and the remaining full windows were not classified */
+            for (size_t rest = ix; rest < stream_count; rest++) {
+                if (streams[rest]->feature_buffer_full && errors[rest] == EI_IMPULSE_OK) {
+                    errors[rest] = EI_IMPULSE_CANCELED;
+                }
+            }
+            return res;
+        }
+#if EI_CLASSIFIER_LATENCY_HISTOGRAM == 1
+        if (res == EI_IMPULSE_OK) {
+            ei_latency_histogram_record(&streams[ix]->latency, ei_read_timer_us() - start_us);
         }
+#endif
+        if (res != EI_IMPULSE_OK && first_error == EI_IMPULSE_OK) {
+            first_error = res;
+        }
+        errors[ix] = res;
     }
-    return ei_impulse_error;
+
+    return first_error;
 }
 
-#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
 /**
- * Setup the TFLite runtime
+ * @brief      Fill the complete matrix with sample slices. From there, run inference
+ *             on the matrix.
  *
- * @param      ctx_start_ms       Pointer to the start time
- * @param      input              Pointer to input tensor
- * @param      output             Pointer to output tensor
- * @param      micro_interpreter  Pointer to interpreter (for non-compiled models)
- * @param      micro_tensor_arena Pointer to the arena that will be allocated
+ * @param      signal  Sample data
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable boot
  *
- * @return  EI_IMPULSE_OK if successful
+ * @return     The ei impulse error.
  */
-static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTensor** input, TfLiteTensor** output,
-#if (EI_CLASSIFIER_COMPILED != 1)
-    tflite::MicroInterpreter** micro_interpreter,
-#endif
-    uint8_t** micro_tensor_arena) {
-#if (EI_CLASSIFIER_COMPILED == 1)
-    TfLiteStatus init_status = trained_model_init(ei_aligned_malloc);
-    if (init_status != kTfLiteOk) {
-        ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
-        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
-    }
-#else
-    // Create an area of memory to use for input, output, and intermediate arrays.
-    uint8_t *tensor_arena = (uint8_t*)ei_aligned_malloc(16, EI_CLASSIFIER_TFLITE_ARENA_SIZE);
-    if (tensor_arena == NULL) {
-        ei_printf("Failed to allocate TFLite arena (%d bytes)\n", EI_CLASSIFIER_TFLITE_ARENA_SIZE);
-        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
+                                                      bool debug = false)
+{
+    if (!classifier_stream.features) {
+        EI_IMPULSE_ERROR init_res = run_classifier_stream_init(&classifier_stream);
+        if (init_res != EI_IMPULSE_OK) {
+            return init_res;
+        }
     }
-    *micro_tensor_arena = tensor_arena;
-#endif
 
-    *ctx_start_ms = ei_read_timer_ms();
-
-    static bool tflite_first_run = true;
-
-#if (EI_CLASSIFIER_COMPILED != 1)
-        static const tflite::Model* model = nullptr;
-#endif
+    return run_classifier_stream_continuous(&classifier_stream, signal, result, debug);
+}
 
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
 #if (EI_CLASSIFIER_COMPILED != 1)
-    // ======
-    // Initialization code start
-    // This part can be run once, but that would require the TFLite arena
-    // to be allocated at all times, which is not ideal (e.g. when doing MFCC)
-    // ======
-    if (tflite_first_run) {
-        // Map the model into a usable data structure. This doesn't involve any
-        // copying or parsing, it's a very lightweight operation.
-        model = tflite::GetModel(trained_tflite);
-        if (model->version() != TFLITE_SCHEMA_VERSION) {
+/**
+ * Build an interpreter for the model and allocate its tensors
+ *
+ * @param      micro_interpreter  Pointer to the interpreter that will be created
+ * @param      micro_tensor_arena Pointer to the arena that will be allocated
+ *
+ * @return  EI_IMPULSE_OK if successful
+ */
+static EI_IMPULSE_ERROR inference_tflite_create_interpreter(tflite::MicroInterpreter **micro_interpreter,
+    uint8_t **micro_tensor_arena) {
+    static EIDSP_THREAD_LOCAL const tflite::Model* model = nullptr;
+
+    // Map the model into a usable data structure. This doesn't involve any
+    // copying or parsing, it's a very lightweight operation.
+    if (!model) {
+        const tflite::Model* trained_model = tflite::GetModel(trained_tflite);
+        if (trained_model->version() != TFLITE_SCHEMA_VERSION) {
             error_reporter->Report(
                 "Model provided is schema version %d not equal "
                 "to supported version %d.",
-                model->version(), TFLITE_SCHEMA_VERSION);
-            ei_aligned_free(tensor_arena);
+                trained_model->version(), TFLITE_SCHEMA_VERSION);
             return EI_IMPULSE_TFLITE_ERROR;
         }
-    }
+        model = trained_model;
+#if EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE > 0
+        tflite_model_hash = tflite::MemoryPlanCache::Hash(trained_tflite, trained_tflite_len);
 #endif
+    }
 
-#if (EI_CLASSIFIER_COMPILED != 1)
+    // The interpreter keeps a reference to the resolver, so it outlives every
+    // interpreter (the generated EI_TFLITE_RESOLVER declares a static one too)
 #ifdef EI_TFLITE_RESOLVER
     EI_TFLITE_RESOLVER
 #else
-    tflite::AllOpsResolver resolver;
-#endif
+    static EIDSP_THREAD_LOCAL tflite::AllOpsResolver resolver;
 #endif
 
-#if (EI_CLASSIFIER_COMPILED == 1)
-    *input = trained_model_input(0);
-    *output = trained_model_output(0);
+    // Create an area of memory to use for input, output, and intermediate arrays.
+    uint8_t *tensor_arena = (uint8_t*)ei_aligned_malloc(16, EI_CLASSIFIER_TFLITE_ARENA_SIZE);
+    if (tensor_arena == NULL) {
+        ei_printf("Failed to allocate TFLite arena (%d bytes)\n", EI_CLASSIFIER_TFLITE_ARENA_SIZE);
+        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+    }
+
+#if EI_CLASSIFIER_PROFILING == 1
+    tflite::Profiler *profiler = &tflite_profiler;
 #else
+    tflite::Profiler *profiler = nullptr;
+#endif
+
     // Build an interpreter to run the model with.
     tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
-        model, resolver, tensor_arena, EI_CLASSIFIER_TFLITE_ARENA_SIZE, error_reporter);
+        model, resolver, tensor_arena, EI_CLASSIFIER_TFLITE_ARENA_SIZE, error_reporter, profiler);
 
-    *micro_interpreter = interpreter;
+#if EI_CLASSIFIER_TFLITE_PLAN_CACHE_SIZE > 0
+    // Without a session the interpreter is built for every inference, only the first one plans
+    interpreter->SetMemoryPlanCache(&tflite_plan_cache, tflite_model_hash);
+#endif
 
     // Allocate memory from the tensor_arena for the model's tensors.
     TfLiteStatus allocate_status = interpreter->AllocateTensors();
     if (allocate_status != kTfLiteOk) {
         error_reporter->Report("AllocateTensors() failed");
-        ei_aligned_free(tensor_arena);
+        inference_tflite_free_interpreter(interpreter, tensor_arena);
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
+    *micro_interpreter = interpreter;
+    *micro_tensor_arena = tensor_arena;
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Free an interpreter and its arena
+ */
+static void inference_tflite_free_interpreter(tflite::MicroInterpreter *interpreter, uint8_t *tensor_arena) {
+    delete interpreter;
+    ei_aligned_free(tensor_arena);
+}
+#endif
+
+/**
+ * Setup the TFLite runtime
+ *
+ * @param      ctx_start_us       Pointer to the start time
+ * @param      input              Pointer to input tensor
+ * @param      output             Pointer to output tensor
+ * @param      micro_interpreter  Pointer to interpreter (for non-compiled models)
+ * @param      micro_tensor_arena Pointer to the arena that will be allocated
+ *
+ * @return  EI_IMPULSE_OK if successful
+ */
+static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_us, TfLiteTensor** input, TfLiteTensor** output,
+#if (EI_CLASSIFIER_COMPILED != 1)
+    tflite::MicroInterpreter** micro_interpreter,
+#endif
+    uint8_t** micro_tensor_arena) {
+#if (EI_CLASSIFIER_COMPILED == 1)
+    // With an active session the model is already initialized
+    if (!tflite_session_active) {
+        TfLiteStatus init_status = trained_model_init_ctx(tflite_model_ctx, ei_aligned_malloc);
+        if (init_status != kTfLiteOk) {
+            ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
+            return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+        }
+    }
+#if EI_CLASSIFIER_PROFILING == 1
+    trained_model_set_profiler_ctx(tflite_model_ctx, &tflite_profiler);
+#endif
+#endif
+
+    *ctx_start_us = ei_read_timer_us();
+
+    static EIDSP_THREAD_LOCAL bool tflite_first_run = true;
+
+#if (EI_CLASSIFIER_COMPILED == 1)
+    *input = trained_model_input_ctx(tflite_model_ctx, 0);
+    *output = trained_model_output_ctx(tflite_model_ctx, 0);
+#else
+    // With an active session the interpreter is resident, otherwise build one
+    // for this inference (keeping it would tie up the arena during DSP)
+    if (tflite_session_active) {
+        *micro_interpreter = tflite_session_interpreter;
+        *micro_tensor_arena = tflite_session_arena;
+    }
+    else {
+        EI_IMPULSE_ERROR init_res = inference_tflite_create_interpreter(micro_interpreter, micro_tensor_arena);
+        if (init_res != EI_IMPULSE_OK) {
+            return init_res;
+        }
+    }
+
     // Obtain pointers to the model's input and output tensors.
-    *input = interpreter->input(0);
-    *output = interpreter->output(0);
+    *input = (*micro_interpreter)->input(0);
+    *output = (*micro_interpreter)->output(0);
 #endif
 
     // Assert that our quantization parameters match the model
@@ -422,16 +1369,16 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
 /**
  * Run TFLite model
  *
- * @param   ctx_start_ms    Start time of the setup function (see above)
+ * @param   ctx_start_us    Start time of the setup function (see above)
  * @param   output          Output tensor
  * @param   interpreter     TFLite interpreter (non-compiled models)
- * @param   tensor_arena    Allocated arena (will be freed)
+ * @param   tensor_arena    Allocated arena (freed unless a session is active)
  * @param   result          Struct for results
  * @param   debug           Whether to print debug info
  *
  * @return  EI_IMPULSE_OK if successful
  */
-static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
+static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_us,
     TfLiteTensor* output,
 #if (EI_CLASSIFIER_COMPILED != 1)
     tflite::MicroInterpreter* interpreter,
@@ -440,21 +1387,50 @@ static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
     ei_impulse_result_t *result,
     bool debug) {
 #if (EI_CLASSIFIER_COMPILED == 1)
-    trained_model_invoke();
+#if (EI_CLASSIFIER_TFLITE_STREAMING == 1)
+    // The session keeps the activations of the last window around
+    TfLiteStatus invoke_status = (tflite_session_active && tflite_stream_shift >= 0) ?
+        trained_model_invoke_streaming_ctx(tflite_model_ctx, tflite_stream_shift) :
+        trained_model_invoke_ctx(tflite_model_ctx);
+#else
+    TfLiteStatus invoke_status = trained_model_invoke_ctx(tflite_model_ctx);
+#endif
+    if (invoke_status != kTfLiteOk) {
+        ei_printf("ERR: Invoke failed (%d)\n", invoke_status);
+        if (!tflite_session_active) {
+            trained_model_reset_ctx(tflite_model_ctx, ei_aligned_free);
+        }
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
 #else
     // Run inference, and report any error
     TfLiteStatus invoke_status = interpreter->Invoke();
     if (invoke_status != kTfLiteOk) {
         error_reporter->Report("Invoke failed (%d)\n", invoke_status);
-        ei_aligned_free(tensor_arena);
+        if (!tflite_session_active) {
+            inference_tflite_free_interpreter(interpreter, tensor_arena);
+        }
         return EI_IMPULSE_TFLITE_ERROR;
     }
-    delete interpreter;
 #endif
 
-    uint64_t ctx_end_ms = ei_read_timer_ms();
+    uint64_t ctx_end_us = ei_read_timer_us();
+
+#if EI_CLASSIFIER_PROFILING == 1
+    size_t arena_used_bytes;
+#if (EI_CLASSIFIER_COMPILED == 1)
+    size_t arena_size;
+    trained_model_arena_stats_ctx(tflite_model_ctx, &arena_used_bytes, &arena_size);
+#else
+    arena_used_bytes = interpreter->arena_used_bytes();
+#endif
+    if (arena_used_bytes > tflite_arena_peak_bytes) {
+        tflite_arena_peak_bytes = arena_used_bytes;
+    }
+#endif
 
-    result->timing.classification = ctx_end_ms - ctx_start_ms;
+    result->timing.classification_us = ctx_end_us - ctx_start_us;
+    result->timing.classification = static_cast<int>(result->timing.classification_us / 1000);
 
     // Read the predicted y value from the model's output tensor
     if (debug) {
@@ -479,9 +1455,14 @@ static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
     }
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    trained_model_reset(ei_aligned_free);
+    // The session owns the arena, only tear down one-shot setups
+    if (!tflite_session_active) {
+        trained_model_reset_ctx(tflite_model_ctx, ei_aligned_free);
+    }
 #else
-    ei_aligned_free(tensor_arena);
+    if (!tflite_session_active) {
+        inference_tflite_free_interpreter(interpreter, tensor_arena);
+    }
 #endif
 
     if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
@@ -508,16 +1489,16 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 {
 #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
     {
-        uint64_t ctx_start_ms;
+        uint64_t ctx_start_us;
         TfLiteTensor* input;
         TfLiteTensor* output;
         uint8_t* tensor_arena;
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &tensor_arena);
+        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &tensor_arena);
 #else
         tflite::MicroInterpreter* interpreter;
-        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
+        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &interpreter, &tensor_arena);
 #endif
         if (init_res != EI_IMPULSE_OK) {
             return init_res;
@@ -535,9 +1516,9 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         }
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, tensor_arena, result, debug);
+        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_us, output, tensor_arena, result, debug);
 #else
-        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, interpreter, tensor_arena, result, debug);
+        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_us, output, interpreter, tensor_arena, result, debug);
 #endif
 
         if (run_res != EI_IMPULSE_OK) {
@@ -588,7 +1569,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         }
     }
 
-    uint64_t ctx_start_ms = ei_read_timer_ms();
+    uint64_t ctx_start_us = ei_read_timer_us();
 
 #if EI_CLASSIFIER_CUBEAI_QUANTIZED_IN_OUT == 1
     ai_network_report report;
@@ -632,9 +1613,10 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         return EI_IMPULSE_CUBEAI_ERROR;
     }
 
-    uint64_t ctx_end_ms = ei_read_timer_ms();
+    uint64_t ctx_end_us = ei_read_timer_us();
 
-    result->timing.classification = ctx_end_ms - ctx_start_ms;
+    result->timing.classification_us = ctx_end_us - ctx_start_us;
+    result->timing.classification = static_cast<int>(result->timing.classification_us / 1000);
 
     if (debug) {
         ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
@@ -659,7 +1641,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 
     // Anomaly detection
     {
-        uint64_t anomaly_start_ms = ei_read_timer_ms();
+        uint64_t anomaly_start_us = ei_read_timer_us();
 
         float input[EI_CLASSIFIER_ANOM_AXIS_SIZE];
         for (size_t ix = 0; ix < EI_CLASSIFIER_ANOM_AXIS_SIZE; ix++) {
@@ -669,15 +1651,16 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         float anomaly = get_min_distance_to_cluster(
             input, EI_CLASSIFIER_ANOM_AXIS_SIZE, ei_classifier_anom_clusters, EI_CLASSIFIER_ANOM_CLUSTER_COUNT);
 
-        uint64_t anomaly_end_ms = ei_read_timer_ms();
+        uint64_t anomaly_end_us = ei_read_timer_us();
 
         if (debug) {
-            ei_printf("Anomaly score (time: %d ms.): ", static_cast<int>(anomaly_end_ms - anomaly_start_ms));
+            ei_printf("Anomaly score (time: %d ms.): ", static_cast<int>((anomaly_end_us - anomaly_start_us) / 1000));
             ei_printf_float(anomaly);
             ei_printf("\n");
         }
 
-        result->timing.anomaly = anomaly_end_ms - anomaly_start_ms;
+        result->timing.anomaly_us = anomaly_end_us - anomaly_start_us;
+        result->timing.anomaly = static_cast<int>(result->timing.anomaly_us / 1000);
 
         result->anomaly = anomaly;
     }
@@ -691,6 +1674,131 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Check if the feature window of run_classifier_continuous can be normalized
+ * straight into a quantized input tensor (run_inference_window_quantized)
+ *
+ * @param      stream  The stream
+ */
+static EI_IMPULSE_ERROR can_run_inference_window_quantized(ei_classifier_stream_t *stream)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE) || (EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED != 1) || \
+    (EI_CLASSIFIER_TFLITE_INPUT_DATATYPE != EI_CLASSIFIER_DATATYPE_INT8) || (EI_CLASSIFIER_HAS_ANOMALY == 1)
+    return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+#else
+    size_t cols = feature_window_cols(stream);
+    if (cols == 0 || !stream->window_rows || stream->window_row_count * cols != EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    const float *span_a, *span_b;
+    size_t span_a_size, span_b_size;
+    feature_window_spans(stream, &span_a, &span_a_size, &span_b, &span_b_size);
+    if (span_a_size % cols != 0 || span_b_size % cols != 0) {
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    return EI_IMPULSE_OK;
+#endif
+}
+
+/**
+ * @brief      Run cepstral mean and variance normalization over the feature window
+ *             of run_classifier_continuous, quantize straight into the input tensor
+ *             and run inference. This skips the float copy of the window and the
+ *             per-feature division of run_inference. Only call this when
+ *             can_run_inference_window_quantized returns EI_IMPULSE_OK.
+ *
+ * @param      stream  The stream
+ * @param      result  Output classifier results
+ * @param[in]  debug   Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR run_inference_window_quantized(ei_classifier_stream_t *stream,
+                                                       ei_impulse_result_t *result, bool debug)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE) || (EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED != 1) || \
+    (EI_CLASSIFIER_TFLITE_INPUT_DATATYPE != EI_CLASSIFIER_DATATYPE_INT8) || (EI_CLASSIFIER_HAS_ANOMALY == 1)
+    return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+#else
+    size_t cols;
+    uint16_t win_size;
+    bool variance_normalization;
+    bool scale;
+
+    /* Same parameters as calc_cepstral_mean_and_var_normalization_mfcc / _mfe */
+    if (stream->is_mfcc) {
+        ei_dsp_config_mfcc_t *config = (ei_dsp_config_mfcc_t *)ei_dsp_blocks[0].config;
+        cols = config->num_cepstral;
+        win_size = config->win_size;
+        variance_normalization = true;
+        scale = false;
+    }
+    else {
+        ei_dsp_config_mfe_t *config = (ei_dsp_config_mfe_t *)ei_dsp_blocks[0].config;
+        cols = config->num_filters;
+        win_size = config->win_size;
+        variance_normalization = false;
+        scale = true;
+    }
+
+    // allocated by feature_window_rows_setup
+    const size_t row_count = stream->window_row_count;
+    const float **rows = stream->window_rows;
+    if (!feature_window_rows(stream, cols, rows, row_count)) {
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    uint64_t ctx_start_us;
+    TfLiteTensor* input;
+    TfLiteTensor* output;
+    uint8_t* tensor_arena;
+
+#if (EI_CLASSIFIER_COMPILED == 1)
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &tensor_arena);
+#else
+    tflite::MicroInterpreter* interpreter;
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &interpreter, &tensor_arena);
+#endif
+    if (init_res != EI_IMPULSE_OK) {
+        return init_res;
+    }
+
+    uint64_t dsp_start_us = ei_read_timer_us();
+
+    // the input tensor is the output matrix, no float copy of the window
+    ei::matrix_i8_t features_matrix(row_count, cols, input->data.int8);
+
+    int ret = speechpy::processing::cmvnw_quantized(rows, row_count, cols, &features_matrix,
+        input->params.scale, input->params.zero_point, win_size, variance_normalization, scale);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: cmvnw failed (%d)\n", ret);
+#if (EI_CLASSIFIER_COMPILED == 1)
+        if (!tflite_session_active) {
+            trained_model_reset_ctx(tflite_model_ctx, ei_aligned_free);
+        }
+#else
+        if (!tflite_session_active) {
+            inference_tflite_free_interpreter(interpreter, tensor_arena);
+        }
+#endif
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    result->timing.dsp_us += ei_read_timer_us() - dsp_start_us;
+    result->timing.dsp = static_cast<int>(result->timing.dsp_us / 1000);
+
+    ctx_start_us = ei_read_timer_us();
+
+#if (EI_CLASSIFIER_COMPILED == 1)
+    return inference_tflite_run(ctx_start_us, output, tensor_arena, result, debug);
+#else
+    return inference_tflite_run(ctx_start_us, output, interpreter, tensor_arena, result, debug);
+#endif
+#endif
+}
+
 /**
  * Run the classifier over a raw features array
  * @param raw_features Raw features array
@@ -703,6 +1811,11 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
     ei_impulse_result_t *result,
     bool debug = false)
 {
+#if EI_CLASSIFIER_VAD == 1
+    // the voice activity gate only runs in continuous classification
+    result->no_speech = false;
+#endif
+
 #if EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED == 1
     // Shortcut for quantized image models
     if (can_run_classifier_image_quantized() == EI_IMPULSE_OK) {
@@ -724,7 +1837,7 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
 
     ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
 
-    uint64_t dsp_start_ms = ei_read_timer_ms();
+    uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
 
@@ -751,7 +1864,8 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
         out_features_index += block.n_output_features;
     }
 
-    result->timing.dsp = ei_read_timer_ms() - dsp_start_ms;
+    result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+    result->timing.dsp = static_cast<int>(result->timing.dsp_us / 1000);
 
     if (debug) {
         ei_printf("Features (%d ms.): ", result->timing.dsp);
@@ -952,16 +2066,16 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
 #if (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE)
     return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
 #else
-    uint64_t ctx_start_ms;
+    uint64_t ctx_start_us;
     TfLiteTensor* input;
     TfLiteTensor* output;
     uint8_t* tensor_arena;
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &tensor_arena);
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &tensor_arena);
 #else
     tflite::MicroInterpreter* interpreter;
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_us, &input, &output, &interpreter, &tensor_arena);
 #endif
     if (init_res != EI_IMPULSE_OK) {
         return init_res;
@@ -971,7 +2085,7 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
         return EI_IMPULSE_ONLY_SUPPORTED_FOR_IMAGES;
     }
 
-    uint64_t dsp_start_ms = ei_read_timer_ms();
+    uint64_t dsp_start_us = ei_read_timer_us();
 
     // features matrix maps around the input tensor to not allocate any memory
     ei::matrix_i8_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, input->data.int8);
@@ -987,7 +2101,8 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
         return EI_IMPULSE_CANCELED;
     }
 
-    result->timing.dsp = ei_read_timer_ms() - dsp_start_ms;
+    result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+    result->timing.dsp = static_cast<int>(result->timing.dsp_us / 1000);
 
     if (debug) {
         ei_printf("Features (%d ms.): ", result->timing.dsp);
@@ -998,12 +2113,12 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
         ei_printf("\n");
     }
 
-    ctx_start_ms = ei_read_timer_ms();
+    ctx_start_us = ei_read_timer_us();
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, tensor_arena, result, debug);
+    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_us, output, tensor_arena, result, debug);
 #else
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, interpreter, tensor_arena, result, debug);
+    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_us, output, interpreter, tensor_arena, result, debug);
 #endif
 
     if (run_res != EI_IMPULSE_OK) {
@@ -26,6 +26,7 @@
 #include "model-parameters/model_metadata.h"
 #include "edge-impulse-sdk/dsp/spectral/spectral.hpp"
 #include "edge-impulse-sdk/dsp/speechpy/speechpy.hpp"
+#include "ei_classifier_types.h"
 
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
 extern "C" {
@@ -263,9 +264,142 @@ __attribute__((unused)) int extract_flatten_features(signal_t *signal, matrix_t
     return EIDSP_OK;
 }
 
-static class speechpy::processing::preemphasis *preemphasis;
-static int preemphasized_audio_signal_get_data(size_t offset, size_t length, float *out_ptr) {
-    return preemphasis->get_data(offset, length, out_ptr);
+/* Slice state used by the *_per_slice_features functions, see set_dsp_slice_state() */
+static EIDSP_THREAD_LOCAL ei_dsp_slice_state_t dsp_slice_state_default = { false, false, false, false, false, { 0 }, false, 0.0f, 0.0f };
+static EIDSP_THREAD_LOCAL ei_dsp_slice_state_t *dsp_slice_state = &dsp_slice_state_default;
+
+/**
+ * Select the state the *_per_slice_features functions use, so several audio
+ * streams can be sliced independently. Pass NULL to go back to the default state.
+ */
+__attribute__((unused)) void set_dsp_slice_state(ei_dsp_slice_state_t *state) {
+    dsp_slice_state = state ? state : &dsp_slice_state_default;
+}
+
+/**
+ * Pre-emphasis history the next slice starts with, NULL on the first slice
+ * (then the slice wraps around to its own end, like a full window does)
+ */
+static const float *get_slice_preemphasis_history(int shift) {
+    if (!dsp_slice_state->preemphasis_history_valid ||
+        shift < 1 || shift > EI_DSP_SLICE_PREEMPHASIS_MAX_SHIFT) {
+        return NULL;
+    }
+    return dsp_slice_state->preemphasis_history;
+}
+
+/**
+ * Keep the last `shift` samples of a slice, so the pre-emphasis of the next
+ * slice continues where this one ends
+ * @param slice_length Length of the slice, without the extra frame_length the
+ *     per slice functions add for the framing
+ */
+static int save_slice_preemphasis_history(signal_t *signal, size_t slice_length, int shift) {
+    if (shift < 1 || shift > EI_DSP_SLICE_PREEMPHASIS_MAX_SHIFT || slice_length < static_cast<size_t>(shift)) {
+        return EIDSP_OK;
+    }
+
+    int ret = signal->get_data(slice_length - shift, shift, dsp_slice_state->preemphasis_history);
+    if (ret != 0) {
+        EIDSP_ERR(ret);
+    }
+    dsp_slice_state->preemphasis_history_valid = true;
+    return EIDSP_OK;
+}
+
+#if EI_CLASSIFIER_VAD == 1
+/**
+ * Keep the quietest and loudest frame of a slice for the voice activity gate,
+ * merged with what earlier DSP blocks of the same slice found
+ * @param log_energies ln(frame energy) of the first frame
+ * @param frame_count Number of frames
+ * @param stride Distance between the energies of two frames
+ */
+static void save_slice_frame_energies(const float *log_energies, size_t frame_count, size_t stride) {
+    for (size_t ix = 0; ix < frame_count; ix++) {
+        float log_energy = log_energies[ix * stride];
+
+        if (!dsp_slice_state->frame_energy_valid) {
+            dsp_slice_state->frame_log_energy_min = log_energy;
+            dsp_slice_state->frame_log_energy_max = log_energy;
+            dsp_slice_state->frame_energy_valid = true;
+        }
+        else if (log_energy < dsp_slice_state->frame_log_energy_min) {
+            dsp_slice_state->frame_log_energy_min = log_energy;
+        }
+        else if (log_energy > dsp_slice_state->frame_log_energy_max) {
+            dsp_slice_state->frame_log_energy_max = log_energy;
+        }
+    }
+}
+#endif // EI_CLASSIFIER_VAD == 1
+
+// MFE blocks build their plan without cepstral coefficients, they get their own
+// slot so an impulse with an MFE and an MFCC block doesn't rebuild the plans on every call
+static EIDSP_THREAD_LOCAL speechpy::mfcc_plan_t mfcc_plan = { 0 };
+static EIDSP_THREAD_LOCAL speechpy::mfcc_plan_t mfe_plan = { 0 };
+
+/**
+ * Get the MFCC plan (mel filterbank and framing parameters) for a DSP block,
+ * num_cepstral is 0 for MFE. The plan is built on first use and kept around,
+ * it's only rebuilt when called with different parameters.
+ * @returns Pointer to the plan, or NULL if building the plan failed
+ */
+static speechpy::mfcc_plan_t *get_mfcc_plan(uint32_t sampling_frequency,
+    float frame_length, float frame_stride, uint8_t num_cepstral, uint16_t num_filters,
+    uint16_t fft_length, uint32_t low_frequency, uint32_t high_frequency)
+{
+    speechpy::mfcc_plan_t *plan = num_cepstral == 0 ? &mfe_plan : &mfcc_plan;
+
+    if (high_frequency == 0) {
+        high_frequency = sampling_frequency / 2;
+    }
+
+    if (plan->filters &&
+        plan->sampling_frequency == sampling_frequency &&
+        plan->frame_length == frame_length &&
+        plan->frame_stride == frame_stride &&
+        plan->num_cepstral == num_cepstral &&
+        plan->num_filters == num_filters &&
+        plan->fft_length == fft_length &&
+        plan->low_frequency == low_frequency &&
+        plan->high_frequency == high_frequency) {
+        return plan;
+    }
+
+    speechpy::feature::free_mfcc_plan(plan);
+
+    int ret = speechpy::feature::create_mfcc_plan(plan, sampling_frequency,
+        frame_length, frame_stride, num_cepstral, num_filters, fft_length,
+        low_frequency, high_frequency);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: Failed to create MFCC plan (%d)\n", ret);
+        return NULL;
+    }
+
+    return plan;
+}
+
+/**
+ * Memory held by the cached MFCC and MFE plans, in bytes (0 if no plan was built yet)
+ */
+__attribute__((unused)) size_t get_mfcc_plan_memory_size(void) {
+    size_t size = 0;
+    if (mfcc_plan.filters) {
+        size += speechpy::feature::mfcc_plan_memory_size(&mfcc_plan);
+    }
+    if (mfe_plan.filters) {
+        size += speechpy::feature::mfcc_plan_memory_size(&mfe_plan);
+    }
+    return size;
+}
+
+/**
+ * Release the cached MFCC and MFE plans, they will be rebuilt on the next extraction
+ */
+__attribute__((unused)) void free_mfcc_plan(void) {
+    speechpy::feature::free_mfcc_plan(&mfcc_plan);
+    speechpy::feature::free_mfcc_plan(&mfe_plan);
 }
 
 __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
@@ -277,13 +411,8 @@ __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *ou
 
     const uint32_t frequency = static_cast<uint32_t>(sampling_frequency);
 
-    // preemphasis class to preprocess the audio...
-    class speechpy::processing::preemphasis pre(signal, config.pre_shift, config.pre_cof);
-    preemphasis = &pre;
-
-    signal_t preemphasized_audio_signal;
-    preemphasized_audio_signal.total_length = signal->total_length;
-    preemphasized_audio_signal.get_data = &preemphasized_audio_signal_get_data;
+    // the audio is pre-emphasized while it's framed
+    speechpy::processing::preemphasis_params_t preemphasis = { config.pre_shift, config.pre_cof, NULL };
 
     // calculate the size of the MFCC matrix
     matrix_size_t out_matrix_size =
@@ -299,10 +428,14 @@ __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *ou
     output_matrix->rows = out_matrix_size.rows;
     output_matrix->cols = out_matrix_size.cols;
 
+    speechpy::mfcc_plan_t *plan = get_mfcc_plan(frequency, config.frame_length, config.frame_stride,
+        config.num_cepstral, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
     // and run the MFCC extraction (using 32 rather than 40 filters here to optimize speed on embedded)
-    int ret = speechpy::feature::mfcc(output_matrix, &preemphasized_audio_signal,
-        frequency, config.frame_length, config.frame_stride, config.num_cepstral, config.num_filters, config.fft_length,
-        config.low_frequency, config.high_frequency);
+    int ret = speechpy::feature::mfcc(output_matrix, signal, plan, true, &preemphasis);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: MFCC failed (%d)\n", ret);
         EIDSP_ERR(ret);
@@ -324,17 +457,18 @@ __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *ou
 __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
 
-    static bool first_run = false;
+    bool &first_run = dsp_slice_state->mfcc_first_run;
 
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
     const uint32_t frequency = static_cast<uint32_t>(sampling_frequency);
+    const size_t slice_length = signal->total_length;
 
-    // preemphasis class to preprocess the audio...
-    class speechpy::processing::preemphasis pre(signal, config.pre_shift, config.pre_cof);
-    preemphasis = &pre;
+    // the audio is pre-emphasized while it's framed, continuing from the previous slice
+    speechpy::processing::preemphasis_params_t preemphasis = {
+        config.pre_shift, config.pre_cof, get_slice_preemphasis_history(config.pre_shift) };
 
     /* Fake an extra frame_length for stack frames calculations. There, 1 frame_length is always
     subtracted and there for never used. But skip the first slice to fit the feature_matrix
@@ -345,10 +479,6 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
 
     first_run = true;
 
-    signal_t preemphasized_audio_signal;
-    preemphasized_audio_signal.total_length = signal->total_length;
-    preemphasized_audio_signal.get_data = &preemphasized_audio_signal_get_data;
-
     // calculate the size of the MFCC matrix
     matrix_size_t out_matrix_size =
         speechpy::feature::calculate_mfcc_buffer_size(
@@ -363,15 +493,24 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
     output_matrix->rows = out_matrix_size.rows;
     output_matrix->cols = out_matrix_size.cols;
 
+    speechpy::mfcc_plan_t *plan = get_mfcc_plan(frequency, config.frame_length, config.frame_stride,
+        config.num_cepstral, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
     // and run the MFCC extraction (using 32 rather than 40 filters here to optimize speed on embedded)
-    int ret = speechpy::feature::mfcc(output_matrix, &preemphasized_audio_signal,
-        frequency, config.frame_length, config.frame_stride, config.num_cepstral, config.num_filters, config.fft_length,
-        config.low_frequency, config.high_frequency);
+    int ret = speechpy::feature::mfcc(output_matrix, signal, plan, true, &preemphasis);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: MFCC failed (%d)\n", ret);
         EIDSP_ERR(ret);
     }
 
+#if EI_CLASSIFIER_VAD == 1
+    // with DC elimination the first coefficient of every frame is its log energy
+    save_slice_frame_energies(output_matrix->buffer, output_matrix->rows, output_matrix->cols);
+#endif
+
     output_matrix->cols = out_matrix_size.rows * out_matrix_size.cols;
     output_matrix->rows = 1;
 
@@ -379,9 +518,189 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
         signal->total_length -= (size_t)(config.frame_length * (float)frequency);
     }
 
+    ret = save_slice_preemphasis_history(signal, slice_length, config.pre_shift);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
+
+    return EIDSP_OK;
+}
+
+
+static EIDSP_THREAD_LOCAL speechpy::mfcc_q15_plan_t mfcc_q15_plan = { 0 };
+
+/**
+ * Get the fixed point MFCC plan for a DSP block, built on first use and kept
+ * around like the one from `get_mfcc_plan`.
+ * @returns Pointer to the plan, or NULL if building the plan failed
+ */
+static speechpy::mfcc_q15_plan_t *get_mfcc_q15_plan(uint32_t sampling_frequency,
+    float frame_length, float frame_stride, uint8_t num_cepstral, uint16_t num_filters,
+    uint16_t fft_length, uint32_t low_frequency, uint32_t high_frequency)
+{
+    if (high_frequency == 0) {
+        high_frequency = sampling_frequency / 2;
+    }
+
+    const speechpy::mfcc_plan_t *p = &mfcc_q15_plan.plan;
+    if (p->filters &&
+        p->sampling_frequency == sampling_frequency &&
+        p->frame_length == frame_length &&
+        p->frame_stride == frame_stride &&
+        p->num_cepstral == num_cepstral &&
+        p->num_filters == num_filters &&
+        p->fft_length == fft_length &&
+        p->low_frequency == low_frequency &&
+        p->high_frequency == high_frequency) {
+        return &mfcc_q15_plan;
+    }
+
+    speechpy::feature::free_mfcc_q15_plan(&mfcc_q15_plan);
+
+    int ret = speechpy::feature::create_mfcc_q15_plan(&mfcc_q15_plan, sampling_frequency,
+        frame_length, frame_stride, num_cepstral, num_filters, fft_length,
+        low_frequency, high_frequency);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: Failed to create fixed point MFCC plan (%d)\n", ret);
+        return NULL;
+    }
+
+    return &mfcc_q15_plan;
+}
+
+/**
+ * Release the cached fixed point MFCC plan
+ */
+__attribute__((unused)) void free_mfcc_q15_plan(void) {
+    speechpy::feature::free_mfcc_q15_plan(&mfcc_q15_plan);
+}
+
+/**
+ * MFCC block in fixed point, for targets without an FPU. Drop-in replacement for
+ * `extract_mfcc_features` (set it as the extract_fn of the block in dsp_blocks.h),
+ * see `speechpy::feature::mfcc_q15` for the difference versus the float version.
+ */
+__attribute__((unused)) int extract_mfcc_q15_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
+    ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
+
+    if (config.axes != 1) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    const uint32_t frequency = static_cast<uint32_t>(sampling_frequency);
+
+    // preemphasis class to preprocess the audio...
+    class speechpy::processing::preemphasis_q15 pre(signal, config.pre_shift, config.pre_cof);
+
+    // calculate the size of the MFCC matrix
+    matrix_size_t out_matrix_size =
+        speechpy::feature::calculate_mfcc_buffer_size(
+            signal->total_length, frequency, config.frame_length, config.frame_stride, config.num_cepstral);
+    /* Only throw size mismatch error calculated buffer doesn't fit for continuous inferencing */
+    if (out_matrix_size.rows * out_matrix_size.cols > output_matrix->rows * output_matrix->cols) {
+        ei_printf("out_matrix = %hux%hu\n", output_matrix->rows, output_matrix->cols);
+        ei_printf("calculated size = %hux%hu\n", out_matrix_size.rows, out_matrix_size.cols);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    output_matrix->rows = out_matrix_size.rows;
+    output_matrix->cols = out_matrix_size.cols;
+
+    speechpy::mfcc_q15_plan_t *plan = get_mfcc_q15_plan(frequency, config.frame_length, config.frame_stride,
+        config.num_cepstral, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    int ret = speechpy::feature::mfcc_q15(output_matrix, &pre, plan);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    // cepstral mean and variance normalization
+    ret = speechpy::processing::cmvnw(output_matrix, config.win_size, true);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: cmvnw failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    output_matrix->cols = out_matrix_size.rows * out_matrix_size.cols;
+    output_matrix->rows = 1;
+
     return EIDSP_OK;
 }
 
+__attribute__((unused)) int extract_mfcc_q15_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
+    ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
+
+    bool &first_run = dsp_slice_state->mfcc_q15_first_run;
+
+    if (config.axes != 1) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    const uint32_t frequency = static_cast<uint32_t>(sampling_frequency);
+    const size_t slice_length = signal->total_length;
+
+    // preemphasis class to preprocess the audio, continuing from the previous slice
+    class speechpy::processing::preemphasis_q15 pre(signal, config.pre_shift, config.pre_cof,
+        get_slice_preemphasis_history(config.pre_shift));
+
+    /* Fake an extra frame_length for stack frames calculations. There, 1 frame_length is always
+    subtracted and there for never used. But skip the first slice to fit the feature_matrix
+    buffer */
+    if (first_run == true) {
+        signal->total_length += (size_t)(config.frame_length * (float)frequency);
+    }
+
+    first_run = true;
+
+    // calculate the size of the MFCC matrix
+    matrix_size_t out_matrix_size =
+        speechpy::feature::calculate_mfcc_buffer_size(
+            signal->total_length, frequency, config.frame_length, config.frame_stride, config.num_cepstral);
+    /* Only throw size mismatch error calculated buffer doesn't fit for continuous inferencing */
+    if (out_matrix_size.rows * out_matrix_size.cols > output_matrix->rows * output_matrix->cols) {
+        ei_printf("out_matrix = %hux%hu\n", output_matrix->rows, output_matrix->cols);
+        ei_printf("calculated size = %hux%hu\n", out_matrix_size.rows, out_matrix_size.cols);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    output_matrix->rows = out_matrix_size.rows;
+    output_matrix->cols = out_matrix_size.cols;
+
+    speechpy::mfcc_q15_plan_t *plan = get_mfcc_q15_plan(frequency, config.frame_length, config.frame_stride,
+        config.num_cepstral, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    int ret = speechpy::feature::mfcc_q15(output_matrix, &pre, plan);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+#if EI_CLASSIFIER_VAD == 1
+    // with DC elimination the first coefficient of every frame is its log energy
+    save_slice_frame_energies(output_matrix->buffer, output_matrix->rows, output_matrix->cols);
+#endif
+
+    output_matrix->cols = out_matrix_size.rows * out_matrix_size.cols;
+    output_matrix->rows = 1;
+
+    if (first_run == true) {
+        signal->total_length -= (size_t)(config.frame_length * (float)frequency);
+    }
+
+    ret = save_slice_preemphasis_history(signal, slice_length, config.pre_shift);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
+
+    return EIDSP_OK;
+}
 
 __attribute__((unused)) int extract_spectrogram_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_spectrogram_t config = *((ei_dsp_config_spectrogram_t*)config_ptr);
@@ -433,7 +752,7 @@ __attribute__((unused)) int extract_spectrogram_features(signal_t *signal, matri
 __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_spectrogram_t config = *((ei_dsp_config_spectrogram_t*)config_ptr);
 
-    static bool first_run = false;
+    bool &first_run = dsp_slice_state->spectrogram_first_run;
 
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
@@ -506,15 +825,14 @@ __attribute__((unused)) int extract_mfe_features(signal_t *signal, matrix_t *out
     output_matrix->rows = out_matrix_size.rows;
     output_matrix->cols = out_matrix_size.cols;
 
-    // and run the MFE extraction
-    EI_DSP_MATRIX(energy_matrix, output_matrix->rows, 1);
-    if (!energy_matrix.buffer) {
+    // and run the MFE extraction, the frame energies are not used
+    speechpy::mfcc_plan_t *plan = get_mfcc_plan(frequency, config.frame_length, config.frame_stride,
+        0, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
         EIDSP_ERR(EIDSP_OUT_OF_MEM);
     }
 
-    int ret = speechpy::feature::mfe(output_matrix, &energy_matrix, signal,
-        frequency, config.frame_length, config.frame_stride, config.num_filters, config.fft_length,
-        config.low_frequency, config.high_frequency);
+    int ret = speechpy::feature::mfe(output_matrix, NULL, signal, plan);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: MFE failed (%d)\n", ret);
         EIDSP_ERR(ret);
@@ -536,7 +854,7 @@ __attribute__((unused)) int extract_mfe_features(signal_t *signal, matrix_t *out
 __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_mfe_t config = *((ei_dsp_config_mfe_t*)config_ptr);
 
-    static bool first_run = false;
+    bool &first_run = dsp_slice_state->mfe_first_run;
 
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
@@ -567,20 +885,38 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     output_matrix->rows = out_matrix_size.rows;
     output_matrix->cols = out_matrix_size.cols;
 
+    // the frame energies are only needed by the voice activity gate
+#if EI_CLASSIFIER_VAD == 1
     EI_DSP_MATRIX(energy_matrix, output_matrix->rows, 1);
     if (!energy_matrix.buffer) {
         EIDSP_ERR(EIDSP_OUT_OF_MEM);
     }
+    matrix_t *energies = &energy_matrix;
+#else
+    matrix_t *energies = NULL;
+#endif
 
     // and run the MFE extraction
-    int ret = speechpy::feature::mfe(output_matrix, &energy_matrix, signal,
-        frequency, config.frame_length, config.frame_stride, config.num_filters, config.fft_length,
-        config.low_frequency, config.high_frequency);
+    speechpy::mfcc_plan_t *plan = get_mfcc_plan(frequency, config.frame_length, config.frame_stride,
+        0, config.num_filters, config.fft_length, config.low_frequency, config.high_frequency);
+    if (!plan) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    int ret = speechpy::feature::mfe(output_matrix, energies, signal, plan);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: MFCC failed (%d)\n", ret);
         EIDSP_ERR(ret);
     }
 
+#if EI_CLASSIFIER_VAD == 1
+    ret = numpy::log(&energy_matrix);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
+    save_slice_frame_energies(energy_matrix.buffer, energy_matrix.rows, 1);
+#endif
+
     output_matrix->cols = out_matrix_size.rows * out_matrix_size.cols;
     output_matrix->rows = 1;
 
@@ -87,8 +87,57 @@
 #define EIDSP_PRINT_ALLOCATIONS      1
 #endif
 
+// number of FFT plans (twiddle tables) kept alive by numpy::get_fft_plan,
+// MFE and MFCC need one (the frame FFT), numpy::dct2 one per transform length
+#ifndef EIDSP_FFT_PLAN_CACHE_SIZE
+#define EIDSP_FFT_PLAN_CACHE_SIZE    4
+#endif // EIDSP_FFT_PLAN_CACHE_SIZE
+
+// compute the sliding window statistics in cmvnw from running sums instead of
+// re-summing every window, the output matches to within float rounding
+#ifndef EIDSP_CMVNW_RUNNING_SUMS
+#define EIDSP_CMVNW_RUNNING_SUMS     1
+#endif // EIDSP_CMVNW_RUNNING_SUMS
+
+// time the DSP stages (pre-emphasis, framing, FFT, filterbank, log, DCT, CMVN)
+// into ei_dsp_stage_counters, see profiling.hpp. On with EI_CLASSIFIER_PROFILING
+#ifndef EIDSP_PROFILING
+#if defined(EI_CLASSIFIER_PROFILING) && EI_CLASSIFIER_PROFILING == 1
+#define EIDSP_PROFILING              1
+#else
+#define EIDSP_PROFILING              0
+#endif
+#endif // EIDSP_PROFILING
+
+// number of frames MFE / MFCC transform before projecting them onto the mel filterbank
+// in one pass, costs (fft_length / 2 + 1) floats of heap per frame
+#ifndef EIDSP_MFE_BATCH_FRAMES
+#define EIDSP_MFE_BATCH_FRAMES       8
+#endif // EIDSP_MFE_BATCH_FRAMES
+
+// vectorized log / exp approximations (see fast_math.hpp) for the MFCC log and the float
+// softmax: AVX2 or SSE2 on x86, CMSIS-DSP on NEON / Helium. With 0 numpy::log runs the same
+// approximation one value at a time and softmax uses the TensorFlow Lite reference (std::exp).
+// Opt-in, benchmark/dsp_accuracy_benchmark checks the approximations against their references.
+#ifndef EIDSP_USE_FAST_MATH
+#define EIDSP_USE_FAST_MATH          0
+#endif // EIDSP_USE_FAST_MATH
+
 #ifndef EIDSP_SIGNAL_C_FN_POINTER
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
 
+// set to 1 to classify from several threads at once (see classifier/ei_classifier_thread_pool.h),
+// everything that is kept alive between calls (MFCC and FFT plans, the per-slice state and the
+// inference session) then is per thread
+#ifndef EIDSP_MULTI_THREADED
+#define EIDSP_MULTI_THREADED         0
+#endif // EIDSP_MULTI_THREADED
+
+#if EIDSP_MULTI_THREADED == 1
+#define EIDSP_THREAD_LOCAL           thread_local
+#else
+#define EIDSP_THREAD_LOCAL
+#endif // EIDSP_MULTI_THREADED == 1
+
 #endif // _EIDSP_CPP_CONFIG_H_
@@ -35,22 +35,33 @@
 
 // DCT type II, unscaled
 int ei::dct::transform(float vector[], size_t len) {
-	const size_t fft_data_out_size = (len / 2 + 1) * sizeof(ei::fft_complex_t);
-	const size_t fft_data_in_size = len * sizeof(float);
+	const size_t scratch_size = ei::numpy::dct2_scratch_size(len) * sizeof(float);
 
-	// Allocate KissFFT input / output buffer
-    fft_complex_t *fft_data_out =
-		(ei::fft_complex_t*)ei_dsp_calloc(fft_data_out_size, 1);
-	if (!fft_data_out) {
+	float *scratch = (float*)ei_dsp_malloc(scratch_size);
+	if (!scratch) {
 		return ei::EIDSP_OUT_OF_MEM;
 	}
 
-    float *fft_data_in = (float*)ei_dsp_calloc(fft_data_in_size, 1);
-	if (!fft_data_in) {
-		ei_dsp_free(fft_data_out, fft_data_out_size);
-		return ei::EIDSP_OUT_OF_MEM;
+	ei::fft_plan_t temp_plan;
+	const ei::fft_plan_t *plan;
+	int r = ei::numpy::acquire_fft_plan(len, &temp_plan, &plan);
+	if (r == 0) {
+		r = ei::dct::transform(vector, len, plan, scratch);
+		ei::numpy::release_fft_plan(&temp_plan, plan);
 	}
 
+	ei_dsp_free(scratch, scratch_size);
+
+	return r;
+}
+
+// DCT type II, unscaled, with a prebuilt FFT plan for len points and
+// ei::numpy::dct2_scratch_size(len) floats of scratch
+int ei::dct::transform(float vector[], size_t len, const ei::fft_plan_t *plan, float *scratch) {
+	float *fft_data_in = scratch;
+	fft_complex_t *fft_data_out = (ei::fft_complex_t*)(scratch + len);
+	float *rfft_scratch = scratch + len + (len / 2 + 1) * 2;
+
 	// Preprocess the input buffer with the data from the vector
 	size_t halfLen = len / 2;
 	for (size_t i = 0; i < halfLen; i++) {
@@ -61,10 +72,8 @@ int ei::dct::transform(float vector[], size_t len) {
 		fft_data_in[halfLen] = vector[len - 1];
 	}
 
-	int r = ei::numpy::rfft(fft_data_in, len, fft_data_out, (len / 2 + 1), len);
+	int r = ei::numpy::rfft(plan, fft_data_in, len, fft_data_out, (len / 2 + 1), rfft_scratch);
 	if (r != 0) {
-		ei_dsp_free(fft_data_in, fft_data_in_size);
-		ei_dsp_free(fft_data_out, fft_data_out_size);
 		return r;
 	}
 
@@ -73,9 +82,6 @@ int ei::dct::transform(float vector[], size_t len) {
 		vector[i] = fft_data_out[i].r * cos(temp) + fft_data_out[i].i * sin(temp);
 	}
 
-	ei_dsp_free(fft_data_in, fft_data_in_size);
-	ei_dsp_free(fft_data_out, fft_data_out_size);
-
 	return 0;
 }
 
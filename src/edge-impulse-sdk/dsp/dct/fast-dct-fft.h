@@ -28,9 +28,13 @@
 #include "../kissfft/kiss_fft.h"
 
 namespace ei {
+
+struct ei_fft_plan;
+
 namespace dct {
 
 int transform(float vector[], size_t len);
+int transform(float vector[], size_t len, const struct ei_fft_plan *plan, float *scratch);
 int inverse_transform(float vector[], size_t len);
 
 } // namespace dct
@@ -0,0 +1,335 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_FAST_MATH_H_
+#define _EIDSP_FAST_MATH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "config.hpp"
+
+// pick the vector unit at compile time: CMSIS-DSP only vectorizes log / exp on
+// NEON and Helium (elsewhere arm_vlog_f32 is a logf loop), on x86 use AVX2 or SSE2
+#if EIDSP_USE_FAST_MATH == 1
+#if EIDSP_USE_CMSIS_DSP && (defined(ARM_MATH_MVEF) || defined(ARM_MATH_HELIUM) || defined(ARM_MATH_NEON))
+#define EIDSP_FAST_MATH_CMSIS        1
+#include "edge-impulse-sdk/CMSIS/DSP/Include/arm_math.h"
+#elif defined(__AVX2__)
+#define EIDSP_FAST_MATH_AVX2         1
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define EIDSP_FAST_MATH_SSE2         1
+#include <emmintrin.h>
+#if defined(__FMA__)
+#include <immintrin.h>
+#endif
+#endif
+#endif // EIDSP_USE_FAST_MATH == 1
+
+// fused multiply-add only where the hardware has it, a libm fmaf is far slower than a * b + c
+#if defined(FP_FAST_FMAF) || defined(__FMA__) || defined(__ARM_FEATURE_FMA)
+#define EIDSP_FAST_MATH_FMA          1
+#else
+#define EIDSP_FAST_MATH_FMA          0
+#endif
+
+namespace ei {
+
+/**
+ * Approximations of log and exp, one float at a time or vectorized over an array.
+ * The vector versions run the same operations as the scalar ones lane by lane,
+ * so (except through CMSIS-DSP) an element gets the same value wherever it is.
+ *  - log: at most 2.3e-5 absolute error versus logf() for inputs in [1e-30, 1e30]
+ *  - exp: at most 1.4 ulp versus expf(), inputs are clamped to [-87.3365, 88.376] so
+ *    the result stays a normal float, anything below gives about FLT_MIN instead of 0
+ */
+class fast_math {
+public:
+    static inline float fmadd(float a, float b, float c)
+    {
+#if EIDSP_FAST_MATH_FMA == 1
+        return fmaf(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    /**
+     * > 50% faster then the math.h log() function
+     * in return for a small loss in accuracy (0.00001 average diff with log())
+     * From: https://stackoverflow.com/questions/39821367/very-fast-approximate-logarithm-natural-log-function-in-c/39822314#39822314
+     * Licensed under the CC BY-SA 3.0
+     * @param a Input number
+     * @returns Natural log value of a
+     */
+    static inline float log(float a)
+    {
+        float m, r, s, t, i, f;
+        int32_t e, g;
+
+        memcpy(&g, &a, sizeof(g));
+        e = (g - 0x3f2aaaab) & 0xff800000;
+        g = g - e;
+        memcpy(&m, &g, sizeof(m));
+        i = (float)e * 1.19209290e-7f; // 0x1.0p-23
+        /* m in [2/3, 4/3] */
+        f = m - 1.0f;
+        s = f * f;
+        /* Compute log1p(f) for f in [-1/3, 1/3] */
+        r = fmadd(0.230836749f, f, -0.279208571f); // 0x1.d8c0f0p-3, -0x1.1de8dap-2
+        t = fmadd(0.331826031f, f, -0.498910338f); // 0x1.53ca34p-2, -0x1.fee25ap-2
+        r = fmadd(r, s, t);
+        r = fmadd(r, s, f);
+        r = fmadd(i, 0.693147182f, r); // 0x1.62e430p-1 // log(2)
+
+        return r;
+    }
+
+    /**
+     * exp(a) as 2^n * exp(r) with |r| <= log(2) / 2 and a degree 6 polynomial
+     * for exp(r) (the Cephes expf coefficients)
+     * @param a Input number
+     * @returns e to the power of a
+     */
+    static inline float exp(float a)
+    {
+        a = a > 88.3762626647949f ? 88.3762626647949f : a;
+        // log(FLT_MIN) rounded up: n stays >= -126, at -127 the exponent field below is 0
+        a = a < -87.33654f ? -87.33654f : a;
+
+        // n = round(a / log(2)), then r = a - n * log(2) in two steps for precision
+        float n = floorf(fmadd(a, 1.44269504088896341f, 0.5f));
+        float r = fmadd(n, -0.693359375f, a);
+        r = fmadd(n, 2.12194440e-4f, r);
+
+        float y = 1.9875691500e-4f;
+        y = fmadd(y, r, 1.3981999507e-3f);
+        y = fmadd(y, r, 8.3334519073e-3f);
+        y = fmadd(y, r, 4.1665795894e-2f);
+        y = fmadd(y, r, 1.6666665459e-1f);
+        y = fmadd(y, r, 5.0000001201e-1f);
+        y = fmadd(y, r * r, r);
+        y = y + 1.0f;
+
+        int32_t pow2n = (static_cast<int32_t>(n) + 127) << 23;
+        float scale;
+        memcpy(&scale, &pow2n, sizeof(scale));
+        return y * scale;
+    }
+
+    /**
+     * Natural log of every element of an array
+     * @param in Input array
+     * @param out Output array, may be the same as in
+     * @param size Number of elements
+     */
+    static void log(const float *in, float *out, size_t size)
+    {
+        size_t ix = 0;
+#if EIDSP_FAST_MATH_CMSIS == 1
+        arm_vlog_f32(in, out, size);
+        ix = size;
+#elif EIDSP_FAST_MATH_AVX2 == 1
+        for (; ix + 8 <= size; ix += 8) {
+            _mm256_storeu_ps(out + ix, log_avx2(_mm256_loadu_ps(in + ix)));
+        }
+#elif EIDSP_FAST_MATH_SSE2 == 1
+        for (; ix + 4 <= size; ix += 4) {
+            _mm_storeu_ps(out + ix, log_sse2(_mm_loadu_ps(in + ix)));
+        }
+#endif
+        for (; ix < size; ix++) {
+            out[ix] = log(in[ix]);
+        }
+    }
+
+    /**
+     * e to the power of every element of an array
+     * @param in Input array
+     * @param out Output array, may be the same as in
+     * @param size Number of elements
+     */
+    static void exp(const float *in, float *out, size_t size)
+    {
+        size_t ix = 0;
+#if EIDSP_FAST_MATH_CMSIS == 1
+        arm_vexp_f32(in, out, size);
+        ix = size;
+#elif EIDSP_FAST_MATH_AVX2 == 1
+        for (; ix + 8 <= size; ix += 8) {
+            _mm256_storeu_ps(out + ix, exp_avx2(_mm256_loadu_ps(in + ix)));
+        }
+#elif EIDSP_FAST_MATH_SSE2 == 1
+        for (; ix + 4 <= size; ix += 4) {
+            _mm_storeu_ps(out + ix, exp_sse2(_mm_loadu_ps(in + ix)));
+        }
+#endif
+        for (; ix < size; ix++) {
+            out[ix] = exp(in[ix]);
+        }
+    }
+
+    /**
+     * Softmax over one row, exp((x - max) * beta) / sum like the TensorFlow Lite
+     * reference kernel but with the vectorized exp
+     * @param in Input row
+     * @param out Output row, may be the same as in
+     * @param size Number of elements in the row
+     * @param beta Scale of the inputs
+     */
+    static void softmax(const float *in, float *out, size_t size, float beta)
+    {
+        if (size == 0) {
+            return;
+        }
+
+        float max = in[0];
+        for (size_t ix = 1; ix < size; ix++) {
+            max = in[ix] > max ? in[ix] : max;
+        }
+
+        for (size_t ix = 0; ix < size; ix++) {
+            out[ix] = (in[ix] - max) * beta;
+        }
+
+        exp(out, out, size);
+
+        float sum = 0.0f;
+        for (size_t ix = 0; ix < size; ix++) {
+            sum += out[ix];
+        }
+        for (size_t ix = 0; ix < size; ix++) {
+            out[ix] = out[ix] / sum;
+        }
+    }
+
+private:
+#if EIDSP_FAST_MATH_AVX2 == 1
+    static inline __m256 fmadd_avx2(__m256 a, __m256 b, __m256 c)
+    {
+#if EIDSP_FAST_MATH_FMA == 1
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    static inline __m256 log_avx2(__m256 a)
+    {
+        __m256i g = _mm256_castps_si256(a);
+        __m256i e = _mm256_and_si256(_mm256_sub_epi32(g, _mm256_set1_epi32(0x3f2aaaab)),
+            _mm256_set1_epi32(static_cast<int32_t>(0xff800000)));
+        __m256 m = _mm256_castsi256_ps(_mm256_sub_epi32(g, e));
+        __m256 i = _mm256_mul_ps(_mm256_cvtepi32_ps(e), _mm256_set1_ps(1.19209290e-7f));
+        __m256 f = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+        __m256 s = _mm256_mul_ps(f, f);
+        __m256 r = fmadd_avx2(_mm256_set1_ps(0.230836749f), f, _mm256_set1_ps(-0.279208571f));
+        __m256 t = fmadd_avx2(_mm256_set1_ps(0.331826031f), f, _mm256_set1_ps(-0.498910338f));
+        r = fmadd_avx2(r, s, t);
+        r = fmadd_avx2(r, s, f);
+        return fmadd_avx2(i, _mm256_set1_ps(0.693147182f), r);
+    }
+
+    static inline __m256 exp_avx2(__m256 a)
+    {
+        a = _mm256_min_ps(a, _mm256_set1_ps(88.3762626647949f));
+        a = _mm256_max_ps(a, _mm256_set1_ps(-87.33654f));
+
+        __m256 n = _mm256_floor_ps(fmadd_avx2(a, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+        __m256 r = fmadd_avx2(n, _mm256_set1_ps(-0.693359375f), a);
+        r = fmadd_avx2(n, _mm256_set1_ps(2.12194440e-4f), r);
+
+        __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+        y = fmadd_avx2(y, r, _mm256_set1_ps(1.3981999507e-3f));
+        y = fmadd_avx2(y, r, _mm256_set1_ps(8.3334519073e-3f));
+        y = fmadd_avx2(y, r, _mm256_set1_ps(4.1665795894e-2f));
+        y = fmadd_avx2(y, r, _mm256_set1_ps(1.6666665459e-1f));
+        y = fmadd_avx2(y, r, _mm256_set1_ps(5.0000001201e-1f));
+        y = fmadd_avx2(y, _mm256_mul_ps(r, r), r);
+        y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+        __m256i pow2n = _mm256_slli_epi32(
+            _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+    }
+#endif // EIDSP_FAST_MATH_AVX2 == 1
+
+#if EIDSP_FAST_MATH_SSE2 == 1
+    static inline __m128 fmadd_sse2(__m128 a, __m128 b, __m128 c)
+    {
+#if EIDSP_FAST_MATH_FMA == 1
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+
+    static inline __m128 log_sse2(__m128 a)
+    {
+        __m128i g = _mm_castps_si128(a);
+        __m128i e = _mm_and_si128(_mm_sub_epi32(g, _mm_set1_epi32(0x3f2aaaab)),
+            _mm_set1_epi32(static_cast<int32_t>(0xff800000)));
+        __m128 m = _mm_castsi128_ps(_mm_sub_epi32(g, e));
+        __m128 i = _mm_mul_ps(_mm_cvtepi32_ps(e), _mm_set1_ps(1.19209290e-7f));
+        __m128 f = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+        __m128 s = _mm_mul_ps(f, f);
+        __m128 r = fmadd_sse2(_mm_set1_ps(0.230836749f), f, _mm_set1_ps(-0.279208571f));
+        __m128 t = fmadd_sse2(_mm_set1_ps(0.331826031f), f, _mm_set1_ps(-0.498910338f));
+        r = fmadd_sse2(r, s, t);
+        r = fmadd_sse2(r, s, f);
+        return fmadd_sse2(i, _mm_set1_ps(0.693147182f), r);
+    }
+
+    static inline __m128 exp_sse2(__m128 a)
+    {
+        a = _mm_min_ps(a, _mm_set1_ps(88.3762626647949f));
+        a = _mm_max_ps(a, _mm_set1_ps(-87.33654f));
+
+        // floor without SSE4.1: truncate, then step down where that rounded up
+        __m128 v = fmadd_sse2(a, _mm_set1_ps(1.44269504088896341f), _mm_set1_ps(0.5f));
+        __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, v), _mm_set1_ps(1.0f)));
+
+        __m128 r = fmadd_sse2(n, _mm_set1_ps(-0.693359375f), a);
+        r = fmadd_sse2(n, _mm_set1_ps(2.12194440e-4f), r);
+
+        __m128 y = _mm_set1_ps(1.9875691500e-4f);
+        y = fmadd_sse2(y, r, _mm_set1_ps(1.3981999507e-3f));
+        y = fmadd_sse2(y, r, _mm_set1_ps(8.3334519073e-3f));
+        y = fmadd_sse2(y, r, _mm_set1_ps(4.1665795894e-2f));
+        y = fmadd_sse2(y, r, _mm_set1_ps(1.6666665459e-1f));
+        y = fmadd_sse2(y, r, _mm_set1_ps(5.0000001201e-1f));
+        y = fmadd_sse2(y, _mm_mul_ps(r, r), r);
+        y = _mm_add_ps(y, _mm_set1_ps(1.0f));
+
+        __m128i pow2n = _mm_slli_epi32(
+            _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+    }
+#endif // EIDSP_FAST_MATH_SSE2 == 1
+};
+
+} // namespace ei
+
+#endif // _EIDSP_FAST_MATH_H_
@@ -22,5 +22,6 @@
 
 #include "memory.hpp"
 
-size_t ei_memory_in_use = 0;
-size_t ei_memory_peak_use = 0;
+ei_memory_counter_t ei_memory_in_use(0);
+ei_memory_counter_t ei_memory_peak_use(0);
+ei_memory_counter_t ei_memory_alloc_count(0);
@@ -24,10 +24,37 @@
 #define _EIDSP_MEMORY_H_
 
 #include <stdio.h>
+#include "config.hpp"
 #include "../porting/ei_classifier_porting.h"
 
-extern size_t ei_memory_in_use;
-extern size_t ei_memory_peak_use;
+// with EIDSP_MULTI_THREADED every thread allocates through the same counters,
+// so they are atomic there (the peak is the peak over all threads together)
+#if EIDSP_MULTI_THREADED == 1
+#include <atomic>
+typedef std::atomic<size_t> ei_memory_counter_t;
+#else
+typedef size_t ei_memory_counter_t;
+#endif // EIDSP_MULTI_THREADED == 1
+
+extern ei_memory_counter_t ei_memory_in_use;
+extern ei_memory_counter_t ei_memory_peak_use;
+extern ei_memory_counter_t ei_memory_alloc_count;
+
+/**
+ * Raise ei_memory_peak_use to in_use if that is higher.
+ * @param in_use Bytes in use right after an allocation
+ */
+static inline void ei_memory_update_peak(size_t in_use) {
+#if EIDSP_MULTI_THREADED == 1
+    size_t peak = ei_memory_peak_use.load();
+    while (in_use > peak && !ei_memory_peak_use.compare_exchange_weak(peak, in_use)) {
+    }
+#else
+    if (in_use > ei_memory_peak_use) {
+        ei_memory_peak_use = in_use;
+    }
+#endif // EIDSP_MULTI_THREADED == 1
+}
 
 #if EIDSP_PRINT_ALLOCATIONS == 1
 #define ei_dsp_printf           printf
@@ -40,6 +67,8 @@ namespace ei {
 /**
  * These are macros used to track allocations when running DSP processes.
  * Enable memory tracking through the EIDSP_TRACK_ALLOCATIONS macro.
+ * `ei_memory_alloc_count` counts every registered allocation, sample it around
+ * a call to check that a hot path does not hit the heap.
  */
 
 #if EIDSP_TRACK_ALLOCATIONS
@@ -49,12 +78,10 @@ namespace ei {
      * @param bytes Number of bytes allocated
      */
     #define ei_dsp_register_alloc_internal(fn, file, line, bytes) \
-        ei_memory_in_use += bytes; \
-        if (ei_memory_in_use > ei_memory_peak_use) { \
-            ei_memory_peak_use = ei_memory_in_use; \
-        } \
+        ei_memory_update_peak(ei_memory_in_use += bytes); \
+        ei_memory_alloc_count++; \
         ei_dsp_printf("alloc %lu bytes (in_use=%lu, peak=%lu) (%s@%s:%d)\n", \
-            bytes, ei_memory_in_use, ei_memory_peak_use, fn, file, line);
+            bytes, (size_t)ei_memory_in_use, (size_t)ei_memory_peak_use, fn, file, line);
 
     /**
      * Register a matrix allocation. Don't call this function yourself,
@@ -64,12 +91,10 @@ namespace ei {
      * @param type_size Size of the data type
      */
     #define ei_dsp_register_matrix_alloc_internal(fn, file, line, rows, cols, type_size) \
-        ei_memory_in_use += (rows * cols * type_size); \
-        if (ei_memory_in_use > ei_memory_peak_use) { \
-            ei_memory_peak_use = ei_memory_in_use; \
-        } \
+        ei_memory_update_peak(ei_memory_in_use += (rows * cols * type_size)); \
+        ei_memory_alloc_count++; \
         ei_dsp_printf("alloc matrix %hu x %hu = %lu bytes (in_use=%lu, peak=%lu) (%s@%s:%d)\n", \
-            rows, cols, rows * cols * type_size, ei_memory_in_use, ei_memory_peak_use, fn, file, line);
+            rows, cols, rows * cols * type_size, (size_t)ei_memory_in_use, (size_t)ei_memory_peak_use, fn, file, line);
 
     /**
      * Register free'ing manually allocated memory (allocated through malloc/calloc)
@@ -78,7 +103,7 @@ namespace ei {
     #define ei_dsp_register_free_internal(fn, file, line, bytes) \
         ei_memory_in_use -= bytes; \
         ei_dsp_printf("free %lu bytes (in_use=%lu, peak=%lu) (%s@%s:%d)\n", \
-            bytes, ei_memory_in_use, ei_memory_peak_use, fn, file, line);
+            bytes, (size_t)ei_memory_in_use, (size_t)ei_memory_peak_use, fn, file, line);
 
     /**
      * Register a matrix free. Don't call this function yourself,
@@ -90,7 +115,7 @@ namespace ei {
     #define ei_dsp_register_matrix_free_internal(fn, file, line, rows, cols, type_size) \
         ei_memory_in_use -= (rows * cols * type_size); \
         ei_dsp_printf("free matrix %hu x %hu = %lu bytes (in_use=%lu, peak=%lu) (%s@%s:%d)\n", \
-            rows, cols, rows * cols * type_size, ei_memory_in_use, ei_memory_peak_use, fn, file, line);
+            rows, cols, rows * cols * type_size, (size_t)ei_memory_in_use, (size_t)ei_memory_peak_use, fn, file, line);
 
     #define ei_dsp_register_alloc(...) ei_dsp_register_alloc_internal(__func__, __FILE__, __LINE__, __VA_ARGS__)
     #define ei_dsp_register_matrix_alloc(...) ei_dsp_register_matrix_alloc_internal(__func__, __FILE__, __LINE__, __VA_ARGS__)
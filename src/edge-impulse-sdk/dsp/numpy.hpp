@@ -31,6 +31,7 @@
 #include "config.hpp"
 #include "returntypes.hpp"
 #include "memory.hpp"
+#include "fast_math.hpp"
 #include "dct/fast-dct-fft.h"
 #include "kissfft/kiss_fftr.h"
 #if EIDSP_USE_CMSIS_DSP
@@ -45,12 +46,47 @@
 
 #define EI_MAX_UINT16 65535
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif // M_PI
+
 namespace ei {
 
 // lookup table for quantized values between 0.0f and 1.0f
 static const float quantized_values_one_zero[] = { (0.0f / 1.0f), (1.0f / 100.0f), (2.0f / 100.0f), (3.0f / 100.0f), (4.0f / 100.0f), (1.0f / 22.0f), (1.0f / 21.0f), (1.0f / 20.0f), (1.0f / 19.0f), (1.0f / 18.0f), (1.0f / 17.0f), (6.0f / 100.0f), (1.0f / 16.0f), (1.0f / 15.0f), (7.0f / 100.0f), (1.0f / 14.0f), (1.0f / 13.0f), (8.0f / 100.0f), (1.0f / 12.0f), (9.0f / 100.0f), (1.0f / 11.0f), (2.0f / 21.0f), (1.0f / 10.0f), (2.0f / 19.0f), (11.0f / 100.0f), (1.0f / 9.0f), (2.0f / 17.0f), (12.0f / 100.0f), (1.0f / 8.0f), (13.0f / 100.0f), (2.0f / 15.0f), (3.0f / 22.0f), (14.0f / 100.0f), (1.0f / 7.0f), (3.0f / 20.0f), (2.0f / 13.0f), (3.0f / 19.0f), (16.0f / 100.0f), (1.0f / 6.0f), (17.0f / 100.0f), (3.0f / 17.0f), (18.0f / 100.0f), (2.0f / 11.0f), (3.0f / 16.0f), (19.0f / 100.0f), (4.0f / 21.0f), (1.0f / 5.0f), (21.0f / 100.0f), (4.0f / 19.0f), (3.0f / 14.0f), (22.0f / 100.0f), (2.0f / 9.0f), (5.0f / 22.0f), (23.0f / 100.0f), (3.0f / 13.0f), (4.0f / 17.0f), (5.0f / 21.0f), (24.0f / 100.0f), (1.0f / 4.0f), (26.0f / 100.0f), (5.0f / 19.0f), (4.0f / 15.0f), (27.0f / 100.0f), (3.0f / 11.0f), (5.0f / 18.0f), (28.0f / 100.0f), (2.0f / 7.0f), (29.0f / 100.0f), (5.0f / 17.0f), (3.0f / 10.0f), (4.0f / 13.0f), (31.0f / 100.0f), (5.0f / 16.0f), (6.0f / 19.0f), (7.0f / 22.0f), (32.0f / 100.0f), (33.0f / 100.0f), (1.0f / 3.0f), (34.0f / 100.0f), (7.0f / 20.0f), (6.0f / 17.0f), (5.0f / 14.0f), (36.0f / 100.0f), (4.0f / 11.0f), (7.0f / 19.0f), (37.0f / 100.0f), (3.0f / 8.0f), (38.0f / 100.0f), (8.0f / 21.0f), (5.0f / 13.0f), (7.0f / 18.0f), (39.0f / 100.0f), (2.0f / 5.0f), (9.0f / 22.0f), (41.0f / 100.0f), (7.0f / 17.0f), (5.0f / 12.0f), (42.0f / 100.0f), (8.0f / 19.0f), (3.0f / 7.0f), (43.0f / 100.0f), (7.0f / 16.0f), (44.0f / 100.0f), (4.0f / 9.0f), (9.0f / 20.0f), (5.0f / 11.0f), (46.0f / 100.0f), (6.0f / 13.0f), (7.0f / 15.0f), (47.0f / 100.0f), (8.0f / 17.0f), (9.0f / 19.0f), (10.0f / 21.0f), (48.0f / 100.0f), (49.0f / 100.0f), (1.0f / 2.0f), (51.0f / 100.0f), (52.0f / 100.0f), (11.0f / 21.0f), (10.0f / 19.0f), (9.0f / 17.0f), (53.0f / 100.0f), (8.0f / 15.0f), (7.0f / 13.0f), (54.0f / 100.0f), (6.0f / 11.0f), (11.0f / 20.0f), (5.0f / 9.0f), (56.0f / 100.0f), (9.0f / 16.0f), (57.0f / 100.0f), (4.0f / 7.0f), (11.0f / 19.0f), (58.0f / 100.0f), (7.0f / 12.0f), (10.0f / 17.0f), (59.0f / 100.0f), (13.0f / 22.0f), (3.0f / 5.0f), (61.0f / 100.0f), (11.0f / 18.0f), (8.0f / 13.0f), (13.0f / 21.0f), (62.0f / 100.0f), (5.0f / 8.0f), (63.0f / 100.0f), (12.0f / 19.0f), (7.0f / 11.0f), (64.0f / 100.0f), (9.0f / 14.0f), (11.0f / 17.0f), (13.0f / 20.0f), (66.0f / 100.0f), (2.0f / 3.0f), (67.0f / 100.0f), (68.0f / 100.0f), (15.0f / 22.0f), (13.0f / 19.0f), (11.0f / 16.0f), (69.0f / 100.0f), (9.0f / 13.0f), (7.0f / 10.0f), (12.0f / 17.0f), (71.0f / 100.0f), (5.0f / 7.0f), (72.0f / 100.0f), (13.0f / 18.0f), (8.0f / 11.0f), (73.0f / 100.0f), (11.0f / 15.0f), (14.0f / 19.0f), (74.0f / 100.0f), (3.0f / 4.0f), (76.0f / 100.0f), (16.0f / 21.0f), (13.0f / 17.0f), (10.0f / 13.0f), (77.0f / 100.0f), (17.0f / 22.0f), (7.0f / 9.0f), (78.0f / 100.0f), (11.0f / 14.0f), (15.0f / 19.0f), (79.0f / 100.0f), (4.0f / 5.0f), (17.0f / 21.0f), (81.0f / 100.0f), (13.0f / 16.0f), (9.0f / 11.0f), (82.0f / 100.0f), (14.0f / 17.0f), (83.0f / 100.0f), (5.0f / 6.0f), (84.0f / 100.0f), (16.0f / 19.0f), (11.0f / 13.0f), (17.0f / 20.0f), (6.0f / 7.0f), (86.0f / 100.0f), (19.0f / 22.0f), (13.0f / 15.0f), (87.0f / 100.0f), (7.0f / 8.0f), (88.0f / 100.0f), (15.0f / 17.0f), (8.0f / 9.0f), (89.0f / 100.0f), (17.0f / 19.0f), (9.0f / 10.0f), (19.0f / 21.0f), (10.0f / 11.0f), (91.0f / 100.0f), (11.0f / 12.0f), (92.0f / 100.0f), (12.0f / 13.0f), (13.0f / 14.0f), (93.0f / 100.0f), (14.0f / 15.0f), (15.0f / 16.0f), (94.0f / 100.0f), (16.0f / 17.0f), (17.0f / 18.0f), (18.0f / 19.0f), (19.0f / 20.0f), (20.0f / 21.0f), (21.0f / 22.0f), (96.0f / 100.0f), (97.0f / 100.0f), (98.0f / 100.0f), (99.0f / 100.0f), (1.0f / 1.0f) ,
     1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
 
+/**
+ * Precomputed state (twiddle factors) for a real FFT of a fixed length.
+ * Get a shared one through `numpy::get_fft_plan`, or own one through
+ * `numpy::create_fft_plan` / `numpy::free_fft_plan`.
+ */
+typedef struct ei_fft_plan {
+    size_t n_fft;
+    kiss_fftr_cfg kiss_cfg;         // NULL when CMSIS-DSP handles this length
+    size_t kiss_cfg_size;
+#if EIDSP_USE_CMSIS_DSP
+    arm_rfft_fast_instance_f32 rfft_instance;
+#endif
+} fft_plan_t;
+
+/**
+ * Precomputed state for a q31 real FFT of a fixed (power of two) length.
+ * Build with `numpy::create_rfft_q31_plan`, release with `numpy::free_rfft_q31_plan`.
+ */
+typedef struct ei_rfft_q31_plan {
+    size_t n_fft;
+    uint8_t n_fft_bits;             // log2(n_fft)
+#if EIDSP_USE_CMSIS_DSP
+    arm_rfft_instance_q31 rfft_instance;
+#else
+    int32_t *twiddles;              // n_fft / 2 (cos, -sin) pairs in q31
+#endif
+} rfft_q31_plan_t;
+
+// log2(1 + i / 32) in q16, used by numpy::log2_q16
+static const int32_t log2_q16_table[] = { 0, 2909, 5732, 8473, 11136, 13727, 16248, 18704, 21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346, 38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207, 52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047, 65536 };
+
 class numpy {
 public:
     /**
@@ -420,6 +456,71 @@ public:
         return EIDSP_OK;
     }
 
+    /**
+     * Return the Discrete Cosine Transform of arbitrary type sequence 2,
+     * using a prebuilt FFT plan and caller-owned scratch, does not allocate.
+     * @param plan FFT plan for N points
+     * @param input Input array (of size N)
+     * @param N number of items in input and output array
+     * @param scratch Buffer of `dct2_scratch_size(N)` floats
+     * @returns EIDSP_OK if OK
+     */
+    static int dct2(const fft_plan_t *plan, float *input, size_t N, DCT_NORMALIZATION_MODE normalization,
+        float *scratch)
+    {
+        if (N == 0) {
+            return EIDSP_OK;
+        }
+
+        int ret = ei::dct::transform(input, N, plan, scratch);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        // for some reason the output is 2x too low...
+        for (size_t ix = 0; ix < N; ix++) {
+            input[ix] *= 2;
+        }
+
+        if (normalization == DCT_NORMALIZATION_ORTHO) {
+            input[0] = input[0] * sqrt(1.0f / static_cast<float>(4 * N));
+            for (size_t ix = 1; ix < N; ix++) {
+                input[ix] = input[ix] * sqrt(1.0f / static_cast<float>(2 * N));
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Discrete Cosine Transform of arbitrary type sequence 2 on every row of a matrix,
+     * using a prebuilt FFT plan (for matrix->cols points) and caller-owned scratch.
+     * @param plan FFT plan for matrix->cols points
+     * @param matrix
+     * @param scratch Buffer of `dct2_scratch_size(matrix->cols)` floats
+     * @returns EIDSP_OK if OK
+     */
+    static int dct2(const fft_plan_t *plan, matrix_t *matrix, DCT_NORMALIZATION_MODE normalization,
+        float *scratch)
+    {
+        for (size_t row = 0; row < matrix->rows; row++) {
+            int r = dct2(plan, matrix->buffer + (row * matrix->cols), matrix->cols, normalization, scratch);
+            if (r != EIDSP_OK) {
+                return r;
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Number of floats of scratch the plan based `dct2` needs.
+     * @param N number of items in the DCT
+     */
+    static size_t dct2_scratch_size(size_t N) {
+        return N + ((N / 2) + 1) * 2 + rfft_scratch_size(N);
+    }
+
     /**
      * Discrete Cosine Transform of arbitrary type sequence 2 on a matrix.
      * @param matrix
@@ -486,6 +587,23 @@ public:
         return quantized_values_one_zero[value];
     }
 
+    /**
+     * Quantize a float value to int8 (affine quantization, saturated)
+     * @param value Float value
+     * @param inverse_scale 1 / scale of the quantized tensor
+     * @param zero_point Zero point of the quantized tensor
+     */
+    static inline int8_t quantize_int8(float value, float inverse_scale, int32_t zero_point) {
+        int32_t q = static_cast<int32_t>(round(value * inverse_scale)) + zero_point;
+        if (q > 127) {
+            return 127;
+        }
+        if (q < -128) {
+            return -128;
+        }
+        return static_cast<int8_t>(q);
+    }
+
     /**
      * Pad an array.
      * Pads with the reflection of the vector mirrored along the edge of the array.
@@ -1076,16 +1194,151 @@ public:
     }
 
     /**
-     * Compute the one-dimensional discrete Fourier Transform for real input.
-     * This function computes the one-dimensional n-point discrete Fourier Transform (DFT) of
-     * a real-valued array by means of an efficient algorithm called the Fast Fourier Transform (FFT).
+     * Build an FFT plan for a real FFT of n_fft points.
+     * Lengths CMSIS-DSP supports (powers of two between 32 and 4096) use its fast rfft,
+     * all others (and all lengths without CMSIS-DSP) use KissFFT.
+     * @param plan Plan to fill, release with `free_fft_plan`
+     * @param n_fft Number of points
+     * @returns EIDSP_OK if OK
+     */
+    static int create_fft_plan(fft_plan_t *plan, size_t n_fft) {
+        memset(plan, 0, sizeof(fft_plan_t));
+
+#if EIDSP_USE_CMSIS_DSP
+        if (n_fft == 32 || n_fft == 64 || n_fft == 128 || n_fft == 256 ||
+            n_fft == 512 || n_fft == 1024 || n_fft == 2048 || n_fft == 4096) {
+            arm_status status = arm_rfft_fast_init_f32(&plan->rfft_instance, n_fft);
+            if (status != ARM_MATH_SUCCESS) {
+                return status;
+            }
+            plan->n_fft = n_fft;
+            return EIDSP_OK;
+        }
+#endif
+
+        size_t kiss_fftr_mem_length;
+
+        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
+        if (!cfg) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        ei_dsp_register_alloc(kiss_fftr_mem_length);
+
+        plan->n_fft = n_fft;
+        plan->kiss_cfg = cfg;
+        plan->kiss_cfg_size = kiss_fftr_mem_length;
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release an FFT plan created through `create_fft_plan`
+     * @param plan
+     */
+    static void free_fft_plan(fft_plan_t *plan) {
+        if (plan->kiss_cfg) {
+            ei_dsp_free(plan->kiss_cfg, plan->kiss_cfg_size);
+        }
+        memset(plan, 0, sizeof(fft_plan_t));
+    }
+
+    /**
+     * Get the shared FFT plan for n_fft points, built on first use.
+     * Plans stay alive until `free_fft_plans` is called.
+     * @param n_fft Number of points
+     * @returns The plan, or NULL if the cache (EIDSP_FFT_PLAN_CACHE_SIZE) is full or out of memory
+     */
+    static const fft_plan_t *get_fft_plan(size_t n_fft) {
+        fft_plan_t *cache = fft_plan_cache();
+
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (cache[ix].n_fft == n_fft) {
+                return &cache[ix];
+            }
+        }
+
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (cache[ix].n_fft == 0) {
+                if (create_fft_plan(&cache[ix], n_fft) != EIDSP_OK) {
+                    return NULL;
+                }
+                return &cache[ix];
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * Release all shared FFT plans. Pointers returned by `get_fft_plan` become invalid.
+     */
+    static void free_fft_plans() {
+        fft_plan_t *cache = fft_plan_cache();
+
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (cache[ix].n_fft != 0) {
+                free_fft_plan(&cache[ix]);
+            }
+        }
+    }
+
+    /**
+     * Get the shared FFT plan for n_fft points, or build a temporary one
+     * if the cache is full. Release with `release_fft_plan`.
+     * @param n_fft Number of points
+     * @param temp_plan Storage for the temporary plan
+     * @param plan Out: plan to use
+     * @returns EIDSP_OK if OK
+     */
+    static int acquire_fft_plan(size_t n_fft, fft_plan_t *temp_plan, const fft_plan_t **plan) {
+        *plan = get_fft_plan(n_fft);
+        if (*plan) {
+            return EIDSP_OK;
+        }
+
+        int ret = create_fft_plan(temp_plan, n_fft);
+        if (ret != EIDSP_OK) {
+            return ret;
+        }
+
+        *plan = temp_plan;
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release a plan returned by `acquire_fft_plan`
+     */
+    static void release_fft_plan(fft_plan_t *temp_plan, const fft_plan_t *plan) {
+        if (plan == temp_plan) {
+            free_fft_plan(temp_plan);
+        }
+    }
+
+    /**
+     * Number of floats of scratch the plan based `rfft` needs.
+     * @param n_fft Number of points
+     */
+    static size_t rfft_scratch_size(size_t n_fft) {
+        // zero-padded input + (n_fft / 2 + 1) complex outputs
+        return n_fft + n_fft + 2;
+    }
+
+    /**
+     * Compute the one-dimensional discrete Fourier Transform for real input,
+     * using a prebuilt plan and caller-owned scratch, does not allocate.
+     * @param plan FFT plan
      * @param src Source buffer
      * @param src_size Size of the source buffer
-     * @param output Output buffer
+     * @param output Output buffer (magnitude per bin)
      * @param output_size Size of the output buffer, should be n_fft / 2 + 1
+     * @param scratch Buffer of `rfft_scratch_size(n_fft)` floats
      * @returns 0 if OK
      */
-    static int rfft(const float *src, size_t src_size, float *output, size_t output_size, size_t n_fft) {
+    static int rfft(const fft_plan_t *plan, const float *src, size_t src_size, float *output, size_t output_size,
+        float *scratch)
+    {
+        const size_t n_fft = plan->n_fft;
         size_t n_fft_out_features = (n_fft / 2) + 1;
         if (output_size != n_fft_out_features) {
             EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
@@ -1096,58 +1349,147 @@ public:
             src_size = n_fft;
         }
 
-        // declare input and output arrays
-        EI_DSP_MATRIX(fft_input, 1, n_fft);
-        if (!fft_input.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
+        float *fft_input = scratch;
+        float *fft_output = scratch + n_fft;
 
         // copy from src to fft_input
-        memcpy(fft_input.buffer, src, src_size * sizeof(float));
+        memcpy(fft_input, src, src_size * sizeof(float));
         // pad to the rigth with zeros
-        memset(fft_input.buffer + src_size, 0, (n_fft - src_size) * sizeof(kiss_fft_scalar));
+        memset(fft_input + src_size, 0, (n_fft - src_size) * sizeof(float));
 
 #if EIDSP_USE_CMSIS_DSP
-        if (n_fft != 32 && n_fft != 64 && n_fft != 128 && n_fft != 256 &&
-            n_fft != 512 && n_fft != 1024 && n_fft != 2048 && n_fft != 4096) {
-            int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
-            if (ret != EIDSP_OK) {
-                EIDSP_ERR(ret);
+        if (!plan->kiss_cfg) {
+            // hardware acceleration only works for the powers of two
+            arm_rfft_fast_f32(&plan->rfft_instance, fft_input, fft_output, 0);
+
+            output[0] = fft_output[0];
+            output[n_fft_out_features - 1] = fft_output[1];
+
+            size_t fft_output_buffer_ix = 2;
+            for (size_t ix = 1; ix < n_fft_out_features - 1; ix += 1) {
+                float rms_result;
+                arm_rms_f32(fft_output + fft_output_buffer_ix, 2, &rms_result);
+                output[ix] = rms_result * sqrt(2);
+
+                fft_output_buffer_ix += 2;
             }
+
+            return EIDSP_OK;
         }
-        else {
-            // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            arm_status status = arm_rfft_fast_init_f32(&rfft_instance, n_fft);
-            if (status != ARM_MATH_SUCCESS) {
-                return status;
-            }
+#endif
 
-            EI_DSP_MATRIX(fft_output, 1, n_fft);
-            if (!fft_output.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
-            }
+        kiss_fft_cpx *kiss_output = (kiss_fft_cpx*)fft_output;
+
+        // execute the rfft operation
+        kiss_fftr(plan->kiss_cfg, fft_input, kiss_output);
+
+        // and write back to the output
+        for (size_t ix = 0; ix < n_fft_out_features; ix++) {
+            output[ix] = sqrt(pow(kiss_output[ix].r, 2) + pow(kiss_output[ix].i, 2));
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Compute the one-dimensional discrete Fourier Transform for real input,
+     * using a prebuilt plan and caller-owned scratch, does not allocate.
+     * @param plan FFT plan
+     * @param src Source buffer
+     * @param src_size Size of the source buffer
+     * @param output Output buffer
+     * @param output_size Size of the output buffer, should be n_fft / 2 + 1
+     * @param scratch Buffer of `rfft_scratch_size(n_fft)` floats
+     * @returns 0 if OK
+     */
+    static int rfft(const fft_plan_t *plan, const float *src, size_t src_size, fft_complex_t *output,
+        size_t output_size, float *scratch)
+    {
+        const size_t n_fft = plan->n_fft;
+        size_t n_fft_out_features = (n_fft / 2) + 1;
+        if (output_size != n_fft_out_features) {
+            EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+        }
+
+        // truncate if needed
+        if (src_size > n_fft) {
+            src_size = n_fft;
+        }
+
+        // always copy, the CMSIS-DSP rfft overwrites its input
+        float *fft_input = scratch;
+
+        // copy from src to fft_input
+        memcpy(fft_input, src, src_size * sizeof(float));
+        // pad to the rigth with zeros
+        memset(fft_input + src_size, 0, (n_fft - src_size) * sizeof(float));
 
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
+#if EIDSP_USE_CMSIS_DSP
+        if (!plan->kiss_cfg) {
+            float *fft_output = scratch + n_fft;
 
-            output[0] = fft_output.buffer[0];
-            output[n_fft_out_features - 1] = fft_output.buffer[1];
+            arm_rfft_fast_f32(&plan->rfft_instance, fft_input, fft_output, 0);
+
+            output[0].r = fft_output[0];
+            output[0].i = 0.0f;
+            output[n_fft_out_features - 1].r = fft_output[1];
+            output[n_fft_out_features - 1].i = 0.0f;
 
             size_t fft_output_buffer_ix = 2;
             for (size_t ix = 1; ix < n_fft_out_features - 1; ix += 1) {
-                float rms_result;
-                arm_rms_f32(fft_output.buffer + fft_output_buffer_ix, 2, &rms_result);
-                output[ix] = rms_result * sqrt(2);
+                output[ix].r = fft_output[fft_output_buffer_ix];
+                output[ix].i = fft_output[fft_output_buffer_ix + 1];
 
                 fft_output_buffer_ix += 2;
             }
+
+            return EIDSP_OK;
         }
-#else
-        int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
+#endif
+
+        // execute the rfft operation
+        kiss_fftr(plan->kiss_cfg, fft_input, (kiss_fft_cpx*)output);
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Compute the one-dimensional discrete Fourier Transform for real input.
+     * This function computes the one-dimensional n-point discrete Fourier Transform (DFT) of
+     * a real-valued array by means of an efficient algorithm called the Fast Fourier Transform (FFT).
+     * Uses the shared plan for n_fft, use the overload that takes a plan and scratch
+     * to avoid the scratch allocation.
+     * @param src Source buffer
+     * @param src_size Size of the source buffer
+     * @param output Output buffer
+     * @param output_size Size of the output buffer, should be n_fft / 2 + 1
+     * @returns 0 if OK
+     */
+    static int rfft(const float *src, size_t src_size, float *output, size_t output_size, size_t n_fft) {
+        size_t n_fft_out_features = (n_fft / 2) + 1;
+        if (output_size != n_fft_out_features) {
+            EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+        }
+
+        const size_t scratch_size = rfft_scratch_size(n_fft) * sizeof(float);
+        float *scratch = (float*)ei_dsp_malloc(scratch_size);
+        if (!scratch) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        fft_plan_t temp_plan;
+        const fft_plan_t *plan;
+        int ret = acquire_fft_plan(n_fft, &temp_plan, &plan);
+        if (ret == EIDSP_OK) {
+            ret = rfft(plan, src, src_size, output, output_size, scratch);
+            release_fft_plan(&temp_plan, plan);
+        }
+
+        ei_dsp_free(scratch, scratch_size);
+
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
-#endif
 
         return EIDSP_OK;
     }
@@ -1156,6 +1498,8 @@ public:
      * Compute the one-dimensional discrete Fourier Transform for real input.
      * This function computes the one-dimensional n-point discrete Fourier Transform (DFT) of
      * a real-valued array by means of an efficient algorithm called the Fast Fourier Transform (FFT).
+     * Uses the shared plan for n_fft, use the overload that takes a plan and scratch
+     * to avoid the scratch allocation.
      * @param src Source buffer
      * @param src_size Size of the source buffer
      * @param output Output buffer
@@ -1168,75 +1512,196 @@ public:
             EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
         }
 
-        // truncate if needed
-        if (src_size > n_fft) {
-            src_size = n_fft;
+        const size_t scratch_size = rfft_scratch_size(n_fft) * sizeof(float);
+        float *scratch = (float*)ei_dsp_malloc(scratch_size);
+        if (!scratch) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        fft_plan_t temp_plan;
+        const fft_plan_t *plan;
+        int ret = acquire_fft_plan(n_fft, &temp_plan, &plan);
+        if (ret == EIDSP_OK) {
+            ret = rfft(plan, src, src_size, output, output_size, scratch);
+            release_fft_plan(&temp_plan, plan);
+        }
+
+        ei_dsp_free(scratch, scratch_size);
+
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
-        // declare input and output arrays
-        float *fft_input_buffer = NULL;
-        if (src_size == n_fft) {
-            fft_input_buffer = (float*)src;
+        return EIDSP_OK;
+    }
+
+    /**
+     * Build a plan for a q31 real FFT.
+     * @param plan Plan to fill, release with `free_rfft_q31_plan`
+     * @param n_fft Number of points, a power of two between 32 and 4096
+     * @returns EIDSP_OK if OK
+     */
+    static int create_rfft_q31_plan(rfft_q31_plan_t *plan, size_t n_fft) {
+        memset(plan, 0, sizeof(rfft_q31_plan_t));
+
+        uint8_t n_fft_bits = 0;
+        while ((static_cast<size_t>(1) << n_fft_bits) < n_fft) {
+            n_fft_bits++;
+        }
+        if ((static_cast<size_t>(1) << n_fft_bits) != n_fft || n_fft < 32 || n_fft > 4096) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
         }
 
-        EI_DSP_MATRIX_B(fft_input, 1, n_fft, fft_input_buffer);
-        if (!fft_input.buffer) {
+#if EIDSP_USE_CMSIS_DSP
+        arm_status status = arm_rfft_init_q31(&plan->rfft_instance, n_fft, 0, 1);
+        if (status != ARM_MATH_SUCCESS) {
+            return status;
+        }
+#else
+        const size_t twiddles_size = n_fft * sizeof(int32_t);
+        plan->twiddles = (int32_t*)ei_dsp_malloc(twiddles_size);
+        if (!plan->twiddles) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        if (!fft_input_buffer) {
-            // copy from src to fft_input
-            memcpy(fft_input.buffer, src, src_size * sizeof(float));
-            // pad to the rigth with zeros
-            memset(fft_input.buffer + src_size, 0, (n_fft - src_size) * sizeof(float));
+        for (size_t ix = 0; ix < n_fft / 2; ix++) {
+            double phase = 2.0 * M_PI * static_cast<double>(ix) / static_cast<double>(n_fft);
+            plan->twiddles[ix * 2] = saturate_q31(round(cos(phase) * 2147483648.0));
+            plan->twiddles[ix * 2 + 1] = saturate_q31(round(-sin(phase) * 2147483648.0));
         }
+#endif
+
+        plan->n_fft = n_fft;
+        plan->n_fft_bits = n_fft_bits;
 
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release a plan created through `create_rfft_q31_plan`
+     * @param plan
+     */
+    static void free_rfft_q31_plan(rfft_q31_plan_t *plan) {
+#if !EIDSP_USE_CMSIS_DSP
+        if (plan->twiddles) {
+            ei_dsp_free(plan->twiddles, plan->n_fft * sizeof(int32_t));
+        }
+#endif
+        memset(plan, 0, sizeof(rfft_q31_plan_t));
+    }
+
+    /**
+     * Real FFT in q31. To avoid overflow the result is scaled down by n_fft,
+     * so output bin k holds DFT(input)[k] / n_fft (the same format arm_rfft_q31 uses).
+     * The host checks only run the portable version, the CMSIS-DSP sources shipped
+     * with the SDK come without the q31 twiddle tables (the target's CMSIS-DSP
+     * library has them).
+     * @param plan q31 FFT plan
+     * @param input n_fft q31 samples, used as scratch (overwritten)
+     * @param output 2 * n_fft q31 values, interleaved real / imaginary. Bins 0..n_fft/2 are valid.
+     * @returns EIDSP_OK if OK
+     */
+    static int rfft_q31(const rfft_q31_plan_t *plan, int32_t *input, int32_t *output) {
 #if EIDSP_USE_CMSIS_DSP
-        if (n_fft != 32 && n_fft != 64 && n_fft != 128 && n_fft != 256 &&
-            n_fft != 512 && n_fft != 1024 && n_fft != 2048 && n_fft != 4096) {
-            int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
-            if (ret != EIDSP_OK) {
-                EIDSP_ERR(ret);
+        arm_rfft_q31(&plan->rfft_instance, input, output);
+#else
+        const size_t n_fft = plan->n_fft;
+
+        // bit reversed copy of the (real) input into the complex output
+        for (size_t ix = 0; ix < n_fft; ix++) {
+            size_t rev = 0;
+            for (uint8_t bit = 0; bit < plan->n_fft_bits; bit++) {
+                rev |= ((ix >> bit) & 1) << (plan->n_fft_bits - 1 - bit);
             }
+            output[rev * 2] = input[ix];
+            output[rev * 2 + 1] = 0;
         }
-        else {
-            // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            arm_status status = arm_rfft_fast_init_f32(&rfft_instance, n_fft);
-            if (status != ARM_MATH_SUCCESS) {
-                return status;
-            }
 
-            EI_DSP_MATRIX(fft_output, 1, n_fft);
-            if (!fft_output.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
-            }
+        // radix-2 butterflies, halving after every stage keeps the values in range
+        for (size_t len = 2; len <= n_fft; len <<= 1) {
+            size_t half = len >> 1;
+            size_t twiddle_step = n_fft / len;
 
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
+            for (size_t start = 0; start < n_fft; start += len) {
+                for (size_t ix = 0; ix < half; ix++) {
+                    int64_t w_re = plan->twiddles[ix * twiddle_step * 2];
+                    int64_t w_im = plan->twiddles[ix * twiddle_step * 2 + 1];
 
-            output[0].r = fft_output.buffer[0];
-            output[0].i = 0.0f;
-            output[n_fft_out_features - 1].r = fft_output.buffer[1];
-            output[n_fft_out_features - 1].i = 0.0f;
+                    int32_t *a = output + ((start + ix) * 2);
+                    int32_t *b = output + ((start + ix + half) * 2);
 
-            size_t fft_output_buffer_ix = 2;
-            for (size_t ix = 1; ix < n_fft_out_features - 1; ix += 1) {
-                output[ix].r = fft_output.buffer[fft_output_buffer_ix];
-                output[ix].i = fft_output.buffer[fft_output_buffer_ix + 1];
+                    int64_t b_re = ((b[0] * w_re) - (b[1] * w_im) + (1LL << 30)) >> 31;
+                    int64_t b_im = ((b[0] * w_im) + (b[1] * w_re) + (1LL << 30)) >> 31;
 
-                fft_output_buffer_ix += 2;
+                    int64_t a_re = a[0];
+                    int64_t a_im = a[1];
+
+                    a[0] = saturate_q31((a_re + b_re) >> 1);
+                    a[1] = saturate_q31((a_im + b_im) >> 1);
+                    b[0] = saturate_q31((a_re - b_re) >> 1);
+                    b[1] = saturate_q31((a_im - b_im) >> 1);
+                }
             }
         }
-#else
-        int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
-        if (ret != EIDSP_OK) {
-            EIDSP_ERR(ret);
-        }
 #endif
 
         return EIDSP_OK;
     }
 
+    /**
+     * Base 2 logarithm in fixed point, table based (max. error about 2e-4).
+     * @param value Input number, must be > 0
+     * @returns log2(value) in q16 (16 fractional bits)
+     */
+    static int32_t log2_q16(uint64_t value) {
+        // integer part is the position of the highest set bit
+        int32_t msb = 0;
+        for (int32_t step = 32; step > 0; step >>= 1) {
+            if (value >> (msb + step)) {
+                msb += step;
+            }
+        }
+
+        // mantissa in [1, 2) with 30 fractional bits
+        uint32_t mantissa = msb >= 30 ?
+            static_cast<uint32_t>(value >> (msb - 30)) :
+            static_cast<uint32_t>(value << (30 - msb));
+        uint32_t fraction = mantissa - (1UL << 30);
+        uint32_t index = fraction >> 25;
+        int32_t interpolate = (fraction >> 9) & 0xffff;
+
+        int32_t table_value = log2_q16_table[index] +
+            (((log2_q16_table[index + 1] - log2_q16_table[index]) * interpolate) >> 16);
+
+        return (msb << 16) + table_value;
+    }
+
+    /**
+     * Saturate a value to the q15 range
+     */
+    static inline int16_t saturate_q15(int32_t value) {
+        if (value > 32767) {
+            return 32767;
+        }
+        if (value < -32768) {
+            return -32768;
+        }
+        return static_cast<int16_t>(value);
+    }
+
+    /**
+     * Saturate a value to the q31 range
+     */
+    static inline int32_t saturate_q31(int64_t value) {
+        if (value > 2147483647LL) {
+            return 2147483647;
+        }
+        if (value < -2147483648LL) {
+            return -2147483647 - 1;
+        }
+        return static_cast<int32_t>(value);
+    }
+
     /**
      * Return evenly spaced numbers over a specified interval.
      * Returns num evenly spaced samples, calculated over the interval [start, stop].
@@ -1336,54 +1801,27 @@ public:
     }
 #endif
 
-#if defined ( __GNUC__ )
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wstrict-aliasing"
-#endif
     /**
      * > 50% faster then the math.h log() function
-     * in return for a small loss in accuracy (0.00001 average diff with log())
-     * From: https://stackoverflow.com/questions/39821367/very-fast-approximate-logarithm-natural-log-function-in-c/39822314#39822314
-     * Licensed under the CC BY-SA 3.0
+     * in return for a small loss in accuracy (0.00001 average diff with log()),
+     * see fast_math::log
      * @param a Input number
      * @returns Natural log value of a
      */
     __attribute__((always_inline)) static inline float log(float a)
     {
-        float m, r, s, t, i, f;
-        int32_t e, g;
-
-        g = (int32_t) * ((int32_t *)&a);
-        e = (g - 0x3f2aaaab) & 0xff800000;
-        g = g - e;
-        m = (float) * ((float *)&g);
-        i = (float)e * 1.19209290e-7f; // 0x1.0p-23
-        /* m in [2/3, 4/3] */
-        f = m - 1.0f;
-        s = f * f;
-        /* Compute log1p(f) for f in [-1/3, 1/3] */
-        r = fmaf(0.230836749f, f, -0.279208571f); // 0x1.d8c0f0p-3, -0x1.1de8dap-2
-        t = fmaf(0.331826031f, f, -0.498910338f); // 0x1.53ca34p-2, -0x1.fee25ap-2
-        r = fmaf(r, s, t);
-        r = fmaf(r, s, f);
-        r = fmaf(i, 0.693147182f, r); // 0x1.62e430p-1 // log(2)
-
-        return r;
-    }
-#if defined ( __GNUC__ )
-#pragma GCC diagnostic pop
-#endif
+        return fast_math::log(a);
+    }
 
     /**
      * Calculate the natural log value of a matrix. Does an in-place replacement.
+     * Vectorized with EIDSP_USE_FAST_MATH.
      * @param matrix Matrix (MxN)
      * @returns 0 if OK
      */
     static int log(matrix_t *matrix)
     {
-        for (uint32_t ix = 0; ix < matrix->rows * matrix->cols; ix++) {
-            matrix->buffer[ix] = numpy::log(matrix->buffer[ix]);
-        }
+        fast_math::log(matrix->buffer, matrix->buffer, matrix->rows * matrix->cols);
 
         return EIDSP_OK;
     }
@@ -1434,55 +1872,9 @@ public:
     }
 
 private:
-    static int software_rfft(float *fft_input, float *output, size_t n_fft, size_t n_fft_out_features) {
-        kiss_fft_cpx *fft_output = (kiss_fft_cpx*)ei_dsp_malloc(n_fft_out_features * sizeof(kiss_fft_cpx));
-        if (!fft_output) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-
-        size_t kiss_fftr_mem_length;
-
-        // create fftr context
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
-        if (!cfg) {
-            ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-
-        ei_dsp_register_alloc(kiss_fftr_mem_length);
-
-        // execute the rfft operation
-        kiss_fftr(cfg, fft_input, fft_output);
-
-        // and write back to the output
-        for (size_t ix = 0; ix < n_fft_out_features; ix++) {
-            output[ix] = sqrt(pow(fft_output[ix].r, 2) + pow(fft_output[ix].i, 2));
-        }
-
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
-        ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
-
-        return EIDSP_OK;
-    }
-
-    static int software_rfft(float *fft_input, fft_complex_t *output, size_t n_fft, size_t n_fft_out_features)
-    {
-        // create fftr context
-        size_t kiss_fftr_mem_length;
-
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
-        if (!cfg) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-
-        ei_dsp_register_alloc(kiss_fftr_mem_length);
-
-        // execute the rfft operation
-        kiss_fftr(cfg, fft_input, (kiss_fft_cpx*)output);
-
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
-
-        return EIDSP_OK;
+    static fft_plan_t *fft_plan_cache() {
+        static EIDSP_THREAD_LOCAL fft_plan_t cache[EIDSP_FFT_PLAN_CACHE_SIZE];
+        return cache;
     }
 
     static int signal_get_data(float *in_buffer, size_t offset, size_t length, float *out_ptr)
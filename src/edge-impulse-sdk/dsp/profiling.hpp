@@ -0,0 +1,101 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_PROFILING_H_
+#define _EIDSP_PROFILING_H_
+
+#include <stdint.h>
+#include "config.hpp"
+#include "../porting/ei_classifier_porting.h"
+
+/**
+ * Stages of the audio front ends. Stages nest where the code does: framing
+ * includes reading the signal, and with that the pre-emphasis.
+ */
+typedef enum {
+    EI_DSP_STAGE_PREEMPHASIS = 0,
+    EI_DSP_STAGE_FRAMING,
+    EI_DSP_STAGE_FFT,               /* FFT and power spectrum */
+    EI_DSP_STAGE_FILTERBANK,
+    EI_DSP_STAGE_LOG,
+    EI_DSP_STAGE_DCT,
+    EI_DSP_STAGE_CMVN,
+    EI_DSP_STAGE_COUNT
+} ei_dsp_stage_t;
+
+/**
+ * Time spent in a profiled section, summed since the last reset. A section
+ * that runs once per frame counts one call per frame.
+ */
+typedef struct {
+    uint32_t calls;
+    uint32_t max_us;
+    uint64_t total_us;
+} ei_profile_counter_t;
+
+static inline void ei_profile_counter_add(ei_profile_counter_t *counter, uint64_t us) {
+    counter->calls++;
+    counter->total_us += us;
+    if (us > counter->max_us) {
+        counter->max_us = static_cast<uint32_t>(us);
+    }
+}
+
+#if EIDSP_PROFILING == 1
+
+/* Stage timings of the calling thread, indexed by ei_dsp_stage_t */
+extern EIDSP_THREAD_LOCAL ei_profile_counter_t ei_dsp_stage_counters[EI_DSP_STAGE_COUNT];
+
+namespace ei {
+
+class dsp_profile_scope {
+public:
+    dsp_profile_scope(ei_dsp_stage_t stage) : _stage(stage), _start(ei_read_timer_us()) { }
+    ~dsp_profile_scope() {
+        ei_profile_counter_add(&ei_dsp_stage_counters[_stage], ei_read_timer_us() - _start);
+    }
+
+private:
+    ei_dsp_stage_t _stage;
+    uint64_t _start;
+};
+
+} // namespace ei
+
+/**
+ * Time the code between EIDSP_PROFILE_BEGIN(stage) and EIDSP_PROFILE_END(stage),
+ * both in the same scope, or from EIDSP_PROFILE_SCOPE(stage) to the end of the
+ * scope. Compiled out without EIDSP_PROFILING.
+ */
+#define EIDSP_PROFILE_BEGIN(stage) \
+    const uint64_t eidsp_profile_start_##stage = ei_read_timer_us()
+#define EIDSP_PROFILE_END(stage) \
+    ei_profile_counter_add(&ei_dsp_stage_counters[stage], ei_read_timer_us() - eidsp_profile_start_##stage)
+#define EIDSP_PROFILE_SCOPE(stage) \
+    ei::dsp_profile_scope eidsp_profile_scope_##stage(stage)
+#else
+#define EIDSP_PROFILE_BEGIN(stage) (void)0
+#define EIDSP_PROFILE_END(stage) (void)0
+#define EIDSP_PROFILE_SCOPE(stage) (void)0
+#endif // EIDSP_PROFILING == 1
+
+#endif // _EIDSP_PROFILING_H_
@@ -0,0 +1,300 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_RING_BUFFER_H_
+#define _EIDSP_RING_BUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "numpy.hpp"
+
+namespace ei {
+
+/**
+ * Single producer / single consumer ring buffer for int16 audio.
+ *
+ * The producer (a microphone interrupt, or an ALSA / file reader thread on Linux)
+ * calls write() or write_span() + commit(). The consumer (the inference loop)
+ * waits for available() to reach a slice, classifies it straight from the ring
+ * through get_signal() and then calls consume(). Neither side ever blocks or
+ * takes a lock: the producer only moves the head, the consumer only moves the
+ * tail, and both are plain atomic loads and stores (no read-modify-write), so
+ * this also works on cores without LDREX/STREX such as the Cortex-M0.
+ *
+ * When the consumer falls behind, new samples that don't fit are dropped and
+ * counted (get_overrun_count / get_dropped_samples), samples the consumer has
+ * not released are never overwritten.
+ */
+class audio_ring_buffer {
+public:
+    audio_ring_buffer()
+        : _buffer(NULL), _size(0), _buffer_managed_by_me(false),
+          _head(0), _tail(0), _overrun_count(0), _dropped_samples(0)
+    {
+    }
+
+    ~audio_ring_buffer() {
+        deinit();
+    }
+
+    /**
+     * Set up the ring buffer, not safe while a producer is running
+     * @param capacity Number of samples the ring can hold
+     * @param buffer Storage of (capacity + 1) samples, if not provided we'll alloc on the heap
+     * @returns EIDSP_OK if OK
+     */
+    int init(size_t capacity, int16_t *buffer = NULL) {
+        deinit();
+
+        if (capacity == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        // one slot stays empty, so a full ring can be told apart from an empty one
+        _size = capacity + 1;
+        if (buffer) {
+            _buffer = buffer;
+            _buffer_managed_by_me = false;
+        }
+        else {
+            _buffer = (int16_t*)ei_dsp_calloc(_size, sizeof(int16_t));
+            if (!_buffer) {
+                _size = 0;
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
+            _buffer_managed_by_me = true;
+        }
+
+        reset();
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release the buffer (if we allocated it)
+     */
+    void deinit() {
+        if (_buffer && _buffer_managed_by_me) {
+            ei_dsp_free(_buffer, _size * sizeof(int16_t));
+        }
+        _buffer = NULL;
+        _size = 0;
+        _buffer_managed_by_me = false;
+    }
+
+    /**
+     * Drop all samples and clear the overrun counters, not safe while a producer is running
+     */
+    void reset() {
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _overrun_count.store(0, std::memory_order_relaxed);
+        _dropped_samples.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return _size > 0 ? _size - 1 : 0;
+    }
+
+    /* Producer side --------------------------------------------------------- */
+
+    /**
+     * Copy samples into the ring (producer only)
+     * @param samples Samples
+     * @param count Number of samples
+     * @returns Number of samples written, the rest was dropped
+     */
+    size_t write(const int16_t *samples, size_t count) {
+        size_t written = 0;
+
+        while (written < count) {
+            int16_t *span;
+            size_t span_size = write_span(&span);
+            if (span_size == 0) {
+                break;
+            }
+            if (span_size > count - written) {
+                span_size = count - written;
+            }
+            memcpy(span, samples + written, span_size * sizeof(int16_t));
+            commit(span_size);
+            written += span_size;
+        }
+
+        if (written < count) {
+            mark_overrun(count - written);
+        }
+        return written;
+    }
+
+    /**
+     * Get the contiguous free space after the head (producer only), so a driver
+     * can read straight into the ring. Call commit() with the number of samples
+     * written, then call write_span() again to get the part after the wrap.
+     * @param span Out, start of the free space
+     * @returns Number of samples that fit in the span
+     */
+    size_t write_span(int16_t **span) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+
+        size_t free_size;
+        if (head >= tail) {
+            // up to the end of the buffer, but keep a slot empty if the tail sits at 0
+            free_size = _size - head - (tail == 0 ? 1 : 0);
+        }
+        else {
+            free_size = tail - head - 1;
+        }
+
+        *span = _buffer + head;
+        return free_size;
+    }
+
+    /**
+     * Publish samples written into the span from write_span() (producer only)
+     */
+    void commit(size_t count) {
+        size_t head = _head.load(std::memory_order_relaxed) + count;
+        if (head >= _size) {
+            head -= _size;
+        }
+        _head.store(head, std::memory_order_release);
+    }
+
+    /**
+     * Record that samples were dropped because the ring was full (producer only),
+     * for drivers that use write_span() and have to discard the rest of a frame
+     */
+    void mark_overrun(size_t dropped_samples) {
+        _overrun_count.store(_overrun_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        _dropped_samples.store(_dropped_samples.load(std::memory_order_relaxed) + dropped_samples,
+            std::memory_order_relaxed);
+    }
+
+    /* Consumer side --------------------------------------------------------- */
+
+    /**
+     * Number of samples ready to be read (consumer only)
+     */
+    size_t available() const {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        return head >= tail ? head - tail : head + _size - tail;
+    }
+
+    /**
+     * Read samples as float, without removing them from the ring (consumer only)
+     * @param offset Offset from the oldest sample that was not consumed yet
+     * @param length Number of samples
+     * @param out_ptr Out buffer
+     * @returns EIDSP_OK if OK
+     */
+    int read(size_t offset, size_t length, float *out_ptr) const {
+        if (offset + length > available()) {
+            EIDSP_ERR(EIDSP_OUT_OF_BOUNDS);
+        }
+
+        size_t start = _tail.load(std::memory_order_relaxed) + offset;
+        if (start >= _size) {
+            start -= _size;
+        }
+
+        size_t first = _size - start;
+        if (first > length) {
+            first = length;
+        }
+
+        numpy::int16_to_float(_buffer + start, out_ptr, first);
+        if (first < length) {
+            numpy::int16_to_float(_buffer, out_ptr + first, length - first);
+        }
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release the oldest samples to the producer (consumer only)
+     */
+    void consume(size_t count) {
+        if (count > available()) {
+            count = available();
+        }
+
+        size_t tail = _tail.load(std::memory_order_relaxed) + count;
+        if (tail >= _size) {
+            tail -= _size;
+        }
+        _tail.store(tail, std::memory_order_release);
+    }
+
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+    /**
+     * Wrap the oldest `length` samples into a signal (consumer only). get_data
+     * converts straight from the ring, nothing is copied up front. The samples
+     * stay valid until consume() is called.
+     * @returns EIDSP_OK if OK, EIDSP_OUT_OF_BOUNDS if fewer samples are available
+     */
+    int get_signal(size_t length, signal_t *signal) {
+        if (length > available()) {
+            return EIDSP_OUT_OF_BOUNDS;
+        }
+
+        signal->total_length = length;
+#ifdef __MBED__
+        signal->get_data = mbed::callback(this, &audio_ring_buffer::read);
+#else
+        signal->get_data = [this](size_t offset, size_t length, float *out_ptr) {
+            return this->read(offset, length, out_ptr);
+        };
+#endif
+        return EIDSP_OK;
+    }
+#endif // EIDSP_SIGNAL_C_FN_POINTER == 0
+
+    /**
+     * Number of writes that (partly) did not fit in the ring
+     */
+    uint32_t get_overrun_count() const {
+        return _overrun_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Total number of samples dropped because the ring was full
+     */
+    uint32_t get_dropped_samples() const {
+        return _dropped_samples.load(std::memory_order_relaxed);
+    }
+
+private:
+    int16_t *_buffer;
+    size_t _size;
+    bool _buffer_managed_by_me;
+
+    std::atomic<size_t> _head;              // written by the producer only
+    std::atomic<size_t> _tail;              // written by the consumer only
+    std::atomic<uint32_t> _overrun_count;   // written by the producer only
+    std::atomic<uint32_t> _dropped_samples; // written by the producer only
+};
+
+} // namespace ei
+
+#endif // _EIDSP_RING_BUFFER_H_
@@ -27,59 +27,69 @@
 #include <stdint.h>
 #include "functions.hpp"
 #include "processing.hpp"
+#include "../profiling.hpp"
 #include "../memory.hpp"
 
 namespace ei {
 namespace speechpy {
 
+// one filter in a sparse mel filterbank, only the nonzero span of the triangle is stored
+typedef struct {
+    uint16_t first_bin;         // first FFT bin with a nonzero weight
+    uint16_t bin_count;         // number of weights in the span
+    uint16_t weights_offset;    // offset of the span in mfcc_plan_t::weights
+} sparse_mel_filter_t;
+
+// everything MFE / MFCC extraction needs that only depends on the DSP configuration,
+// build once with `feature::create_mfcc_plan` and release with `feature::free_mfcc_plan`
+typedef struct {
+    uint32_t sampling_frequency;
+    float frame_length;
+    float frame_stride;
+    uint8_t num_cepstral;
+    uint16_t num_filters;
+    uint16_t fft_length;
+    uint32_t low_frequency;
+    uint32_t high_frequency;    // resolved, never 0
+    sparse_mel_filter_t *filters;
+    float *weights;
+    size_t weights_count;
+    float *dct_basis;           // num_filters x num_cepstral, transposed orthonormal DCT-II, NULL without cepstra
+} mfcc_plan_t;
+
+// fixed point version of `mfcc_plan_t`, build with `feature::create_mfcc_q15_plan`
+// and release with `feature::free_mfcc_q15_plan`
+typedef struct {
+    mfcc_plan_t plan;           // framing parameters and the filterbank layout (weights freed)
+    uint16_t *weights;          // plan.weights in q15
+    int16_t *dct_basis;         // num_cepstral x num_filters orthonormal DCT-II basis in q15
+    rfft_q31_plan_t fft;
+} mfcc_q15_plan_t;
+
 class feature {
 public:
     /**
-     * Compute the Mel-filterbanks. Each filter will be stored in one rows.
-     * The columns correspond to fft bins.
-     *
-     * @param filterbanks Matrix of size num_filter * coefficients
+     * Calculate the FFT bins that the mel filters start, peak and end on.
+     * @param freq_index Output array of num_filter + 2 bin indices
      * @param num_filter the number of filters in the filterbank
      * @param coefficients (fftpoints//2 + 1)
-     * @param sampling_freq  the samplerate of the signal we are working
-     *                       with. It affects mel spacing.
-     * @param low_freq lowest band edge of mel filters, default 0 Hz
-     * @param high_freq highest band edge of mel filters, default samplerate / 2
-     * @param output_transposed If set to true this will transpose the matrix (memory efficient).
-     *                          This is more efficient than calling this function and then transposing
-     *                          as the latter requires the filterbank to be allocated twice (for a short while).
+     * @param sampling_freq  the samplerate of the signal we are working with
+     * @param low_freq lowest band edge of mel filters
+     * @param high_freq highest band edge of mel filters
      * @returns EIDSP_OK if OK
      */
-    static int filterbanks(
-#if EIDSP_QUANTIZE_FILTERBANK
-        quantized_matrix_t *filterbanks,
-#else
-        matrix_t *filterbanks,
-#endif
+    static int filterbank_bin_edges(int *freq_index,
         uint16_t num_filter, int coefficients, uint32_t sampling_freq,
-        uint32_t low_freq, uint32_t high_freq,
-        bool output_transposed = false
-        )
+        uint32_t low_freq, uint32_t high_freq)
     {
         const size_t mels_mem_size = (num_filter + 2) * sizeof(float);
         const size_t hertz_mem_size = (num_filter + 2) * sizeof(float);
-        const size_t freq_index_mem_size = (num_filter + 2) * sizeof(int);
 
         float *mels = (float*)ei_dsp_malloc(mels_mem_size);
         if (!mels) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        if (filterbanks->rows != num_filter || filterbanks->cols != static_cast<uint32_t>(coefficients)) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
-        }
-
-#if EIDSP_QUANTIZE_FILTERBANK
-        memset(filterbanks->buffer, 0, filterbanks->rows * filterbanks->cols * sizeof(uint8_t));
-#else
-        memset(filterbanks->buffer, 0, filterbanks->rows * filterbanks->cols * sizeof(float));
-#endif
-
         // Computing the Mel filterbank
         // converting the upper and lower frequencies to Mels.
         // num_filter + 2 is because for num_filter filterbanks we need
@@ -119,15 +129,62 @@ public:
         // The frequency resolution required to put filters at the
         // exact points calculated above should be extracted.
         //  So we should round those frequencies to the closest FFT bin.
+        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
+            freq_index[ix] = static_cast<int>(floor((coefficients + 1) * hertz[ix] / sampling_freq));
+        }
+        ei_dsp_free(hertz, hertz_mem_size);
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Compute the Mel-filterbanks. Each filter will be stored in one rows.
+     * The columns correspond to fft bins.
+     *
+     * @param filterbanks Matrix of size num_filter * coefficients
+     * @param num_filter the number of filters in the filterbank
+     * @param coefficients (fftpoints//2 + 1)
+     * @param sampling_freq  the samplerate of the signal we are working
+     *                       with. It affects mel spacing.
+     * @param low_freq lowest band edge of mel filters, default 0 Hz
+     * @param high_freq highest band edge of mel filters, default samplerate / 2
+     * @param output_transposed If set to true this will transpose the matrix (memory efficient).
+     *                          This is more efficient than calling this function and then transposing
+     *                          as the latter requires the filterbank to be allocated twice (for a short while).
+     * @returns EIDSP_OK if OK
+     */
+    static int filterbanks(
+#if EIDSP_QUANTIZE_FILTERBANK
+        quantized_matrix_t *filterbanks,
+#else
+        matrix_t *filterbanks,
+#endif
+        uint16_t num_filter, int coefficients, uint32_t sampling_freq,
+        uint32_t low_freq, uint32_t high_freq,
+        bool output_transposed = false
+        )
+    {
+        const size_t freq_index_mem_size = (num_filter + 2) * sizeof(int);
+
+        if (filterbanks->rows != num_filter || filterbanks->cols != static_cast<uint32_t>(coefficients)) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+#if EIDSP_QUANTIZE_FILTERBANK
+        memset(filterbanks->buffer, 0, filterbanks->rows * filterbanks->cols * sizeof(uint8_t));
+#else
+        memset(filterbanks->buffer, 0, filterbanks->rows * filterbanks->cols * sizeof(float));
+#endif
+
         int *freq_index = (int*)ei_dsp_malloc(freq_index_mem_size);
         if (!freq_index) {
-            ei_dsp_free(hertz, hertz_mem_size);
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
-            freq_index[ix] = static_cast<int>(floor((coefficients + 1) * hertz[ix] / sampling_freq));
+        int ret = filterbank_bin_edges(freq_index, num_filter, coefficients, sampling_freq, low_freq, high_freq);
+        if (ret != EIDSP_OK) {
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(ret);
         }
-        ei_dsp_free(hertz, hertz_mem_size);
 
         for (size_t i = 0; i < num_filter; i++) {
             int left = freq_index[i];
@@ -170,152 +227,425 @@ public:
     }
 
     /**
-     * Compute Mel-filterbank energy features from an audio signal.
-     * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
-     * @param out_energies A matrix in the form of Mx1 where M is the rows from `calculate_mfe_buffer_size`
-     * @param signal: audio signal structure with functions to retrieve data from a signal
+     * One coefficient of the DCT-II basis, with the same scaling as `numpy::dct2`
+     * with DCT_NORMALIZATION_ORTHO
+     * @param i Cepstral coefficient
+     * @param j Filter
+     * @param num_filters Length of the transform
+     */
+    static inline double dct_ortho_basis_value(size_t i, size_t j, size_t num_filters)
+    {
+        double scale = i == 0 ? sqrt(1.0 / (4.0 * num_filters)) : sqrt(1.0 / (2.0 * num_filters));
+        return 2.0 * cos(M_PI * i * (2.0 * j + 1.0) / (2.0 * num_filters)) * scale;
+    }
+
+    /**
+     * Build an MFCC plan: the sparse mel filterbank plus the framing parameters.
+     * The plan only depends on the configuration, so build it once and reuse it
+     * for every window or slice. With num_cepstral > 0 the plan also holds the
+     * DCT basis for the kept cepstral coefficients.
+     * @param plan Plan to fill, release with `free_mfcc_plan`
      * @param sampling_frequency (int): the sampling frequency of the signal
      *     we are working with.
      * @param frame_length (float): the length of each frame in seconds.
-     *     Default is 0.020s
      * @param frame_stride (float): the step between successive frames in seconds.
-     *     Default is 0.02s (means no overlap)
-     * @param num_filters (int): the number of filters in the filterbank,
-     *     default 40.
-     * @param fft_length (int): number of FFT points. Default is 512.
+     * @param num_cepstral (int): Number of cepstral coefficients.
+     * @param num_filters (int): the number of filters in the filterbank
+     * @param fft_length (int): number of FFT points.
      * @param low_frequency (int): lowest band edge of mel filters.
-     *     In Hz, default is 0.
-     * @param high_frequency (int): highest band edge of mel filters.
-     *     In Hz, default is samplerate/2
-     * @EIDSP_OK if OK
+     * @param high_frequency (int): highest band edge of mel filters (0 = samplerate/2)
+     * @returns EIDSP_OK if OK
      */
-    static int mfe(matrix_t *out_features, matrix_t *out_energies,
-        signal_t *signal,
+    static int create_mfcc_plan(mfcc_plan_t *plan,
         uint32_t sampling_frequency,
-        float frame_length = 0.02f, float frame_stride = 0.02f, uint16_t num_filters = 40,
-        uint16_t fft_length = 512, uint32_t low_frequency = 300, uint32_t high_frequency = 0
-        )
+        float frame_length, float frame_stride, uint8_t num_cepstral, uint16_t num_filters,
+        uint16_t fft_length, uint32_t low_frequency, uint32_t high_frequency)
     {
-        int ret = 0;
+        memset(plan, 0, sizeof(mfcc_plan_t));
 
         if (high_frequency == 0) {
             high_frequency = sampling_frequency / 2;
         }
 
-        stack_frames_info_t stack_frame_info = { 0 };
-        stack_frame_info.signal = signal;
+        const int coefficients = fft_length / 2 + 1;
+        const size_t freq_index_mem_size = (num_filters + 2) * sizeof(int);
 
-        ret = processing::stack_frames(
-            &stack_frame_info,
-            sampling_frequency,
-            frame_length,
-            frame_stride,
-            false
-        );
-        if (ret != 0) {
-            EIDSP_ERR(ret);
-        }
+        // z holds one triangle, no filter spans more than all bins
+        EI_DSP_MATRIX(z, 1, coefficients + 1);
 
-        if (stack_frame_info.frame_ixs->size() != out_features->rows) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        int *freq_index = (int*)ei_dsp_malloc(freq_index_mem_size);
+        if (!freq_index) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-
-        if (num_filters != out_features->cols) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        int ret = filterbank_bin_edges(freq_index, num_filters, coefficients,
+            sampling_frequency, low_frequency, high_frequency);
+        if (ret != EIDSP_OK) {
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(ret);
         }
 
-        if (stack_frame_info.frame_ixs->size() != out_energies->rows || out_energies->cols != 1) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        // two passes: first find the nonzero span of every filter, then copy the weights
+        plan->filters = (sparse_mel_filter_t*)ei_dsp_calloc(num_filters, sizeof(sparse_mel_filter_t));
+        if (!plan->filters) {
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        for (uint32_t i = 0; i < out_features->rows * out_features->cols; i++) {
-            *(out_features->buffer + i) = 0;
-        }
+        for (int pass = 0; pass < 2; pass++) {
+            size_t weights_count = 0;
+
+            for (size_t i = 0; i < num_filters; i++) {
+                int left = freq_index[i];
+                int middle = freq_index[i + 1];
+                int right = freq_index[i + 2];
+                int span = right - left + 1;
+                if (span > static_cast<int>(z.cols)) {
+                    ei_dsp_free(freq_index, freq_index_mem_size);
+                    free_mfcc_plan(plan);
+                    EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+                }
 
-        uint16_t coefficients = fft_length / 2 + 1;
+                numpy::linspace(left, right, span, z.buffer);
+                functions::triangle(z.buffer, span, left, middle, right);
 
-        // calculate the filterbanks first... preferably I would want to do the matrix multiplications
-        // whenever they happen, but OK...
+                // same weights as feature::filterbanks() would store
+                for (int zx = 0; zx < span; zx++) {
 #if EIDSP_QUANTIZE_FILTERBANK
-        EI_DSP_QUANTIZED_MATRIX(filterbanks, num_filters, coefficients, &numpy::dequantize_zero_one);
-#else
-        EI_DSP_MATRIX(filterbanks, num_filters, coefficients);
+                    z.buffer[zx] = numpy::dequantize_zero_one(numpy::quantize_zero_one(z.buffer[zx]));
 #endif
-        if (!filterbanks.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
+                    // bins past the spectrum are never multiplied
+                    if (left + zx >= coefficients) {
+                        z.buffer[zx] = 0.0f;
+                    }
+                }
 
-        ret = feature::filterbanks(
-            &filterbanks, num_filters, coefficients, sampling_frequency, low_frequency, high_frequency, true);
-        if (ret != 0) {
-            EIDSP_ERR(ret);
+                int first = 0;
+                while (first < span && z.buffer[first] == 0.0f) {
+                    first++;
+                }
+                int last = span - 1;
+                while (last >= first && z.buffer[last] == 0.0f) {
+                    last--;
+                }
+                int count = last - first + 1;
+
+                if (pass == 1) {
+                    plan->filters[i].first_bin = static_cast<uint16_t>(left + first);
+                    plan->filters[i].bin_count = static_cast<uint16_t>(count);
+                    plan->filters[i].weights_offset = static_cast<uint16_t>(weights_count);
+                    if (count > 0) {
+                        memcpy(plan->weights + weights_count, z.buffer + first, count * sizeof(float));
+                    }
+                }
+
+                weights_count += count;
+            }
+
+            if (pass == 0) {
+                if (weights_count > EI_MAX_UINT16) {
+                    ei_dsp_free(freq_index, freq_index_mem_size);
+                    free_mfcc_plan(plan);
+                    EIDSP_ERR(EIDSP_NARROWING);
+                }
+
+                plan->weights_count = weights_count;
+                plan->weights = (float*)ei_dsp_calloc(weights_count > 0 ? weights_count : 1, sizeof(float));
+                if (!plan->weights) {
+                    ei_dsp_free(freq_index, freq_index_mem_size);
+                    free_mfcc_plan(plan);
+                    EIDSP_ERR(EIDSP_OUT_OF_MEM);
+                }
+            }
         }
-        for (size_t ix = 0; ix < stack_frame_info.frame_ixs->size(); ix++) {
-            size_t power_spectrum_frame_size = (fft_length / 2 + 1);
 
-            EI_DSP_MATRIX(power_spectrum_frame, 1, power_spectrum_frame_size);
-            if (!power_spectrum_frame.buffer) {
+        ei_dsp_free(freq_index, freq_index_mem_size);
+
+        // only the first num_cepstral rows of the DCT are ever kept
+        if (num_cepstral > 0) {
+            plan->dct_basis = (float*)ei_dsp_calloc(num_filters * num_cepstral, sizeof(float));
+            if (!plan->dct_basis) {
+                free_mfcc_plan(plan);
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
+            for (size_t j = 0; j < num_filters; j++) {
+                for (size_t i = 0; i < num_cepstral; i++) {
+                    plan->dct_basis[(j * num_cepstral) + i] =
+                        static_cast<float>(dct_ortho_basis_value(i, j, num_filters));
+                }
+            }
+        }
 
-            // get signal data from the audio file
-            EI_DSP_MATRIX(signal_frame, 1, stack_frame_info.frame_length);
+        plan->sampling_frequency = sampling_frequency;
+        plan->frame_length = frame_length;
+        plan->frame_stride = frame_stride;
+        plan->num_cepstral = num_cepstral;
+        plan->num_filters = num_filters;
+        plan->fft_length = fft_length;
+        plan->low_frequency = low_frequency;
+        plan->high_frequency = high_frequency;
 
-            // don't read outside of the audio buffer... we'll automatically zero pad then
-            size_t signal_offset = stack_frame_info.frame_ixs->at(ix);
-            size_t signal_length = stack_frame_info.frame_length;
-            if (signal_offset + signal_length > stack_frame_info.signal->total_length) {
-                signal_length = signal_length -
-                    (stack_frame_info.signal->total_length - (signal_offset + signal_length));
-            }
+        return EIDSP_OK;
+    }
 
-            ret = stack_frame_info.signal->get_data(
-                signal_offset,
-                signal_length,
-                signal_frame.buffer
-            );
-            if (ret != 0) {
-                EIDSP_ERR(ret);
+    /**
+     * Release the memory held by an MFCC plan
+     * @param plan Plan created through `create_mfcc_plan`
+     */
+    static void free_mfcc_plan(mfcc_plan_t *plan)
+    {
+        if (plan->filters) {
+            ei_dsp_free(plan->filters, plan->num_filters * sizeof(sparse_mel_filter_t));
+        }
+        if (plan->weights) {
+            ei_dsp_free(plan->weights, (plan->weights_count > 0 ? plan->weights_count : 1) * sizeof(float));
+        }
+        if (plan->dct_basis) {
+            ei_dsp_free(plan->dct_basis, plan->num_filters * plan->num_cepstral * sizeof(float));
+        }
+        memset(plan, 0, sizeof(mfcc_plan_t));
+    }
+
+    /**
+     * Memory footprint of an MFCC plan (the struct and everything it owns)
+     * @param plan Plan created through `create_mfcc_plan`
+     * @returns Size in bytes
+     */
+    static size_t mfcc_plan_memory_size(const mfcc_plan_t *plan)
+    {
+        return sizeof(mfcc_plan_t) +
+            (plan->num_filters * sizeof(sparse_mel_filter_t)) +
+            ((plan->weights_count > 0 ? plan->weights_count : 1) * sizeof(float)) +
+            (plan->dct_basis ? plan->num_filters * plan->num_cepstral * sizeof(float) : 0);
+    }
+
+    /**
+     * Multiply a power spectrum with the sparse filterbank of a plan
+     * @param power_spectrum Power spectrum of one frame (fft_length / 2 + 1 bins)
+     * @param plan MFCC plan
+     * @param out Output, one value per filter
+     */
+    static inline void apply_sparse_filterbank(const float *power_spectrum, const mfcc_plan_t *plan, float *out)
+    {
+        for (size_t j = 0; j < plan->num_filters; j++) {
+            const sparse_mel_filter_t *filter = &plan->filters[j];
+            const float *bins = power_spectrum + filter->first_bin;
+            const float *weights = plan->weights + filter->weights_offset;
+
+            float tmp = 0.0f;
+            for (size_t k = 0; k < filter->bin_count; k++) {
+                tmp += bins[k] * weights[k];
             }
+            out[j] = tmp;
+        }
+    }
 
-            ret = processing::power_spectrum(
-                signal_frame.buffer,
-                stack_frame_info.frame_length,
-                power_spectrum_frame.buffer,
-                power_spectrum_frame_size,
-                fft_length
-            );
+    /**
+     * Multiply a block of power spectra with the sparse filterbank of a plan, and sum
+     * every spectrum into its frame energy. The filters are the outer loop, so the
+     * weights of a filter are loaded once for the whole block.
+     * @param power_spectra frame_count power spectra of fft_length / 2 + 1 bins, one per row
+     * @param frame_count Number of frames in the block
+     * @param plan MFCC plan
+     * @param out Output, frame_count rows of one value per filter
+     * @param out_energies Output, one energy per frame (FLT_EPSILON for silent frames), or NULL
+     */
+    static inline void apply_sparse_filterbank(const float *power_spectra, size_t frame_count,
+        const mfcc_plan_t *plan, float *out, float *out_energies)
+    {
+        const size_t bins = plan->fft_length / 2 + 1;
 
-            if (ret != 0) {
-                EIDSP_ERR(ret);
+        for (size_t ix = 0; out_energies && ix < frame_count; ix++) {
+            const float *spectrum = power_spectra + (ix * bins);
+            float energy = 0.0f;
+            for (size_t k = 0; k < bins; k++) {
+                energy += spectrum[k];
             }
+            out_energies[ix] = energy == 0 ? FLT_EPSILON : energy;
+        }
+
+        // nothing to share between frames, the per frame loop is cheaper
+        if (frame_count == 1) {
+            apply_sparse_filterbank(power_spectra, plan, out);
+            return;
+        }
+
+        for (size_t j = 0; j < plan->num_filters; j++) {
+            const sparse_mel_filter_t *filter = &plan->filters[j];
+            const float *weights = plan->weights + filter->weights_offset;
 
-            float energy = numpy::sum(power_spectrum_frame.buffer, power_spectrum_frame_size);
-            if (energy == 0) {
-                energy = FLT_EPSILON;
+            for (size_t ix = 0; ix < frame_count; ix++) {
+                const float *spectrum = power_spectra + (ix * bins) + filter->first_bin;
+
+                float tmp = 0.0f;
+                for (size_t k = 0; k < filter->bin_count; k++) {
+                    tmp += spectrum[k] * weights[k];
+                }
+                out[(ix * plan->num_filters) + j] = tmp;
             }
+        }
+    }
 
-            out_energies->buffer[ix] = energy;
+    /**
+     * Compute Mel-filterbank energy features from an audio signal.
+     * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
+     * @param out_energies A matrix in the form of Mx1 where M is the rows from `calculate_mfe_buffer_size`,
+     *     or NULL if the frame energies are not needed
+     * @param signal: audio signal structure with functions to retrieve data from a signal
+     * @param plan MFCC plan holding the filterbank and framing parameters
+     * @param preemphasis Pre-emphasis to apply while framing, NULL for none
+     * @EIDSP_OK if OK
+     */
+    static int mfe(matrix_t *out_features, matrix_t *out_energies,
+        signal_t *signal, const mfcc_plan_t *plan,
+        const processing::preemphasis_params_t *preemphasis = NULL)
+    {
+        int ret = 0;
 
-            // calculate the out_features directly here
-            ret = numpy::dot_by_row(
-                ix,
-                power_spectrum_frame.buffer,
-                power_spectrum_frame_size,
-                &filterbanks,
-                out_features
-            );
+        // same framing as processing::frame_reader (no zero padding)
+        int32_t frame_count = processing::calculate_no_of_stack_frames(
+            signal->total_length,
+            plan->sampling_frequency,
+            plan->frame_length,
+            plan->frame_stride,
+            false);
+        if (frame_count < 0 || static_cast<size_t>(frame_count) != out_features->rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
 
-            if (ret != 0) {
-                EIDSP_ERR(ret);
+        if (plan->num_filters != out_features->cols) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        if (out_energies && (static_cast<size_t>(frame_count) != out_energies->rows || out_energies->cols != 1)) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        const size_t frame_sample_length = static_cast<size_t>(
+            round(static_cast<float>(plan->sampling_frequency) * plan->frame_length));
+        const size_t frame_sample_stride = static_cast<size_t>(
+            round(static_cast<float>(plan->sampling_frequency) * plan->frame_stride));
+
+        const uint16_t fft_length = plan->fft_length;
+        const size_t power_spectrum_frame_size = (fft_length / 2 + 1);
+
+        // frames are transformed in blocks, then projected onto the filterbank per block;
+        // all buffers the loop needs are allocated once up front
+        const size_t batch_frames = EIDSP_MFE_BATCH_FRAMES < static_cast<size_t>(frame_count) ?
+            EIDSP_MFE_BATCH_FRAMES : (frame_count > 0 ? static_cast<size_t>(frame_count) : 1);
+
+        EI_DSP_MATRIX(power_spectra, batch_frames, power_spectrum_frame_size);
+        if (!power_spectra.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        EI_DSP_MATRIX(signal_frame, 1, frame_sample_length);
+        if (!signal_frame.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        EI_DSP_MATRIX(fft_scratch, 1, numpy::rfft_scratch_size(fft_length));
+        if (!fft_scratch.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        // reads every sample once and pre-emphasizes it on the way in
+        processing::frame_reader frames(signal, frame_sample_length, frame_sample_stride, preemphasis);
+
+        fft_plan_t temp_fft_plan;
+        const fft_plan_t *fft_plan;
+        ret = numpy::acquire_fft_plan(fft_length, &temp_fft_plan, &fft_plan);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        for (size_t block = 0; block < static_cast<size_t>(frame_count); block += batch_frames) {
+            const size_t block_frames = static_cast<size_t>(frame_count) - block < batch_frames ?
+                static_cast<size_t>(frame_count) - block : batch_frames;
+
+            for (size_t ix = 0; ix < block_frames; ix++) {
+                EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FRAMING);
+                ret = frames.next_frame(signal_frame.buffer);
+                if (ret != EIDSP_OK) {
+                    numpy::release_fft_plan(&temp_fft_plan, fft_plan);
+                    EIDSP_ERR(ret);
+                }
+                EIDSP_PROFILE_END(EI_DSP_STAGE_FRAMING);
+
+                EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FFT);
+                ret = processing::power_spectrum(
+                    fft_plan,
+                    signal_frame.buffer,
+                    frame_sample_length,
+                    power_spectra.buffer + (ix * power_spectrum_frame_size),
+                    power_spectrum_frame_size,
+                    fft_scratch.buffer
+                );
+
+                if (ret != 0) {
+                    numpy::release_fft_plan(&temp_fft_plan, fft_plan);
+                    EIDSP_ERR(ret);
+                }
+                EIDSP_PROFILE_END(EI_DSP_STAGE_FFT);
             }
+
+            // calculate the out_features directly here
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FILTERBANK);
+            apply_sparse_filterbank(power_spectra.buffer, block_frames, plan,
+                out_features->buffer + (block * out_features->cols),
+                out_energies ? out_energies->buffer + block : NULL);
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FILTERBANK);
         }
 
+        numpy::release_fft_plan(&temp_fft_plan, fft_plan);
+
         functions::zero_handling(out_features);
 
         return EIDSP_OK;
     }
 
+    /**
+     * Compute Mel-filterbank energy features from an audio signal.
+     * This builds a temporary plan, use the overload that takes an `mfcc_plan_t`
+     * when calling this repeatedly with the same parameters.
+     * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
+     * @param out_energies A matrix in the form of Mx1 where M is the rows from `calculate_mfe_buffer_size`
+     * @param signal: audio signal structure with functions to retrieve data from a signal
+     * @param sampling_frequency (int): the sampling frequency of the signal
+     *     we are working with.
+     * @param frame_length (float): the length of each frame in seconds.
+     *     Default is 0.020s
+     * @param frame_stride (float): the step between successive frames in seconds.
+     *     Default is 0.02s (means no overlap)
+     * @param num_filters (int): the number of filters in the filterbank,
+     *     default 40.
+     * @param fft_length (int): number of FFT points. Default is 512.
+     * @param low_frequency (int): lowest band edge of mel filters.
+     *     In Hz, default is 0.
+     * @param high_frequency (int): highest band edge of mel filters.
+     *     In Hz, default is samplerate/2
+     * @EIDSP_OK if OK
+     */
+    static int mfe(matrix_t *out_features, matrix_t *out_energies,
+        signal_t *signal,
+        uint32_t sampling_frequency,
+        float frame_length = 0.02f, float frame_stride = 0.02f, uint16_t num_filters = 40,
+        uint16_t fft_length = 512, uint32_t low_frequency = 300, uint32_t high_frequency = 0
+        )
+    {
+        mfcc_plan_t plan;
+        int ret = create_mfcc_plan(&plan, sampling_frequency, frame_length, frame_stride,
+            0, num_filters, fft_length, low_frequency, high_frequency);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        ret = mfe(out_features, out_energies, signal, &plan);
+
+        free_mfcc_plan(&plan);
+
+        return ret;
+    }
+
     /**
      * Compute spectrogram from a sensor signal.
      * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
@@ -336,24 +666,22 @@ public:
     {
         int ret = 0;
 
-        stack_frames_info_t stack_frame_info = { 0 };
-        stack_frame_info.signal = signal;
-
-        ret = processing::stack_frames(
-            &stack_frame_info,
+        // same framing as processing::frame_reader (no zero padding)
+        int32_t frame_count = processing::calculate_no_of_stack_frames(
+            signal->total_length,
             sampling_frequency,
             frame_length,
             frame_stride,
-            false
-        );
-        if (ret != 0) {
-            EIDSP_ERR(ret);
-        }
-
-        if (stack_frame_info.frame_ixs->size() != out_features->rows) {
+            false);
+        if (frame_count < 0 || static_cast<size_t>(frame_count) != out_features->rows) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
+        const size_t frame_sample_length = static_cast<size_t>(
+            round(static_cast<float>(sampling_frequency) * frame_length));
+        const size_t frame_sample_stride = static_cast<size_t>(
+            round(static_cast<float>(sampling_frequency) * frame_stride));
+
         uint16_t coefficients = fft_length / 2 + 1;
 
         if (coefficients != out_features->cols) {
@@ -364,40 +692,53 @@ public:
             *(out_features->buffer + i) = 0;
         }
 
-        for (size_t ix = 0; ix < stack_frame_info.frame_ixs->size(); ix++) {
-            // get signal data from the audio file
-            EI_DSP_MATRIX(signal_frame, 1, stack_frame_info.frame_length);
+        EI_DSP_MATRIX(signal_frame, 1, frame_sample_length);
+        if (!signal_frame.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
 
-            // don't read outside of the audio buffer... we'll automatically zero pad then
-            size_t signal_offset = stack_frame_info.frame_ixs->at(ix);
-            size_t signal_length = stack_frame_info.frame_length;
-            if (signal_offset + signal_length > stack_frame_info.signal->total_length) {
-                signal_length = signal_length -
-                    (stack_frame_info.signal->total_length - (signal_offset + signal_length));
-            }
+        EI_DSP_MATRIX(fft_scratch, 1, numpy::rfft_scratch_size(fft_length));
+        if (!fft_scratch.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
 
-            ret = stack_frame_info.signal->get_data(
-                signal_offset,
-                signal_length,
-                signal_frame.buffer
-            );
-            if (ret != 0) {
+        processing::frame_reader frames(signal, frame_sample_length, frame_sample_stride);
+
+        fft_plan_t temp_fft_plan;
+        const fft_plan_t *fft_plan;
+        ret = numpy::acquire_fft_plan(fft_length, &temp_fft_plan, &fft_plan);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        for (size_t ix = 0; ix < static_cast<size_t>(frame_count); ix++) {
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FRAMING);
+            ret = frames.next_frame(signal_frame.buffer);
+            if (ret != EIDSP_OK) {
+                numpy::release_fft_plan(&temp_fft_plan, fft_plan);
                 EIDSP_ERR(ret);
             }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FRAMING);
 
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FFT);
             ret = processing::power_spectrum(
+                fft_plan,
                 signal_frame.buffer,
-                stack_frame_info.frame_length,
+                frame_sample_length,
                 out_features->buffer + (ix * coefficients),
                 coefficients,
-                fft_length
+                fft_scratch.buffer
             );
 
             if (ret != 0) {
+                numpy::release_fft_plan(&temp_fft_plan, fft_plan);
                 EIDSP_ERR(ret);
             }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FFT);
         }
 
+        numpy::release_fft_plan(&temp_fft_plan, fft_plan);
+
         functions::zero_handling(out_features);
 
         return EIDSP_OK;
@@ -435,40 +776,34 @@ public:
      * @param out_features Use `calculate_mfcc_buffer_size` to allocate the right matrix.
      * @param signal: audio signal structure from which to compute features.
      *     has functions to retrieve data from a signal lazily.
-     * @param sampling_frequency (int): the sampling frequency of the signal
-     *     we are working with.
-     * @param frame_length (float): the length of each frame in seconds.
-     *     Default is 0.020s
-     * @param frame_stride (float): the step between successive frames in seconds.
-     *     Default is 0.01s (means no overlap)
-     * @param num_cepstral (int): Number of cepstral coefficients.
-     * @param num_filters (int): the number of filters in the filterbank,
-     *     default 40.
-     * @param fft_length (int): number of FFT points. Default is 512.
-     * @param low_frequency (int): lowest band edge of mel filters.
-     *     In Hz, default is 0.
-     * @param high_frequency (int): highest band edge of mel filters.
-     *     In Hz, default is samplerate/2
+     * @param plan MFCC plan holding the filterbank and framing parameters
      * @param dc_elimination Whether the first dc component should
      *     be eliminated or not.
+     * @param preemphasis Pre-emphasis to apply while framing, NULL for none
      * @returns 0 if OK
      */
     static int mfcc(matrix_t *out_features, signal_t *signal,
-        uint32_t sampling_frequency, float frame_length = 0.02f, float frame_stride = 0.01f,
-        uint8_t num_cepstral = 13, uint16_t num_filters = 40, uint16_t fft_length = 512,
-        uint32_t low_frequency = 0, uint32_t high_frequency = 0, bool dc_elimination = true)
+        const mfcc_plan_t *plan, bool dc_elimination = true,
+        const processing::preemphasis_params_t *preemphasis = NULL)
     {
+        const uint8_t num_cepstral = plan->num_cepstral;
+
         if (out_features->cols != num_cepstral) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
+        // plans built without cepstra (MFE only) have no DCT basis
+        if (!plan->dct_basis) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
         matrix_size_t mfe_matrix_size =
             calculate_mfe_buffer_size(
                 signal->total_length,
-                sampling_frequency,
-                frame_length,
-                frame_stride,
-                num_filters);
+                plan->sampling_frequency,
+                plan->frame_length,
+                plan->frame_stride,
+                plan->num_filters);
 
         if (out_features->rows != mfe_matrix_size.rows) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
@@ -487,38 +822,359 @@ public:
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        ret = mfe(&features_matrix, &energy_matrix, signal,
-            sampling_frequency, frame_length, frame_stride, num_filters, fft_length,
-            low_frequency, high_frequency);
+        ret = mfe(&features_matrix, &energy_matrix, signal, plan, preemphasis);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
 
         // ok... now we need to calculate the MFCC from this...
         // first do log() over all features...
+        EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_LOG);
         ret = numpy::log(&features_matrix);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
+        EIDSP_PROFILE_END(EI_DSP_STAGE_LOG);
 
-        // now do DST type 2
-        ret = numpy::dct2(&features_matrix, DCT_NORMALIZATION_ORTHO);
+        // now do DCT type 2, but only for the cepstral coefficients we keep:
+        // one (frames x filters) * (filters x num_cepstral) product straight into the output
+        EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_DCT);
+        matrix_t dct_basis(plan->num_filters, num_cepstral, plan->dct_basis);
+        ret = numpy::dot(&features_matrix, &dct_basis, out_features);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
+        EIDSP_PROFILE_END(EI_DSP_STAGE_DCT);
 
         // replace first cepstral coefficient with log of frame energy for DC elimination
         if (dc_elimination) {
-            for (size_t row = 0; row < features_matrix.rows; row++) {
-                features_matrix.buffer[row * features_matrix.cols] = numpy::log(energy_matrix.buffer[row]);
+            EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_LOG);
+            ret = numpy::log(&energy_matrix);
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+            for (size_t row = 0; row < out_features->rows; row++) {
+                out_features->buffer[row * num_cepstral] = energy_matrix.buffer[row];
             }
         }
 
-        // copy to the output...
-        for (size_t row = 0; row < features_matrix.rows; row++) {
-            for(int i = 0; i < num_cepstral; i++) {
-                *(out_features->buffer + (num_cepstral * row) + i) = *(features_matrix.buffer + (features_matrix.cols * row) + i);
+        return EIDSP_OK;
+    }
+
+    /**
+     * Compute MFCC features from an audio signal.
+     * This builds a temporary plan, use the overload that takes an `mfcc_plan_t`
+     * when calling this repeatedly with the same parameters.
+     * @param out_features Use `calculate_mfcc_buffer_size` to allocate the right matrix.
+     * @param signal: audio signal structure from which to compute features.
+     *     has functions to retrieve data from a signal lazily.
+     * @param sampling_frequency (int): the sampling frequency of the signal
+     *     we are working with.
+     * @param frame_length (float): the length of each frame in seconds.
+     *     Default is 0.020s
+     * @param frame_stride (float): the step between successive frames in seconds.
+     *     Default is 0.01s (means no overlap)
+     * @param num_cepstral (int): Number of cepstral coefficients.
+     * @param num_filters (int): the number of filters in the filterbank,
+     *     default 40.
+     * @param fft_length (int): number of FFT points. Default is 512.
+     * @param low_frequency (int): lowest band edge of mel filters.
+     *     In Hz, default is 0.
+     * @param high_frequency (int): highest band edge of mel filters.
+     *     In Hz, default is samplerate/2
+     * @param dc_elimination Whether the first dc component should
+     *     be eliminated or not.
+     * @returns 0 if OK
+     */
+    static int mfcc(matrix_t *out_features, signal_t *signal,
+        uint32_t sampling_frequency, float frame_length = 0.02f, float frame_stride = 0.01f,
+        uint8_t num_cepstral = 13, uint16_t num_filters = 40, uint16_t fft_length = 512,
+        uint32_t low_frequency = 0, uint32_t high_frequency = 0, bool dc_elimination = true)
+    {
+        mfcc_plan_t plan;
+        int ret = create_mfcc_plan(&plan, sampling_frequency, frame_length, frame_stride,
+            num_cepstral, num_filters, fft_length, low_frequency, high_frequency);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        ret = mfcc(out_features, signal, &plan, dc_elimination);
+
+        free_mfcc_plan(&plan);
+
+        return ret;
+    }
+
+    /**
+     * Build a fixed point MFCC plan, takes the same parameters as `create_mfcc_plan`.
+     * fft_length needs to be a power of two between 32 and 4096.
+     * @param plan Plan to fill, release with `free_mfcc_q15_plan`
+     * @returns EIDSP_OK if OK
+     */
+    static int create_mfcc_q15_plan(mfcc_q15_plan_t *plan,
+        uint32_t sampling_frequency,
+        float frame_length, float frame_stride, uint8_t num_cepstral, uint16_t num_filters,
+        uint16_t fft_length, uint32_t low_frequency, uint32_t high_frequency)
+    {
+        memset(plan, 0, sizeof(mfcc_q15_plan_t));
+
+        if (num_cepstral > num_filters) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        int ret = create_mfcc_plan(&plan->plan, sampling_frequency, frame_length, frame_stride,
+            num_cepstral, num_filters, fft_length, low_frequency, high_frequency);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        ret = numpy::create_rfft_q31_plan(&plan->fft, fft_length);
+        if (ret != EIDSP_OK) {
+            free_mfcc_q15_plan(plan);
+            EIDSP_ERR(ret);
+        }
+
+        const size_t weights_count = plan->plan.weights_count > 0 ? plan->plan.weights_count : 1;
+        plan->weights = (uint16_t*)ei_dsp_calloc(weights_count, sizeof(uint16_t));
+        plan->dct_basis = (int16_t*)ei_dsp_calloc(num_cepstral * num_filters, sizeof(int16_t));
+        if (!plan->weights || !plan->dct_basis) {
+            free_mfcc_q15_plan(plan);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        // filterbank weights are in [0, 1], the float copy is not needed after this
+        for (size_t ix = 0; ix < plan->plan.weights_count; ix++) {
+            plan->weights[ix] = static_cast<uint16_t>(plan->plan.weights[ix] * 32768.0f + 0.5f);
+        }
+        ei_dsp_free(plan->plan.weights, weights_count * sizeof(float));
+        plan->plan.weights = NULL;
+
+        // same for the float DCT basis, the q15 one is built from the exact values
+        if (plan->plan.dct_basis) {
+            ei_dsp_free(plan->plan.dct_basis, num_filters * num_cepstral * sizeof(float));
+            plan->plan.dct_basis = NULL;
+        }
+
+        for (size_t i = 0; i < num_cepstral; i++) {
+            for (size_t j = 0; j < num_filters; j++) {
+                double v = dct_ortho_basis_value(i, j, num_filters);
+                plan->dct_basis[(i * num_filters) + j] = numpy::saturate_q15(
+                    static_cast<int32_t>(round(v * 32768.0)));
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Release the memory held by a fixed point MFCC plan
+     * @param plan Plan created through `create_mfcc_q15_plan`
+     */
+    static void free_mfcc_q15_plan(mfcc_q15_plan_t *plan)
+    {
+        if (plan->weights) {
+            ei_dsp_free(plan->weights,
+                (plan->plan.weights_count > 0 ? plan->plan.weights_count : 1) * sizeof(uint16_t));
+        }
+        if (plan->dct_basis) {
+            ei_dsp_free(plan->dct_basis, plan->plan.num_cepstral * plan->plan.num_filters * sizeof(int16_t));
+        }
+        numpy::free_rfft_q31_plan(&plan->fft);
+        free_mfcc_plan(&plan->plan);
+        memset(plan, 0, sizeof(mfcc_q15_plan_t));
+    }
+
+    /**
+     * Compute MFCC features from an audio signal, in fixed point (no floating point
+     * math in the per-frame loop besides the float to q15 conversion of the samples
+     * in `preemphasis_q15`, only the output is written as float).
+     * Every frame is normalized (block floating point) before a q31 FFT, the power
+     * spectrum and the filterbank are accumulated in 64 bits and the log is table based.
+     * Tolerance versus `mfcc`: coefficients differ by less than 0.005 (typically 0.001),
+     * after cmvnw fewer than 0.2% of the int8 quantized features move by one step.
+     * @param out_features Use `calculate_mfcc_buffer_size` to allocate the right matrix.
+     * @param signal: preemphasized audio signal
+     * @param plan Plan created through `create_mfcc_q15_plan`
+     * @param dc_elimination Whether the first dc component should
+     *     be eliminated or not.
+     * @returns 0 if OK
+     */
+    static int mfcc_q15(matrix_t *out_features, processing::preemphasis_q15 *signal,
+        const mfcc_q15_plan_t *plan, bool dc_elimination = true)
+    {
+        const mfcc_plan_t *p = &plan->plan;
+        const size_t total_length = signal->total_length();
+
+        if (out_features->cols != p->num_cepstral) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        int ret = EIDSP_OK;
+
+        // same framing as processing::frame_reader (no zero padding)
+        int32_t frame_count = processing::calculate_no_of_stack_frames(
+            total_length,
+            p->sampling_frequency,
+            p->frame_length,
+            p->frame_stride,
+            false);
+        if (frame_count < 0 || static_cast<size_t>(frame_count) != out_features->rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        const size_t frame_sample_length = static_cast<size_t>(
+            round(static_cast<float>(p->sampling_frequency) * p->frame_length));
+        const size_t frame_sample_stride = static_cast<size_t>(
+            round(static_cast<float>(p->sampling_frequency) * p->frame_stride));
+
+        const size_t n_fft = p->fft_length;
+        const size_t coefficients = n_fft / 2 + 1;
+        // only the first n_fft samples of a frame make it into the FFT
+        const size_t frame_length = frame_sample_length < n_fft ? frame_sample_length : n_fft;
+
+        // ln(FLT_EPSILON) in q16, what zero_handling + log give in the float version
+        const int32_t ln_epsilon = -1044800;
+        // ln(2) in q16
+        const int64_t ln_2 = 45426;
+
+        const size_t frame_mem_size = n_fft * sizeof(int32_t);
+        const size_t fft_output_mem_size = n_fft * 2 * sizeof(int32_t);
+        const size_t power_spectrum_mem_size = coefficients * sizeof(uint64_t);
+        const size_t log_mem_size = p->num_filters * sizeof(int32_t);
+
+        int32_t *frame = (int32_t*)ei_dsp_malloc(frame_mem_size);
+        int32_t *fft_output = (int32_t*)ei_dsp_malloc(fft_output_mem_size);
+        uint64_t *power_spectrum = (uint64_t*)ei_dsp_malloc(power_spectrum_mem_size);
+        int32_t *log_energies = (int32_t*)ei_dsp_malloc(log_mem_size);
+
+        if (!frame || !fft_output || !power_spectrum || !log_energies) {
+            ret = EIDSP_OUT_OF_MEM;
+        }
+
+        for (size_t ix = 0; ret == EIDSP_OK && ix < static_cast<size_t>(frame_count); ix++) {
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FRAMING);
+            // don't read outside of the audio buffer... we'll automatically zero pad then
+            size_t signal_offset = ix * frame_sample_stride;
+            size_t signal_length = frame_length;
+            if (signal_offset + signal_length > total_length) {
+                signal_length = total_length - signal_offset;
             }
+
+            ret = signal->get_data(signal_offset, signal_length, frame);
+            if (ret != EIDSP_OK) {
+                break;
+            }
+            if (signal_length < n_fft) {
+                memset(frame + signal_length, 0, (n_fft - signal_length) * sizeof(int32_t));
+            }
+
+            // block floating point: shift the frame so the peak lands in [2^29, 2^30),
+            // that leaves one bit of headroom for the FFT
+            uint32_t peak = 0;
+            for (size_t jx = 0; jx < signal_length; jx++) {
+                uint32_t v = frame[jx] < 0 ? -static_cast<uint32_t>(frame[jx]) : frame[jx];
+                if (v > peak) {
+                    peak = v;
+                }
+            }
+
+            int shift = 0;
+            if (peak > 0) {
+                while ((peak >> -shift) >= (1UL << 30)) {
+                    shift--;
+                }
+                while (shift >= 0 && (peak << shift) < (1UL << 29)) {
+                    shift++;
+                }
+            }
+            if (shift > 0) {
+                for (size_t jx = 0; jx < signal_length; jx++) {
+                    frame[jx] = frame[jx] * (1L << shift);
+                }
+            }
+            else if (shift < 0) {
+                for (size_t jx = 0; jx < signal_length; jx++) {
+                    frame[jx] = (frame[jx] + (1L << (-shift - 1))) >> -shift;
+                }
+            }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FRAMING);
+
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FFT);
+            ret = numpy::rfft_q31(&plan->fft, frame, fft_output);
+            if (ret != EIDSP_OK) {
+                break;
+            }
+
+            // power spectrum. The frame peaks below 2^30, so by Parseval the powers
+            // sum to less than 2^60
+            uint64_t energy = 0;
+            for (size_t jx = 0; jx < coefficients; jx++) {
+                int64_t re = fft_output[jx * 2];
+                int64_t im = fft_output[jx * 2 + 1];
+                power_spectrum[jx] = static_cast<uint64_t>((re * re) + (im * im));
+                energy += power_spectrum[jx];
+            }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FFT);
+
+            // the power spectrum is (DFT / n_fft)^2 of a frame scaled by 2^(30 + shift),
+            // the float version is DFT^2 / n_fft: correct for that in the log domain
+            const int32_t log2_correction =
+                (static_cast<int32_t>(plan->fft.n_fft_bits) - 60 - (2 * shift)) * 65536;
+
+            // the log is fused into the filterbank here, it counts as filterbank time
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_FILTERBANK);
+            for (size_t jx = 0; jx < p->num_filters; jx++) {
+                const sparse_mel_filter_t *filter = &p->filters[jx];
+                const uint64_t *bins = power_spectrum + filter->first_bin;
+                const uint16_t *weights = plan->weights + filter->weights_offset;
+
+                // bins * q15 weights, split in two so the 64 bit accumulator can't overflow
+                uint64_t acc = 0;
+                for (size_t k = 0; k < filter->bin_count; k++) {
+                    acc += ((bins[k] >> 15) * weights[k]) + (((bins[k] & 0x7fff) * weights[k]) >> 15);
+                }
+
+                if (acc == 0) {
+                    log_energies[jx] = ln_epsilon;
+                }
+                else {
+                    int32_t log2_value = numpy::log2_q16(acc) + log2_correction;
+                    log_energies[jx] = static_cast<int32_t>((log2_value * ln_2) >> 16);
+                }
+            }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_FILTERBANK);
+
+            EIDSP_PROFILE_BEGIN(EI_DSP_STAGE_DCT);
+            float *out_row = out_features->buffer + (ix * out_features->cols);
+
+            for (size_t i = 0; i < p->num_cepstral; i++) {
+                const int16_t *basis = plan->dct_basis + (i * p->num_filters);
+                int64_t acc = 0;
+                for (size_t j = 0; j < p->num_filters; j++) {
+                    acc += static_cast<int64_t>(basis[j]) * log_energies[j];
+                }
+                out_row[i] = static_cast<float>(acc >> 15) / 65536.0f;
+            }
+            EIDSP_PROFILE_END(EI_DSP_STAGE_DCT);
+
+            // replace first cepstral coefficient with log of frame energy for DC elimination
+            if (dc_elimination) {
+                int32_t log_energy = ln_epsilon;
+                if (energy > 0) {
+                    int32_t log2_value = numpy::log2_q16(energy) + log2_correction;
+                    log_energy = static_cast<int32_t>((log2_value * ln_2) >> 16);
+                }
+                out_row[0] = static_cast<float>(log_energy) / 65536.0f;
+            }
+        }
+
+        if (frame) ei_dsp_free(frame, frame_mem_size);
+        if (fft_output) ei_dsp_free(fft_output, fft_output_mem_size);
+        if (power_spectrum) ei_dsp_free(power_spectrum, power_spectrum_mem_size);
+        if (log_energies) ei_dsp_free(log_energies, log_mem_size);
+
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
         return EIDSP_OK;
@@ -24,24 +24,11 @@
 #define _EIDSP_SPEECHPY_PROCESSING_H_
 
 #include "../numpy.hpp"
+#include "../profiling.hpp"
 
 namespace ei {
 namespace speechpy {
 
-// one stack frame returned by stack_frames
-typedef struct ei_stack_frames_info {
-    signal_t *signal;
-    std::vector<uint32_t> *frame_ixs;
-    int frame_length;
-
-    // start_ixs is owned by us
-    ~ei_stack_frames_info() {
-        if (frame_ixs) {
-            delete frame_ixs;
-        }
-    }
-} stack_frames_info_t;
-
 namespace processing {
     /**
      * Lazy Preemphasising on the signal.
@@ -75,6 +62,8 @@ public:
          * @param length Length of the audio signal
          */
         int get_data(size_t offset, size_t length, float *out_buffer) {
+            EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_PREEMPHASIS);
+
             if (!_prev_buffer || !_end_of_signal_buffer) {
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
@@ -83,7 +72,8 @@ public:
             }
 
             int ret;
-            if (static_cast<int32_t>(offset) - _shift >= 0) {
+            // reading on from the last call, the history is in _prev_buffer already
+            if (static_cast<int32_t>(offset) - _shift >= 0 && offset != _next_offset_should_be) {
                 ret = _signal->get_data(offset - _shift, _shift, _prev_buffer);
                 if (ret != 0) {
                     EIDSP_ERR(ret);
@@ -116,7 +106,7 @@ public:
                 _prev_buffer[_shift - 1] = now;
             }
 
-            _next_offset_should_be += length;
+            _next_offset_should_be = offset + length;
 
             return EIDSP_OK;
         }
@@ -138,6 +128,332 @@ private:
         float *_end_of_signal_buffer;
         size_t _next_offset_should_be;
     };
+
+    /**
+     * Lazy preemphasising on the signal, in fixed point. Same filter as the
+     * `preemphasis` class, but the samples are converted to q15 when they are
+     * read and the output is q30 in an int32_t (q15 * q15 without rounding, the
+     * filtered signal can go up to (1 + cof)).
+     * The input stays float because that is all `signal_t` delivers; int16 audio
+     * goes through `numpy::int16_to_float` first, which maps back to the same
+     * q15 values exactly.
+     * @param signal: The input signal, in the range [-1, 1)
+     * @param shift (int): The shift step.
+     * @param cof (float): The preemphasising coefficient. 0 equals to no filtering.
+     * @param history `shift` samples that came before the signal, or NULL to
+     *     take them from the end of the signal
+     */
+    class preemphasis_q15 {
+public:
+        preemphasis_q15(ei_signal_t *signal, int shift = 1, float cof = 0.98f, const float *history = NULL)
+            : _signal(signal), _shift(shift), _next_offset(0)
+        {
+            _cof = static_cast<int32_t>(cof * 32768.0f + 0.5f);
+            _prev_buffer = (int16_t*)ei_dsp_calloc(shift * sizeof(int16_t), 1);
+            _end_of_signal_buffer = (int16_t*)ei_dsp_calloc(shift * sizeof(int16_t), 1);
+
+            if (shift < 0) {
+                _shift = signal->total_length + shift;
+            }
+
+            if (!_prev_buffer || !_end_of_signal_buffer) return;
+
+            if (history) {
+                for (int ix = 0; ix < shift; ix++) {
+                    _end_of_signal_buffer[ix] = to_q15(history[ix]);
+                }
+                return;
+            }
+
+            // we need to get the shift bytes from the end of the buffer...
+            read_q15(signal->total_length - shift, shift, _end_of_signal_buffer);
+        }
+
+        /**
+         * Get preemphasized data from the underlying audio buffer, in q30
+         * @param offset Offset in the audio signal
+         * @param length Length of the audio signal
+         * @param out_buffer Output, `length` q30 values
+         */
+        int get_data(size_t offset, size_t length, int32_t *out_buffer) {
+            EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_PREEMPHASIS);
+
+            if (!_prev_buffer || !_end_of_signal_buffer) {
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
+            if (offset + length > _signal->total_length) {
+                EIDSP_ERR(EIDSP_OUT_OF_BOUNDS);
+            }
+
+            int ret;
+            // reading on from the last call, the history is in _prev_buffer already
+            if (static_cast<int32_t>(offset) - _shift >= 0 && offset != _next_offset) {
+                ret = read_q15(offset - _shift, _shift, _prev_buffer);
+                if (ret != 0) {
+                    EIDSP_ERR(ret);
+                }
+            }
+            // else we'll use the end_of_signal_buffer; so no need to check
+
+            float chunk[32];
+
+            for (size_t chunk_ix = 0; chunk_ix < length; chunk_ix += 32) {
+                size_t chunk_length = length - chunk_ix < 32 ? length - chunk_ix : 32;
+
+                ret = _signal->get_data(offset + chunk_ix, chunk_length, chunk);
+                if (ret != 0) {
+                    EIDSP_ERR(ret);
+                }
+
+                for (size_t ix = 0; ix < chunk_length; ix++) {
+                    int16_t now = to_q15(chunk[ix]);
+                    int32_t history;
+
+                    // under shift? read from end
+                    if (offset + chunk_ix + ix < static_cast<uint32_t>(_shift)) {
+                        history = _end_of_signal_buffer[offset + chunk_ix + ix];
+                    }
+                    // otherwise read from history buffer
+                    else {
+                        history = _prev_buffer[0];
+                    }
+
+                    out_buffer[chunk_ix + ix] = (now * 32768) - (_cof * history);
+
+                    // roll through and overwrite last element
+                    if (_shift != 1) {
+                        memmove(_prev_buffer, _prev_buffer + 1, (_shift - 1) * sizeof(int16_t));
+                    }
+                    _prev_buffer[_shift - 1] = now;
+                }
+            }
+
+            _next_offset = offset + length;
+
+            return EIDSP_OK;
+        }
+
+        /**
+         * Length of the underlying signal
+         */
+        size_t total_length() const {
+            return _signal->total_length;
+        }
+
+        ~preemphasis_q15() {
+            if (_prev_buffer) {
+                ei_dsp_free(_prev_buffer, _shift * sizeof(int16_t));
+            }
+            if (_end_of_signal_buffer) {
+                ei_dsp_free(_end_of_signal_buffer, _shift * sizeof(int16_t));
+            }
+        }
+
+private:
+        static int16_t to_q15(float value) {
+            return numpy::saturate_q15(static_cast<int32_t>(roundf(value * 32768.0f)));
+        }
+
+        int read_q15(size_t offset, size_t length, int16_t *out_buffer) {
+            float chunk[32];
+
+            for (size_t chunk_ix = 0; chunk_ix < length; chunk_ix += 32) {
+                size_t chunk_length = length - chunk_ix < 32 ? length - chunk_ix : 32;
+
+                int ret = _signal->get_data(offset + chunk_ix, chunk_length, chunk);
+                if (ret != 0) {
+                    return ret;
+                }
+
+                for (size_t ix = 0; ix < chunk_length; ix++) {
+                    out_buffer[chunk_ix + ix] = to_q15(chunk[ix]);
+                }
+            }
+
+            return EIDSP_OK;
+        }
+
+        ei_signal_t *_signal;
+        int _shift;
+        int32_t _cof;
+        int16_t *_prev_buffer;
+        int16_t *_end_of_signal_buffer;
+        size_t _next_offset;
+    };
+
+    /**
+     * Pre-emphasis that `frame_reader` applies while it reads the signal.
+     * `history` holds the `shift` samples that came before the signal (f.e. the
+     * end of the previous slice of a stream), NULL takes them from the end of
+     * the signal itself, which is what `preemphasis` does.
+     */
+    typedef struct {
+        int shift;
+        float cof;
+        const float *history;
+    } preemphasis_params_t;
+
+    /**
+     * Frames a signal in one pass, front to back. Frame `ix` starts at sample
+     * `ix * frame_stride`, the frames `calculate_no_of_stack_frames` counts
+     * without zero padding. Every sample is read from the signal once:
+     * consecutive frames share their overlap, and
+     * pre-emphasis runs over the samples as they are read, so `next_frame`
+     * fills the buffer the FFT reads. Frames that run past the end of the
+     * signal are zero padded.
+     */
+    class frame_reader {
+public:
+        /**
+         * @param signal The signal to frame
+         * @param frame_length Length of a frame, in samples
+         * @param frame_stride Step between the starts of two frames, in samples
+         * @param preemphasis Pre-emphasis to apply, NULL reads the signal as is
+         */
+        frame_reader(ei_signal_t *signal, size_t frame_length, size_t frame_stride,
+            const preemphasis_params_t *preemphasis = NULL)
+            : _signal(signal), _frame_length(frame_length), _frame_stride(frame_stride),
+              _frame_ix(0), _read_offset(0), _shift(0), _cof(0.0f), _history(NULL), _history_ix(0),
+              _error(EIDSP_OK)
+        {
+            if (!preemphasis || preemphasis->cof == 0.0f) {
+                return;
+            }
+            if (preemphasis->shift < 1 || static_cast<size_t>(preemphasis->shift) > frame_length ||
+                static_cast<size_t>(preemphasis->shift) > signal->total_length) {
+                _error = EIDSP_PARAMETER_INVALID;
+                return;
+            }
+
+            _shift = preemphasis->shift;
+            _cof = preemphasis->cof;
+            _history = (float*)ei_dsp_calloc(_shift * sizeof(float), 1);
+            if (!_history) {
+                _error = EIDSP_OUT_OF_MEM;
+                return;
+            }
+
+            if (preemphasis->history) {
+                memcpy(_history, preemphasis->history, _shift * sizeof(float));
+            }
+            else {
+                _error = signal->get_data(signal->total_length - _shift, _shift, _history);
+            }
+        }
+
+        ~frame_reader() {
+            if (_history) {
+                ei_dsp_free(_history, _shift * sizeof(float));
+            }
+        }
+
+        /**
+         * Read the next frame
+         * @param frame Frame buffer of `frame_length` items. Pass the same buffer
+         *     every call, the overlap with the previous frame is taken from it.
+         * @returns EIDSP_OK if OK
+         */
+        int next_frame(float *frame) {
+            if (_error != EIDSP_OK) {
+                EIDSP_ERR(_error);
+            }
+
+            const size_t total_length = _signal->total_length;
+            const size_t start = _frame_ix * _frame_stride;
+            const size_t end = start + _frame_length;
+            int ret;
+
+            // the buffer holds the previous frame up to _read_offset, keep the overlap
+            size_t kept = 0;
+            if (_frame_ix > 0 && _read_offset > start) {
+                kept = _read_offset - start;
+                memmove(frame, frame + _frame_stride, kept * sizeof(float));
+            }
+            // frames further apart than their length skip samples, only the
+            // pre-emphasis needs the last `shift` of those
+            else if (_read_offset < start) {
+                const size_t gap_end = start < total_length ? start : total_length;
+                if (_history && _read_offset + _shift < gap_end) {
+                    _read_offset = gap_end - _shift;
+                }
+                if (_history && _read_offset < gap_end) {
+                    ret = read(_read_offset, gap_end - _read_offset, frame);
+                    if (ret != EIDSP_OK) {
+                        EIDSP_ERR(ret);
+                    }
+                }
+                _read_offset = start;
+            }
+
+            const size_t read_end = end < total_length ? end : total_length;
+            if (start + kept < read_end) {
+                ret = read(start + kept, read_end - (start + kept), frame + kept);
+                if (ret != EIDSP_OK) {
+                    EIDSP_ERR(ret);
+                }
+                kept = read_end - start;
+            }
+
+            if (kept < _frame_length) {
+                memset(frame + kept, 0, (_frame_length - kept) * sizeof(float));
+            }
+
+            _frame_ix++;
+            return EIDSP_OK;
+        }
+
+private:
+        /**
+         * Read samples [offset, offset + length) into out_buffer, pre-emphasized
+         */
+        int read(size_t offset, size_t length, float *out_buffer) {
+            int ret = _signal->get_data(offset, length, out_buffer);
+            if (ret != 0) {
+                return ret;
+            }
+            _read_offset = offset + length;
+
+            if (!_history) {
+                return EIDSP_OK;
+            }
+
+            EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_PREEMPHASIS);
+
+            // the common case, keep the previous sample in a register
+            if (_shift == 1) {
+                float prev = _history[0];
+                for (size_t ix = 0; ix < length; ix++) {
+                    float now = out_buffer[ix];
+                    out_buffer[ix] = now - (_cof * prev);
+                    prev = now;
+                }
+                _history[0] = prev;
+                return EIDSP_OK;
+            }
+
+            for (size_t ix = 0; ix < length; ix++) {
+                float now = out_buffer[ix];
+                out_buffer[ix] = now - (_cof * _history[_history_ix]);
+                _history[_history_ix] = now;
+                if (++_history_ix == static_cast<size_t>(_shift)) {
+                    _history_ix = 0;
+                }
+            }
+
+            return EIDSP_OK;
+        }
+
+        ei_signal_t *_signal;
+        size_t _frame_length;
+        size_t _frame_stride;
+        size_t _frame_ix;
+        size_t _read_offset;            // everything before this went through the filter
+        int _shift;
+        float _cof;
+        float *_history;                // ring of the last `shift` samples read, oldest at `_history_ix`
+        size_t _history_ix;
+        int _error;
+    };
 }
 
 namespace processing {
@@ -182,70 +498,6 @@ namespace processing {
         return EIDSP_OK;
     }
 
-    /**
-     * Frame a signal into overlapping frames.
-     * @param info This is both the base object and where we'll store our results.
-     * @param sampling_frequency (int): The sampling frequency of the signal.
-     * @param frame_length (float): The length of the frame in second.
-     * @param frame_stride (float): The stride between frames.
-     * @param zero_padding (bool): If the samples is not a multiple of
-     *        frame_length(number of frames sample), zero padding will
-     *        be done for generating last frame.
-     * @returns EIDSP_OK if OK
-     */
-    static int stack_frames(stack_frames_info_t *info,
-                            uint32_t sampling_frequency,
-                            float frame_length,
-                            float frame_stride,
-                            bool zero_padding)
-    {
-        if (!info->signal || !info->signal->get_data || info->signal->total_length == 0) {
-            EIDSP_ERR(EIDSP_SIGNAL_SIZE_MISMATCH);
-        }
-
-        size_t length_signal = info->signal->total_length;
-        int frame_sample_length = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_length));
-        frame_stride = round(static_cast<float>(sampling_frequency) * frame_stride);
-
-        volatile int numframes;
-        volatile int len_sig;
-
-        if (zero_padding) {
-            // Calculation of number of frames
-            numframes = static_cast<int>(
-                ceil(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
-
-            // Zero padding
-            len_sig = static_cast<int>(static_cast<float>(numframes) * frame_stride) + frame_sample_length;
-
-            info->signal->total_length = static_cast<size_t>(len_sig);
-        }
-        else {
-            numframes = static_cast<int>(
-                floor(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
-            len_sig = static_cast<int>(
-                (static_cast<float>(numframes - 1) * frame_stride + frame_sample_length));
-
-            info->signal->total_length = static_cast<size_t>(len_sig);
-        }
-
-        // alloc the vector on the heap, will be owned by the info struct
-        std::vector<uint32_t> *frame_indices = new std::vector<uint32_t>();
-
-        int frame_count = 0;
-
-        for (size_t ix = 0; ix < static_cast<uint32_t>(len_sig); ix += static_cast<size_t>(frame_stride)) {
-            if (++frame_count > numframes) break;
-
-            frame_indices->push_back(ix);
-        }
-
-        info->frame_ixs = frame_indices;
-        info->frame_length = frame_sample_length;
-
-        return EIDSP_OK;
-    }
-
     /**
      * Calculate the number of stack frames for the settings provided.
      * This is needed to allocate the right buffer size for the output of f.e. the MFE
@@ -286,37 +538,101 @@ namespace processing {
     }
 
     /**
-     * Power spectrum of a frame
+     * Power spectrum of a frame, using a prebuilt FFT plan and caller-owned scratch,
+     * does not allocate.
+     * @param plan FFT plan, the frames will be zero-padded to plan->n_fft
      * @param frame Row of a frame
      * @param frame_size Size of the frame
-     * @param out_buffer Out buffer, size should be fft_points
-     * @param out_buffer_size Buffer size
-     * @param fft_points (int): The length of FFT. If fft_length is greater than frame_len, the frames will be zero-padded.
+     * @param out_buffer Out buffer
+     * @param out_buffer_size Buffer size, should be plan->n_fft / 2 + 1
+     * @param scratch Buffer of `numpy::rfft_scratch_size(plan->n_fft)` floats
      * @returns EIDSP_OK if OK
      */
-    static int power_spectrum(float *frame, size_t frame_size, float *out_buffer, size_t out_buffer_size, uint16_t fft_points)
+    static int power_spectrum(const fft_plan_t *plan, float *frame, size_t frame_size,
+        float *out_buffer, size_t out_buffer_size, float *scratch)
     {
-        if (out_buffer_size != static_cast<size_t>(fft_points / 2 + 1)) {
+        if (out_buffer_size != plan->n_fft / 2 + 1) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
-        int r = numpy::rfft(frame, frame_size, out_buffer, out_buffer_size, fft_points);
+        int r = numpy::rfft(plan, frame, frame_size, out_buffer, out_buffer_size, scratch);
         if (r != EIDSP_OK) {
             return r;
         }
 
         for (size_t ix = 0; ix < out_buffer_size; ix++) {
-            out_buffer[ix] = (1.0 / static_cast<float>(fft_points)) *
+            out_buffer[ix] = (1.0 / static_cast<float>(plan->n_fft)) *
                 (out_buffer[ix] * out_buffer[ix]);
         }
 
         return EIDSP_OK;
     }
 
+    /**
+     * Sum of the first k entries of the symmetric (edge repeating) extension
+     * of a column, given the prefix sums of the column itself.
+     * @param prefix rows + 1 prefix sums, prefix[0] == 0
+     * @param rows Number of rows in the column
+     * @param k Number of entries, relative to the first row (may be negative)
+     */
+    static inline double cmvnw_symmetric_prefix_sum(const double *prefix, int32_t rows, int32_t k)
+    {
+        // the symmetric extension repeats every 2 * rows entries
+        const int32_t period = 2 * rows;
+        int32_t periods = k / period;
+        int32_t rest = k % period;
+        if (rest < 0) {
+            rest += period;
+            periods--;
+        }
+
+        double partial = rest <= rows ? prefix[rest] : 2 * prefix[rows] - prefix[period - rest];
+        return (periods * 2 * prefix[rows]) + partial;
+    }
+
+    /**
+     * Normalize one value of a column with the statistics of its cmvnw window
+     * @param value Value at `row` in the column
+     * @param sum_prefix rows + 1 prefix sums of the column
+     * @param sq_prefix rows + 1 prefix sums of the squares of the column
+     * @param rows Number of rows in the column
+     * @param row Row of the value
+     * @param win_size The size of the sliding window
+     * @param variance_normalization If the variance normalization should be performed
+     */
+    static inline float cmvnw_value(float value, const double *sum_prefix, const double *sq_prefix,
+        int32_t rows, int32_t row, uint16_t win_size, bool variance_normalization)
+    {
+        // the window covers rows [row - pad_size, row - pad_size + win_size) of the
+        // symmetrically padded column
+        int32_t window_start = row - ((win_size - 1) / 2);
+        int32_t window_end = window_start + win_size;
+
+        double window_sum = cmvnw_symmetric_prefix_sum(sum_prefix, rows, window_end) -
+            cmvnw_symmetric_prefix_sum(sum_prefix, rows, window_start);
+        float mean = window_sum / win_size;
+
+        if (variance_normalization == true) {
+            double window_sq_sum = cmvnw_symmetric_prefix_sum(sq_prefix, rows, window_end) -
+                cmvnw_symmetric_prefix_sum(sq_prefix, rows, window_start);
+            double window_mean = window_sum / win_size;
+            double variance = (window_sq_sum / win_size) - (window_mean * window_mean);
+            float std = variance > 0 ? sqrt(variance) : 0.0f;
+
+            return (value - mean) / (std + FLT_EPSILON);
+        }
+        else {
+            return value - mean;
+        }
+    }
+
     /**
      * This function performs local cepstral mean and
      * variance normalization on a sliding window. The code assumes that
      * there is one observation per row.
+     * With EIDSP_CMVNW_RUNNING_SUMS the window statistics come from running
+     * (prefix) sums per column, which is O(rows x cols) instead of
+     * O(rows x win_size x cols) and does not build the padded matrix.
      * @param features_matrix input feature matrix, will be modified in place
      * @param win_size The size of sliding window for local normalization.
      *   Default=301 which is around 3s if 100 Hz rate is
@@ -329,9 +645,51 @@ namespace processing {
     static int cmvnw(matrix_t *features_matrix, uint16_t win_size = 301, bool variance_normalization = false,
         bool scale = false)
     {
-        uint16_t pad_size = (win_size - 1) / 2;
+        EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_CMVN);
 
         int ret;
+
+#if EIDSP_CMVNW_RUNNING_SUMS == 1
+        if (features_matrix->rows == 0) {
+            EIDSP_ERR(EIDSP_INPUT_MATRIX_EMPTY);
+        }
+
+        const int32_t rows = features_matrix->rows;
+        const size_t cols = features_matrix->cols;
+        const size_t prefix_size = (rows + 1) * sizeof(double);
+
+        // prefix sums (and sums of squares) of the current column
+        double *sum_prefix = (double*)ei_dsp_malloc(prefix_size);
+        if (!sum_prefix) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        double *sq_prefix = (double*)ei_dsp_malloc(prefix_size);
+        if (!sq_prefix) {
+            ei_dsp_free(sum_prefix, prefix_size);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        for (size_t col = 0; col < cols; col++) {
+            sum_prefix[0] = 0;
+            sq_prefix[0] = 0;
+            for (int32_t row = 0; row < rows; row++) {
+                double v = features_matrix->buffer[(row * cols) + col];
+                sum_prefix[row + 1] = sum_prefix[row] + v;
+                sq_prefix[row + 1] = sq_prefix[row] + (v * v);
+            }
+
+            for (int32_t row = 0; row < rows; row++) {
+                float *feature = &features_matrix->buffer[(row * cols) + col];
+                *feature = cmvnw_value(*feature, sum_prefix, sq_prefix, rows, row, win_size,
+                    variance_normalization);
+            }
+        }
+
+        ei_dsp_free(sum_prefix, prefix_size);
+        ei_dsp_free(sq_prefix, prefix_size);
+#else
+        uint16_t pad_size = (win_size - 1) / 2;
+
         float *features_buffer_ptr;
 
         // mean & variance normalization
@@ -388,6 +746,7 @@ namespace processing {
                 }
             }
         }
+#endif // EIDSP_CMVNW_RUNNING_SUMS == 1
 
         if (scale) {
             ret = numpy::normalize(features_matrix);
@@ -398,6 +757,128 @@ namespace processing {
 
         return EIDSP_OK;
     }
+
+    /**
+     * cmvnw straight into an int8 matrix, for features that go into a quantized
+     * input tensor. The input is only read, and the rows are passed as pointers
+     * so they don't need to be contiguous (e.g. a window that wraps around a ring
+     * buffer). With EIDSP_CMVNW_RUNNING_SUMS=0 the rows are copied into a float
+     * matrix for the padded window loop of cmvnw, and quantized from there.
+     * @param feature_rows Pointer to each row (cols features), NULL for a row of zeros
+     * @param rows Number of rows
+     * @param cols Number of features per row
+     * @param out_matrix Output matrix (rows x cols)
+     * @param quantization_scale Scale of the quantized output
+     * @param quantization_zero_point Zero point of the quantized output
+     * @param win_size The size of sliding window for local normalization.
+     * @param variance_normalization If the variance normilization should
+     *   be performed or not.
+     * @param scale Scale to 0..1 before quantizing
+     * @returns 0 if OK
+     */
+    __attribute__((unused)) static int cmvnw_quantized(const float * const *feature_rows, size_t rows, size_t cols,
+        matrix_i8_t *out_matrix, float quantization_scale, int32_t quantization_zero_point,
+        uint16_t win_size = 301, bool variance_normalization = false, bool scale = false)
+    {
+        if (rows == 0) {
+            EIDSP_ERR(EIDSP_INPUT_MATRIX_EMPTY);
+        }
+        if (out_matrix->rows * out_matrix->cols != rows * cols) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        const float inverse_scale = 1.0f / quantization_scale;
+
+#if EIDSP_CMVNW_RUNNING_SUMS == 1
+        EIDSP_PROFILE_SCOPE(EI_DSP_STAGE_CMVN);
+
+        const size_t prefix_size = (rows + 1) * sizeof(double);
+
+        double *sum_prefix = (double*)ei_dsp_malloc(prefix_size);
+        if (!sum_prefix) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        double *sq_prefix = (double*)ei_dsp_malloc(prefix_size);
+        if (!sq_prefix) {
+            ei_dsp_free(sum_prefix, prefix_size);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        // when scaling the min / max of the normalized features are needed first,
+        // so normalize twice rather than keeping a float copy around
+        float min = 0.0f;
+        float max = 0.0f;
+        float range_scale = 1.0f;
+
+        for (int pass = scale ? 0 : 1; pass < 2; pass++) {
+            for (size_t col = 0; col < cols; col++) {
+                sum_prefix[0] = 0;
+                sq_prefix[0] = 0;
+                for (size_t row = 0; row < rows; row++) {
+                    double v = feature_rows[row] ? feature_rows[row][col] : 0.0f;
+                    sum_prefix[row + 1] = sum_prefix[row] + v;
+                    sq_prefix[row + 1] = sq_prefix[row] + (v * v);
+                }
+
+                for (size_t row = 0; row < rows; row++) {
+                    float v = feature_rows[row] ? feature_rows[row][col] : 0.0f;
+                    v = cmvnw_value(v, sum_prefix, sq_prefix, rows, row, win_size,
+                        variance_normalization);
+
+                    if (pass == 0) {
+                        if ((row == 0 && col == 0) || v < min) {
+                            min = v;
+                        }
+                        if ((row == 0 && col == 0) || v > max) {
+                            max = v;
+                        }
+                        continue;
+                    }
+
+                    if (scale) {
+                        v = (v - min) * range_scale;
+                    }
+                    out_matrix->buffer[(row * cols) + col] =
+                        numpy::quantize_int8(v, inverse_scale, quantization_zero_point);
+                }
+            }
+
+            if (pass == 0) {
+                range_scale = 1.0f / (max - min);
+            }
+        }
+
+        ei_dsp_free(sum_prefix, prefix_size);
+        ei_dsp_free(sq_prefix, prefix_size);
+#else
+        EI_DSP_MATRIX(features_matrix, rows, cols);
+        if (!features_matrix.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        for (size_t row = 0; row < rows; row++) {
+            float *out_row = features_matrix.buffer + (row * cols);
+            if (feature_rows[row]) {
+                memcpy(out_row, feature_rows[row], cols * sizeof(float));
+            }
+            else {
+                memset(out_row, 0, cols * sizeof(float));
+            }
+        }
+
+        int ret = cmvnw(&features_matrix, win_size, variance_normalization, scale);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        for (size_t ix = 0; ix < rows * cols; ix++) {
+            out_matrix->buffer[ix] =
+                numpy::quantize_int8(features_matrix.buffer[ix], inverse_scale, quantization_zero_point);
+        }
+#endif // EIDSP_CMVNW_RUNNING_SUMS == 1
+
+        return EIDSP_OK;
+    }
 };
 
 } // namespace speechpy
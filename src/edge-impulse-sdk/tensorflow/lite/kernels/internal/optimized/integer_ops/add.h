@@ -0,0 +1,134 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ADD_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ADD_H_
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/types.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/x86_simd.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// SSE4.1 version of reference_integer_ops::AddElementwise, 4 elements at a
+// time, with the same output (the fused ReLU is the activation clamp).
+inline void AddElementwise(int size, const ArithmeticParams& params,
+                           const int8_t* input1_data, const int8_t* input2_data,
+                           int8_t* output_data) {
+  const __m128i input1_offset = _mm_set1_epi32(params.input1_offset);
+  const __m128i input2_offset = _mm_set1_epi32(params.input2_offset);
+  const __m128i output_offset = _mm_set1_epi32(params.output_offset);
+  const __m128i activation_min = _mm_set1_epi32(params.quantized_activation_min);
+  const __m128i activation_max = _mm_set1_epi32(params.quantized_activation_max);
+  const __m128i left_shift = _mm_cvtsi32_si128(params.left_shift);
+
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m128i input1_val =
+        _mm_add_epi32(x86::LoadInt8x4(input1_data + i), input1_offset);
+    __m128i input2_val =
+        _mm_add_epi32(x86::LoadInt8x4(input2_data + i), input2_offset);
+    __m128i scaled_input1_val =
+        x86::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+            _mm_sll_epi32(input1_val, left_shift), params.input1_multiplier,
+            params.input1_shift);
+    __m128i scaled_input2_val =
+        x86::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+            _mm_sll_epi32(input2_val, left_shift), params.input2_multiplier,
+            params.input2_shift);
+    __m128i raw_sum = _mm_add_epi32(scaled_input1_val, scaled_input2_val);
+    __m128i raw_output = _mm_add_epi32(
+        x86::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+            raw_sum, params.output_multiplier, params.output_shift),
+        output_offset);
+    __m128i clamped_output =
+        _mm_min_epi32(activation_max, _mm_max_epi32(activation_min, raw_output));
+    x86::StoreInt8x4(output_data + i, clamped_output);
+  }
+
+  if (i < size) {
+    reference_integer_ops::AddElementwise(size - i, params, input1_data + i,
+                                          input2_data + i, output_data + i);
+  }
+}
+
+inline void Add(const ArithmeticParams& params,
+                const RuntimeShape& input1_shape, const int8_t* input1_data,
+                const RuntimeShape& input2_shape, const int8_t* input2_data,
+                const RuntimeShape& output_shape, int8_t* output_data) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  const int flat_size =
+      MatchingElementsSize(input1_shape, input2_shape, output_shape);
+  AddElementwise(flat_size, params, input1_data, input2_data, output_data);
+}
+
+// Broadcast add. The common case in conv / dense models, one input covering
+// the whole output and the other one a vector along the innermost dimension
+// (a bias), runs row by row through AddElementwise. Other broadcasts go to
+// the reference kernel.
+inline void BroadcastAdd4DSlow(const ArithmeticParams& params,
+                               const RuntimeShape& input1_shape,
+                               const int8_t* input1_data,
+                               const RuntimeShape& input2_shape,
+                               const int8_t* input2_data,
+                               const RuntimeShape& output_shape,
+                               int8_t* output_data) {
+  const RuntimeShape extended_output_shape =
+      RuntimeShape::ExtendedShape(4, output_shape);
+  const RuntimeShape extended_input1_shape =
+      RuntimeShape::ExtendedShape(4, input1_shape);
+  const RuntimeShape extended_input2_shape =
+      RuntimeShape::ExtendedShape(4, input2_shape);
+  const int depth = extended_output_shape.Dims(3);
+  const int flat_size = extended_output_shape.FlatSize();
+
+  const bool input1_full = extended_input1_shape == extended_output_shape;
+  const bool input2_full = extended_input2_shape == extended_output_shape;
+  const bool input1_row = extended_input1_shape.FlatSize() == depth &&
+                          extended_input1_shape.Dims(3) == depth;
+  const bool input2_row = extended_input2_shape.FlatSize() == depth &&
+                          extended_input2_shape.Dims(3) == depth;
+
+  if (input1_full && input2_row) {
+    for (int offset = 0; offset < flat_size; offset += depth) {
+      AddElementwise(depth, params, input1_data + offset, input2_data,
+                     output_data + offset);
+    }
+  } else if (input2_full && input1_row) {
+    // the sum of the scaled inputs is symmetric, so swap the inputs
+    ArithmeticParams swapped_params = params;
+    swapped_params.input1_offset = params.input2_offset;
+    swapped_params.input1_multiplier = params.input2_multiplier;
+    swapped_params.input1_shift = params.input2_shift;
+    swapped_params.input2_offset = params.input1_offset;
+    swapped_params.input2_multiplier = params.input1_multiplier;
+    swapped_params.input2_shift = params.input1_shift;
+    for (int offset = 0; offset < flat_size; offset += depth) {
+      AddElementwise(depth, swapped_params, input2_data + offset, input1_data,
+                     output_data + offset);
+    }
+  } else {
+    reference_integer_ops::BroadcastAdd4DSlow(
+        params, input1_shape, input1_data, input2_shape, input2_data,
+        output_shape, output_data);
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_ADD_H_
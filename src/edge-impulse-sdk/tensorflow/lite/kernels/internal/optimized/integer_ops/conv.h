@@ -0,0 +1,136 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/x86_simd.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Fixed-point per-channel-quantization convolution, SSE4.1 / AVX2 version of
+// reference_integer_ops::ConvPerChannel with the same output. With NHWC input
+// and OHWI filters, the taps of one filter row that fall inside the image are
+// contiguous in both tensors (unless the width is dilated), so every filter
+// row is a single dot product.
+inline void ConvPerChannel(
+    const ConvParams& params, const int32* output_multiplier,
+    const int32* output_shift, const RuntimeShape& input_shape,
+    const int8* input_data, const RuntimeShape& filter_shape,
+    const int8* filter_data, const RuntimeShape& bias_shape,
+    const int32* bias_data, const RuntimeShape& output_shape,
+    int8* output_data) {
+  // Get parameters.
+  const int32 input_offset = params.input_offset;  // r = s(q - Z)
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32 output_offset = params.output_offset;
+
+  // Set min and max value of the output.
+  const int32 output_activation_min = params.quantized_activation_min;
+  const int32 output_activation_max = params.quantized_activation_max;
+
+  // Sanity check.
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  // Check dimensions of the tensors.
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        // Zero padding by omitting the taps outside the image.
+        const int filter_x_start =
+            dilation_width_factor == 1 ? std::max(0, -in_x_origin) : 0;
+        const int filter_x_end =
+            dilation_width_factor == 1
+                ? std::min(filter_width, input_width - in_x_origin)
+                : filter_width;
+
+        int8* out_ptr =
+            &output_data[Offset(output_shape, batch, out_y, out_x, 0)];
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int32 acc = 0;
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y = in_y_origin + dilation_height_factor * filter_y;
+            if (in_y < 0 || in_y >= input_height) {
+              continue;
+            }
+            if (dilation_width_factor == 1) {
+              if (filter_x_end > filter_x_start) {
+                acc += x86::DotProductInt8(
+                    &input_data[Offset(input_shape, batch, in_y,
+                                       in_x_origin + filter_x_start, 0)],
+                    input_offset,
+                    &filter_data[Offset(filter_shape, out_channel, filter_y,
+                                        filter_x_start, 0)],
+                    0, (filter_x_end - filter_x_start) * input_depth);
+              }
+              continue;
+            }
+            for (int filter_x = filter_x_start; filter_x < filter_x_end;
+                 ++filter_x) {
+              const int in_x = in_x_origin + dilation_width_factor * filter_x;
+              if (in_x < 0 || in_x >= input_width) {
+                continue;
+              }
+              acc += x86::DotProductInt8(
+                  &input_data[Offset(input_shape, batch, in_y, in_x, 0)],
+                  input_offset,
+                  &filter_data[Offset(filter_shape, out_channel, filter_y,
+                                      filter_x, 0)],
+                  0, input_depth);
+            }
+          }
+
+          if (bias_data) {
+            acc += bias_data[out_channel];
+          }
+          acc = MultiplyByQuantizedMultiplier(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          acc += output_offset;
+          acc = std::max(acc, output_activation_min);
+          acc = std::min(acc, output_activation_max);
+          out_ptr[out_channel] = static_cast<int8_t>(acc);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
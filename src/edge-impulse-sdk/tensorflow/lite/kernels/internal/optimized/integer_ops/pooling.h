@@ -0,0 +1,127 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
+
+#include <limits>
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/x86_simd.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// SSE4.1 version of reference_integer_ops::MaxPool (int8), with the same
+// output. Takes the max over the window for 16 (then 8) channels at a time.
+inline void MaxPool(const PoolParams& params, const RuntimeShape& input_shape,
+                    const int8* input_data, const RuntimeShape& output_shape,
+                    int8* output_data) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK_GE(params.quantized_activation_min,
+                   std::numeric_limits<int8_t>::min());
+  TFLITE_DCHECK_LE(params.quantized_activation_max,
+                   std::numeric_limits<int8_t>::max());
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int stride_height = params.stride_height;
+  const int stride_width = params.stride_width;
+  const __m128i activation_min =
+      _mm_set1_epi8(static_cast<int8_t>(params.quantized_activation_min));
+  const __m128i activation_max =
+      _mm_set1_epi8(static_cast<int8_t>(params.quantized_activation_max));
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            (out_x * stride_width) - params.padding_values.width;
+        const int in_y_origin =
+            (out_y * stride_height) - params.padding_values.height;
+        // Compute the boundaries of the filter region clamped so as to
+        // ensure that the filter window fits in the input array.
+        const int filter_x_start = std::max(0, -in_x_origin);
+        const int filter_x_end =
+            std::min(params.filter_width, input_width - in_x_origin);
+        const int filter_y_start = std::max(0, -in_y_origin);
+        const int filter_y_end =
+            std::min(params.filter_height, input_height - in_y_origin);
+        int8* out_ptr =
+            &output_data[Offset(output_shape, batch, out_y, out_x, 0)];
+
+        int channel = 0;
+        for (; channel + 16 <= depth; channel += 16) {
+          __m128i max = _mm_set1_epi8(std::numeric_limits<int8_t>::lowest());
+          for (int filter_y = filter_y_start; filter_y < filter_y_end;
+               ++filter_y) {
+            for (int filter_x = filter_x_start; filter_x < filter_x_end;
+                 ++filter_x) {
+              const int8* in_ptr =
+                  &input_data[Offset(input_shape, batch, in_y_origin + filter_y,
+                                     in_x_origin + filter_x, channel)];
+              max = _mm_max_epi8(
+                  max, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_ptr)));
+            }
+          }
+          max = _mm_min_epi8(_mm_max_epi8(max, activation_min), activation_max);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out_ptr + channel), max);
+        }
+        for (; channel + 8 <= depth; channel += 8) {
+          __m128i max = _mm_set1_epi8(std::numeric_limits<int8_t>::lowest());
+          for (int filter_y = filter_y_start; filter_y < filter_y_end;
+               ++filter_y) {
+            for (int filter_x = filter_x_start; filter_x < filter_x_end;
+                 ++filter_x) {
+              const int8* in_ptr =
+                  &input_data[Offset(input_shape, batch, in_y_origin + filter_y,
+                                     in_x_origin + filter_x, channel)];
+              max = _mm_max_epi8(
+                  max, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in_ptr)));
+            }
+          }
+          max = _mm_min_epi8(_mm_max_epi8(max, activation_min), activation_max);
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(out_ptr + channel), max);
+        }
+        for (; channel < depth; ++channel) {
+          int8_t max = std::numeric_limits<int8_t>::lowest();
+          for (int filter_y = filter_y_start; filter_y < filter_y_end;
+               ++filter_y) {
+            for (int filter_x = filter_x_start; filter_x < filter_x_end;
+                 ++filter_x) {
+              max = std::max(
+                  max, input_data[Offset(input_shape, batch,
+                                         in_y_origin + filter_y,
+                                         in_x_origin + filter_x, channel)]);
+            }
+          }
+          max = std::max<int8_t>(max, params.quantized_activation_min);
+          max = std::min<int8_t>(max, params.quantized_activation_max);
+          out_ptr[channel] = max;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
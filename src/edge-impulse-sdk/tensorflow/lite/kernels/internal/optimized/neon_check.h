@@ -20,10 +20,14 @@ limitations under the License.
 #include <arm_neon.h>
 #endif
 
-#if defined __GNUC__ && defined __SSE4_1__ && !defined TF_LITE_DISABLE_X86_NEON
+// Patched by Edge Impulse, NEON_2_SSE.h does not ship with the SDK, only use it when it's
+// on the include path (the x86 int8 kernels are in optimized/integer_ops instead)
+#if defined __GNUC__ && defined __SSE4_1__ && !defined TF_LITE_DISABLE_X86_NEON && defined __has_include
+#if __has_include("NEON_2_SSE.h")
 #define USE_NEON
 #include "NEON_2_SSE.h"
 #endif
+#endif
 
 // NEON_OR_PORTABLE(SomeFunc, args) calls NeonSomeFunc(args) if USE_NEON is
 // defined, PortableSomeFunc(args) otherwise.
@@ -0,0 +1,154 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_X86_SIMD_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_X86_SIMD_H_
+
+// SSE4.1 / AVX2 building blocks for the int8 kernels in optimized/integer_ops.
+// Everything here is bit-exact with the scalar gemmlowp fixed point helpers
+// used by the reference kernels. AVX2 is used when the compiler targets it
+// (-mavx2 or -march=...), SSE4.1 is the baseline.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <smmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace tflite {
+namespace optimized_integer_ops {
+namespace x86 {
+
+// sum((a[i] + a_offset) * (b[i] + b_offset)) for i < len. The offsets are
+// zero points, so a[i] + a_offset always fits in int16 and madd_epi16 gives
+// the same int32 products as the reference kernels.
+inline int32_t DotProductInt8(const int8_t* a, int32_t a_offset,
+                              const int8_t* b, int32_t b_offset, int len) {
+  int i = 0;
+  __m128i acc = _mm_setzero_si128();
+
+#ifdef __AVX2__
+  const __m256i a_offset_256 = _mm256_set1_epi16(static_cast<int16_t>(a_offset));
+  const __m256i b_offset_256 = _mm256_set1_epi16(static_cast<int16_t>(b_offset));
+  __m256i acc_256 = _mm256_setzero_si256();
+  for (; i + 16 <= len; i += 16) {
+    __m256i va = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256i vb = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    va = _mm256_add_epi16(va, a_offset_256);
+    vb = _mm256_add_epi16(vb, b_offset_256);
+    acc_256 = _mm256_add_epi32(acc_256, _mm256_madd_epi16(va, vb));
+  }
+  acc = _mm_add_epi32(_mm256_castsi256_si128(acc_256),
+                      _mm256_extracti128_si256(acc_256, 1));
+#endif
+
+  const __m128i a_offset_128 = _mm_set1_epi16(static_cast<int16_t>(a_offset));
+  const __m128i b_offset_128 = _mm_set1_epi16(static_cast<int16_t>(b_offset));
+  for (; i + 8 <= len; i += 8) {
+    __m128i va = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i)));
+    __m128i vb = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)));
+    va = _mm_add_epi16(va, a_offset_128);
+    vb = _mm_add_epi16(vb, b_offset_128);
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+  }
+
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t sum = _mm_cvtsi128_si32(acc);
+
+  for (; i < len; ++i) {
+    sum += (static_cast<int32_t>(a[i]) + a_offset) *
+           (static_cast<int32_t>(b[i]) + b_offset);
+  }
+  return sum;
+}
+
+// Load 4 int8 values and sign extend them to int32.
+inline __m128i LoadInt8x4(const int8_t* ptr) {
+  int32_t v;
+  memcpy(&v, ptr, sizeof(v));
+  return _mm_cvtepi8_epi32(_mm_cvtsi32_si128(v));
+}
+
+// Narrow 4 int32 values (already clamped to the int8 range) and store them.
+inline void StoreInt8x4(int8_t* ptr, __m128i v) {
+  v = _mm_packs_epi32(v, v);
+  v = _mm_packs_epi16(v, v);
+  int32_t out = _mm_cvtsi128_si32(v);
+  memcpy(ptr, &out, sizeof(out));
+}
+
+// gemmlowp::SaturatingRoundingDoublingHighMul for the two 64-bit lanes (the
+// low dword of each lane is used), the result is in the low dword of each lane.
+inline __m128i SaturatingRoundingDoublingHighMulEven(__m128i a, __m128i b) {
+  const __m128i ab = _mm_mul_epi32(a, b);
+  // the sign of each 64-bit product, spread over both its dwords
+  const __m128i ab_negative =
+      _mm_shuffle_epi32(_mm_srai_epi32(ab, 31), _MM_SHUFFLE(3, 3, 1, 1));
+  const __m128i nudge =
+      _mm_blendv_epi8(_mm_set1_epi64x(1ll << 30), _mm_set1_epi64x(1 - (1ll << 30)),
+                      ab_negative);
+  __m128i t = _mm_add_epi64(ab, nudge);
+  // the reference divides by 2^31 (rounds toward zero), so bias negative values
+  const __m128i t_negative =
+      _mm_shuffle_epi32(_mm_srai_epi32(t, 31), _MM_SHUFFLE(3, 3, 1, 1));
+  t = _mm_add_epi64(t, _mm_and_si128(t_negative, _mm_set1_epi64x(0x7fffffffll)));
+  // bits 31..62 are the same for a logical and an arithmetic shift
+  return _mm_srli_epi64(t, 31);
+}
+
+// gemmlowp::SaturatingRoundingDoublingHighMul on 4 int32 lanes.
+inline __m128i SaturatingRoundingDoublingHighMul(__m128i a, __m128i b) {
+  const __m128i even = SaturatingRoundingDoublingHighMulEven(a, b);
+  const __m128i odd = SaturatingRoundingDoublingHighMulEven(
+      _mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  const __m128i result = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+
+  const __m128i int32_min = _mm_set1_epi32(INT32_MIN);
+  const __m128i overflow = _mm_and_si128(_mm_cmpeq_epi32(a, b),
+                                         _mm_cmpeq_epi32(a, int32_min));
+  return _mm_blendv_epi8(result, _mm_set1_epi32(INT32_MAX), overflow);
+}
+
+// gemmlowp::RoundingDivideByPOT on 4 int32 lanes, exponent in [0, 31].
+inline __m128i RoundingDivideByPOT(__m128i x, int exponent) {
+  const __m128i mask =
+      _mm_set1_epi32(static_cast<int32_t>((1ll << exponent) - 1));
+  const __m128i remainder = _mm_and_si128(x, mask);
+  // (mask >> 1) + (x < 0 ? 1 : 0), the compare gives -1 for true
+  const __m128i threshold = _mm_sub_epi32(
+      _mm_srai_epi32(mask, 1), _mm_cmpgt_epi32(_mm_setzero_si128(), x));
+  const __m128i shifted = _mm_sra_epi32(x, _mm_cvtsi32_si128(exponent));
+  return _mm_sub_epi32(shifted, _mm_cmpgt_epi32(remainder, threshold));
+}
+
+// MultiplyByQuantizedMultiplierSmallerThanOneExp on 4 int32 lanes.
+inline __m128i MultiplyByQuantizedMultiplierSmallerThanOneExp(
+    __m128i x, int32_t quantized_multiplier, int left_shift) {
+  return RoundingDivideByPOT(
+      SaturatingRoundingDoublingHighMul(x, _mm_set1_epi32(quantized_multiplier)),
+      -left_shift);
+}
+
+}  // namespace x86
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_X86_SIMD_H_
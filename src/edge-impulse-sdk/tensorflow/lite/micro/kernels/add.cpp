@@ -234,6 +234,10 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+// Patched by Edge Impulse, SSE4.1 / AVX2 kernels on x86 hosts
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/add.h"
+#endif
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
@@ -357,11 +361,19 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                GetTensorData<dtype>(input2), GetTensorShape(output), \
                GetTensorData<dtype>(output));
     if (output->type == kTfLiteInt8) {
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+      if (need_broadcast) {
+        TF_LITE_ADD(optimized_integer_ops, BroadcastAdd4DSlow, int8_t);
+      } else {
+        TF_LITE_ADD(optimized_integer_ops, Add, int8_t);
+      }
+#else
       if (need_broadcast) {
         TF_LITE_ADD(reference_integer_ops, BroadcastAdd4DSlow, int8_t);
       } else {
         TF_LITE_ADD(reference_integer_ops, Add, int8_t);
       }
+#endif
     } else {
       if (need_broadcast) {
         TF_LITE_ADD(reference_ops, BroadcastAdd4DSlow, uint8_t);
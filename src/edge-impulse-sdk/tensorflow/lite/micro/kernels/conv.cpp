@@ -1014,6 +1014,10 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+// Patched by Edge Impulse, SSE4.1 / AVX2 kernels on x86 hosts
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/conv.h"
+#endif
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
@@ -1214,7 +1218,11 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = data.output_activation_min;
   op_params.quantized_activation_max = data.output_activation_max;
 
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+  optimized_integer_ops::ConvPerChannel(
+#else
   reference_integer_ops::ConvPerChannel(
+#endif
       op_params, data.per_channel_output_multiplier,
       data.per_channel_output_shift, GetTensorShape(input),
       GetTensorData<int8>(input), GetTensorShape(filter),
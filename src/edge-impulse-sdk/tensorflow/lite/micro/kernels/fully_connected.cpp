@@ -675,6 +675,10 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+// Patched by Edge Impulse, SSE4.1 / AVX2 kernels on x86 hosts
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#endif
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 
@@ -770,7 +774,11 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = data.output_activation_min;
   op_params.quantized_activation_max = data.output_activation_max;
 
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+  optimized_integer_ops::FullyConnected(
+#else
   reference_integer_ops::FullyConnected(
+#endif
       op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
       GetTensorShape(filter), GetTensorData<int8_t>(filter),
       GetTensorShape(bias), GetTensorData<int32_t>(bias),
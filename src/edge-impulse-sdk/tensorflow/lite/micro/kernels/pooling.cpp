@@ -778,6 +778,10 @@ limitations under the License.
 
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+// Patched by Edge Impulse, SSE4.1 / AVX2 kernels on x86 hosts
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
+#endif
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
@@ -910,7 +914,11 @@ void MaxEvalQuantized(TfLiteContext* context, TfLiteNode* node,
         op_params, GetTensorShape(input), GetTensorData<uint8_t>(input),
         GetTensorShape(output), GetTensorData<uint8_t>(output));
   } else {
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+    optimized_integer_ops::MaxPool(
+#else
     reference_integer_ops::MaxPool(
+#endif
         op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
         GetTensorShape(output), GetTensorData<int8_t>(output));
   }
@@ -19,6 +19,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/softmax.h"
+// Patched by Edge Impulse, vectorized exp for the float softmax
+#include "edge-impulse-sdk/dsp/fast_math.hpp"
 
 #include "edge-impulse-sdk/CMSIS/NN/Include/arm_nnfunctions.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
@@ -80,9 +82,26 @@ TfLiteStatus SoftmaxPrepare(TfLiteContext* context, TfLiteNode* node) {
 // Takes a tensor and performs softmax along the last dimension.
 void SoftmaxFloat(const TfLiteTensor* input, TfLiteTensor* output,
                   const SoftmaxParams& op_data) {
+#if EIDSP_USE_FAST_MATH == 1
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+  const float* input_data = GetTensorData<float>(input);
+  float* output_data = GetTensorData<float>(output);
+
+  for (int i = 0; i < outer_size; ++i) {
+    ei::fast_math::softmax(input_data + i * depth, output_data + i * depth,
+                           depth, static_cast<float>(op_data.beta));
+  }
+#else
   tflite::reference_ops::Softmax(
       op_data, GetTensorShape(input), GetTensorData<float>(input),
       GetTensorShape(output), GetTensorData<float>(output));
+#endif
 }
 
 void SoftmaxQuantized(const TfLiteTensor* input, TfLiteTensor* output,
@@ -170,6 +189,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/softmax.h"
+// Patched by Edge Impulse, vectorized exp for the float softmax
+#include "edge-impulse-sdk/dsp/fast_math.hpp"
 
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
@@ -240,9 +261,26 @@ TfLiteStatus SoftmaxPrepare(TfLiteContext* context, TfLiteNode* node) {
 // Takes a tensor and performs softmax along the last dimension.
 void SoftmaxFloat(const TfLiteTensor* input, TfLiteTensor* output,
                   const SoftmaxParams& op_data) {
+#if EIDSP_USE_FAST_MATH == 1
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+  const float* input_data = GetTensorData<float>(input);
+  float* output_data = GetTensorData<float>(output);
+
+  for (int i = 0; i < outer_size; ++i) {
+    ei::fast_math::softmax(input_data + i * depth, output_data + i * depth,
+                           depth, static_cast<float>(op_data.beta));
+  }
+#else
   tflite::reference_ops::Softmax(
       op_data, GetTensorShape(input), GetTensorData<float>(input),
       GetTensorShape(output), GetTensorData<float>(output));
+#endif
 }
 
 void SoftmaxQuantized(const TfLiteTensor* input, TfLiteTensor* output,
@@ -0,0 +1,278 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_STATIC_SHAPE_KERNELS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_STATIC_SHAPE_KERNELS_H_
+
+#include <stdint.h>
+
+#include <limits>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+
+// Kernels for compiled models, where every shape is known when the model is
+// generated. The shapes, strides and window sizes are template parameters, so
+// all loop bounds are constants that the compiler can unroll and vectorize,
+// and the padding checks only run for the columns at the edges.
+//
+// A ConvBlock is what MicroGraphOptimizer fuses: an int8 CONV_2D along the
+// time axis, optionally followed by the ADD of a constant vector and a
+// MAX_POOL_2D whose windows don't overlap. The quantization constants are
+// computed at init and passed in ConvBlockParams.
+
+namespace tflite {
+namespace static_shape {
+
+// Shape of a conv block, used to check that a kernel fits the graph.
+struct ConvBlockShape {
+  int input_time_steps;
+  int input_channels;
+  int channels;
+  int conv_filter;
+  int conv_stride;
+  int conv_dilation;
+  int conv_padding;
+  int conv_time_steps;
+  bool has_add;
+  int pool_filter;  // 0 if there is no pool
+  int pool_stride;
+  int pool_padding;
+  int output_time_steps;
+};
+
+inline bool operator==(const ConvBlockShape& a, const ConvBlockShape& b) {
+  return a.input_time_steps == b.input_time_steps &&
+         a.input_channels == b.input_channels && a.channels == b.channels &&
+         a.conv_filter == b.conv_filter && a.conv_stride == b.conv_stride &&
+         a.conv_dilation == b.conv_dilation &&
+         a.conv_padding == b.conv_padding &&
+         a.conv_time_steps == b.conv_time_steps && a.has_add == b.has_add &&
+         a.pool_filter == b.pool_filter &&
+         (a.pool_filter == 0 || (a.pool_stride == b.pool_stride &&
+                                 a.pool_padding == b.pool_padding)) &&
+         a.output_time_steps == b.output_time_steps;
+}
+
+// Quantization constants and weights of a conv block. The add is described
+// from the side of the conv output, the constant side is folded into
+// add_vector_term.
+struct ConvBlockParams {
+  const int8_t* filter_data;  // [channels][conv_filter][input_channels]
+  const int32_t* bias_data;   // may be NULL
+  const int32_t* per_channel_multiplier;
+  const int32_t* per_channel_shift;
+  int32_t input_offset;
+  int32_t conv_output_offset;
+  int32_t conv_activation_min;
+  int32_t conv_activation_max;
+
+  int add_left_shift;
+  int32_t add_input_offset;
+  int32_t add_input_multiplier;
+  int add_input_shift;
+  const int32_t* add_vector_term;  // [channels]
+  int32_t add_output_offset;
+  int32_t add_output_multiplier;
+  int add_output_shift;
+  int32_t add_activation_min;
+  int32_t add_activation_max;
+
+  int32_t pool_activation_min;
+  int32_t pool_activation_max;
+};
+
+typedef void (*ConvBlockKernel)(const ConvBlockParams& params,
+                                const int8_t* input, int8_t* output);
+
+// Same as ComputePaddingHeightWidth in kernels/padding.h, for one axis
+constexpr int EffectiveFilterSize(int filter, int dilation) {
+  return (filter - 1) * dilation + 1;
+}
+
+constexpr int OutputSize(TfLitePadding padding, int input, int filter,
+                         int stride) {
+  return padding == kTfLitePaddingSame ? (input + stride - 1) / stride
+                                       : (input + stride - filter) / stride;
+}
+
+constexpr int PaddingSize(int input, int output, int filter, int stride) {
+  return ((output - 1) * stride + filter - input) / 2 > 0
+             ? ((output - 1) * stride + filter - input) / 2
+             : 0;
+}
+
+// Conv value of one channel, requantized, with the add applied, same
+// arithmetic as reference_integer_ops::ConvPerChannel and AddElementwise.
+template <bool kHasAdd>
+inline int32_t ConvBlockEpilogue(const ConvBlockParams& params, int channel,
+                                 int32_t acc) {
+  if (params.bias_data) {
+    acc += params.bias_data[channel];
+  }
+  acc = MultiplyByQuantizedMultiplier(acc,
+                                      params.per_channel_multiplier[channel],
+                                      params.per_channel_shift[channel]);
+  acc += params.conv_output_offset;
+  acc = acc < params.conv_activation_min ? params.conv_activation_min : acc;
+  acc = acc > params.conv_activation_max ? params.conv_activation_max : acc;
+  if (!kHasAdd) {
+    return acc;
+  }
+
+  const int32_t scaled = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+      (acc + params.add_input_offset) * (1 << params.add_left_shift),
+      params.add_input_multiplier, params.add_input_shift);
+  int32_t output = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+                       scaled + params.add_vector_term[channel],
+                       params.add_output_multiplier, params.add_output_shift) +
+                   params.add_output_offset;
+  output = output < params.add_activation_min ? params.add_activation_min
+                                              : output;
+  return output > params.add_activation_max ? params.add_activation_max
+                                            : output;
+}
+
+template <int kInputTimeSteps, int kInputChannels, int kChannels, int kFilter,
+          int kStride, int kDilation, TfLitePadding kPadding, bool kHasAdd,
+          int kPoolFilter = 0, int kPoolStride = 1,
+          TfLitePadding kPoolPadding = kTfLitePaddingValid>
+struct ConvBlock {
+  static constexpr int kConvTimeSteps =
+      OutputSize(kPadding, kInputTimeSteps,
+                 EffectiveFilterSize(kFilter, kDilation), kStride);
+  static constexpr int kConvPadding =
+      PaddingSize(kInputTimeSteps, kConvTimeSteps,
+                  EffectiveFilterSize(kFilter, kDilation), kStride);
+  static constexpr int kOutputTimeSteps =
+      kPoolFilter > 0
+          ? OutputSize(kPoolPadding, kConvTimeSteps, kPoolFilter, kPoolStride)
+          : kConvTimeSteps;
+  static constexpr int kPoolPaddingSize =
+      kPoolFilter > 0 ? PaddingSize(kConvTimeSteps, kOutputTimeSteps,
+                                    kPoolFilter, kPoolStride)
+                      : 0;
+  // Conv columns [kFirstInterior, kEndInterior) read no padding
+  static constexpr int kFirstInterior = (kConvPadding + kStride - 1) / kStride;
+  static constexpr int kEndInterior =
+      (kInputTimeSteps - 1 + kConvPadding - (kFilter - 1) * kDilation) /
+          kStride + 1;
+
+  static_assert(kPoolFilter <= kPoolStride,
+                "pool windows must not overlap, or conv columns would be "
+                "computed more than once");
+
+  static ConvBlockShape Shape() {
+    ConvBlockShape shape;
+    shape.input_time_steps = kInputTimeSteps;
+    shape.input_channels = kInputChannels;
+    shape.channels = kChannels;
+    shape.conv_filter = kFilter;
+    shape.conv_stride = kStride;
+    shape.conv_dilation = kDilation;
+    shape.conv_padding = kConvPadding;
+    shape.conv_time_steps = kConvTimeSteps;
+    shape.has_add = kHasAdd;
+    shape.pool_filter = kPoolFilter;
+    shape.pool_stride = kPoolStride;
+    shape.pool_padding = kPoolPaddingSize;
+    shape.output_time_steps = kOutputTimeSteps;
+    return shape;
+  }
+
+  static void Eval(const ConvBlockParams& params, const int8_t* input,
+                   int8_t* output) {
+    int32_t values[kChannels];
+    if (kPoolFilter == 0) {
+      for (int t = 0; t < kConvTimeSteps; t++) {
+        Column(params, input, t, values);
+        for (int c = 0; c < kChannels; c++) {
+          output[t * kChannels + c] = static_cast<int8_t>(values[c]);
+        }
+      }
+      return;
+    }
+
+    // see reference_integer_ops::MaxPool
+    for (int p = 0; p < kOutputTimeSteps; p++) {
+      int32_t max[kChannels];
+      for (int c = 0; c < kChannels; c++) {
+        max[c] = std::numeric_limits<int8_t>::lowest();
+      }
+      const int origin = p * kPoolStride - kPoolPaddingSize;
+      for (int k = 0; k < kPoolFilter; k++) {
+        const int t = origin + k;
+        if (t < 0 || t >= kConvTimeSteps) {
+          continue;
+        }
+        Column(params, input, t, values);
+        for (int c = 0; c < kChannels; c++) {
+          max[c] = values[c] > max[c] ? values[c] : max[c];
+        }
+      }
+      for (int c = 0; c < kChannels; c++) {
+        int32_t value = max[c] < params.pool_activation_min
+                            ? params.pool_activation_min
+                            : max[c];
+        value = value > params.pool_activation_max
+                    ? params.pool_activation_max
+                    : value;
+        output[p * kChannels + c] = static_cast<int8_t>(value);
+      }
+    }
+  }
+
+ private:
+  template <bool kChecked>
+  static void Accumulate(const ConvBlockParams& params, const int8_t* input,
+                         int column, int32_t* acc) {
+    const int origin = column * kStride - kConvPadding;
+    for (int c = 0; c < kChannels; c++) {
+      acc[c] = 0;
+    }
+    for (int k = 0; k < kFilter; k++) {
+      const int t = origin + k * kDilation;
+      if (kChecked && (t < 0 || t >= kInputTimeSteps)) {
+        continue;
+      }
+      const int8_t* in = input + t * kInputChannels;
+      for (int c = 0; c < kChannels; c++) {
+        const int8_t* filter =
+            params.filter_data + (c * kFilter + k) * kInputChannels;
+        int32_t sum = 0;
+        for (int i = 0; i < kInputChannels; i++) {
+          sum += filter[i] * (in[i] + params.input_offset);
+        }
+        acc[c] += sum;
+      }
+    }
+  }
+
+  static void Column(const ConvBlockParams& params, const int8_t* input,
+                     int column, int32_t* values) {
+    if (column >= kFirstInterior && column < kEndInterior) {
+      Accumulate<false>(params, input, column, values);
+    } else {
+      Accumulate<true>(params, input, column, values);
+    }
+    for (int c = 0; c < kChannels; c++) {
+      values[c] = ConvBlockEpilogue<kHasAdd>(params, c, values[c]);
+    }
+  }
+};
+
+}  // namespace static_shape
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_STATIC_SHAPE_KERNELS_H_
@@ -15,28 +15,16 @@ limitations under the License.
 
 #include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace tflite {
 
-// Simple stable in-place sort function. Not time-efficient for large arrays.
-// Would normally be in an anonymous namespace to keep it private, but we want
-// to be able to test it externally.
-void ReverseSortInPlace(int* values, int* ids, int size) {
-  bool any_swapped;
-  do {
-    any_swapped = false;
-    for (int i = 1; i < size; ++i) {
-      if (values[i - 1] < values[i]) {
-        const int value_temp = values[i - 1];
-        values[i - 1] = values[i];
-        values[i] = value_temp;
-        const int id_temp = ids[i - 1];
-        ids[i - 1] = ids[i];
-        ids[i] = id_temp;
-        any_swapped = true;
-      }
-    }
-  } while (any_swapped);
-}
+namespace {
+
+constexpr int kNotPlaced = std::numeric_limits<int>::min();
+
+}  // namespace
 
 GreedyMemoryPlanner::GreedyMemoryPlanner(unsigned char* scratch_buffer,
                                          int scratch_buffer_size)
@@ -48,14 +36,28 @@ GreedyMemoryPlanner::GreedyMemoryPlanner(unsigned char* scratch_buffer,
   requirements_ = reinterpret_cast<BufferRequirements*>(next_free);
   next_free += sizeof(BufferRequirements) * max_buffer_count_;
 
-  buffer_sizes_sorted_ = reinterpret_cast<int*>(next_free);
+  buffer_ids_sorted_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  buffer_ids_by_first_use_ = reinterpret_cast<int*>(next_free);
   next_free += sizeof(int) * max_buffer_count_;
 
-  buffer_ids_sorted_ = reinterpret_cast<int*>(next_free);
+  first_use_positions_ = reinterpret_cast<int*>(next_free);
   next_free += sizeof(int) * max_buffer_count_;
 
-  buffers_sorted_by_offset_ = reinterpret_cast<ListEntry*>(next_free);
-  next_free += sizeof(ListEntry) * max_buffer_count_;
+  placement_order_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  active_buffers_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  sort_scratch_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * max_buffer_count_;
+
+  // A tree with a leaf per buffer, rounded up to a power of two, has less than
+  // 4 nodes per buffer.
+  last_use_tree_ = reinterpret_cast<int*>(next_free);
+  next_free += sizeof(int) * 4 * max_buffer_count_;
 
   buffer_offsets_ = reinterpret_cast<int*>(next_free);
 }
@@ -94,47 +96,59 @@ TfLiteStatus GreedyMemoryPlanner::AddBuffer(
   return kTfLiteOk;
 }
 
-bool GreedyMemoryPlanner::DoesEntryOverlapInTime(
-    const GreedyMemoryPlanner::ListEntry* entry, const int first_time_used,
-    const int last_time_used) const {
-  const BufferRequirements* entry_requirements =
-      &requirements_[entry->requirements_index];
-  if (entry_requirements->first_time_used > last_time_used) {
-    return false;
+// Bottom-up merge sort, merging runs back and forth between `ids` and
+// sort_scratch_.
+template <typename Compare>
+void GreedyMemoryPlanner::StableSort(int* ids, int size, Compare comes_before) {
+  int* from = ids;
+  int* to = sort_scratch_;
+  for (int width = 1; width < size; width *= 2) {
+    for (int start = 0; start < size; start += 2 * width) {
+      const int middle = std::min(start + width, size);
+      const int end = std::min(start + 2 * width, size);
+      int left = start;
+      int right = middle;
+      for (int i = start; i < end; ++i) {
+        if (left < middle &&
+            (right >= end || !comes_before(from[right], from[left]))) {
+          to[i] = from[left++];
+        } else {
+          to[i] = from[right++];
+        }
+      }
+    }
+    std::swap(from, to);
   }
-  if (first_time_used > entry_requirements->last_time_used) {
-    return false;
+  if (from != ids) {
+    std::copy(from, from + size, ids);
   }
-  return true;
 }
 
-GreedyMemoryPlanner::ListEntry*
-GreedyMemoryPlanner::NextSimultaneouslyActiveBuffer(
-    const GreedyMemoryPlanner::ListEntry* start, const int first_time_used,
-    const int last_time_used) {
-  ListEntry* result = nullptr;
-  ListEntry* candidate_next_entry;
-  if (start == nullptr) {
-    candidate_next_entry = &buffers_sorted_by_offset_[first_entry_index_];
-  } else {
-    if (start->next_entry_index == -1) {
-      return nullptr;
-    }
-    candidate_next_entry = &buffers_sorted_by_offset_[start->next_entry_index];
+void GreedyMemoryPlanner::MarkPlaced(int buffer_id) {
+  int node = last_use_tree_leaves_ + first_use_positions_[buffer_id];
+  last_use_tree_[node] = requirements_[buffer_id].last_time_used;
+  for (node /= 2; node > 0; node /= 2) {
+    last_use_tree_[node] =
+        std::max(last_use_tree_[2 * node], last_use_tree_[2 * node + 1]);
   }
-  do {
-    if (DoesEntryOverlapInTime(candidate_next_entry, first_time_used,
-                               last_time_used)) {
-      result = candidate_next_entry;
-      break;
-    }
-    if (candidate_next_entry->next_entry_index == -1) {
-      break;
-    }
-    candidate_next_entry =
-        &buffers_sorted_by_offset_[candidate_next_entry->next_entry_index];
-  } while (true);
-  return result;
+}
+
+void GreedyMemoryPlanner::CollectActiveBuffers(int node, int node_start,
+                                               int node_end, int end,
+                                               int first_time_used,
+                                               int* active_count) {
+  if (node_start >= end || last_use_tree_[node] < first_time_used) {
+    return;
+  }
+  if (node >= last_use_tree_leaves_) {
+    active_buffers_[(*active_count)++] = buffer_ids_by_first_use_[node_start];
+    return;
+  }
+  const int node_middle = (node_start + node_end) / 2;
+  CollectActiveBuffers(2 * node, node_start, node_middle, end, first_time_used,
+                       active_count);
+  CollectActiveBuffers(2 * node + 1, node_middle, node_end, end,
+                       first_time_used, active_count);
 }
 
 void GreedyMemoryPlanner::CalculateOffsetsIfNeeded() {
@@ -154,88 +168,94 @@ void GreedyMemoryPlanner::CalculateOffsetsIfNeeded() {
   for (int i = 0; i < buffer_count_; ++i) {
     if (requirements_[i].offline_offset == kOnlinePlannedBuffer) {
       idx_from_tail--;
-      buffer_sizes_sorted_[idx_from_tail] = requirements_[i].size;
       buffer_ids_sorted_[idx_from_tail] = i;
       buffer_offsets_[i] = -1;
     } else {
-      buffer_sizes_sorted_[idx_from_head] = requirements_[i].size;
       buffer_ids_sorted_[idx_from_head] = i;
       buffer_offsets_[i] = requirements_[i].offline_offset;
       idx_from_head++;
     }
   }
 
-  // This sorting algorithm is naive, and may end up taking a very long time
-  // with hundreds of buffers. Do not sort the offline planned offsets.
-  ReverseSortInPlace(&buffer_sizes_sorted_[idx_from_head],
-                     &buffer_ids_sorted_[idx_from_head],
-                     buffer_count_ - idx_from_head);
+  // Do not sort the offline planned offsets.
+  const BufferRequirements* requirements = requirements_;
+  StableSort(&buffer_ids_sorted_[idx_from_head], buffer_count_ - idx_from_head,
+             [requirements](int a, int b) {
+               return requirements[a].size > requirements[b].size;
+             });
+
+  // Index the buffers by first use, the tree starts out with no buffer placed.
+  for (int i = 0; i < buffer_count_; ++i) {
+    buffer_ids_by_first_use_[i] = i;
+  }
+  StableSort(buffer_ids_by_first_use_, buffer_count_,
+             [requirements](int a, int b) {
+               return requirements[a].first_time_used <
+                      requirements[b].first_time_used;
+             });
+  for (int i = 0; i < buffer_count_; ++i) {
+    first_use_positions_[buffer_ids_by_first_use_[i]] = i;
+  }
+  last_use_tree_leaves_ = 1;
+  while (last_use_tree_leaves_ < buffer_count_) {
+    last_use_tree_leaves_ *= 2;
+  }
+  std::fill(last_use_tree_, last_use_tree_ + 2 * last_use_tree_leaves_,
+            kNotPlaced);
 
-  // Initialize the first entry to the first buffer in
-  // buffer_ids_sorted_.
+  // Work through the buffers in order to find a good gap to place each one.
   //   - If there are no offline planned offsets, the largest buffer will be
   //     first, and the buffers will be handled in size order.
   //   - If offline offsets are present, these will be handled first in order
   //     for the greedy algorithm to utilized gaps in the offline plan.
-  first_entry_index_ = 0;
-  next_free_entry_ = 1;
-  ListEntry* first_entry = &buffers_sorted_by_offset_[first_entry_index_];
-  first_entry->next_entry_index = -1;  // to mark the entry as end of list
-  int buffer_id = buffer_ids_sorted_[0];
-  first_entry->requirements_index = buffer_id;
-  if (requirements_[buffer_id].offline_offset == kOnlinePlannedBuffer) {
-    buffer_offsets_[buffer_id] = 0;
-  }
-  first_entry->offset = buffer_offsets_[buffer_id];
-
-  // Work through the rest of the buffers to find a good gap to place each one.
-  for (int i = 1; i < buffer_count_; ++i) {
+  const int* offsets = buffer_offsets_;
+  const int* placement_order = placement_order_;
+  for (int i = 0; i < buffer_count_; ++i) {
     // The id is the order the buffer was originally added by the client.
-    buffer_id = buffer_ids_sorted_[i];
+    const int buffer_id = buffer_ids_sorted_[i];
     // Look at what size and time range the buffer needs to be active.
     BufferRequirements* wanted_requirements = &requirements_[buffer_id];
     const int wanted_size = wanted_requirements->size;
     const int wanted_first_time_used = wanted_requirements->first_time_used;
     const int wanted_last_time_used = wanted_requirements->last_time_used;
 
-    // Find the first buffer that's active in our time range. All placed
-    // buffers are stored in the order of their starting position in the arena
-    // so that it's easy to find the next buffer in memory, and so the gap.
-    // The candidate_entry variable holds the buffer that we're considering
-    // placing the current buffer after.
-
     int candidate_offset = 0;
-    // Loop through the offset-ordered list of buffers, looking for gaps.
     if (wanted_requirements->offline_offset == kOnlinePlannedBuffer) {
-      ListEntry* prior_entry = nullptr;
-      while (true) {
-        // Find out what the next active buffer is.
-        ListEntry* next_entry = NextSimultaneouslyActiveBuffer(
-            prior_entry, wanted_first_time_used, wanted_last_time_used);
-
-        if (prior_entry) {
-          BufferRequirements* candidate_requirements =
-              &requirements_[prior_entry->requirements_index];
-          const int prior_entry_offset =
-              prior_entry->offset + candidate_requirements->size;
-          if (prior_entry_offset > candidate_offset) {
-            candidate_offset = prior_entry_offset;
-          }
-        }
-        if (next_entry == nullptr) {
-          // We're at the end of the list, so we can always append the buffer
-          // here.
-          break;
-        }
-        // Find out how much space there is between us and the next buffer.
-        const int gap = next_entry->offset - candidate_offset;
+      // The placed buffers that are active in our time range are the ones
+      // first used before our range ends, and last used after it starts.
+      const int used_before_end =
+          std::upper_bound(buffer_ids_by_first_use_,
+                           buffer_ids_by_first_use_ + buffer_count_,
+                           wanted_last_time_used,
+                           [requirements](int time, int id) {
+                             return time < requirements[id].first_time_used;
+                           }) -
+          buffer_ids_by_first_use_;
+      int active_count = 0;
+      CollectActiveBuffers(1, 0, last_use_tree_leaves_, used_before_end,
+                           wanted_first_time_used, &active_count);
+      StableSort(active_buffers_, active_count,
+                 [offsets, placement_order](int a, int b) {
+                   return offsets[a] < offsets[b] ||
+                          (offsets[a] == offsets[b] &&
+                           placement_order[a] < placement_order[b]);
+                 });
+
+      // Go through the active buffers in the order of their position in the
+      // arena, looking for the first gap that's big enough.
+      for (int j = 0; j < active_count; ++j) {
+        const int active_id = active_buffers_[j];
+        const int gap = buffer_offsets_[active_id] - candidate_offset;
         if (gap >= wanted_size) {
-          // This entry has a big enough gap between it and the next, so
-          // use it!
+          // This entry has a big enough gap between it and the previous one,
+          // so use it!
           break;
         }
-        // The gap wasn't big enough, so move on to another candidate.
-        prior_entry = next_entry;
+        const int active_end =
+            buffer_offsets_[active_id] + requirements_[active_id].size;
+        if (active_end > candidate_offset) {
+          candidate_offset = active_end;
+        }
       }
     } else {
       // Offline planned offset are to be considered constant
@@ -246,67 +266,23 @@ void GreedyMemoryPlanner::CalculateOffsetsIfNeeded() {
     // buffers in this time range and so we can put it at offset zero.
     // Record the buffer's offset in our plan.
     buffer_offsets_[buffer_id] = candidate_offset;
-    // Add the newly-placed buffer to our offset-ordered list, so that
-    // subsequent passes can fit in their buffers around it.
-    ListEntry* new_entry = &buffers_sorted_by_offset_[next_free_entry_];
-    new_entry->offset = candidate_offset;
-    new_entry->requirements_index = buffer_id;
-    const int new_entry_index = next_free_entry_;
-    ++next_free_entry_;
-
-    if (first_entry->offset > candidate_offset) {
-      // The new entry offset is smaller than the first entry offset =>
-      // replace the first entry
-      first_entry = new_entry;
-      first_entry->next_entry_index = first_entry_index_;
-      first_entry_index_ = new_entry_index;
-    } else {
-      ListEntry* current_entry = first_entry;
-      // Make sure that we insert the buffer at the correct place in the
-      // buffer-offset-ordered list
-      while (true) {
-        const int next_entry_index = current_entry->next_entry_index;
-        if (next_entry_index == -1) {
-          // We're at the end of the list, so just add the new entry here.
-          current_entry->next_entry_index = new_entry_index;
-          new_entry->next_entry_index = -1;
-          break;
-        }
-        // not at the end of the list -> take a look at next entry
-        ListEntry* next_entry = &buffers_sorted_by_offset_[next_entry_index];
-        if (next_entry->offset > candidate_offset) {
-          // We're at the right spot to do an insertion and retain the sorting
-          // order, so place the new entry here.
-          new_entry->next_entry_index = current_entry->next_entry_index;
-          current_entry->next_entry_index = new_entry_index;
-          break;
-        }
-        current_entry = next_entry;
-      }
-    }
+    placement_order_[buffer_id] = i;
+    // Add the newly-placed buffer to the tree, so that subsequent passes can
+    // fit in their buffers around it.
+    MarkPlaced(buffer_id);
   }
 }
 
 size_t GreedyMemoryPlanner::GetMaximumMemorySize() {
   CalculateOffsetsIfNeeded();
-  if (buffer_count_ == 0) {
-    return 0;
-  }
-  ListEntry* entry = &buffers_sorted_by_offset_[first_entry_index_];
   size_t max_size = 0;
-  while (entry) {
-    BufferRequirements* requirements =
-        &requirements_[entry->requirements_index];
+  for (int i = 0; i < buffer_count_; ++i) {
     // TODO(b/148246793): Update all size and offset variables types from
     //                    int to size_t
-    const size_t current_size = entry->offset + requirements->size;
+    const size_t current_size = buffer_offsets_[i] + requirements_[i].size;
     if (current_size > max_size) {
       max_size = current_size;
     }
-    if (entry->next_entry_index == -1) {
-      break;
-    }
-    entry = &buffers_sorted_by_offset_[entry->next_entry_index];
   }
   return max_size;
 }
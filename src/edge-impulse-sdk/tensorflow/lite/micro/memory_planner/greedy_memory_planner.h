@@ -41,6 +41,12 @@ constexpr int kOnlinePlannedBuffer = -1;
 //    last buffer that's simultaneously active.
 //  - This continues until all buffers are placed, and the offsets stored.
 //
+// The sorts are stable merge sorts, and the placed buffers are kept in a tree
+// ordered by first use that holds the latest last use of each subtree, so the
+// simultaneously active buffers are found without looking at the others.
+// Planning takes O(n log n) for n buffers, plus the sorting of the active
+// buffers for each placement.
+//
 // This is not guaranteed to produce the best placement, since that's an
 // NP-Complete problem, but in practice it should produce one that's decent.
 class GreedyMemoryPlanner : public MemoryPlanner {
@@ -53,7 +59,7 @@ class GreedyMemoryPlanner : public MemoryPlanner {
   // this scratch memory, so you should enlarge it if you see an error when
   // calling AddBuffer(). The memory can be reused once you're done with the
   // planner, as long as you copy the calculated offsets to another location.
-  // Each buffer requires about 36 bytes of scratch.
+  // Each buffer requires about 60 bytes of scratch.
   GreedyMemoryPlanner(unsigned char* scratch_buffer, int scratch_buffer_size);
   ~GreedyMemoryPlanner() override;
 
@@ -87,34 +93,33 @@ class GreedyMemoryPlanner : public MemoryPlanner {
   // is an O(N^2) complexity operation, so only use for testing.
   bool DoAnyBuffersOverlap(ErrorReporter* error_reporter);
 
-  // Used to store a list of buffers ordered by their offset.
-  struct ListEntry {
-    int offset;
-    int requirements_index;
-    int next_entry_index;
-  };
-
   // Number of bytes required in order to plan a buffer.
   static size_t per_buffer_size() {
     const int per_buffer_size =
         sizeof(BufferRequirements) +  // requirements_
-        sizeof(int) +                 // buffer_sizes_sorted_
         sizeof(int) +                 // buffer_ids_sorted_
-        sizeof(ListEntry) +           // buffers_sorted_by_offset_
+        sizeof(int) +                 // buffer_ids_by_first_use_
+        sizeof(int) +                 // first_use_positions_
+        sizeof(int) +                 // placement_order_
+        sizeof(int) +                 // active_buffers_
+        sizeof(int) +                 // sort_scratch_
+        sizeof(int) * 4 +             // last_use_tree_
         sizeof(int);                  // buffer_offsets_;
     return per_buffer_size;
   }
 
  private:
-  // Whether a buffer is active in a given time range.
-  bool DoesEntryOverlapInTime(const ListEntry* entry, const int first_time_used,
-                              const int last_time_used) const;
+  // Sorts `ids` in place, keeping the order of ids that compare equal.
+  template <typename Compare>
+  void StableSort(int* ids, int size, Compare comes_before);
+
+  // Records the last use of a placed buffer in last_use_tree_.
+  void MarkPlaced(int buffer_id);
 
-  // Walks the list to return the next buffer that is active in a given time
-  // range, or a null pointer if there are none.
-  ListEntry* NextSimultaneouslyActiveBuffer(const ListEntry* start,
-                                            const int first_time_used,
-                                            const int last_time_used);
+  // Appends the placed buffers among the first `end` buffers in order of
+  // first use that are still used at `first_time_used` to active_buffers_.
+  void CollectActiveBuffers(int node, int node_start, int node_end, int end,
+                            int first_time_used, int* active_count);
 
   // If there isn't an up to date plan, calculate a new one.
   void CalculateOffsetsIfNeeded();
@@ -136,18 +141,24 @@ class GreedyMemoryPlanner : public MemoryPlanner {
 
   // Working arrays used during the layout algorithm.
   BufferRequirements* requirements_;
-  // buffer_sizes_sorted_ and buffer_ids_sorted_ are sorted according to:
+  // buffer_ids_sorted_ is sorted according to:
   //   {
   //     offline planned buffers,
   //     online planned buffers sorted by size
   //   }
-  int* buffer_sizes_sorted_;
   int* buffer_ids_sorted_;
-  ListEntry* buffers_sorted_by_offset_;
-  int next_free_entry_;    // Index of the next free entry of
-                           // buffers_sorted_by_offset_
-  int first_entry_index_;  // Index of the first entry (smallest offset) of
-                           // buffers_sorted_by_offset_
+  // All buffers in order of first use, and the position of each buffer in it.
+  int* buffer_ids_by_first_use_;
+  int* first_use_positions_;
+  // When each buffer was placed, breaks ties between buffers at one offset.
+  int* placement_order_;
+  // The simultaneously active buffers of the buffer being placed.
+  int* active_buffers_;
+  int* sort_scratch_;
+  // Max tree over buffer_ids_by_first_use_, the leaves are the last use of
+  // placed buffers, or kNotPlaced. last_use_tree_leaves_ is a power of two.
+  int* last_use_tree_;
+  int last_use_tree_leaves_;
 
   // Stores the outcome of the plan, the location of each buffer in the arena.
   int* buffer_offsets_;
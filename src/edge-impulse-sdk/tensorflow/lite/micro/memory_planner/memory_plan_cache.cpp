@@ -0,0 +1,116 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/memory_plan_cache.h"
+
+#include <string.h>
+
+namespace tflite {
+
+namespace {
+
+constexpr uint32_t kPlanMagic = 0x4c504945;  // "EIPL"
+
+}  // namespace
+
+MemoryPlanCache::MemoryPlanCache(uint8_t* storage, size_t storage_size)
+    : storage_(storage), storage_size_(storage_size), used_(0) {}
+
+uint32_t MemoryPlanCache::Hash(const void* data, size_t size, uint32_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+TfLiteStatus MemoryPlanCache::Load(const uint8_t* data, size_t size) {
+  used_ = 0;
+  if (size > storage_size_) {
+    return kTfLiteError;
+  }
+  // Walk the plans before taking them, a truncated write to flash must not
+  // turn into plans that run past the data. The offsets in a plan are checked
+  // against the buffers and the arena when the plan is used (MicroAllocator).
+  size_t position = 0;
+  while (position < size) {
+    PlanHeader header;
+    if (size - position < sizeof(PlanHeader)) {
+      return kTfLiteError;
+    }
+    memcpy(&header, data + position, sizeof(PlanHeader));
+    if (header.magic != kPlanMagic || header.buffer_count < 0 ||
+        PlanSize(header.buffer_count) > size - position) {
+      return kTfLiteError;
+    }
+    position += PlanSize(header.buffer_count);
+  }
+  memcpy(storage_, data, size);
+  used_ = size;
+  return kTfLiteOk;
+}
+
+MemoryPlanCache::PlanHeader* MemoryPlanCache::FindPlan(
+    uint32_t model_hash) const {
+  size_t position = 0;
+  while (position < used_) {
+    PlanHeader* plan = reinterpret_cast<PlanHeader*>(storage_ + position);
+    if (plan->model_hash == model_hash) {
+      return plan;
+    }
+    position += PlanSize(plan->buffer_count);
+  }
+  return nullptr;
+}
+
+void MemoryPlanCache::RemovePlan(PlanHeader* plan) {
+  uint8_t* start = reinterpret_cast<uint8_t*>(plan);
+  const size_t plan_size = PlanSize(plan->buffer_count);
+  const size_t following = used_ - (start - storage_) - plan_size;
+  memmove(start, start + plan_size, following);
+  used_ -= plan_size;
+}
+
+const int32_t* MemoryPlanCache::Lookup(uint32_t model_hash,
+                                       uint32_t buffers_hash, int buffer_count,
+                                       size_t* arena_bytes) const {
+  const PlanHeader* plan = FindPlan(model_hash);
+  if (plan == nullptr || plan->buffers_hash != buffers_hash ||
+      plan->buffer_count != buffer_count) {
+    return nullptr;
+  }
+  *arena_bytes = plan->arena_bytes;
+  return reinterpret_cast<const int32_t*>(plan + 1);
+}
+
+int32_t* MemoryPlanCache::Insert(uint32_t model_hash, uint32_t buffers_hash,
+                                 int buffer_count, size_t arena_bytes) {
+  PlanHeader* old_plan = FindPlan(model_hash);
+  if (old_plan != nullptr) {
+    RemovePlan(old_plan);
+  }
+  if (buffer_count < 0 || PlanSize(buffer_count) > storage_size_ - used_) {
+    return nullptr;
+  }
+  PlanHeader* plan = reinterpret_cast<PlanHeader*>(storage_ + used_);
+  plan->magic = kPlanMagic;
+  plan->model_hash = model_hash;
+  plan->buffers_hash = buffers_hash;
+  plan->buffer_count = buffer_count;
+  plan->arena_bytes = static_cast<uint32_t>(arena_bytes);
+  used_ += PlanSize(buffer_count);
+  return reinterpret_cast<int32_t*>(plan + 1);
+}
+
+}  // namespace tflite
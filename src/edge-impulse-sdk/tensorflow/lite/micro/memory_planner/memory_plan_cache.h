@@ -0,0 +1,91 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_MEMORY_PLAN_CACHE_H_
+#define TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_MEMORY_PLAN_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// Memory plans of earlier AllocateTensors() calls, so a model only has to be
+// planned once. A plan is the arena offset of every planned buffer, keyed by
+// a hash of the model and checked against a hash of the buffer sizes and
+// lifetimes, so a stale plan is never used.
+//
+// The plans are stored serialized in a buffer owned by the caller. That
+// buffer can be written to flash and passed to Load() on the next start, so
+// the model is not planned at all. MicroAllocator only commits a plan whose
+// buffers all fit the arena, anything else is planned again.
+//
+// Serialized format, all fields 32 bit in native byte order:
+//   per plan: magic, model hash, buffers hash, buffer count, arena bytes,
+//             buffer count offsets
+class MemoryPlanCache {
+ public:
+  static constexpr uint32_t kHashSeed = 2166136261u;
+
+  // `storage` must be 4 byte aligned and live as long as the cache.
+  MemoryPlanCache(uint8_t* storage, size_t storage_size);
+
+  // FNV-1a, pass the previous result as `hash` to hash several blocks.
+  static uint32_t Hash(const void* data, size_t size,
+                       uint32_t hash = kHashSeed);
+
+  // Replace the plans by serialized plans from data(), fails if they are
+  // malformed or don't fit.
+  TfLiteStatus Load(const uint8_t* data, size_t size);
+
+  // The serialized plans.
+  const uint8_t* data() const { return storage_; }
+  size_t size() const { return used_; }
+
+  // Offsets of the buffers of a plan, NULL if there is no matching plan.
+  const int32_t* Lookup(uint32_t model_hash, uint32_t buffers_hash,
+                        int buffer_count, size_t* arena_bytes) const;
+
+  // Adds a plan (replacing an older plan of the model) and returns where its
+  // offsets go, NULL if it doesn't fit.
+  int32_t* Insert(uint32_t model_hash, uint32_t buffers_hash,
+                  int buffer_count, size_t arena_bytes);
+
+  void Clear() { used_ = 0; }
+
+ private:
+  struct PlanHeader {
+    uint32_t magic;
+    uint32_t model_hash;
+    uint32_t buffers_hash;
+    int32_t buffer_count;
+    uint32_t arena_bytes;
+  };
+
+  static size_t PlanSize(int buffer_count) {
+    return sizeof(PlanHeader) + buffer_count * sizeof(int32_t);
+  }
+
+  PlanHeader* FindPlan(uint32_t model_hash) const;
+  void RemovePlan(PlanHeader* plan);
+
+  uint8_t* storage_;
+  size_t storage_size_;
+  size_t used_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_MEMORY_PLAN_CACHE_H_
@@ -388,6 +388,64 @@ TfLiteStatus CommitPlan(ErrorReporter* error_reporter, MemoryPlanner* planner,
   }
   return kTfLiteOk;
 }
+
+// Hash of the buffers given to the planner, a cached plan is only used for
+// the exact same buffers.
+uint32_t HashPlannerBuffers(const AllocationInfo* allocation_info,
+                            size_t allocation_info_size, int* buffer_count) {
+  uint32_t hash = MemoryPlanCache::kHashSeed;
+  *buffer_count = 0;
+  for (size_t i = 0; i < allocation_info_size; ++i) {
+    const AllocationInfo* current = &allocation_info[i];
+    if (current->needs_allocating) {
+      const int32_t buffer[4] = {
+          static_cast<int32_t>(AlignSizeUp(current->bytes, kBufferAlignment)),
+          current->first_created, current->last_used,
+          current->offline_offset};
+      hash = MemoryPlanCache::Hash(buffer, sizeof(buffer), hash);
+      ++*buffer_count;
+    }
+  }
+  return hash;
+}
+
+// A cached plan can come from flash (MemoryPlanCache::Load), only take it if
+// every buffer lies within the `arena_bytes` the plan claims, so a stale or
+// corrupted plan or a hash collision can't place tensors outside the arena.
+bool CachedPlanFits(const int32_t* offsets, size_t arena_bytes,
+                    const AllocationInfo* allocation_info,
+                    size_t allocation_info_size) {
+  int planner_index = 0;
+  for (size_t i = 0; i < allocation_info_size; ++i) {
+    const AllocationInfo* current = &allocation_info[i];
+    if (current->needs_allocating) {
+      const int32_t offset = offsets[planner_index];
+      if (offset < 0 ||
+          static_cast<size_t>(offset) > arena_bytes ||
+          AlignSizeUp(current->bytes, kBufferAlignment) >
+              arena_bytes - static_cast<size_t>(offset)) {
+        return false;
+      }
+      ++planner_index;
+    }
+  }
+  return true;
+}
+
+void CommitCachedPlan(const int32_t* offsets, uint8_t* starting_point,
+                      const AllocationInfo* allocation_info,
+                      size_t allocation_info_size) {
+  int planner_index = 0;
+  for (size_t i = 0; i < allocation_info_size; ++i) {
+    const AllocationInfo* current = &allocation_info[i];
+    if (current->needs_allocating) {
+      *current->output_ptr =
+          reinterpret_cast<void*>(starting_point + offsets[planner_index]);
+      ++planner_index;
+    }
+  }
+}
+
 }  // namespace
 
 namespace internal {
@@ -710,6 +768,12 @@ size_t MicroAllocator::used_bytes() const {
   return memory_allocator_->GetUsedBytes();
 }
 
+void MicroAllocator::SetMemoryPlanCache(MemoryPlanCache* cache,
+                                        uint32_t model_hash) {
+  plan_cache_ = cache;
+  plan_cache_model_hash_ = model_hash;
+}
+
 TfLiteStatus MicroAllocator::AllocateTfLiteTensorArray(
     TfLiteContext* context, const SubGraph* subgraph) {
   context->tensors_size = subgraph->tensors()->size();
@@ -916,6 +980,33 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(const Model* model,
     TF_LITE_ENSURE_STATUS(builder.AddScratchBuffers(scratch_buffer_handles_));
     const AllocationInfo* allocation_info = builder.Finish();
 
+    size_t actual_available_arena_size =
+        memory_allocator_->GetAvailableMemory();
+
+    // A model that was planned before takes the plan from the cache, a plan
+    // that doesn't fit the arena is planned again and replaced.
+    int buffer_count = 0;
+    uint32_t buffers_hash = 0;
+    if (plan_cache_ != nullptr) {
+      buffers_hash =
+          HashPlannerBuffers(allocation_info, builder.Size(), &buffer_count);
+      size_t cached_arena_bytes;
+      const int32_t* cached_offsets =
+          plan_cache_->Lookup(plan_cache_model_hash_, buffers_hash,
+                              buffer_count, &cached_arena_bytes);
+      if (cached_offsets != nullptr &&
+          cached_arena_bytes <= actual_available_arena_size &&
+          CachedPlanFits(cached_offsets, cached_arena_bytes, allocation_info,
+                         builder.Size())) {
+        CommitCachedPlan(cached_offsets, memory_allocator_->GetHead(),
+                         allocation_info, builder.Size());
+        uint8_t* allocated_tensor_memory = memory_allocator_->AllocateFromHead(
+            cached_arena_bytes, /*alignment=*/1);
+        TF_LITE_ENSURE(error_reporter_, allocated_tensor_memory != nullptr);
+        return kTfLiteOk;
+      }
+    }
+
     // Remaining arena size that memory planner can use for calculating offsets.
     size_t remaining_arena_size = tmp_allocator.GetAvailableMemory();
     uint8_t* planner_arena =
@@ -925,8 +1016,6 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(const Model* model,
     TF_LITE_ENSURE_STATUS(
         CreatePlan(error_reporter_, &planner, allocation_info, builder.Size()));
 
-    size_t actual_available_arena_size =
-        memory_allocator_->GetAvailableMemory();
     // Make sure we have enough arena size.
     if (planner.GetMaximumMemorySize() > actual_available_arena_size) {
       TF_LITE_REPORT_ERROR(
@@ -941,6 +1030,18 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(const Model* model,
     TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, &planner,
                                      memory_allocator_->GetHead(),
                                      allocation_info, builder.Size()));
+    if (plan_cache_ != nullptr) {
+      // A full cache only means the next start plans again
+      int32_t* cached_offsets =
+          plan_cache_->Insert(plan_cache_model_hash_, buffers_hash,
+                              buffer_count, planner.GetMaximumMemorySize());
+      for (int i = 0; cached_offsets != nullptr && i < buffer_count; ++i) {
+        int offset;
+        TF_LITE_ENSURE_STATUS(
+            planner.GetOffsetForBuffer(error_reporter_, i, &offset));
+        cached_offsets[i] = offset;
+      }
+    }
     // Allocate the planned area, so the allocator knows it's used.
     uint8_t* allocated_tensor_memory =
         memory_allocator_->AllocateFromHead(planner.GetMaximumMemorySize(),
@@ -22,6 +22,7 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/core/api/error_reporter.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/compatibility.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/memory_plan_cache.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_op_resolver.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/simple_memory_allocator.h"
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
@@ -139,6 +140,10 @@ class MicroAllocator {
   // `FinishModelAllocation`. Otherwise, it will return 0.
   size_t used_bytes() const;
 
+  // Take the memory plan from `cache` when it has one for `model_hash`, and
+  // store new plans in it. Must be called before `FinishModelAllocation`.
+  void SetMemoryPlanCache(MemoryPlanCache* cache, uint32_t model_hash);
+
  protected:
   MicroAllocator(SimpleMemoryAllocator* memory_allocator,
                  ErrorReporter* error_reporter);
@@ -206,6 +211,9 @@ class MicroAllocator {
   // How many scratch buffers have been allocated.
   size_t scratch_buffer_count_ = 0;
 
+  MemoryPlanCache* plan_cache_ = nullptr;
+  uint32_t plan_cache_model_hash_ = 0;
+
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
 
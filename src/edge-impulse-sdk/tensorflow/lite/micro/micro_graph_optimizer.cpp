@@ -0,0 +1,565 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_graph_optimizer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/core/api/profiler.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_error_reporter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_time_major_utils.h"
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/x86_simd.h"
+#endif
+
+namespace tflite {
+
+namespace {
+
+// Same alignment as the tensors placed by MicroAllocator
+size_t AlignSize(size_t size) { return (size + 15) & ~static_cast<size_t>(15); }
+
+// sum((input[i] + input_offset) * filter[i]), the filters are symmetric
+inline int32_t DotProduct(const int8_t* input, int32_t input_offset,
+                          const int8_t* filter, int len) {
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+  return optimized_integer_ops::x86::DotProductInt8(input, input_offset, filter,
+                                                    0, len);
+#else
+  int32_t acc = 0;
+  for (int i = 0; i < len; i++) {
+    acc += filter[i] * (input[i] + input_offset);
+  }
+  return acc;
+#endif
+}
+
+}  // namespace
+
+MicroGraphOptimizer::MicroGraphOptimizer()
+    : context_(nullptr),
+      nodes_(nullptr),
+      registrations_(nullptr),
+      nodes_size_(0),
+      outputs_(nullptr),
+      outputs_size_(0),
+      node_state_(nullptr),
+      blocks_size_(0) {}
+
+int MicroGraphOptimizer::FindProducer(int tensor) const {
+  for (int i = 0; i < nodes_size_; i++) {
+    for (int j = 0; j < nodes_[i].outputs->size; j++) {
+      if (nodes_[i].outputs->data[j] == tensor) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+int MicroGraphOptimizer::CountConsumers(int tensor) const {
+  int count = 0;
+  for (int i = 0; i < nodes_size_; i++) {
+    for (int j = 0; j < nodes_[i].inputs->size; j++) {
+      count += nodes_[i].inputs->data[j] == tensor;
+    }
+  }
+  return count;
+}
+
+int MicroGraphOptimizer::FindConsumer(int tensor) const {
+  for (int i = 0; i < nodes_size_; i++) {
+    for (int j = 0; j < nodes_[i].inputs->size; j++) {
+      if (nodes_[i].inputs->data[j] == tensor) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+bool MicroGraphOptimizer::IsGraphOutput(int tensor) const {
+  for (int i = 0; i < outputs_size_; i++) {
+    if (outputs_[i] == tensor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MicroGraphOptimizer::IsArenaTensor(int tensor) const {
+  return context_->tensors[tensor].allocation_type == kTfLiteArenaRw;
+}
+
+int MicroGraphOptimizer::AliasRoot(int tensor) const {
+  const int producer = FindProducer(tensor);
+  if (producer >= 0 && node_state_[producer] == kElided) {
+    return AliasRoot(nodes_[producer].inputs->data[0]);
+  }
+  return tensor;
+}
+
+int MicroGraphOptimizer::Step(int node_index) const {
+  const int state = node_state_[node_index];
+  return state >= 0 ? blocks_[state].first_node : node_index;
+}
+
+bool MicroGraphOptimizer::IsTimeMajorReshape(int node_index) const {
+  const TfLiteNode* node = &nodes_[node_index];
+  if (!IsRegistrationOf(registrations_[node_index],
+                        ops::micro::Register_RESHAPE()) ||
+      node->inputs->size < 1 || node->outputs->size != 1) {
+    return false;
+  }
+  const TfLiteTensor* input = &context_->tensors[node->inputs->data[0]];
+  const TfLiteTensor* output = &context_->tensors[node->outputs->data[0]];
+  int input_time_steps, input_channels, output_time_steps, output_channels;
+  int axis;
+  return GetTimeMajorShape(input, &input_time_steps, &input_channels, &axis) &&
+         GetTimeMajorShape(output, &output_time_steps, &output_channels,
+                           &axis) &&
+         input_time_steps == output_time_steps &&
+         input_channels == output_channels;
+}
+
+bool MicroGraphOptimizer::MatchBlock(int conv_node, FusedBlock* block) {
+  TfLiteNode* node = &nodes_[conv_node];
+  TfLiteTensor* tensors = context_->tensors;
+  static_shape::ConvBlockShape* shape = &block->shape;
+  static_shape::ConvBlockParams* params = &block->params;
+  TimeWindow conv;
+  if (!IsRegistrationOf(registrations_[conv_node],
+                        ops::micro::Register_CONV_2D()) ||
+      !GetConvTimeWindow(context_, node, &conv)) {
+    return false;
+  }
+
+  const TfLiteTensor* input = &tensors[node->inputs->data[0]];
+  const TfLiteTensor* output = &tensors[node->outputs->data[0]];
+  int axis;
+  if (!GetTimeMajorShape(input, &shape->input_time_steps,
+                         &shape->input_channels, &axis) ||
+      !GetTimeMajorShape(output, &shape->conv_time_steps, &shape->channels,
+                         &axis)) {
+    return false;
+  }
+  shape->conv_filter = conv.filter;
+  shape->conv_stride = conv.stride;
+  shape->conv_dilation = conv.dilation;
+  shape->conv_padding = conv.padding;
+  shape->has_add = false;
+  shape->pool_filter = 0;
+  shape->pool_stride = 1;
+  shape->pool_padding = 0;
+  shape->output_time_steps = shape->conv_time_steps;
+
+  memset(params, 0, sizeof(*params));
+  params->filter_data = GetTensorData<int8_t>(&tensors[node->inputs->data[1]]);
+  if (node->inputs->size == 3 && node->inputs->data[2] >= 0) {
+    params->bias_data =
+        GetTensorData<int32_t>(&tensors[node->inputs->data[2]]);
+  }
+  params->input_offset = -input->params.zero_point;
+  params->conv_output_offset = output->params.zero_point;
+
+  block->first_node = conv_node;
+  block->conv_node = conv_node;
+  block->add_node = -1;
+  block->pool_node = -1;
+  block->input_tensor = node->inputs->data[0];
+  block->kernel = nullptr;
+
+  // Follow the only consumer of the conv output: reshapes that keep the
+  // layout, then optionally the add, then optionally the max pool
+  int members[kMaxBlockNodes];
+  int members_size = 0;
+  int pending_reshapes = 0;
+  int current = node->outputs->data[0];
+  block->output_tensor = current;
+  members[members_size++] = conv_node;
+
+  while (members_size + pending_reshapes < kMaxBlockNodes) {
+    if (IsGraphOutput(current) || CountConsumers(current) != 1) {
+      break;
+    }
+    const int next = FindConsumer(current);
+    TfLiteNode* next_node = &nodes_[next];
+    const TfLiteRegistration* registration = registrations_[next];
+
+    if (IsTimeMajorReshape(next) && next_node->inputs->data[0] == current) {
+      members[members_size + pending_reshapes++] = next;
+      current = next_node->outputs->data[0];
+      continue;
+    }
+
+    if (block->add_node < 0 && block->pool_node < 0 &&
+        IsRegistrationOf(registration, ops::micro::Register_ADD())) {
+      const int streamed = GetAddVectorInput(context_, next_node);
+      AddQuantParams add;
+      if (streamed < 0 || next_node->inputs->data[streamed] != current ||
+          GetAddQuantParams(context_, next_node, &add) != kTfLiteOk) {
+        break;
+      }
+      const bool input1 = streamed == 0;
+      params->add_left_shift = add.left_shift;
+      params->add_input_offset = input1 ? add.input1_offset : add.input2_offset;
+      params->add_input_multiplier =
+          input1 ? add.input1_multiplier : add.input2_multiplier;
+      params->add_input_shift = input1 ? add.input1_shift : add.input2_shift;
+      params->add_output_offset = add.output_offset;
+      params->add_output_multiplier = add.output_multiplier;
+      params->add_output_shift = add.output_shift;
+      params->add_activation_min = add.activation_min;
+      params->add_activation_max = add.activation_max;
+      shape->has_add = true;
+      block->add_node = next;
+    } else if (block->pool_node < 0 &&
+               IsRegistrationOf(registration,
+                                ops::micro::Register_MAX_POOL_2D())) {
+      // Overlapping windows would compute conv columns more than once
+      TimeWindow pool;
+      if (!GetMaxPoolTimeWindow(context_, next_node, &pool) ||
+          pool.filter > pool.stride) {
+        break;
+      }
+      auto* pool_params =
+          reinterpret_cast<TfLitePoolParams*>(next_node->builtin_data);
+      TfLiteTensor* pool_output = &tensors[next_node->outputs->data[0]];
+      if (CalculateActivationRangeQuantized(
+              context_, pool_params->activation, pool_output,
+              &params->pool_activation_min,
+              &params->pool_activation_max) != kTfLiteOk) {
+        break;
+      }
+      int channels;
+      GetTimeMajorShape(pool_output, &shape->output_time_steps, &channels,
+                        &axis);
+      shape->pool_filter = pool.filter;
+      shape->pool_stride = pool.stride;
+      shape->pool_padding = pool.padding;
+      block->pool_node = next;
+    } else {
+      break;
+    }
+
+    members_size += pending_reshapes + 1;
+    members[members_size - 1] = next;
+    pending_reshapes = 0;
+    current = next_node->outputs->data[0];
+    block->output_tensor = current;
+  }
+
+  // A conv on its own runs faster through its kernel
+  if (block->add_node < 0 && block->pool_node < 0) {
+    return false;
+  }
+  for (int i = 0; i < members_size; i++) {
+    node_state_[members[i]] = static_cast<int8_t>(blocks_size_);
+  }
+  return true;
+}
+
+TfLiteStatus MicroGraphOptimizer::Init(
+    TfLiteContext* context, TfLiteNode* nodes,
+    const TfLiteRegistration* const* registrations, int nodes_size,
+    const int* outputs, int outputs_size) {
+  context_ = context;
+  nodes_ = nodes;
+  registrations_ = registrations;
+  nodes_size_ = nodes_size;
+  outputs_ = outputs;
+  outputs_size_ = outputs_size;
+  blocks_size_ = 0;
+
+  // rounded up, so the buffers allocated after this one stay aligned
+  void* state;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, (nodes_size + 3) & ~3, &state));
+  node_state_ = static_cast<int8_t*>(state);
+  for (int i = 0; i < nodes_size; i++) {
+    node_state_[i] = kInvoke;
+  }
+
+  for (int i = 0; i < nodes_size && blocks_size_ < kMaxBlocks; i++) {
+    if (node_state_[i] == kInvoke && MatchBlock(i, &blocks_[blocks_size_])) {
+      blocks_size_++;
+    }
+  }
+
+  // Reshapes left over just relabel a tensor nobody else reads
+  for (int i = 0; i < nodes_size; i++) {
+    TfLiteNode* node = &nodes[i];
+    if (node_state_[i] != kInvoke ||
+        !IsRegistrationOf(registrations[i], ops::micro::Register_RESHAPE()) ||
+        node->inputs->size < 1 || node->outputs->size != 1) {
+      continue;
+    }
+    const int input = node->inputs->data[0];
+    const int output = node->outputs->data[0];
+    if (IsArenaTensor(input) && IsArenaTensor(output) &&
+        !IsGraphOutput(input) && CountConsumers(input) == 1 &&
+        context->tensors[input].bytes == context->tensors[output].bytes) {
+      node_state_[i] = kElided;
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroGraphOptimizer::PlanMemory(uint8_t* arena,
+                                             size_t arena_size,
+                                             size_t* used_bytes) {
+  TfLiteTensor* tensors = context_->tensors;
+  const int tensors_size = static_cast<int>(context_->tensors_size);
+
+  // Tensors only written and read inside a fused block don't exist anymore
+  auto is_dead = [this](int tensor) {
+    const int producer = FindProducer(tensor);
+    return producer >= 0 && node_state_[producer] >= 0 &&
+           blocks_[node_state_[producer]].output_tensor != tensor;
+  };
+  auto is_planned = [&](int tensor) {
+    return IsArenaTensor(tensor) && AliasRoot(tensor) == tensor &&
+           !is_dead(tensor);
+  };
+
+  int buffers_size = 0;
+  for (int i = 0; i < tensors_size; i++) {
+    buffers_size += is_planned(i);
+  }
+  if (buffers_size * GreedyMemoryPlanner::per_buffer_size() > arena_size) {
+    return kTfLiteError;
+  }
+
+  MicroErrorReporter error_reporter;
+  GreedyMemoryPlanner planner(arena, static_cast<int>(arena_size));
+  for (int i = 0; i < tensors_size; i++) {
+    if (!is_planned(i)) {
+      continue;
+    }
+    // Alive from the step that writes it to the last step that reads it or
+    // any of its aliases
+    const int producer = FindProducer(i);
+    const int first = producer >= 0 ? Step(producer) : 0;
+    int last = first;
+    for (int j = 0; j < tensors_size; j++) {
+      if (!IsArenaTensor(j) || AliasRoot(j) != i) {
+        continue;
+      }
+      if (IsGraphOutput(j)) {
+        last = nodes_size_;
+      }
+      for (int n = 0; n < nodes_size_; n++) {
+        for (int k = 0; k < nodes_[n].inputs->size; k++) {
+          if (nodes_[n].inputs->data[k] == j) {
+            last = std::max(last, Step(n));
+          }
+        }
+      }
+    }
+    TF_LITE_ENSURE_STATUS(planner.AddBuffer(
+        &error_reporter, static_cast<int>(AlignSize(tensors[i].bytes)), first,
+        last));
+  }
+
+  const size_t planned_size = planner.GetMaximumMemorySize();
+  if (planned_size > arena_size) {
+    return kTfLiteError;
+  }
+  int buffer_index = 0;
+  for (int i = 0; i < tensors_size; i++) {
+    if (!is_planned(i)) {
+      continue;
+    }
+    int offset;
+    TF_LITE_ENSURE_STATUS(
+        planner.GetOffsetForBuffer(&error_reporter, buffer_index++, &offset));
+    tensors[i].data.data = arena + offset;
+  }
+  for (int i = 0; i < tensors_size; i++) {
+    if (!IsArenaTensor(i) || is_planned(i)) {
+      continue;
+    }
+    tensors[i].data.data =
+        is_dead(i) ? nullptr : tensors[AliasRoot(i)].data.data;
+  }
+  *used_bytes = planned_size;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroGraphOptimizer::Prepare() {
+  TfLiteTensor* tensors = context_->tensors;
+  for (int i = 0; i < blocks_size_; i++) {
+    FusedBlock* block = &blocks_[i];
+    const int channels = block->shape.channels;
+    void* raw;
+    TF_LITE_ENSURE_STATUS(context_->AllocatePersistentBuffer(
+        context_, 3 * channels * sizeof(int32_t), &raw));
+    int32_t* per_channel_multiplier = static_cast<int32_t*>(raw);
+    int32_t* per_channel_shift = per_channel_multiplier + channels;
+    int32_t* add_vector_term = per_channel_shift + channels;
+    block->params.per_channel_multiplier = per_channel_multiplier;
+    block->params.per_channel_shift = per_channel_shift;
+    block->params.add_vector_term = add_vector_term;
+
+    // Same as CalculateOpData in kernels/conv.cpp
+    TfLiteNode* node = &nodes_[block->conv_node];
+    const TfLiteTensor* bias = nullptr;
+    if (node->inputs->size == 3 && node->inputs->data[2] >= 0) {
+      bias = &tensors[node->inputs->data[2]];
+    }
+    auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+    int32_t output_multiplier;
+    int output_shift;
+    TF_LITE_ENSURE_STATUS(PopulateConvolutionQuantizationParams(
+        context_, &tensors[node->inputs->data[0]],
+        &tensors[node->inputs->data[1]], bias,
+        &tensors[node->outputs->data[0]], params->activation,
+        &output_multiplier, &output_shift, &block->params.conv_activation_min,
+        &block->params.conv_activation_max, per_channel_multiplier,
+        reinterpret_cast<int*>(per_channel_shift), channels));
+
+    // The constant side of the add, scaled the way kernels/add.cpp does it
+    if (block->add_node >= 0) {
+      TfLiteNode* add_node = &nodes_[block->add_node];
+      AddQuantParams add;
+      TF_LITE_ENSURE_STATUS(GetAddQuantParams(context_, add_node, &add));
+      const bool input1 = GetAddVectorInput(context_, add_node) == 0;
+      const int8_t* vector = GetTensorData<int8_t>(
+          &tensors[add_node->inputs->data[input1 ? 1 : 0]]);
+      for (int c = 0; c < channels; c++) {
+        const int32_t value =
+            vector[c] + (input1 ? add.input2_offset : add.input1_offset);
+        add_vector_term[c] = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+            value * (1 << add.left_shift),
+            input1 ? add.input2_multiplier : add.input1_multiplier,
+            input1 ? add.input2_shift : add.input1_shift);
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroGraphOptimizer::SetBlockKernel(
+    int block_index, const static_shape::ConvBlockShape& shape,
+    static_shape::ConvBlockKernel kernel) {
+  if (block_index < 0 || block_index >= blocks_size_ ||
+      !(blocks_[block_index].shape == shape)) {
+    return kTfLiteError;
+  }
+  blocks_[block_index].kernel = kernel;
+  return kTfLiteOk;
+}
+
+int32_t MicroGraphOptimizer::ComputeBlockValue(const FusedBlock& block,
+                                               const int8_t* input,
+                                               int column, int channel) const {
+  // conv, see reference_integer_ops::ConvPerChannel
+  const static_shape::ConvBlockShape& shape = block.shape;
+  const static_shape::ConvBlockParams& params = block.params;
+  const int input_channels = shape.input_channels;
+  const int8_t* filter =
+      params.filter_data + channel * shape.conv_filter * input_channels;
+  const int origin = column * shape.conv_stride - shape.conv_padding;
+  int32_t acc = 0;
+  for (int k = 0; k < shape.conv_filter; k++) {
+    const int t = origin + k * shape.conv_dilation;
+    if (t < 0 || t >= shape.input_time_steps) {
+      continue;
+    }
+    acc += DotProduct(input + t * input_channels, params.input_offset,
+                      filter + k * input_channels, input_channels);
+  }
+  return shape.has_add
+             ? static_shape::ConvBlockEpilogue<true>(params, channel, acc)
+             : static_shape::ConvBlockEpilogue<false>(params, channel, acc);
+}
+
+void MicroGraphOptimizer::RunBlock(const FusedBlock& block) const {
+  const int8_t* input = context_->tensors[block.input_tensor].data.int8;
+  int8_t* output = context_->tensors[block.output_tensor].data.int8;
+  if (block.kernel) {
+    block.kernel(block.params, input, output);
+    return;
+  }
+
+  const static_shape::ConvBlockShape& shape = block.shape;
+  const int channels = shape.channels;
+  if (shape.pool_filter == 0) {
+    for (int t = 0; t < shape.conv_time_steps; t++) {
+      for (int c = 0; c < channels; c++) {
+        output[t * channels + c] =
+            static_cast<int8_t>(ComputeBlockValue(block, input, t, c));
+      }
+    }
+    return;
+  }
+
+  // max pool, see reference_integer_ops::MaxPool. Only the conv columns that
+  // fall in a pool window are computed.
+  for (int p = 0; p < shape.output_time_steps; p++) {
+    const int origin = p * shape.pool_stride - shape.pool_padding;
+    const int start = std::max(0, -origin);
+    const int end = std::min(shape.pool_filter, shape.conv_time_steps - origin);
+    for (int c = 0; c < channels; c++) {
+      int32_t max = std::numeric_limits<int8_t>::lowest();
+      for (int k = start; k < end; k++) {
+        max = std::max(max, ComputeBlockValue(block, input, origin + k, c));
+      }
+      max = std::max(max, block.params.pool_activation_min);
+      max = std::min(max, block.params.pool_activation_max);
+      output[p * channels + c] = static_cast<int8_t>(max);
+    }
+  }
+}
+
+TfLiteStatus MicroGraphOptimizer::Invoke() {
+#if EI_CLASSIFIER_PROFILING == 1
+  // A fused block is one event at its first node. No tag, the nodes are named
+  // by whoever set up the profiler.
+  Profiler* profiler = reinterpret_cast<Profiler*>(context_->profiler);
+#endif
+  for (int i = 0; i < nodes_size_; i++) {
+    const int state = node_state_[i];
+    if (state == kElided) {
+      continue;
+    }
+    if (state >= 0) {
+      if (blocks_[state].first_node == i) {
+#if EI_CLASSIFIER_PROFILING == 1
+        ScopedOperatorProfile scoped_profiler(profiler, nullptr, i);
+#endif
+        RunBlock(blocks_[state]);
+      }
+      continue;
+    }
+#if EI_CLASSIFIER_PROFILING == 1
+    ScopedOperatorProfile scoped_profiler(profiler, nullptr, i);
+#endif
+    TF_LITE_ENSURE_STATUS(registrations_[i]->invoke(context_, &nodes_[i]));
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
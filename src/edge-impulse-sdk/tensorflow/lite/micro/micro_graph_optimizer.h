@@ -0,0 +1,130 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_GRAPH_OPTIMIZER_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_GRAPH_OPTIMIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/static_shape_kernels.h"
+
+namespace tflite {
+
+// Graph pass for compiled (EON) models, run once when the model is set up.
+//
+// 1D convolutional models are exported as chains of
+//   RESHAPE, CONV_2D, RESHAPE, ADD (bias + ReLU), RESHAPE, MAX_POOL_2D
+// where every reshape copies the activations, and every op writes a full
+// tensor that the next one reads back. This pass
+//  - elides reshapes: their output aliases their input, so they cost nothing,
+//  - fuses CONV_2D with the ADD of a constant vector and the MAX_POOL_2D that
+//    follow it into one loop, the add and activation become part of the
+//    requantization epilogue and the pool reduces the conv columns as they
+//    are computed, so none of the intermediate tensors are ever stored,
+//  - plans the arena again for the remaining tensors.
+// The fused loop does the same integer arithmetic as the reference kernels,
+// so the output is bit-exact with the unoptimized graph. Compiled models can
+// swap in a static_shape::ConvBlock instantiated for each block's shape.
+class MicroGraphOptimizer {
+ public:
+  static constexpr int kMaxBlocks = 8;
+  static constexpr int kMaxBlockNodes = 16;
+
+  MicroGraphOptimizer();
+
+  // Find the reshapes to elide and the ops to fuse. The tensors and nodes
+  // must be set up, the nodes not prepared yet. `outputs` are the graph
+  // output tensors, those are never aliased or fused away.
+  TfLiteStatus Init(TfLiteContext* context, TfLiteNode* nodes,
+                    const TfLiteRegistration* const* registrations,
+                    int nodes_size, const int* outputs, int outputs_size);
+
+  // Assign arena offsets to the tensors that are still read or written, the
+  // others get a NULL data pointer. The arena is used as scratch space while
+  // planning. `used_bytes` is the size of the planned tensor area.
+  TfLiteStatus PlanMemory(uint8_t* arena, size_t arena_size,
+                          size_t* used_bytes);
+
+  // Compute the quantization params of the fused blocks, after planning.
+  TfLiteStatus Prepare();
+
+  // Run fused block `block_index` (in graph order) with a kernel built for
+  // its shape, e.g. static_shape::ConvBlock<...>::Eval. Fails if `shape`
+  // isn't the shape of the block.
+  TfLiteStatus SetBlockKernel(int block_index,
+                              const static_shape::ConvBlockShape& shape,
+                              static_shape::ConvBlockKernel kernel);
+
+  // Run the graph.
+  TfLiteStatus Invoke();
+
+  // Whether a node runs as part of a fused block. These nodes must not be
+  // initialized, prepared or invoked on their own.
+  bool IsFused(int node_index) const {
+    return node_state_ && node_state_[node_index] >= 0;
+  }
+
+  // Whether a node is a reshape whose output aliases its input.
+  bool IsElided(int node_index) const {
+    return node_state_ && node_state_[node_index] == kElided;
+  }
+
+  int fused_blocks() const { return blocks_size_; }
+
+ private:
+  static constexpr int8_t kInvoke = -1;
+  static constexpr int8_t kElided = -2;
+
+  struct FusedBlock {
+    int first_node;
+    int conv_node;
+    int add_node;   // -1 if none
+    int pool_node;  // -1 if none, only fused when its windows don't overlap
+    int input_tensor;
+    int output_tensor;
+    static_shape::ConvBlockShape shape;
+    static_shape::ConvBlockParams params;
+    static_shape::ConvBlockKernel kernel;  // NULL runs the generic loop
+  };
+
+  int FindProducer(int tensor) const;
+  int CountConsumers(int tensor) const;
+  int FindConsumer(int tensor) const;
+  bool IsGraphOutput(int tensor) const;
+  bool IsArenaTensor(int tensor) const;
+  int AliasRoot(int tensor) const;
+  int Step(int node_index) const;
+  bool IsTimeMajorReshape(int node_index) const;
+  bool MatchBlock(int conv_node, FusedBlock* block);
+  int32_t ComputeBlockValue(const FusedBlock& block, const int8_t* input,
+                            int column, int channel) const;
+  void RunBlock(const FusedBlock& block) const;
+
+  TfLiteContext* context_;
+  TfLiteNode* nodes_;
+  const TfLiteRegistration* const* registrations_;
+  int nodes_size_;
+  const int* outputs_;
+  int outputs_size_;
+
+  int8_t* node_state_;  // kInvoke, kElided or the index of the fused block
+  FusedBlock blocks_[kMaxBlocks];
+  int blocks_size_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_GRAPH_OPTIMIZER_H_
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cstdint>
 
 #include "edge-impulse-sdk/third_party/flatbuffers/include/flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/core/api/error_reporter.h"
 #include "edge-impulse-sdk/tensorflow/lite/core/api/tensor_utils.h"
@@ -275,7 +276,8 @@ TfLiteStatus MicroInterpreter::Invoke() {
 
     if (registration->invoke) {
       TfLiteStatus invoke_status;
-#ifndef NDEBUG  // Omit profiler overhead from release builds.
+// Omit profiler overhead from release builds, unless profiling was asked for.
+#if !defined(NDEBUG) || EI_CLASSIFIER_PROFILING == 1
       // The case where profiler == nullptr is handled by ScopedOperatorProfile.
       tflite::Profiler* profiler =
           reinterpret_cast<tflite::Profiler*>(context_.profiler);
@@ -92,6 +92,13 @@ class MicroInterpreter {
   // intermediate tensors.
   TfLiteStatus AllocateTensors();
 
+  // Have AllocateTensors() take the memory plan from `cache` if it has one
+  // for `model_hash` (e.g. MemoryPlanCache::Hash of the model flatbuffer),
+  // and store the plan there otherwise.
+  void SetMemoryPlanCache(MemoryPlanCache* cache, uint32_t model_hash) {
+    allocator_.SetMemoryPlanCache(cache, model_hash);
+  }
+
   // In order to support partial graph runs for strided models, this can return
   // values other than kTfLiteOk and kTfLiteError.
   // TODO(b/149795762): Add this to the TfLiteStatus enum.
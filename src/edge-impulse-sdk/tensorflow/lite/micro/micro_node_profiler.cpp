@@ -0,0 +1,77 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_node_profiler.h"
+
+#include <string.h>
+
+namespace tflite {
+
+MicroNodeProfiler::MicroNodeProfiler(Node* nodes, size_t nodes_size,
+                                     uint64_t (*clock)())
+    : nodes_(nodes), nodes_size_(nodes_size), nodes_used_(0), clock_(clock) {
+  memset(nodes_, 0, nodes_size_ * sizeof(Node));
+}
+
+uint32_t MicroNodeProfiler::BeginEvent(const char* tag, EventType event_type,
+                                       int64_t event_metadata1,
+                                       int64_t /*event_metadata2*/) {
+  if (event_type != EventType::OPERATOR_INVOKE_EVENT || event_metadata1 < 0 ||
+      static_cast<uint64_t>(event_metadata1) >= nodes_size_) {
+    return kIgnored;
+  }
+  const size_t index = static_cast<size_t>(event_metadata1);
+  Node& node = nodes_[index];
+  if (node.tag == nullptr) {
+    node.tag = tag;
+  }
+  if (index >= nodes_used_) {
+    nodes_used_ = index + 1;
+  }
+  node.start = clock_();
+  return static_cast<uint32_t>(index);
+}
+
+void MicroNodeProfiler::EndEvent(uint32_t event_handle) {
+  if (event_handle == kIgnored) {
+    return;
+  }
+  Node& node = nodes_[event_handle];
+  const uint64_t ticks = clock_() - node.start;
+  node.invocations++;
+  node.total_ticks += ticks;
+  if (ticks > node.max_ticks) {
+    node.max_ticks = static_cast<uint32_t>(ticks);
+  }
+}
+
+void MicroNodeProfiler::SetNodeTag(int node_index, const char* tag) {
+  if (node_index < 0 || static_cast<size_t>(node_index) >= nodes_size_) {
+    return;
+  }
+  nodes_[node_index].tag = tag;
+  if (static_cast<size_t>(node_index) >= nodes_used_) {
+    nodes_used_ = node_index + 1;
+  }
+}
+
+void MicroNodeProfiler::Reset() {
+  for (size_t i = 0; i < nodes_size_; i++) {
+    const char* tag = nodes_[i].tag;
+    memset(&nodes_[i], 0, sizeof(Node));
+    nodes_[i].tag = tag;
+  }
+}
+
+}  // namespace tflite
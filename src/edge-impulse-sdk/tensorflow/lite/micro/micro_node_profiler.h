@@ -0,0 +1,79 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_NODE_PROFILER_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_NODE_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/core/api/profiler.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/compatibility.h"
+
+namespace tflite {
+
+// Profiler that sums the time spent in every node of a graph, for reading the
+// numbers back from code rather than from the log (MicroProfiler prints every
+// event). Only operator invoke events are counted, the node index of the event
+// selects the counter. Ticks come from the clock passed in, e.g. a
+// microsecond timer.
+//
+// Executors that run several nodes as one kernel (fused blocks, streamed
+// layers) report the time at the first node of the group, the other nodes of
+// the group don't see any invocations.
+class MicroNodeProfiler : public tflite::Profiler {
+ public:
+  struct Node {
+    const char* tag;  // first non-null tag seen for the node
+    uint32_t invocations;
+    uint32_t max_ticks;
+    uint64_t total_ticks;
+    uint64_t start;
+  };
+
+  // `nodes` has room for `nodes_size` counters, events for nodes beyond that
+  // are dropped.
+  MicroNodeProfiler(Node* nodes, size_t nodes_size, uint64_t (*clock)());
+  ~MicroNodeProfiler() override = default;
+
+  uint32_t BeginEvent(const char* tag, EventType event_type,
+                      int64_t event_metadata1,
+                      int64_t event_metadata2) override;
+  void EndEvent(uint32_t event_handle) override;
+
+  // Name a node up front, for graphs whose registrations don't carry a
+  // builtin code (the compiled models).
+  void SetNodeTag(int node_index, const char* tag);
+
+  // Zero all counters, the tags are kept.
+  void Reset();
+
+  const Node* nodes() const { return nodes_; }
+  // One past the highest node index seen.
+  size_t nodes_used() const { return nodes_used_; }
+
+ private:
+  static constexpr uint32_t kIgnored = 0xffffffff;
+
+  Node* nodes_;
+  size_t nodes_size_;
+  size_t nodes_used_;
+  uint64_t (*clock_)();
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_NODE_PROFILER_H_
@@ -0,0 +1,513 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_streaming_executor.h"
+
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/tensorflow/lite/core/api/profiler.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/add.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
+#endif
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/types.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_time_major_utils.h"
+
+namespace tflite {
+
+namespace {
+
+// The column ranges are computed with the same kernels a full invoke uses on
+// this target, so both give the same output.
+#if EI_CLASSIFIER_TFLITE_ENABLE_X86_SIMD == 1
+namespace streaming_kernels = optimized_integer_ops;
+#else
+namespace streaming_kernels = reference_integer_ops;
+#endif
+
+size_t AlignSize(size_t size) { return (size + 15) & ~static_cast<size_t>(15); }
+
+}  // namespace
+
+MicroStreamingExecutor::MicroStreamingExecutor()
+    : context_(nullptr),
+      nodes_(nullptr),
+      registrations_(nullptr),
+      nodes_size_(0),
+      input_tensor_(-1),
+      tail_start_(0),
+      input_time_steps_(0),
+      input_channels_(0),
+      input_cache_(nullptr),
+      input_dirty_(nullptr),
+      layers_size_(0),
+      buffer_(nullptr),
+      initialized_(false),
+      primed_(false),
+      recomputed_columns_(0),
+      total_columns_(0) {}
+
+TfLiteStatus MicroStreamingExecutor::AddLayer(int node_index, Layer* layer) {
+  TfLiteNode* node = &nodes_[node_index];
+  const TfLiteRegistration* registration = registrations_[node_index];
+  TfLiteTensor* tensors = context_->tensors;
+
+  if (node->outputs->size != 1) {
+    return kTfLiteError;
+  }
+  TfLiteTensor* output = &tensors[node->outputs->data[0]];
+
+  memset(layer, 0, sizeof(Layer));
+  layer->node_index = node_index;
+  layer->output_tensor = node->outputs->data[0];
+  int axis;
+  if (!GetTimeMajorShape(output, &layer->time_steps, &layer->channels,
+                         &axis)) {
+    return kTfLiteError;
+  }
+
+  if (IsRegistrationOf(registration, ops::micro::Register_ADD())) {
+    const int streamed = GetAddVectorInput(context_, node);
+    if (streamed < 0) {
+      return kTfLiteError;
+    }
+    layer->type = kAdd;
+    layer->streamed_is_input1 = streamed == 0;
+    layer->add_vector =
+        GetTensorData<int8_t>(&tensors[node->inputs->data[1 - streamed]]);
+    return GetAddQuantParams(context_, node, &layer->add);
+  }
+
+  if (IsRegistrationOf(registration, ops::micro::Register_CONV_2D())) {
+    if (!GetConvTimeWindow(context_, node, &layer->window)) {
+      return kTfLiteError;
+    }
+    const TfLiteTensor* input = &tensors[node->inputs->data[0]];
+    layer->type = kConv;
+    layer->filter_data =
+        GetTensorData<int8_t>(&tensors[node->inputs->data[1]]);
+    if (node->inputs->size == 3 && node->inputs->data[2] >= 0) {
+      layer->bias_data =
+          GetTensorData<int32_t>(&tensors[node->inputs->data[2]]);
+    }
+    layer->input_offset = -input->params.zero_point;
+    layer->output_offset = output->params.zero_point;
+    return kTfLiteOk;
+  }
+
+  if (IsRegistrationOf(registration, ops::micro::Register_MAX_POOL_2D())) {
+    if (!GetMaxPoolTimeWindow(context_, node, &layer->window)) {
+      return kTfLiteError;
+    }
+    auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
+    layer->type = kMaxPool;
+    return CalculateActivationRangeQuantized(context_, params->activation,
+                                             output, &layer->activation_min,
+                                             &layer->activation_max);
+  }
+
+  return kTfLiteError;
+}
+
+TfLiteStatus MicroStreamingExecutor::Init(
+    TfLiteContext* context, TfLiteNode* nodes,
+    const TfLiteRegistration* const* registrations, int nodes_size,
+    int input_tensor_index, void* (*alloc_fnc)(size_t, size_t)) {
+  context_ = context;
+  nodes_ = nodes;
+  registrations_ = registrations;
+  nodes_size_ = nodes_size;
+  input_tensor_ = input_tensor_index;
+  layers_size_ = 0;
+  initialized_ = false;
+  primed_ = false;
+
+  const TfLiteTensor* input = &context->tensors[input_tensor_index];
+  if (input->type != kTfLiteInt8) {
+    return kTfLiteError;
+  }
+
+  // Follow the graph from the input for as long as every node streams its
+  // input along the time axis
+  int streamed = input_tensor_index;
+  int time_steps = 0, channels = 0, axis;
+  bool have_shape =
+      GetTimeMajorShape(input, &time_steps, &channels, &axis);
+  int node_index = 0;
+  for (; node_index < nodes_size; node_index++) {
+    TfLiteNode* node = &nodes[node_index];
+    const TfLiteRegistration* registration = registrations[node_index];
+    if (node->inputs->size < 1 || node->outputs->size != 1) {
+      break;
+    }
+    const bool uses_streamed =
+        node->inputs->data[0] == streamed ||
+        (node->inputs->size > 1 && node->inputs->data[1] == streamed &&
+         IsRegistrationOf(registration, ops::micro::Register_ADD()));
+    if (!uses_streamed) {
+      break;
+    }
+
+    // A reshape that keeps the [time][channels] layout is a no-op here
+    if (IsRegistrationOf(registration, ops::micro::Register_RESHAPE())) {
+      const TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+      int output_time_steps, output_channels;
+      if (!GetTimeMajorShape(output, &output_time_steps, &output_channels,
+                             &axis)) {
+        break;
+      }
+      if (have_shape ? (output_time_steps != time_steps ||
+                        output_channels != channels)
+                     : (output_time_steps * output_channels !=
+                        NumElements(input))) {
+        break;
+      }
+      time_steps = output_time_steps;
+      channels = output_channels;
+      have_shape = true;
+      streamed = node->outputs->data[0];
+      continue;
+    }
+
+    if (!have_shape || layers_size_ == kMaxLayers) {
+      break;
+    }
+    if (layers_size_ == 0) {
+      input_time_steps_ = time_steps;
+      input_channels_ = channels;
+    }
+    Layer* layer = &layers_[layers_size_];
+    if (AddLayer(node_index, layer) != kTfLiteOk) {
+      break;
+    }
+    layers_size_++;
+    time_steps = layer->time_steps;
+    channels = layer->channels;
+    streamed = layer->output_tensor;
+  }
+
+  if (layers_size_ == 0) {
+    return kTfLiteError;
+  }
+  // Drop trailing reshapes from the prefix, the tail reads the last layer
+  while (node_index > 0 && IsRegistrationOf(registrations[node_index - 1],
+                                            ops::micro::Register_RESHAPE())) {
+    node_index--;
+  }
+  tail_start_ = node_index;
+
+  // The rest of the graph only gets to see the output of the last layer,
+  // intermediate activations are never written to the arena
+  const int tail_input = layers_[layers_size_ - 1].output_tensor;
+  for (int i = tail_start_; i < nodes_size; i++) {
+    for (int j = 0; j < nodes[i].inputs->size; j++) {
+      const int tensor = nodes[i].inputs->data[j];
+      if (tensor < 0 || tensor == tail_input ||
+          IsConstantTensor(&context->tensors[tensor])) {
+        continue;
+      }
+      bool produced_by_tail = false;
+      for (int k = tail_start_; k < i && !produced_by_tail; k++) {
+        for (int l = 0; l < nodes[k].outputs->size; l++) {
+          produced_by_tail |= nodes[k].outputs->data[l] == tensor;
+        }
+      }
+      if (!produced_by_tail) {
+        return kTfLiteError;
+      }
+    }
+  }
+
+  // One allocation for all caches: quantization params, activations, flags
+  size_t bytes = 0;
+  for (int i = 0; i < layers_size_; i++) {
+    if (layers_[i].type == kConv) {
+      bytes += 2 * AlignSize(layers_[i].channels * sizeof(int32_t));
+    }
+  }
+  bytes += AlignSize(input_time_steps_ * input_channels_) +
+           AlignSize(input_time_steps_);
+  for (int i = 0; i < layers_size_; i++) {
+    bytes += AlignSize(layers_[i].time_steps * layers_[i].channels) +
+             AlignSize(layers_[i].time_steps);
+  }
+  uint8_t* buffer = static_cast<uint8_t*>(alloc_fnc(16, bytes));
+  if (!buffer) {
+    layers_size_ = 0;
+    return kTfLiteError;
+  }
+  buffer_ = buffer;
+
+  uint8_t* ptr = buffer;
+  for (int i = 0; i < layers_size_; i++) {
+    Layer* layer = &layers_[i];
+    if (layer->type != kConv) {
+      continue;
+    }
+    layer->per_channel_multiplier = reinterpret_cast<int32_t*>(ptr);
+    ptr += AlignSize(layer->channels * sizeof(int32_t));
+    layer->per_channel_shift = reinterpret_cast<int32_t*>(ptr);
+    ptr += AlignSize(layer->channels * sizeof(int32_t));
+
+    // Same as CalculateOpData in kernels/conv.cpp
+    TfLiteNode* node = &nodes[layer->node_index];
+    const TfLiteTensor* bias = nullptr;
+    if (node->inputs->size == 3 && node->inputs->data[2] >= 0) {
+      bias = &context->tensors[node->inputs->data[2]];
+    }
+    auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+    int32_t output_multiplier;
+    int output_shift;
+    TfLiteStatus status = PopulateConvolutionQuantizationParams(
+        context, &context->tensors[node->inputs->data[0]],
+        &context->tensors[node->inputs->data[1]], bias,
+        &context->tensors[layer->output_tensor], params->activation,
+        &output_multiplier, &output_shift, &layer->activation_min,
+        &layer->activation_max, layer->per_channel_multiplier,
+        reinterpret_cast<int*>(layer->per_channel_shift), layer->channels);
+    if (status != kTfLiteOk) {
+      return status;
+    }
+  }
+
+  input_cache_ = reinterpret_cast<int8_t*>(ptr);
+  ptr += AlignSize(input_time_steps_ * input_channels_);
+  input_dirty_ = ptr;
+  ptr += AlignSize(input_time_steps_);
+  total_columns_ = 0;
+  for (int i = 0; i < layers_size_; i++) {
+    Layer* layer = &layers_[i];
+    layer->cache = reinterpret_cast<int8_t*>(ptr);
+    ptr += AlignSize(layer->time_steps * layer->channels);
+    layer->dirty = ptr;
+    ptr += AlignSize(layer->time_steps);
+    total_columns_ += layer->time_steps;
+  }
+
+  initialized_ = true;
+  return kTfLiteOk;
+}
+
+void MicroStreamingExecutor::ComputeColumns(const Layer& layer,
+                                            const int8_t* input,
+                                            int input_time_steps,
+                                            int input_channels, int start,
+                                            int end) {
+  // Time always runs along the width here, the kernels index the filter the
+  // same way for a [1, K] and a [K, 1] window.
+  const RuntimeShape input_shape({1, 1, input_time_steps, input_channels});
+  const RuntimeShape output_shape({1, 1, end - start, layer.channels});
+  int8_t* output = layer.cache + start * layer.channels;
+  // Output column `start` becomes column 0, so move the padding with it
+  const int padding = layer.window.padding - start * layer.window.stride;
+
+  switch (layer.type) {
+    case kConv: {
+      ConvParams op_params;
+      op_params.input_offset = layer.input_offset;
+      op_params.output_offset = layer.output_offset;
+      op_params.stride_height = 1;
+      op_params.stride_width = layer.window.stride;
+      op_params.dilation_height_factor = 1;
+      op_params.dilation_width_factor = layer.window.dilation;
+      op_params.padding_values.height = 0;
+      op_params.padding_values.width = padding;
+      op_params.quantized_activation_min = layer.activation_min;
+      op_params.quantized_activation_max = layer.activation_max;
+      streaming_kernels::ConvPerChannel(
+          op_params, layer.per_channel_multiplier, layer.per_channel_shift,
+          input_shape, input,
+          RuntimeShape({layer.channels, 1, layer.window.filter, input_channels}),
+          layer.filter_data, RuntimeShape({layer.channels}), layer.bias_data,
+          output_shape, output);
+      break;
+    }
+    case kAdd: {
+      ArithmeticParams op_params;
+      op_params.left_shift = layer.add.left_shift;
+      op_params.input1_offset = layer.add.input1_offset;
+      op_params.input1_multiplier = layer.add.input1_multiplier;
+      op_params.input1_shift = layer.add.input1_shift;
+      op_params.input2_offset = layer.add.input2_offset;
+      op_params.input2_multiplier = layer.add.input2_multiplier;
+      op_params.input2_shift = layer.add.input2_shift;
+      op_params.output_offset = layer.add.output_offset;
+      op_params.output_multiplier = layer.add.output_multiplier;
+      op_params.output_shift = layer.add.output_shift;
+      SetActivationParams(layer.add.activation_min, layer.add.activation_max,
+                          &op_params);
+      const RuntimeShape vector_shape({layer.channels});
+      const int8_t* streamed = input + start * input_channels;
+      if (layer.streamed_is_input1) {
+        streaming_kernels::BroadcastAdd4DSlow(op_params, output_shape, streamed,
+                                              vector_shape, layer.add_vector,
+                                              output_shape, output);
+      } else {
+        streaming_kernels::BroadcastAdd4DSlow(op_params, vector_shape,
+                                              layer.add_vector, output_shape,
+                                              streamed, output_shape, output);
+      }
+      break;
+    }
+    case kMaxPool: {
+      PoolParams op_params;
+      op_params.stride_height = 1;
+      op_params.stride_width = layer.window.stride;
+      op_params.filter_height = 1;
+      op_params.filter_width = layer.window.filter;
+      op_params.padding_values.height = 0;
+      op_params.padding_values.width = padding;
+      op_params.quantized_activation_min = layer.activation_min;
+      op_params.quantized_activation_max = layer.activation_max;
+      streaming_kernels::MaxPool(op_params, input_shape, input, output_shape,
+                                 output);
+      break;
+    }
+  }
+}
+
+TfLiteStatus MicroStreamingExecutor::Invoke(int shift_elements) {
+  if (!initialized_) {
+    return kTfLiteError;
+  }
+
+  // Input steps that are the same as `shift` steps later in the last input
+  const int8_t* input = context_->tensors[input_tensor_].data.int8;
+  int shift = -1;
+  if (primed_ && shift_elements >= 0 && shift_elements % input_channels_ == 0) {
+    shift = shift_elements / input_channels_;
+  }
+  for (int t = 0; t < input_time_steps_; t++) {
+    input_dirty_[t] =
+        !(shift >= 0 && t + shift < input_time_steps_ &&
+          memcmp(input + t * input_channels_,
+                 input_cache_ + (t + shift) * input_channels_,
+                 input_channels_) == 0);
+  }
+  memcpy(input_cache_, input, input_time_steps_ * input_channels_);
+
+  const int8_t* layer_input = input_cache_;
+  const uint8_t* input_dirty = input_dirty_;
+  int input_time_steps = input_time_steps_;
+  int input_channels = input_channels_;
+  int input_shift = shift;
+  recomputed_columns_ = 0;
+
+#if EI_CLASSIFIER_PROFILING == 1
+  // Every cached layer is one event at its node, no tags (see the optimizer)
+  Profiler* profiler = reinterpret_cast<Profiler*>(context_->profiler);
+#endif
+  for (int i = 0; i < layers_size_; i++) {
+    Layer& layer = layers_[i];
+#if EI_CLASSIFIER_PROFILING == 1
+    ScopedOperatorProfile scoped_profiler(profiler, nullptr, layer.node_index);
+#endif
+    int output_shift = -1;
+    if (input_shift >= 0) {
+      if (layer.type == kAdd) {
+        output_shift = input_shift;
+      } else if (input_shift % layer.window.stride == 0) {
+        output_shift = input_shift / layer.window.stride;
+      }
+    }
+
+    // Output column j can be taken from column j + output_shift of the last
+    // invoke if every tap reads the same value it read back then. That holds
+    // for clean input steps, and for padding that was padding before as well.
+    for (int j = 0; j < layer.time_steps; j++) {
+      bool reuse = output_shift >= 0 && j + output_shift < layer.time_steps;
+      if (reuse && layer.type == kAdd) {
+        reuse = !input_dirty[j];
+      } else if (reuse) {
+        const int origin = j * layer.window.stride - layer.window.padding;
+        for (int k = 0; k < layer.window.filter && reuse; k++) {
+          const int tap = origin + k * layer.window.dilation;
+          if (tap < 0) {
+            reuse = tap + input_shift < 0;
+          } else if (tap < input_time_steps) {
+            reuse = !input_dirty[tap];
+          }
+        }
+      }
+      layer.dirty[j] = !reuse;
+    }
+
+    if (output_shift > 0 && output_shift < layer.time_steps) {
+      memmove(layer.cache, layer.cache + output_shift * layer.channels,
+              (layer.time_steps - output_shift) * layer.channels);
+    }
+
+    for (int j = 0; j < layer.time_steps;) {
+      if (!layer.dirty[j]) {
+        j++;
+        continue;
+      }
+      int end = j + 1;
+      while (end < layer.time_steps && layer.dirty[end]) {
+        end++;
+      }
+      ComputeColumns(layer, layer_input, input_time_steps, input_channels, j,
+                     end);
+      recomputed_columns_ += end - j;
+      j = end;
+    }
+
+    layer_input = layer.cache;
+    input_dirty = layer.dirty;
+    input_time_steps = layer.time_steps;
+    input_channels = layer.channels;
+    input_shift = output_shift;
+  }
+  primed_ = true;
+
+  // Hand the last activations to the rest of the graph
+  const Layer& last = layers_[layers_size_ - 1];
+  memcpy(context_->tensors[last.output_tensor].data.data, last.cache,
+         last.time_steps * last.channels);
+  for (int i = tail_start_; i < nodes_size_; i++) {
+#if EI_CLASSIFIER_PROFILING == 1
+    ScopedOperatorProfile scoped_profiler(profiler, nullptr, i);
+#endif
+    TfLiteStatus status = registrations_[i]->invoke(context_, &nodes_[i]);
+    if (status != kTfLiteOk) {
+      return status;
+    }
+  }
+  return kTfLiteOk;
+}
+
+void MicroStreamingExecutor::Reset() { primed_ = false; }
+
+void MicroStreamingExecutor::Free(void (*free_fnc)(void* ptr)) {
+  if (buffer_ && free_fnc) {
+    free_fnc(buffer_);
+  }
+  buffer_ = nullptr;
+  input_cache_ = nullptr;
+  input_dirty_ = nullptr;
+  layers_size_ = 0;
+  initialized_ = false;
+  primed_ = false;
+}
+
+}  // namespace tflite
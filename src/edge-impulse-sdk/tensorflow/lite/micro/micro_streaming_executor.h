@@ -0,0 +1,138 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_STREAMING_EXECUTOR_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_STREAMING_EXECUTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_time_major_utils.h"
+
+namespace tflite {
+
+// Incremental execution of 1D convolutional models over a sliding window.
+//
+// In continuous classification the window moves by one slice between calls,
+// so most time steps of the input are the ones of the previous call, shifted.
+// This executor keeps the output of every layer of the time-major prefix of
+// the graph (int8 CONV_2D with a 1-wide kernel across the time axis, ADD of a
+// constant per-channel vector, MAX_POOL_2D, and RESHAPEs that keep the
+// [time][channel] layout), and on every call only recomputes the output
+// columns whose receptive field saw new or changed input. The rest of the
+// graph (flatten, fully connected, softmax) runs through the registered
+// kernels as usual.
+//
+// Reuse is verified, not assumed: an input time step only counts as unchanged
+// if it is bit-identical to the step `shift` positions later in the previous
+// input, so the logits are always the same as a full invoke.
+class MicroStreamingExecutor {
+ public:
+  static constexpr int kMaxLayers = 16;
+
+  MicroStreamingExecutor();
+
+  // Analyze the graph and allocate the activation caches. The nodes must have
+  // been prepared. `registrations` holds the registration of every node.
+  // Returns kTfLiteError if the graph has no streamable prefix, the caller
+  // should run the full graph in that case.
+  TfLiteStatus Init(TfLiteContext* context, TfLiteNode* nodes,
+                    const TfLiteRegistration* const* registrations,
+                    int nodes_size, int input_tensor_index,
+                    void* (*alloc_fnc)(size_t, size_t));
+
+  // Run the graph on the current contents of the input tensor.
+  // `shift_elements` is the number of input elements the window moved since
+  // the previous call (the slice size), or -1 if unknown.
+  TfLiteStatus Invoke(int shift_elements);
+
+  // Forget the cached activations, the next invoke computes everything.
+  void Reset();
+
+  // Release the caches (allocated through alloc_fnc), also after a failed Init.
+  void Free(void (*free_fnc)(void* ptr));
+
+  bool initialized() const { return initialized_; }
+
+  // First node that runs through its registered kernel on every invoke.
+  int tail_start() const { return tail_start_; }
+
+  // Columns (time steps over all cached layers) computed by the last invoke,
+  // and the number a full invoke computes.
+  size_t recomputed_columns() const { return recomputed_columns_; }
+  size_t total_columns() const { return total_columns_; }
+
+ private:
+  enum LayerType { kConv, kAdd, kMaxPool };
+
+  struct Layer {
+    LayerType type;
+    int node_index;
+    int output_tensor;
+    int time_steps;  // output columns
+    int channels;    // output channels
+
+    TimeWindow window;  // conv / max pool
+
+    // conv
+    const int8_t* filter_data;
+    const int32_t* bias_data;
+    int32_t* per_channel_multiplier;
+    int32_t* per_channel_shift;
+    int32_t input_offset;
+    int32_t output_offset;
+    int32_t activation_min;  // also max pool
+    int32_t activation_max;
+
+    // add, the streamed tensor is input 1 or 2, the other is a constant vector
+    bool streamed_is_input1;
+    const int8_t* add_vector;
+    AddQuantParams add;
+
+    int8_t* cache;   // [time_steps][channels]
+    uint8_t* dirty;  // per column, recomputed by the last invoke
+  };
+
+  TfLiteStatus AddLayer(int node_index, Layer* layer);
+  void ComputeColumns(const Layer& layer, const int8_t* input,
+                      int input_time_steps, int input_channels, int start,
+                      int end);
+
+  TfLiteContext* context_;
+  TfLiteNode* nodes_;
+  const TfLiteRegistration* const* registrations_;
+  int nodes_size_;
+  int input_tensor_;
+  int tail_start_;
+
+  int input_time_steps_;
+  int input_channels_;
+  int8_t* input_cache_;
+  uint8_t* input_dirty_;
+
+  Layer layers_[kMaxLayers];
+  int layers_size_;
+
+  uint8_t* buffer_;  // holds all of the above
+  bool initialized_;
+  bool primed_;
+  size_t recomputed_columns_;
+  size_t total_columns_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_STREAMING_EXECUTOR_H_
@@ -0,0 +1,205 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_time_major_utils.h"
+
+#include <algorithm>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
+
+namespace tflite {
+
+namespace {
+
+// Input and output of a conv / pool that slides along the time axis only
+bool GetTimeMajorInputOutput(const TfLiteContext* context,
+                             const TfLiteNode* node, int* axis,
+                             int* input_time_steps, int* output_time_steps) {
+  if (node->inputs->size < 1 || node->outputs->size != 1) {
+    return false;
+  }
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  const TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+  int input_axis, output_axis, channels;
+  if (input->type != kTfLiteInt8 || output->type != kTfLiteInt8 ||
+      input->dims->size != 4 || output->dims->size != 4 ||
+      !GetTimeMajorShape(input, input_time_steps, &channels, &input_axis) ||
+      !GetTimeMajorShape(output, output_time_steps, &channels, &output_axis) ||
+      input_axis != output_axis) {
+    return false;
+  }
+  *axis = input_axis;
+  return true;
+}
+
+}  // namespace
+
+bool GetTimeMajorShape(const TfLiteTensor* tensor, int* time_steps,
+                       int* channels, int* axis) {
+  const TfLiteIntArray* dims = tensor->dims;
+  if (dims->size < 3 || dims->data[0] != 1) {
+    return false;
+  }
+  if (dims->size == 3) {
+    *axis = 1;
+  } else if (dims->size == 4 && dims->data[1] == 1) {
+    *axis = 2;
+  } else if (dims->size == 4 && dims->data[2] == 1) {
+    *axis = 1;
+  } else {
+    return false;
+  }
+  *time_steps = dims->data[*axis];
+  *channels = dims->data[dims->size - 1];
+  return true;
+}
+
+bool GetConvTimeWindow(const TfLiteContext* context, const TfLiteNode* node,
+                       TimeWindow* window) {
+  int axis, input_time_steps, output_time_steps;
+  if (node->inputs->size < 2 ||
+      !GetTimeMajorInputOutput(context, node, &axis, &input_time_steps,
+                               &output_time_steps)) {
+    return false;
+  }
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  const TfLiteTensor* filter = &context->tensors[node->inputs->data[1]];
+  if (node->inputs->size == 3 && node->inputs->data[2] >= 0 &&
+      context->tensors[node->inputs->data[2]].type != kTfLiteInt32) {
+    return false;
+  }
+  const bool time_on_height = axis == 1;
+  const int filter_height = filter->dims->data[1];
+  const int filter_width = filter->dims->data[2];
+  if (filter->type != kTfLiteInt8 ||
+      (time_on_height ? filter_width : filter_height) != 1) {
+    return false;
+  }
+
+  auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+  int output_height, output_width;
+  TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width,
+      params->dilation_height_factor, params->dilation_width_factor,
+      input->dims->data[1], input->dims->data[2], filter_height, filter_width,
+      params->padding, &output_height, &output_width);
+  if ((time_on_height ? output_height : output_width) != output_time_steps ||
+      (time_on_height ? output_width : output_height) != 1) {
+    return false;
+  }
+
+  window->stride = time_on_height ? params->stride_height : params->stride_width;
+  window->dilation = time_on_height ? params->dilation_height_factor
+                                    : params->dilation_width_factor;
+  window->filter = time_on_height ? filter_height : filter_width;
+  window->padding = time_on_height ? padding.height : padding.width;
+  return true;
+}
+
+bool GetMaxPoolTimeWindow(const TfLiteContext* context, const TfLiteNode* node,
+                          TimeWindow* window) {
+  int axis, input_time_steps, output_time_steps;
+  if (!GetTimeMajorInputOutput(context, node, &axis, &input_time_steps,
+                               &output_time_steps)) {
+    return false;
+  }
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
+  const bool time_on_height = axis == 1;
+  if ((time_on_height ? params->filter_width : params->filter_height) != 1) {
+    return false;
+  }
+
+  int output_height, output_width;
+  TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width, 1, 1, input->dims->data[1],
+      input->dims->data[2], params->filter_height, params->filter_width,
+      params->padding, &output_height, &output_width);
+  if ((time_on_height ? output_height : output_width) != output_time_steps ||
+      (time_on_height ? output_width : output_height) != 1) {
+    return false;
+  }
+
+  window->stride = time_on_height ? params->stride_height : params->stride_width;
+  window->dilation = 1;
+  window->filter = time_on_height ? params->filter_height : params->filter_width;
+  window->padding = time_on_height ? padding.height : padding.width;
+  return true;
+}
+
+int GetAddVectorInput(const TfLiteContext* context, const TfLiteNode* node) {
+  if (node->inputs->size != 2 || node->outputs->size != 1) {
+    return -1;
+  }
+  const TfLiteTensor* input1 = &context->tensors[node->inputs->data[0]];
+  const TfLiteTensor* input2 = &context->tensors[node->inputs->data[1]];
+  const TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+  const int streamed = IsConstantTensor(input1) ? 1 : 0;
+  const TfLiteTensor* activation = streamed == 0 ? input1 : input2;
+  const TfLiteTensor* vector = streamed == 0 ? input2 : input1;
+
+  int time_steps, channels, axis, output_time_steps, output_channels;
+  if (input1->type != kTfLiteInt8 || input2->type != kTfLiteInt8 ||
+      output->type != kTfLiteInt8 || !IsConstantTensor(vector) ||
+      !GetTimeMajorShape(activation, &time_steps, &channels, &axis) ||
+      !GetTimeMajorShape(output, &output_time_steps, &output_channels,
+                         &axis) ||
+      output_time_steps != time_steps || output_channels != channels ||
+      NumElements(vector) != channels) {
+    return -1;
+  }
+  return streamed;
+}
+
+TfLiteStatus GetAddQuantParams(TfLiteContext* context, const TfLiteNode* node,
+                               AddQuantParams* params) {
+  const TfLiteTensor* input1 = &context->tensors[node->inputs->data[0]];
+  const TfLiteTensor* input2 = &context->tensors[node->inputs->data[1]];
+  TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+
+  params->input1_offset = -input1->params.zero_point;
+  params->input2_offset = -input2->params.zero_point;
+  params->output_offset = output->params.zero_point;
+  params->left_shift = 20;
+  const double twice_max_input_scale =
+      2 * static_cast<double>(
+              std::max(input1->params.scale, input2->params.scale));
+  const double real_input1_multiplier =
+      static_cast<double>(input1->params.scale) / twice_max_input_scale;
+  const double real_input2_multiplier =
+      static_cast<double>(input2->params.scale) / twice_max_input_scale;
+  const double real_output_multiplier =
+      twice_max_input_scale /
+      ((1 << params->left_shift) * static_cast<double>(output->params.scale));
+  QuantizeMultiplierSmallerThanOneExp(real_input1_multiplier,
+                                      &params->input1_multiplier,
+                                      &params->input1_shift);
+  QuantizeMultiplierSmallerThanOneExp(real_input2_multiplier,
+                                      &params->input2_multiplier,
+                                      &params->input2_shift);
+  QuantizeMultiplierSmallerThanOneExp(real_output_multiplier,
+                                      &params->output_multiplier,
+                                      &params->output_shift);
+
+  auto* add_params = reinterpret_cast<TfLiteAddParams*>(node->builtin_data);
+  return CalculateActivationRangeQuantized(context, add_params->activation,
+                                           output, &params->activation_min,
+                                           &params->activation_max);
+}
+
+}  // namespace tflite
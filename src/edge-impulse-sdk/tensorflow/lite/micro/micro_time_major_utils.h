@@ -0,0 +1,84 @@
+/* Copyright 2020 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_TIME_MAJOR_UTILS_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_TIME_MAJOR_UTILS_H_
+
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+
+// Helpers for graph passes over 1D convolutional models, which TFLite
+// expresses as 2D ops on [1, 1, time, channels] or [1, time, 1, channels]
+// tensors with reshapes in between.
+
+namespace tflite {
+
+// Window of a conv or pool along the time axis.
+struct TimeWindow {
+  int stride;
+  int filter;
+  int dilation;
+  int padding;
+};
+
+// Quantization parameters of an int8 ADD, same as kernels/add.cpp.
+struct AddQuantParams {
+  int left_shift;
+  int32_t input1_offset;
+  int32_t input1_multiplier;
+  int input1_shift;
+  int32_t input2_offset;
+  int32_t input2_multiplier;
+  int input2_shift;
+  int32_t output_offset;
+  int32_t output_multiplier;
+  int output_shift;
+  int32_t activation_min;
+  int32_t activation_max;
+};
+
+// View an activation tensor as [time][channels]. Works for [1, time, channels],
+// [1, 1, time, channels] and [1, time, 1, channels], `axis` is the dimension
+// that holds the time steps.
+bool GetTimeMajorShape(const TfLiteTensor* tensor, int* time_steps,
+                       int* channels, int* axis);
+
+// Whether a registration is the given builtin op. The compiled models don't
+// set builtin_code, so this compares the invoke functions.
+inline bool IsRegistrationOf(const TfLiteRegistration* registration,
+                             const TfLiteRegistration* op) {
+  return registration->invoke == op->invoke;
+}
+
+// Time window of an int8 CONV_2D whose filter is 1 wide across the time axis.
+// Returns false for any other conv.
+bool GetConvTimeWindow(const TfLiteContext* context, const TfLiteNode* node,
+                       TimeWindow* window);
+
+// Time window of an int8 MAX_POOL_2D that is 1 wide across the time axis.
+// Returns false for any other pool.
+bool GetMaxPoolTimeWindow(const TfLiteContext* context, const TfLiteNode* node,
+                          TimeWindow* window);
+
+// Index (0 or 1) of the activation input of an int8 ADD of a constant vector
+// with one value per channel, -1 for any other add.
+int GetAddVectorInput(const TfLiteContext* context, const TfLiteNode* node);
+
+TfLiteStatus GetAddQuantParams(TfLiteContext* context, const TfLiteNode* node,
+                               AddQuantParams* params);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_TIME_MAJOR_UTILS_H_
@@ -40,6 +40,7 @@
 /* Includes ---------------------------------------------------------------- */
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 #include "edge-impulse-sdk/dsp/numpy.hpp"
+#include "edge-impulse-sdk/dsp/ring_buffer.hpp"
 #include "model-parameters/model_metadata.h"
 
 extern void ei_printf(const char *format, ...);
@@ -40,18 +40,15 @@
 /* probability threshold for name recognition */
 #define NAME_THRESHOLD 0.1
 
-/** Audio buffers, pointers and selectors */
+/** Audio ring buffer, filled from the PDM interrupt */
 typedef struct {
-    signed short *buffers[2];
-    unsigned char buf_select;
-    unsigned char buf_ready;
-    unsigned int buf_count;
+    ei::audio_ring_buffer ring;
     unsigned int n_samples;
+    uint32_t overrun_count;
 } inference_t;
 
 static inference_t inference;
-static bool record_ready = false;
-static signed short *sampleBuffer;
+static volatile bool record_ready = false;
 static bool debug_nn = false; // Set this to true to see e.g. features generated from the raw signal
 static int print_results = -(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
 
@@ -85,21 +82,21 @@ void setup()
 
 void loop()
 {
-      // This section was throing errors because of how I wait for the light to flicker on and off
-    /*
     bool m = microphone_inference_record();
     if (!m) {
         ei_printf("ERR: Failed to record audio...\n");
         return;
     }
-    */
 
     signal_t signal;
-    signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
-    signal.get_data = &microphone_audio_signal_get_data;
+    inference.ring.get_signal(EI_CLASSIFIER_SLICE_SIZE, &signal);
     ei_impulse_result_t result = {0};
 
     EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, debug_nn);
+
+    // the slice is classified, hand its samples back to the PDM interrupt
+    inference.ring.consume(EI_CLASSIFIER_SLICE_SIZE);
+
     if (r != EI_IMPULSE_OK) {
         ei_printf("ERR: Failed to run classifier (%d)\n", r);
         return;
@@ -155,25 +152,39 @@ void ei_printf(const char *format, ...) {
 
 /**
  * @brief      PDM buffer full callback
- *             Get data and call audio thread callback
+ *             Read the samples straight into the ring buffer
  */
 static void pdm_data_ready_inference_callback(void)
 {
     int bytesAvailable = PDM.available();
 
-    // read into the sample buffer
-    int bytesRead = PDM.read((char *)&sampleBuffer[0], bytesAvailable);
-
-    if (record_ready == true) {
-        for (int i = 0; i<bytesRead>> 1; i++) {
-            inference.buffers[inference.buf_select][inference.buf_count++] = sampleBuffer[i];
-
-            if (inference.buf_count >= inference.n_samples) {
-                inference.buf_select ^= 1;
-                inference.buf_count = 0;
-                inference.buf_ready = 1;
+    // the ring can wrap, so this takes at most two reads
+    while (bytesAvailable > 0) {
+        int16_t *span;
+        size_t span_samples = inference.ring.write_span(&span);
+
+        if (record_ready == false || span_samples == 0) {
+            // not recording, or the inference loop fell behind: drain the PDM buffer
+            int16_t discard[32];
+            int bytesToRead = bytesAvailable < (int)sizeof(discard) ? bytesAvailable : (int)sizeof(discard);
+            int bytesRead = PDM.read((char *)discard, bytesToRead);
+            if (bytesRead <= 0) {
+                break;
+            }
+            if (record_ready == true) {
+                inference.ring.mark_overrun(bytesRead >> 1);
             }
+            bytesAvailable -= bytesRead;
+            continue;
+        }
+
+        int spanBytes = (int)(span_samples * sizeof(int16_t));
+        int bytesRead = PDM.read((char *)span, bytesAvailable < spanBytes ? bytesAvailable : spanBytes);
+        if (bytesRead <= 0) {
+            break;
         }
+        inference.ring.commit(bytesRead >> 1);
+        bytesAvailable -= bytesRead;
     }
 }
 
@@ -186,31 +197,13 @@ static void pdm_data_ready_inference_callback(void)
  */
 static bool microphone_inference_start(uint32_t n_samples)
 {
-    inference.buffers[0] = (signed short *)malloc(n_samples * sizeof(signed short));
-
-    if (inference.buffers[0] == NULL) {
-        return false;
-    }
-
-    inference.buffers[1] = (signed short *)malloc(n_samples * sizeof(signed short));
-
-    if (inference.buffers[0] == NULL) {
-        free(inference.buffers[0]);
+    // room for the slice being classified and the slice being recorded, same as a double buffer
+    if (inference.ring.init(n_samples * 2) != 0) {
         return false;
     }
 
-    sampleBuffer = (signed short *)malloc((n_samples >> 1) * sizeof(signed short));
-
-    if (sampleBuffer == NULL) {
-        free(inference.buffers[0]);
-        free(inference.buffers[1]);
-        return false;
-    }
-
-    inference.buf_select = 0;
-    inference.buf_count = 0;
     inference.n_samples = n_samples;
-    inference.buf_ready = 0;
+    inference.overrun_count = 0;
 
     // configure the data receive callback
     PDM.onReceive(&pdm_data_ready_inference_callback);
@@ -241,41 +234,31 @@ static bool microphone_inference_record(void)
 {
     bool ret = true;
 
-    if (inference.buf_ready == 1) {
+    // only counts samples the interrupt really had to drop, not a slice that is merely ready early
+    uint32_t overrun_count = inference.ring.get_overrun_count();
+    if (overrun_count != inference.overrun_count) {
         ei_printf(
-            "Error sample buffer overrun. Decrease the number of slices per model window "
-            "(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)\n");
+            "Error sample buffer overrun (%u samples dropped). Decrease the number of slices per model window "
+            "(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)\n", (unsigned int)inference.ring.get_dropped_samples());
+        inference.overrun_count = overrun_count;
         ret = false;
     }
 
-    while (inference.buf_ready == 0) {
+    while (inference.ring.available() < inference.n_samples) {
         delay(1);
     }
 
-    inference.buf_ready = 0;
-
     return ret;
 }
 
-/**
- * Get raw audio signal data
- */
-static int microphone_audio_signal_get_data(size_t offset, size_t length, float *out_ptr)
-{
-    numpy::int16_to_float(&inference.buffers[inference.buf_select ^ 1][offset], out_ptr, length);
-
-    return 0;
-}
-
 /**
  * @brief      Stop PDM and release buffers
  */
 static void microphone_inference_end(void)
 {
     PDM.end();
-    free(inference.buffers[0]);
-    free(inference.buffers[1]);
-    free(sampleBuffer);
+    record_ready = false;
+    inference.ring.deinit();
 }
 
 #if !defined(EI_CLASSIFIER_SENSOR) || EI_CLASSIFIER_SENSOR != EI_CLASSIFIER_SENSOR_MICROPHONE
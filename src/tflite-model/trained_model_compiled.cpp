@@ -22,10 +22,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <vector>
+#include <new>
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_graph_optimizer.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_node_profiler.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_streaming_executor.h"
+#include "trained_model_compiled.h"
 
 #if defined __GNUC__
 #define ALIGN(X) __attribute__((aligned(X)))
@@ -37,7 +42,29 @@
 
 namespace {
 
-constexpr int kTensorArenaSize = 1600;
+// Arena map, recorded by running init / prepare of every node when the model
+// was generated. Tensors are at the start of the arena, the persistent
+// buffers of the kernels are allocated down from the end. Nothing is
+// allocated outside of the arena.
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+// tensors as planned after reshape elision and conv / add / pool fusion
+constexpr int kTensorBytes = 848;
+constexpr int kPersistentBufferBytes = 324;
+#elif EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN == 1
+// includes the arm_convolve_s8 buffers of both convs
+constexpr int kTensorBytes = 1277;
+constexpr int kPersistentBufferBytes = 596;
+#elif EI_CLASSIFIER_TFLITE_ENABLE_ARC == 1
+constexpr int kTensorBytes = 1277;
+constexpr int kPersistentBufferBytes = 316;
+#else
+constexpr int kTensorBytes = 1277;
+constexpr int kPersistentBufferBytes = 308;
+#endif
+// no kernel of this graph requests scratch buffers in the arena, a preprocessor
+// constant so the request path compiles out when there are none
+#define SCRATCH_BUFFER_COUNT 0
+constexpr int kTensorArenaSize = (kTensorBytes + kPersistentBufferBytes + 15) & ~15;
 
 #if defined(EI_CLASSIFIER_ALLOCATION_STATIC)
 uint8_t tensor_arena[kTensorArenaSize] ALIGN(16);
@@ -50,15 +77,15 @@ uint8_t tensor_arena[kTensorArenaSize] ALIGN(16);
 uint8_t* tensor_arena = NULL;
 #endif
 
-static uint8_t* tensor_boundary;
-static uint8_t* current_location;
-
 template <int SZ, class T> struct TfArray {
   int sz; T elem[SZ];
 };
 enum used_operators_e {
   OP_RESHAPE, OP_CONV_2D, OP_ADD, OP_MAX_POOL_2D, OP_FULLY_CONNECTED, OP_SOFTMAX,  OP_LAST
 };
+const char* const opNames[OP_LAST] = {
+  "RESHAPE", "CONV_2D", "ADD", "MAX_POOL_2D", "FULLY_CONNECTED", "SOFTMAX",
+};
 struct TensorInfo_t { // subset of TfLiteTensor used for initialization from constant memory
   TfLiteAllocationType allocation_type;
   TfLiteType type;
@@ -74,10 +101,6 @@ struct NodeInfo_t { // subset of TfLiteNode used for initialization from constan
   used_operators_e used_op_index;
 };
 
-TfLiteContext ctx{};
-TfLiteTensor tflTensors[31];
-TfLiteRegistration registrations[OP_LAST];
-TfLiteNode tflNodes[15];
 
 const TfArray<2, int> tensor_dimension0 = { 2, { 1,637 } };
 const TfArray<1, float> quant0_scale = { 1, { 0.047152537852525711, } };
@@ -320,34 +343,74 @@ const TensorInfo_t tensorData[] = {
   { (TfLiteIntArray*)&inputs13, (TfLiteIntArray*)&outputs13, const_cast<void*>(static_cast<const void*>(&opdata13)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs14, (TfLiteIntArray*)&outputs14, const_cast<void*>(static_cast<const void*>(&opdata14)), OP_SOFTMAX, },
 };
-static std::vector<void*> overflow_buffers;
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1 && EI_CLASSIFIER_TFLITE_STATIC_KERNELS == 1
+// nodes 1-5 and 7-11: conv, bias add + relu, max pool
+typedef tflite::static_shape::ConvBlock<49, 13, 8, 3, 1, 1, kTfLitePaddingSame, true, 2, 2, kTfLitePaddingSame> ConvBlock0;
+typedef tflite::static_shape::ConvBlock<25, 8, 16, 3, 1, 1, kTfLitePaddingSame, true, 2, 2, kTfLitePaddingSame> ConvBlock1;
+#endif
+#if SCRATCH_BUFFER_COUNT > 0
+typedef struct {
+  size_t bytes;
+  void *ptr;
+} scratch_buffer_t;
+#endif
+} // namespace
+
+// Everything that is written while running the model. The weights and the
+// tensor / node descriptions above are const and shared by all instances.
+struct trained_model_ctx {
+  TfLiteContext ctx;
+  TfLiteTensor tflTensors[31];
+  TfLiteRegistration registrations[OP_LAST];
+  TfLiteNode tflNodes[15];
+  const TfLiteRegistration* nodeRegistrations[15];
+  uint8_t* tensor_arena;
+  bool owns_arena;
+  uint8_t* tensor_boundary;
+  uint8_t* current_location;
+#if SCRATCH_BUFFER_COUNT > 0
+  scratch_buffer_t scratch_buffers[SCRATCH_BUFFER_COUNT];
+#endif
+  int scratch_buffers_size;
+  // caches for trained_model_invoke_streaming_ctx, set up by trained_model_init_ctx
+  tflite::MicroStreamingExecutor streaming;
+  bool streaming_unsupported;
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+  tflite::MicroGraphOptimizer optimizer;
+#endif
+};
+
+namespace {
+trained_model_ctx default_ctx{};
+
+trained_model_ctx *get_ctx(trained_model_ctx_t *model) {
+  return model ? model : &default_ctx;
+}
+
 static TfLiteStatus AllocatePersistentBuffer(struct TfLiteContext* ctx,
                                                  size_t bytes, void** ptr) {
-  if (current_location - bytes < tensor_boundary) {
-    // OK, this will look super weird, but.... we have CMSIS-NN buffers which
-    // we cannot calculate beforehand easily.
-    *ptr = malloc(bytes);
-    if (*ptr == NULL) {
-      printf("ERR: Failed to allocate persistent buffer of size %u\n", bytes);
-      return kTfLiteError;
-    }
-    overflow_buffers.push_back(*ptr);
-    return kTfLiteOk;
+  trained_model_ctx *model = static_cast<trained_model_ctx*>(ctx->impl_);
+  if (bytes > (size_t)(model->current_location - model->tensor_boundary)) {
+    // the kernels asked for more than the arena map has room for, the model
+    // was generated for another kernel set
+    printf("ERR: Failed to allocate persistent buffer of size %u, arena is too small\n", (unsigned)bytes);
+    return kTfLiteError;
   }
 
-  current_location -= bytes;
+  model->current_location -= bytes;
 
-  *ptr = current_location;
+  *ptr = model->current_location;
   return kTfLiteOk;
 }
-typedef struct {
-  size_t bytes;
-  void *ptr;
-} scratch_buffer_t;
-static std::vector<scratch_buffer_t> scratch_buffers;
 
 static TfLiteStatus RequestScratchBufferInArena(struct TfLiteContext* ctx, size_t bytes,
                                                 int* buffer_idx) {
+#if SCRATCH_BUFFER_COUNT > 0
+  trained_model_ctx *model = static_cast<trained_model_ctx*>(ctx->impl_);
+  if (model->scratch_buffers_size >= SCRATCH_BUFFER_COUNT) {
+    printf("ERR: Failed to allocate scratch buffer of size %u, not in the arena map\n", (unsigned)bytes);
+    return kTfLiteError;
+  }
   scratch_buffer_t b;
   b.bytes = bytes;
 
@@ -356,27 +419,80 @@ static TfLiteStatus RequestScratchBufferInArena(struct TfLiteContext* ctx, size_
     return s;
   }
 
-  scratch_buffers.push_back(b);
-
-  *buffer_idx = scratch_buffers.size() - 1;
+  model->scratch_buffers[model->scratch_buffers_size] = b;
+  *buffer_idx = model->scratch_buffers_size++;
 
   return kTfLiteOk;
+#else
+  (void)ctx;
+  (void)buffer_idx;
+  printf("ERR: Failed to allocate scratch buffer of size %u, not in the arena map\n", (unsigned)bytes);
+  return kTfLiteError;
+#endif
 }
 
 static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
-  if (buffer_idx > static_cast<int>(scratch_buffers.size()) - 1) {
+#if SCRATCH_BUFFER_COUNT > 0
+  trained_model_ctx *model = static_cast<trained_model_ctx*>(ctx->impl_);
+  if (buffer_idx < 0 || buffer_idx >= model->scratch_buffers_size) {
     return NULL;
   }
-  return scratch_buffers[buffer_idx].ptr;
+  return model->scratch_buffers[buffer_idx].ptr;
+#else
+  (void)ctx;
+  (void)buffer_idx;
+  return NULL;
+#endif
 }
 } // namespace
 
-  TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
+trained_model_ctx_t *trained_model_ctx_create() {
+  return new (std::nothrow) trained_model_ctx();
+}
+
+void trained_model_ctx_free(trained_model_ctx_t *model) {
+  if (model && model != &default_ctx) {
+    delete model;
+  }
+}
+
+static const int inTensorIndices[] = {
+  0,
+};
+static const int outTensorIndices[] = {
+  30,
+};
+
+TfLiteStatus trained_model_init_ctx( trained_model_ctx_t *model_ptr, void*(*alloc_fnc)(size_t,size_t) ) {
+  trained_model_ctx *model = get_ctx(model_ptr);
 #ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
+  model->tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
+  if (!model->tensor_arena) {
+    return kTfLiteError;
+  }
+  model->owns_arena = true;
+#else
+  // the default instance runs from the static arena, other instances get their own
+  if (model == &default_ctx) {
+    model->tensor_arena = tensor_arena;
+    model->owns_arena = false;
+  }
+  else {
+    model->tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
+    if (!model->tensor_arena) {
+      return kTfLiteError;
+    }
+    model->owns_arena = true;
+  }
 #endif
-  tensor_boundary = tensor_arena;
-  current_location = tensor_arena + kTensorArenaSize;
+  model->tensor_boundary = model->tensor_arena;
+  model->current_location = model->tensor_arena + kTensorArenaSize;
+  model->scratch_buffers_size = 0;
+  TfLiteContext &ctx = model->ctx;
+  TfLiteTensor *tflTensors = model->tflTensors;
+  TfLiteRegistration *registrations = model->registrations;
+  TfLiteNode *tflNodes = model->tflNodes;
+  ctx.impl_ = model;
   ctx.AllocatePersistentBuffer = &AllocatePersistentBuffer;
   ctx.RequestScratchBufferInArena = &RequestScratchBufferInArena;
   ctx.GetScratchBuffer = &GetScratchBuffer;
@@ -385,30 +501,28 @@ static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
   for(size_t i = 0; i < 31; ++i) {
     tflTensors[i].type = tensorData[i].type;
     tflTensors[i].is_variable = 0;
-    #if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
     tflTensors[i].allocation_type = tensorData[i].allocation_type;
-#else
-    tflTensors[i].allocation_type = (tensor_arena <= tensorData[i].data && tensorData[i].data < tensor_arena + kTensorArenaSize) ? kTfLiteArenaRw : kTfLiteMmapRo;
-#endif
     tflTensors[i].bytes = tensorData[i].bytes;
     tflTensors[i].dims = tensorData[i].dims;
-    #if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
     if(tflTensors[i].allocation_type == kTfLiteArenaRw){
-      uint8_t* start = (uint8_t*) ((uintptr_t)tensorData[i].data + (uintptr_t) tensor_arena);
+#if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
+      // tensor_arena was still NULL when tensorData was built, so data holds the offset
+      uintptr_t offset = (uintptr_t) tensorData[i].data;
+#else
+      uintptr_t offset = (uintptr_t) ((uint8_t*) tensorData[i].data - tensor_arena);
+#endif
+      uint8_t* start = model->tensor_arena + offset;
       uint8_t* end = start + tensorData[i].bytes;
 
      tflTensors[i].data.data =  start;
 
-     if (end > tensor_boundary) {
-       tensor_boundary = end;
+     if (end > model->tensor_boundary) {
+       model->tensor_boundary = end;
      }
     }
     else{
        tflTensors[i].data.data = tensorData[i].data;
     }
-#else
-    tflTensors[i].data.data = tensorData[i].data;
-#endif // EI_CLASSIFIER_ALLOCATION_HEAP
     tflTensors[i].quantization = tensorData[i].quantization;
     if (tflTensors[i].quantization.type == kTfLiteAffineQuantization) {
       TfLiteAffineQuantization const* quant = ((TfLiteAffineQuantization const*)(tensorData[i].quantization.params));
@@ -429,11 +543,43 @@ static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
     tflNodes[i].builtin_data = nodeData[i].builtin_data;
     tflNodes[i].custom_initial_data = nullptr;
     tflNodes[i].custom_initial_data_size = 0;
+    model->nodeRegistrations[i] = &registrations[nodeData[i].used_op_index];
+  }
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+  // kTensorArenaSize only fits the tensors of the optimized graph, the offsets
+  // above are replaced by the plan
+  model->tensor_boundary = model->tensor_arena;
+  if (model->optimizer.Init(&ctx, tflNodes, model->nodeRegistrations, 15, outTensorIndices, 1) != kTfLiteOk) {
+    return kTfLiteError;
+  }
+#if EI_CLASSIFIER_TFLITE_STATIC_KERNELS == 1
+  if (model->optimizer.SetBlockKernel(0, ConvBlock0::Shape(), &ConvBlock0::Eval) != kTfLiteOk ||
+      model->optimizer.SetBlockKernel(1, ConvBlock1::Shape(), &ConvBlock1::Eval) != kTfLiteOk) {
+    return kTfLiteError;
+  }
+#endif
+  size_t planned_bytes;
+  if (model->optimizer.PlanMemory(model->tensor_arena, model->current_location - model->tensor_arena, &planned_bytes) != kTfLiteOk) {
+    return kTfLiteError;
+  }
+  model->tensor_boundary = model->tensor_arena + planned_bytes;
+#endif
+  for(size_t i = 0; i < 15; ++i) {
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+    if (model->optimizer.IsFused(i)) {
+      continue;
+    }
+#endif
     if (registrations[nodeData[i].used_op_index].init) {
       tflNodes[i].user_data = registrations[nodeData[i].used_op_index].init(&ctx, (const char*)tflNodes[i].builtin_data, 0);
     }
   }
   for(size_t i = 0; i < 15; ++i) {
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+    if (model->optimizer.IsFused(i)) {
+      continue;
+    }
+#endif
     if (registrations[nodeData[i].used_op_index].prepare) {
       TfLiteStatus status = registrations[nodeData[i].used_op_index].prepare(&ctx, &tflNodes[i]);
       if (status != kTfLiteOk) {
@@ -441,41 +587,120 @@ static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
       }
     }
   }
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+  TfLiteStatus status = model->optimizer.Prepare();
+  if (status != kTfLiteOk) {
+    return status;
+  }
+#endif
+#if EI_CLASSIFIER_TFLITE_STREAMING == 1
+  // allocated here with the other persistent buffers, so a streaming invoke
+  // doesn't allocate. A graph the executor can't stream runs the full graph.
+  model->streaming_unsupported =
+    model->streaming.Init(&ctx, tflNodes, model->nodeRegistrations, 15,
+                          inTensorIndices[0], alloc_fnc) != kTfLiteOk;
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+  // the tail runs node by node, the intermediate tensors of fused nodes are gone
+  for (int i = model->streaming.tail_start(); i < 15 && !model->streaming_unsupported; i++) {
+    model->streaming_unsupported = model->optimizer.IsFused(i);
+  }
+#endif
+#endif
   return kTfLiteOk;
 }
 
-static const int inTensorIndices[] = {
-  0, 
-};
+TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
+  return trained_model_init_ctx(NULL, alloc_fnc);
+}
+
+TfLiteTensor* trained_model_input_ctx(trained_model_ctx_t *model, int index) {
+  return &get_ctx(model)->ctx.tensors[inTensorIndices[index]];
+}
 TfLiteTensor* trained_model_input(int index) {
-  return &ctx.tensors[inTensorIndices[index]];
+  return trained_model_input_ctx(NULL, index);
 }
 
-static const int outTensorIndices[] = {
-  30, 
-};
+TfLiteTensor* trained_model_output_ctx(trained_model_ctx_t *model, int index) {
+  return &get_ctx(model)->ctx.tensors[outTensorIndices[index]];
+}
 TfLiteTensor* trained_model_output(int index) {
-  return &ctx.tensors[outTensorIndices[index]];
+  return trained_model_output_ctx(NULL, index);
 }
 
-TfLiteStatus trained_model_invoke() {
+TfLiteStatus trained_model_invoke_ctx(trained_model_ctx_t *model_ptr) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+#if EI_CLASSIFIER_TFLITE_GRAPH_FUSION == 1
+  return model->optimizer.Invoke();
+#else
+#if EI_CLASSIFIER_PROFILING == 1
+  tflite::Profiler* profiler = reinterpret_cast<tflite::Profiler*>(model->ctx.profiler);
+#endif
   for(size_t i = 0; i < 15; ++i) {
-    TfLiteStatus status = registrations[nodeData[i].used_op_index].invoke(&ctx, &tflNodes[i]);
+#if EI_CLASSIFIER_PROFILING == 1
+    tflite::ScopedOperatorProfile scoped_profiler(profiler, nullptr, i);
+#endif
+    TfLiteStatus status = model->registrations[nodeData[i].used_op_index].invoke(&model->ctx, &model->tflNodes[i]);
     if (status != kTfLiteOk) {
       return status;
     }
   }
   return kTfLiteOk;
+#endif
+}
+TfLiteStatus trained_model_invoke() {
+  return trained_model_invoke_ctx(NULL);
 }
 
-TfLiteStatus trained_model_reset( void (*free_fnc)(void* ptr) ) {
-#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  free_fnc(tensor_arena);
-#endif
-  scratch_buffers.clear();
-  for (size_t ix = 0; ix < overflow_buffers.size(); ix++) {
-    free(overflow_buffers[ix]);
+TfLiteStatus trained_model_invoke_streaming_ctx(trained_model_ctx_t *model_ptr, int shift) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+  if (!model->streaming.initialized() || model->streaming_unsupported) {
+    return trained_model_invoke_ctx(model_ptr);
   }
-  overflow_buffers.clear();
+  return model->streaming.Invoke(shift);
+}
+TfLiteStatus trained_model_invoke_streaming(int shift) {
+  return trained_model_invoke_streaming_ctx(NULL, shift);
+}
+
+void trained_model_streaming_stats_ctx(trained_model_ctx_t *model_ptr, size_t *recomputed_columns, size_t *total_columns) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+  *recomputed_columns = model->streaming.recomputed_columns();
+  *total_columns = model->streaming.total_columns();
+}
+
+void trained_model_set_profiler_ctx(trained_model_ctx_t *model_ptr, tflite::MicroNodeProfiler *profiler) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+  if (profiler) {
+    for (int i = 0; i < 15; i++) {
+      profiler->SetNodeTag(i, opNames[nodeData[i].used_op_index]);
+    }
+  }
+  model->ctx.profiler = profiler;
+}
+
+void trained_model_arena_stats_ctx(trained_model_ctx_t *model_ptr, size_t *used_bytes, size_t *arena_bytes) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+  *arena_bytes = kTensorArenaSize;
+  *used_bytes = 0;
+  if (model->tensor_arena) {
+    // tensors grow up from the bottom, persistent buffers down from the top
+    *used_bytes = (model->tensor_boundary - model->tensor_arena) +
+      (model->tensor_arena + kTensorArenaSize - model->current_location);
+  }
+}
+
+TfLiteStatus trained_model_reset_ctx( trained_model_ctx_t *model_ptr, void (*free_fnc)(void* ptr) ) {
+  trained_model_ctx *model = get_ctx(model_ptr);
+  if (model->owns_arena && model->tensor_arena && free_fnc) {
+    free_fnc(model->tensor_arena);
+  }
+  model->tensor_arena = NULL;
+  model->owns_arena = false;
+  model->streaming.Free(free_fnc);
+  model->streaming_unsupported = false;
+  model->scratch_buffers_size = 0;
   return kTfLiteOk;
 }
+TfLiteStatus trained_model_reset( void (*free_fnc)(void* ptr) ) {
+  return trained_model_reset_ctx(NULL, free_fnc);
+}
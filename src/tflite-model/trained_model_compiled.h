@@ -25,6 +25,10 @@
 
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 
+namespace tflite {
+class MicroNodeProfiler;
+}
+
 // Sets up the model with init and prepare steps.
 TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) );
 // Returns the input tensor with the given index.
@@ -36,6 +40,38 @@ TfLiteStatus trained_model_invoke();
 //Frees memory allocated
 TfLiteStatus trained_model_reset( void (*free)(void* ptr) );
 
+// Model instance with its own arena and scratch buffers, the weights are shared
+// between all instances. The functions above use a default instance, to run the
+// model from several threads at once give every thread its own instance.
+typedef struct trained_model_ctx trained_model_ctx_t;
+// Creates a new (uninitialized) model instance
+trained_model_ctx_t *trained_model_ctx_create();
+// Releases a model instance, call trained_model_reset_ctx first
+void trained_model_ctx_free(trained_model_ctx_t *ctx);
+// Same as the functions above, for the given instance (NULL for the default instance)
+TfLiteStatus trained_model_init_ctx( trained_model_ctx_t *ctx, void*(*alloc_fnc)(size_t,size_t) );
+TfLiteTensor *trained_model_input_ctx(trained_model_ctx_t *ctx, int index);
+TfLiteTensor *trained_model_output_ctx(trained_model_ctx_t *ctx, int index);
+TfLiteStatus trained_model_invoke_ctx(trained_model_ctx_t *ctx);
+TfLiteStatus trained_model_reset_ctx( trained_model_ctx_t *ctx, void (*free)(void* ptr) );
+
+// Runs inference on a window that moved `shift` input elements since the last
+// call (-1 if unknown). Only the time steps of the convolutional layers that
+// saw new input are computed, the output is the same as trained_model_invoke.
+// The executor state is allocated by trained_model_init_ctx when built with
+// EI_CLASSIFIER_TFLITE_STREAMING=1, otherwise, or for graphs that can't be
+// streamed, this falls back to a full invoke.
+TfLiteStatus trained_model_invoke_streaming(int shift);
+TfLiteStatus trained_model_invoke_streaming_ctx(trained_model_ctx_t *ctx, int shift);
+// Time steps computed by the last streaming invoke, and by a full invoke
+void trained_model_streaming_stats_ctx(trained_model_ctx_t *ctx, size_t *recomputed_columns, size_t *total_columns);
+
+// Times every node with the profiler (only with EI_CLASSIFIER_PROFILING), fused
+// and streamed nodes count at the first node of their group. NULL detaches.
+void trained_model_set_profiler_ctx(trained_model_ctx_t *ctx, tflite::MicroNodeProfiler *profiler);
+// Bytes of the arena taken by tensors and persistent buffers, and its size
+void trained_model_arena_stats_ctx(trained_model_ctx_t *ctx, size_t *used_bytes, size_t *arena_bytes);
+
 
 // Returns the number of input tensors.
 inline size_t trained_model_inputs() {